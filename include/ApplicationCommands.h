@@ -20,5 +20,8 @@ crow::response installApplication(PersistentStore& store, const crow::request& r
 crow::response installAdHocApplication(PersistentStore& store, const crow::request& req);
 ///Update the application catalog
 crow::response updateCatalog(PersistentStore& store, const crow::request& req);
+///Fetch the latest indices of the application catalog's repositories
+///\return whether the indices were successfully updated
+bool refreshCatalog();
 
 #endif //SLATE_APPLICATION_COMMANDS_H
@@ -1,27 +1,160 @@
 #ifndef SLATE_ARCHIVE_H
 #define SLATE_ARCHIVE_H
 
+#include <cstddef>
 #include <istream>
 #include <map>
 #include <memory>
 #include <ostream>
 #include <string>
+#include <utility>
+#include <vector>
 
 ///Check whether a string has only valid base64 characters
 bool sanityCheckBase64(const std::string& str);
 
 ///Decode base64 encoded data
+///\throws std::runtime_error if the data contains characters which are not
+///        valid base64
 std::string decodeBase64(const std::string& coded);
 
 ///Encode data to base64
 std::string encodeBase64(const std::string& raw);
 
+///\return the exact number of characters needed to encode length bytes
+inline std::size_t base64EncodedLength(std::size_t length){
+	return (length+2)/3*4;
+}
+
+///\return an upper bound on the number of bytes produced by decoding length
+///        characters
+inline std::size_t base64DecodedLength(std::size_t length){
+	return (length+3)/4*3;
+}
+
+///Encode data to base64
+///\param data the data to encode
+///\param length the number of bytes of data
+///\param out the buffer to which to write the encoded data, which must have
+///           space for at least base64EncodedLength(length) characters
+///\return the number of characters written
+std::size_t encodeBase64(const char* data, std::size_t length, char* out);
+
+///Decode base64 encoded data, checking its validity in the same pass.
+///The data ends at the first '=' character, which should begin the padding; 
+///anything following it is ignored. Data is valid if all of the characters 
+///before that are base64 characters.
+///\param coded the data to decode
+///\param length the number of characters of coded data
+///\param out the buffer to which to write the decoded data, which must have
+///           space for at least base64DecodedLength(length) bytes
+///\param decodedLength set to the number of bytes written
+///\return whether the data was valid. If not, the contents of out are
+///        unspecified.
+bool decodeBase64(const char* coded, std::size_t length, char* out, std::size_t& decodedLength);
+
+///The implementations of the base64 codec which may be available
+enum class Base64Kernel{Scalar, SSSE3, AVX2};
+
+///\return the fastest base64 implementation supported by this processor
+Base64Kernel bestBase64Kernel();
+
+///Choose the base64 implementation to use, primarily for testing.
+///By default the fastest supported implementation is used.
+///\return whether the implementation is supported by this processor. If not,
+///        the implementation in use is unchanged.
+bool selectBase64Kernel(Base64Kernel kernel);
+
 ///decompress gzipped data from one stream to another
 void gzipDecompress(std::istream& src, std::ostream& dest);
 
 ///compress gzipped data from one stream to another
 void gzipCompress(std::istream& src, std::ostream& dest);
 
+///decompress gzipped data held in memory
+///\param data the compressed data
+///\param length the number of bytes of data
+///\return the decompressed data
+std::string gzipDecompress(const char* data, std::size_t length);
+
+///compress data held in memory to gzip format
+///\param data the data to compress
+///\param length the number of bytes of data
+///\param threads the number of threads to use, or zero to use one per
+///               processor core. With more than one thread large inputs are
+///               split into blocks which are compressed independently, at a
+///               small cost in compression ratio; the result is still a
+///               single gzip stream.
+///\return the compressed data
+std::string gzipCompress(const char* data, std::size_t length, unsigned int threads=1);
+
+///Decompress a gzipped tarball held in memory and extract its contents to the
+///filesystem in a single pass. File data is written directly from the
+///decompression buffer, so no complete copy of the uncompressed tarball, or of
+///any file in it, is ever held in memory.
+///\param data the compressed tarball
+///\param length the number of bytes of data
+///\param prefix the directory into which to extract. Files which would be
+///              placed outside of this directory are rejected.
+///\throws std::runtime_error if the data is not a valid gzipped tarball, or if
+///        extraction fails
+void extractGzippedTarball(const char* data, std::size_t length, const std::string& prefix);
+
+///Decompresses a gzipped tarball and extracts its contents to the filesystem
+///as the data arrives, for instance while it is being downloaded
+class GzippedTarballExtractor{
+public:
+	///\param prefix the directory into which to extract. Files which would be
+	///              placed outside of this directory are rejected.
+	explicit GzippedTarballExtractor(const std::string& prefix);
+	~GzippedTarballExtractor();
+	///Process the next portion of the compressed tarball
+	///\throws std::runtime_error if the data is not a valid gzipped tarball, 
+	///        or if extraction fails
+	void consume(const char* data, std::size_t length);
+	///Check that the complete tarball was received
+	///\throws std::runtime_error if the data ended prematurely
+	void finish();
+private:
+	class Impl;
+	std::unique_ptr<Impl> impl;
+};
+
+///An output stream which compresses the data written to it in gzip format,
+///passing the compressed data on to another stream as it is produced
+class GzipOutputStream : public std::ostream{
+public:
+	///\param dest the stream to which to write the compressed data
+	///\param threads the number of threads to use, or zero to use one per
+	///               processor core, as for gzipCompress
+	explicit GzipOutputStream(std::ostream& dest, unsigned int threads=1);
+	~GzipOutputStream();
+	///Compress all remaining data and write the gzip trailer. Called by the
+	///destructor if necessary, but should be called explicitly so that errors
+	///are reported.
+	///\throws std::runtime_error if compression or writing fails
+	void finish();
+private:
+	class Buffer;
+	std::unique_ptr<Buffer> buffer;
+};
+
+///An output stream which base64 encodes the data written to it, passing the
+///encoded data on to another stream as it is produced
+class Base64OutputStream : public std::ostream{
+public:
+	///\param dest the stream to which to write the encoded data
+	explicit Base64OutputStream(std::ostream& dest);
+	~Base64OutputStream();
+	///Encode all remaining data, with padding. Called by the destructor if
+	///necessary, but should be called explicitly so that errors are reported.
+	///\throws std::runtime_error if writing fails
+	void finish();
+private:
+	class Buffer;
+	std::unique_ptr<Buffer> buffer;
+};
+
 //A simple interface for reading a tarball
 //files are read in on demand, and can be dropped from memory when no longer needed
 //Once dropped, a file cannot be retrieved again
@@ -73,9 +206,20 @@ public:
 	typedef std::map<std::string,FileRecord>::const_reverse_iterator reverse_iterator;
 	
 	TarReader(std::istream& source);
+	///Read a tarball held in memory, such as a mapped file. The locations of
+	///all files are indexed when the reader is constructed, and file contents
+	///are read in place only when requested, so only the parts of the buffer
+	///which are needed are touched. In this mode files may be requested in any
+	///order, and remain available after being dropped.
+	///The buffer must outlive the reader.
+	TarReader(const char* data, std::size_t length);
 	
 	std::unique_ptr<std::istream> streamForFile(const std::string& name);
 	const std::string& stringForFile(const std::string& name);
+	///Get the contents of a file (or target of a symbolic link) without
+	///copying them. Only available for tarballs held in memory.
+	///\return a pointer to the file's contents and their length
+	std::pair<const char*,std::size_t> viewForFile(const std::string& name) const;
 	FileRecord::fileType typeForFile(const std::string& name);
 	int modeForFile(const std::string& name);
 	std::string nextFile();
@@ -85,11 +229,32 @@ public:
 	void extractToFileSystem(const std::string& prefix, bool dropAfterExtracting=true);
 	
 private:
+	///The location of a file within a tarball held in memory
+	struct IndexEntry{
+		FileRecord::fileType type;
+		int mode;
+		std::size_t offset;
+		std::size_t size;
+		std::string linkTarget;
+	};
+	
 	std::string readFiles(const std::string& target);
+	void buildIndex();
+	const IndexEntry& indexEntry(const std::string& name) const;
+	const FileRecord& recordForFile(const std::string& name);
 	
-	std::istream& src;
+	///The source stream, if the tarball is not held in memory
+	std::istream* src;
 	std::map<std::string,FileRecord> files;
 	bool fileEnded;
+	///The tarball, if it is held in memory
+	const char* buffer;
+	std::size_t bufferLength;
+	std::map<std::string,IndexEntry> index;
+	///The names of the indexed files, in the order they appear in the tarball
+	std::vector<std::string> archiveOrder;
+	///The position in archiveOrder of the next file to be returned by nextFile
+	std::size_t nextIndexed;
 };
 
 class TarWriter{
@@ -97,6 +262,12 @@ public:
 	TarWriter(std::ostream& s):sink(s),ended(false){}
 	~TarWriter(){ endStream(); }
 	void appendFile(const std::string& filepath, const std::string& data);
+	///Append a file whose contents are copied from a stream in fixed size
+	///chunks, so that they need not be held in memory
+	///\param filepath the path of the file within the archive
+	///\param data the stream from which to read the file's contents
+	///\param size the number of bytes to copy from data
+	void appendFile(const std::string& filepath, std::istream& data, unsigned long long size);
 	void appendDirectory(const std::string& path);
 	void appendSymLink(const std::string& filepath, const std::string& linkTarget);
 	///Must be called to write the (empty) footer records which signal the end 
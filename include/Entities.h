@@ -1,6 +1,7 @@
 #ifndef SLATE_ENTITIES_H
 #define SLATE_ENTITIES_H
 
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <random>
@@ -253,12 +254,8 @@ public:
 	/// - Each user's token should be unique
 	/// - There should be no way for anyone to derive or guess a user's token
 	///These requirements seem adequately satisfied by a block of 
-	///cryptographically random data. Note that boost::uuids::random_generator 
-	///uses /dev/urandom as a source of randomness, so this is not optimally
-	///secure on Linux hosts. 
-	std::string generateUserToken(){
-		return generateRawID()+generateRawID();
-	}
+	///cryptographically random data. 
+	std::string generateUserToken();
 	
 	const static std::string userIDPrefix;
 	const static std::string clusterIDPrefix;
@@ -267,10 +264,20 @@ public:
 	const static std::string secretIDPrefix;
 	
 private:
-	std::mutex mut;
-	std::random_device idSource;
-	
+	///Random data is drawn from a ChaCha20 keystream held separately by each 
+	///thread, so generating IDs requires no locking, and the operating 
+	///system's random source is only consulted to seed each thread's stream.
 	std::string generateRawID();
 } idGenerator;
 
+namespace detail{
+	///Compute one block of the ChaCha20 keystream (RFC 8439 section 2.3), from
+	///which the IDGenerator draws its random data
+	///\param key the key, as eight little-endian words
+	///\param nonce the nonce, as three little-endian words
+	///\param counter the block counter
+	///\param output destination for the 64 bytes of the block
+	void chacha20Block(const uint32_t key[8], const uint32_t nonce[3], uint32_t counter, unsigned char* output);
+}
+
 #endif //SLATE_ENTITIES_H
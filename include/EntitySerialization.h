@@ -0,0 +1,53 @@
+#ifndef SLATE_ENTITY_SERIALIZATION_H
+#define SLATE_ENTITY_SERIALIZATION_H
+
+#include <string>
+#include <vector>
+
+#include "Entities.h"
+#include "ServerUtilities.h"
+
+//Serializers which write the list representations of entities directly to a
+//JSON writer, without first building a DOM. Each function writes one complete
+//list item object: {"apiVersion":...,"kind":...,"metadata":{...}}
+
+///Write the list entry for a user
+void writeUserListEntry(JSONWriter& writer, const User& user);
+
+///Write the list entry for a group
+void writeGroupListEntry(JSONWriter& writer, const Group& group);
+
+///Write the list entry for a cluster
+///\param owningGroupName the name of the group which owns the cluster
+///\param locations the recorded locations of the cluster
+void writeClusterListEntry(JSONWriter& writer, const Cluster& cluster,
+                           const std::string& owningGroupName,
+                           const std::vector<GeoLocation>& locations);
+
+///Write the list entry for an application instance
+///\param groupName the name of the group which owns the instance
+///\param clusterName the name of the cluster on which the instance runs
+void writeInstanceListEntry(JSONWriter& writer, const ApplicationInstance& instance,
+                            const std::string& groupName, const std::string& clusterName);
+
+///Write the list entry for a secret
+///\param groupName the name of the group which owns the secret
+///\param clusterName the name of the cluster on which the secret is stored
+void writeSecretListEntry(JSONWriter& writer, const Secret& secret,
+                          const std::string& groupName, const std::string& clusterName);
+
+///Write a list entry which has already been serialized, such as one obtained
+///from one of the PersistentStore's fragment caches
+///\param fragment a complete, serialized list entry object
+void writeListFragment(JSONWriter& writer, const std::string& fragment);
+
+///Begin writing a list result, up to the opening of the items array
+void beginListResult(JSONWriter& writer);
+
+///Finish writing a list result begun with beginListResult
+void endListResult(JSONWriter& writer);
+
+///Strip any leading repository name from an application name
+std::string unqualifiedApplicationName(const std::string& application);
+
+#endif //SLATE_ENTITY_SERIALIZATION_H
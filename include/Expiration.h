@@ -0,0 +1,132 @@
+#ifndef SLATE_EXPIRATION_H
+#define SLATE_EXPIRATION_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+///A steady clock which is cheap to read, because it reports a time which a
+///background thread updates periodically, rather than querying the system.
+///It shares the epoch of std::chrono::steady_clock, so their time points may
+///be compared, and lags behind it by at most about one resolution interval.
+///The background thread also advances the expiration timing wheel.
+struct coarse_clock{
+	using duration=std::chrono::steady_clock::duration;
+	using rep=duration::rep;
+	using period=duration::period;
+	using time_point=std::chrono::steady_clock::time_point;
+	static constexpr bool is_steady=true;
+
+	///The interval at which the time is updated
+	static const std::chrono::milliseconds resolution;
+
+	///\return the time at the most recent update
+	static time_point now() noexcept{
+		rep ticks=currentTime.load(std::memory_order_relaxed);
+		if(ticks==0) //the background thread is not running yet
+			return start();
+		return time_point(duration(ticks));
+	}
+	
+	///Note that the background thread was not copied into a child process, so
+	///that the child starts its own when next the clock is read. Called 
+	///automatically after fork. The expiration wheel's lock must not be held 
+	///by another thread when the process forks, so processes which fork 
+	///without then calling exec should do so before reading the clock. 
+	static void restartAfterFork() noexcept;
+
+private:
+	///The most recent time read by the background thread, or zero if the
+	///thread has not been started in this process
+	static std::atomic<rep> currentTime;
+	///Whether starting the background thread has failed in this process, in 
+	///which case the system clock is read instead, without trying again
+	static std::atomic<bool> threadFailed;
+
+	///Start the background thread if it is not already running
+	///\return the current time
+	static time_point start() noexcept;
+};
+
+///An object holding entries which should be discarded after they expire
+class ExpiryTarget{
+public:
+	virtual ~ExpiryTarget(){}
+	///Discard the entries with the given keys, if they have in fact expired.
+	///An entry may have been replaced or refreshed since its expiration was
+	///scheduled, so implementations must check.
+	///\param keys the keys of the entries whose scheduled expiration times
+	///            have passed
+	virtual void reclaim(const std::vector<std::string>& keys)=0;
+};
+
+///Tracks the times at which entries expire, so that they can be reclaimed in
+///batches shortly afterwards. Times are rounded up to a whole number of ticks
+///and entries are held in a hierarchy of wheels of slots, so that scheduling
+///an entry and advancing past it each take constant time, however far in the
+///future it expires.
+class TimingWheel{
+public:
+	using time_point=std::chrono::steady_clock::time_point;
+
+	///\param resolution the duration of one tick
+	///\param start the time at which the wheel begins
+	TimingWheel(std::chrono::steady_clock::duration resolution, time_point start);
+	TimingWheel(const TimingWheel&)=delete;
+	TimingWheel& operator=(const TimingWheel&)=delete;
+
+	///Arrange for a key to be passed to a target once a time has passed.
+	///The target is only referenced weakly, so entries for a target which
+	///has been destroyed are simply dropped.
+	///\param deadline the time after which the key should be reclaimed
+	///\param target the object to which the key should be passed
+	///\param key the key of the entry which expires
+	void schedule(time_point deadline, const std::shared_ptr<ExpiryTarget>& target, std::string key);
+
+	///Advance the wheel, passing the keys of all entries whose times have
+	///passed to their targets, grouped so that each target is called once.
+	///The targets are called after the wheel's lock is released, so they may
+	///schedule further entries.
+	///\param now the current time
+	void advance(time_point now);
+
+	///\return the number of entries which have not yet been reclaimed
+	std::size_t size() const;
+
+private:
+	constexpr static unsigned int slotBits=6;
+	constexpr static unsigned int slotsPerLevel=1u<<slotBits;
+	constexpr static unsigned int levels=4;
+
+	struct Entry{
+		std::uint64_t tick;
+		std::weak_ptr<ExpiryTarget> target;
+		std::string key;
+	};
+
+	const std::chrono::steady_clock::duration resolution;
+	const time_point start;
+	///The last tick which has been processed
+	std::uint64_t currentTick;
+	///The number of entries held in all slots
+	std::size_t count;
+	///Each level's slots span slotsPerLevel times as many ticks as the
+	///level below's; entries move down a level as their times approach
+	std::vector<Entry> slots[levels][slotsPerLevel];
+	mutable std::mutex mut;
+
+	///Put an entry into the slot for its time. Must be called with the lock
+	///held.
+	///\param entry the entry to place
+	///\param due destination for the entry if its time has already passed
+	void place(Entry&& entry, std::vector<Entry>& due);
+};
+
+///\return the timing wheel which the coarse clock's background thread advances
+TimingWheel& expirationWheel();
+
+#endif //SLATE_EXPIRATION_H
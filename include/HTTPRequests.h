@@ -1,17 +1,102 @@
 #ifndef SLATE_HTTPREQUESTS_H
 #define SLATE_HTTPREQUESTS_H
 
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
 ///Trivial HTTP(S) request wrappers around libcurl. 
 namespace httpRequests{
 
+namespace detail{
+	struct SessionState;
+	class CurlHandle;
+}
+
+///A pool of libcurl handles which share a DNS cache, TLS session cache, and
+///connection cache, so that a series of requests to the same server need not
+///each resolve its name, connect, and perform a TLS handshake. 
+///Sessions may be used concurrently from multiple threads.
+class Session{
+public:
+	Session();
+	~Session();
+	Session(const Session&)=delete;
+	Session& operator=(const Session&)=delete;
+private:
+	std::unique_ptr<detail::SessionState> state;
+	friend class detail::CurlHandle;
+};
+
+///A store on disk of the responses to earlier GET requests, which allows them
+///to be reused by later runs of the program. Entries are named by a hash of 
+///the request URL, so that credentials embedded in URLs are not recorded. 
+///Responses are reused without contacting the server only while they are 
+///younger than a request's Options::maxAge, and are otherwise revalidated 
+///using their entity tags, if they have them. Entries which have not been 
+///stored or revalidated for a long time are discarded, as are the least 
+///recently used entries when the cache grows too large. 
+class ResponseCache{
+public:
+	///\param directory the directory in which to store responses. It is 
+	///                 created, accessible only to the current user, if it 
+	///                 does not exist. 
+	///\param maxSize the total size in bytes of the entries beyond which the 
+	///               least recently stored or revalidated are discarded
+	///\param maxEntryAge the time since being stored or revalidated after 
+	///                   which entries are discarded
+	///\throws std::runtime_error if the directory cannot be created
+	explicit ResponseCache(std::string directory, 
+	                       std::size_t maxSize=64UL<<20, 
+	                       std::chrono::seconds maxEntryAge=std::chrono::hours(7*24));
+	
+	///Find a stored response
+	///\param url the URL which was requested
+	///\param etag set to the entity tag of the response, if it had one
+	///\param body set to the body of the response
+	///\param age set to the time since the response was stored or revalidated
+	///\return whether a response was found
+	bool lookup(const std::string& url, std::string& etag, std::string& body, 
+	            std::chrono::seconds& age) const;
+	///Store a response, replacing any earlier response for the same URL
+	void store(const std::string& url, const std::string& etag, const std::string& body);
+	///Record that a stored response has been confirmed to be current
+	void refresh(const std::string& url);
+	///Discard all stored responses, because data on the server has changed
+	void clear();
+	
+private:
+	const std::string directory;
+	
+	std::string pathFor(const std::string& url) const;
+	///Discard entries which are too old, and then the oldest remaining 
+	///entries until the total size is within the limit
+	void evict(std::size_t maxSize, std::chrono::seconds maxEntryAge);
+};
+
 struct Options{
-	Options():contentType("application/octet-stream"){}
+	Options():contentType("application/octet-stream"),session(nullptr),
+	cache(nullptr),maxAge(0){}
 	///value to use for the HTTP ContentType header.
 	///Only meaningful for POST and PUT operations
 	std::string contentType;
 	///If non-empty, the value to set as curl's CURLOPT_CAINFO for SSL 
 	///certificate verification. 
 	std::string caBundlePath;
+	///If set, the session whose connections should be used for the request.
+	///Otherwise the request uses a connection of its own. 
+	Session* session;
+	///If set, the cache from which GET requests may be answered, and which
+	///successful requests of other kinds invalidate. Otherwise GET requests use
+	///a cache which lasts only as long as the process. 
+	ResponseCache* cache;
+	///How old a response from the cache may be and still be used without 
+	///checking with the server
+	std::chrono::seconds maxAge;
 };
 	
 ///The result of an HTTP(S) request
@@ -20,12 +105,33 @@ struct Response{
 	unsigned int status;
 	///The data received as the body of the response
 	std::string body;
+	///The number of seconds after which the server asked that the request be 
+	///retried, or zero if it did not. Only collected for POST requests. 
+	unsigned long retryAfter;
 };
 	
-///Make an HTTP(S) GET request
+///Make an HTTP(S) GET request. 
+///If an earlier response for the same URL carried an entity tag, the tag is 
+///sent as a validator, and if the server reports that the data is unchanged 
+///the earlier response body is returned (with status 200). If a persistent 
+///cache is specified in the options, and it holds a sufficiently recent 
+///response, that response is returned without contacting the server. 
 ///\param url the URL to request
 Response httpGet(const std::string& url, const Options& options={});
 	
+///Make an HTTP(S) GET request, passing the body of the response to a sink as 
+///it arrives rather than collecting it. 
+///Entity tag validators are neither sent nor recorded. 
+///\param url the URL to request
+///\param sink a function which is called with each portion of the response 
+///            body, in order, if the request is successful (status 2xx). The 
+///            bodies of other responses, which are generally short error 
+///            descriptions, are instead collected in the returned Response. 
+///\throws any exception thrown by the sink, which also ends the request
+Response httpGetStreaming(const std::string& url, 
+                          const std::function<void(const char*,std::size_t)>& sink,
+                          const Options& options={});
+	
 ///Make an HTTP(S) DELETE request
 ///\param url the URL to request
 Response httpDelete(const std::string& url, const Options& options={});
@@ -43,6 +149,45 @@ Response httpPut(const std::string& url, const std::string& body,
 ///\param contentType the value to use for the HTTP ContentType header
 Response httpPost(const std::string& url, const std::string& body, 
                   const Options& options={});
+
+///Make an HTTP(S) POST request whose body is produced while it is being sent,
+///so that the complete body need never be held in memory. The body is sent
+///with chunked transfer encoding.
+///\param url the URL to request
+///\param writeBody a function which writes the body of the request to the 
+///                 stream it is given. It is run on a separate thread, and 
+///                 writes to the stream block while the data is in transit.
+///\throws any exception thrown by writeBody which prevented the request from
+///        being completed
+Response httpPostStreaming(const std::string& url, 
+                           const std::function<void(std::ostream&)>& writeBody,
+                           const Options& options={});
+
+///A description of one of a batch of requests
+struct Request{
+	enum class Method{Get,Put,Post,Delete};
+	Method method;
+	///The URL to request
+	std::string url;
+	///The data to send as the body of the request, for PUT and POST requests
+	std::string body;
+	Options options;
+};
+
+///Make several HTTP(S) requests concurrently, using a single thread. 
+///Blocks until all of the requests are complete. GET requests use and update 
+///the same entity tag validators as httpGet. 
+///\param requests the requests to make
+///\param maxConcurrent the maximum number of requests to have in progress at 
+///                     any time
+///\param onComplete if set, called as each request completes, with the index 
+///                  of the request and its result, which is ready
+///\return the result of each request, in the same order as the requests. If a
+///        request could not be made, its result holds the exception 
+///        describing why. 
+std::vector<std::future<Response>> 
+httpBatch(const std::vector<Request>& requests, unsigned int maxConcurrent=8,
+          const std::function<void(std::size_t,std::future<Response>&)>& onComplete={});
 	
 }
 
@@ -0,0 +1,84 @@
+#ifndef SLATE_KUBE_OUTPUT_H
+#define SLATE_KUBE_OUTPUT_H
+
+#include <string>
+#include <vector>
+
+///Parsers for the machine-readable (JSON) output of helm and kubectl.
+///These read the output as a stream of events, picking out only the fields
+///which are needed, rather than building a document tree or splitting
+///human-oriented tables into lines and columns. The output of both helm 2 and
+///helm 3 is understood; output which matches neither is rejected, rather than
+///being taken to list nothing. 
+namespace kubernetes{
+
+///A chart listed by `helm search --output json`
+struct ChartInfo{
+	///The chart name, including the repository prefix
+	std::string name;
+	std::string chartVersion;
+	std::string appVersion;
+	std::string description;
+};
+
+///A release listed by `helm list --output json`
+struct ReleaseInfo{
+	std::string name;
+	unsigned int revision=0;
+	///The time of the last update, in helm's human-readable format
+	std::string updated;
+	std::string status;
+	///The chart name and version
+	std::string chart;
+	std::string appVersion;
+	std::string namespaceName;
+};
+
+///One page of the releases listed by `helm list --output json`
+struct ReleaseList{
+	std::vector<ReleaseInfo> releases;
+	///The name of the first release on the next page, which should be passed
+	///to `helm list --offset` to fetch it, or empty if this is the last page.
+	///Always empty for helm 3, which does not divide the list into pages.
+	std::string next;
+};
+
+///\param output the output of `helm search --output json`
+///\return the charts which were found, in the order helm listed them
+///\throws std::runtime_error if the output is not valid, or any chart has no
+///                           name
+std::vector<ChartInfo> parseHelmSearch(const std::string& output);
+
+///\param output the output of `helm list --output json`
+///\return the releases which were listed
+///\throws std::runtime_error if the output is not valid, lacks the list of 
+///                           releases, or any release has no name
+ReleaseList parseHelmList(const std::string& output);
+
+///\param output the output of `helm status --output json`, which for helm 3 
+///              must also have been given --show-resources
+///\return the names of the pods belonging to the release
+///\throws std::runtime_error if the output is not valid or does not list the
+///                           release's resources
+std::vector<std::string> parseHelmStatusPods(const std::string& output);
+
+///\param output the output of `kubectl get <kind> -o=json`
+///\return the names (metadata.name) of all of the listed items
+///\throws std::runtime_error if the output is not valid
+std::vector<std::string> parseItemNames(const std::string& output);
+
+///\param output the output of 
+///              `kubectl get <kind> -o=custom-columns=NAME:.metadata.name --no-headers`,
+///              which lists only names, so that the contents of the objects 
+///              (such as the data of secrets) are never fetched
+///\return the listed names, one per non-blank line of the output
+std::vector<std::string> parseNameColumn(const std::string& output);
+
+///\param output the output of `kubectl get pod <name> -o=json`
+///\return the names of the pod's containers
+///\throws std::runtime_error if the output is not valid
+std::vector<std::string> parsePodContainerNames(const std::string& output);
+
+}
+
+#endif //SLATE_KUBE_OUTPUT_H
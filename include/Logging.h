@@ -1,22 +1,96 @@
 #ifndef SLATE_LOGGING_H
 #define SLATE_LOGGING_H
 
+#include <atomic>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
+#include <string>
 
 #include "Utilities.h"
 
+///Backend for the log_* macros.
+///Messages are formatted on the calling thread and then placed in a per-thread
+///ring buffer, from which a background thread collects them and writes them
+///to stdout (informational messages) or stderr (everything else). Until the
+///background writer is started, messages are written synchronously.
+namespace logging{
+
+enum Level{
+	Info=0,
+	Warning=1,
+	Error=2,
+	Fatal=3,
+};
+
+enum Format{
+	///"LEVEL: [timestamp] message"
+	Text,
+	///One JSON object per line, with "time", "level", and "message" members
+	JSONLines,
+};
+
+namespace detail{
+	extern std::atomic<int> minimumLevel;
+}
+
+///\return whether messages at the given level are currently being recorded
+inline bool enabled(Level level){
+	return level>=detail::minimumLevel.load(std::memory_order_relaxed);
+}
+
+///Change the minimum level of messages which will be recorded.
+///May be called at any time. Fatal messages are always recorded.
+void setLevel(Level level);
+
+///Arrange for SIGUSR1 to lower the minimum level of recorded messages by one 
+///step (making logging more verbose), and SIGUSR2 to raise it by one step, so 
+///that the level can be changed while the server is running. 
+void handleLevelSignals();
+
+///Interpret a level name
+///\param name one of "info", "warning", "error", or "fatal" (case insensitive)
+///\throws std::runtime_error if the name is not recognized
+Level parseLevel(const std::string& name);
+
+///Change the format in which messages are written. May be called at any time.
+void setFormat(Format format);
+
+///Begin writing messages from a background thread.
+///Has no effect if the writer is already running.
+void startWriter();
+
+///Write all outstanding messages and return to writing messages synchronously
+void stopWriter();
+
+///Block until all messages submitted by any thread before this call have
+///been written
+void flush();
+
+///Record a message
+///\param level the severity of the message
+///\param message the fully formatted message text
+void submit(Level level, std::string&& message);
+
+} //namespace logging
+
+#define slate_log_at_level_(level, msg) \
+do{ \
+	if(logging::enabled(level)){ \
+		std::ostringstream log_str_; \
+		log_str_ << msg; \
+		logging::submit(level, log_str_.str()); \
+	} \
+}while(0)
+
 ///Log an informational message to stdout
-#define log_info(msg) \
-do{ std::cout << "INFO: [" << timestamp() << "] " << msg << std::endl; }while(0)
+#define log_info(msg) slate_log_at_level_(logging::Info, msg)
 
 ///Log that an error or problem has occurred to stderr
-#define log_warn(msg) \
-do{ std::cerr << "WARNING: [" << timestamp() << "] " << msg << std::endl; }while(0)
+#define log_warn(msg) slate_log_at_level_(logging::Warning, msg)
 
 ///Log that an error or problem has occurred to stderr
-#define log_error(msg) \
-do{ std::cerr << "ERROR: [" << timestamp() << "] " << msg << std::endl; }while(0)
+#define log_error(msg) slate_log_at_level_(logging::Error, msg)
 
 ///Log an error to stderr and abort the current activity by throwing an exception
 ///\throws std::runtime_error
@@ -24,7 +98,7 @@ do{ std::cerr << "ERROR: [" << timestamp() << "] " << msg << std::endl; }while(0
 do{ \
 	std::ostringstream str; \
 	str << msg; \
-	std::cerr << "FATAL: [" << timestamp() << "] " << str.str() << std::endl; \
+	logging::submit(logging::Fatal, str.str()); \
 	throw std::runtime_error(str.str()); \
 }while(0)
 
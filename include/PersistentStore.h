@@ -1,10 +1,12 @@
 #ifndef SLATE_PERSISTENT_STORE_H
 #define SLATE_PERSISTENT_STORE_H
 
+#include <algorithm>
 #include <atomic>
 #include <memory>
 #include <set>
 #include <string>
+#include <vector>
 
 #include <aws/core/Aws.h>
 #include <aws/core/auth/AWSCredentialsProvider.h>
@@ -14,7 +16,9 @@
 
 #include <concurrent_multimap.h>
 #include <Entities.h>
+#include <Expiration.h>
 #include <FileHandle.h>
+#include <WorkerProcesses.h>
 
 //In libstdc++ versions < 5 std::atomic seems to be broken for non-integral types
 //In that case, we must use our own, minimal replacement
@@ -53,7 +57,7 @@ struct CacheRecord{
 	///\param validity duration until the record expires
 	template <typename DurationType>
 	CacheRecord(const RecordType& record, DurationType validity):
-	record(record),expirationTime(steady_clock::now()+validity){}
+	record(record),expirationTime(coarse_clock::now()+validity){}
 	
 	///\param exprTime the time after which the record expires
 	CacheRecord(RecordType&& record, steady_clock::time_point exprTime):
@@ -62,14 +66,14 @@ struct CacheRecord{
 	///\param validity duration until the record expires
 	template <typename DurationType>
 	CacheRecord(RecordType&& record, DurationType validity):
-	record(std::move(record)),expirationTime(steady_clock::now()+validity){}
+	record(std::move(record)),expirationTime(coarse_clock::now()+validity){}
 	
 	///\return whether the record's expiration time has passed and it should 
 	///        be discarded
-	bool expired() const{ return (steady_clock::now() > expirationTime); }
+	bool expired() const{ return (coarse_clock::now() > expirationTime); }
 	///\return whether the record has not yet expired, so it is still valid
 	///        for use
-	operator bool() const{ return (steady_clock::now() <= expirationTime); }
+	operator bool() const{ return (coarse_clock::now() <= expirationTime); }
 	///Implicit conversion to RecordType
 	///\return the data stored in the record
 	///This function is not available when it would be ambiguous because the 
@@ -110,8 +114,320 @@ struct hash<std::set<T>>{
 };
 }
 
+///A cache of records which are removed soon after they expire, rather than 
+///remaining until they are next looked up or the cache is cleared. Only 
+///operations which keep the expiration schedule consistent are exposed. 
+template <typename RecordType>
+class ExpiringCache{
+public:
+	using record_type=CacheRecord<RecordType>;
+	using time_point=std::chrono::steady_clock::time_point;
+	
+	ExpiringCache():reclaimer(std::make_shared<Reclaimer>(*this)),retention(nullptr){}
+	~ExpiringCache(){ reclaimer->detach(); }
+	ExpiringCache(const ExpiringCache&)=delete;
+	ExpiringCache& operator=(const ExpiringCache&)=delete;
+	
+	///Keep expired records while a cache-wide expiration time has not passed,
+	///for caches whose entire contents are listed while that time is valid.
+	///\param until the cache-wide expiration time, which must outlive the cache
+	void retainUntil(const slate_atomic<time_point>& until){ retention=&until; }
+	
+	///Look up a record, which may have expired but not yet been reclaimed
+	///\param key the key for which to search
+	///\param record set to the record found, if any
+	///\return whether a record was found
+	template <typename K>
+	bool find(const K& key, record_type& record) const{
+		return data.find(key,record);
+	}
+	
+	template <typename K>
+	bool contains(const K& key) const{
+		return data.contains(key);
+	}
+	
+	///Insert or replace a record. Expiration is scheduled only for a key which
+	///was not present; when a replaced record's old expiration passes, the 
+	///record is instead scheduled again for its new expiration time. A record 
+	///which replaces one expiring later is therefore reclaimed late, which is 
+	///harmless since lookups check the expiration of what they find.
+	template <typename K, typename V>
+	bool insert_or_assign(K&& key, V&& val){
+		const record_type& record=val;
+		std::string keyCopy(key);
+		bool result=data.insert_or_assign(std::forward<K>(key),record);
+		if(result)
+			expirationWheel().schedule(record.expirationTime,reclaimer,std::move(keyCopy));
+		return result;
+	}
+	
+	///Insert a record only if the key is not already present
+	template <typename K, typename... Args>
+	bool insert(K&& key, Args&&... args){
+		record_type record(std::forward<Args>(args)...);
+		time_point expiration=record.expirationTime;
+		std::string keyCopy(key);
+		bool result=data.insert(std::forward<K>(key),std::move(record));
+		if(result)
+			expirationWheel().schedule(expiration,reclaimer,std::move(keyCopy));
+		return result;
+	}
+	
+	///Remove a record. Its scheduled expiration is left to find nothing.
+	template <typename K>
+	bool erase(const K& key){
+		return data.erase(key);
+	}
+	
+	void clear(){ data.clear(); }
+	
+	///Call a function with each record in the cache, while holding the locks
+	///on the whole cache, so the function must not use the cache itself
+	template <typename Fn>
+	void for_each(Fn fn){
+		auto table=data.lock_table();
+		for(const auto& item : table)
+			fn(item.second);
+	}
+	
+private:
+	///The object through which the timing wheel refers to the cache, which 
+	///stops forwarding to it once it is destroyed
+	class Reclaimer : public ExpiryTarget{
+	public:
+		explicit Reclaimer(ExpiringCache& cache):cache(&cache){}
+		void reclaim(const std::vector<std::string>& keys) override{
+			std::lock_guard<std::mutex> lock(mut);
+			if(cache)
+				cache->reclaim(keys);
+		}
+		void detach(){
+			std::lock_guard<std::mutex> lock(mut);
+			cache=nullptr;
+		}
+	private:
+		std::mutex mut;
+		ExpiringCache* cache;
+	};
+	
+	cuckoohash_map<std::string,record_type> data;
+	std::shared_ptr<Reclaimer> reclaimer;
+	const slate_atomic<time_point>* retention;
+	
+	void reclaim(std::vector<std::string> keys){
+		const time_point now=coarse_clock::now();
+		const time_point retainedUntil=(retention ? retention->load() : time_point());
+		//a key erased and inserted again may have been scheduled more than once
+		std::sort(keys.begin(),keys.end());
+		keys.erase(std::unique(keys.begin(),keys.end()),keys.end());
+		std::vector<std::pair<time_point,std::string>> kept;
+		for(const auto& key : keys){
+			data.erase_fn(key,[&](const record_type& record){
+				//a record which has not expired was replaced after this 
+				//expiration was scheduled, so wait for its own expiration
+				if(record.expirationTime>=now){
+					kept.emplace_back(record.expirationTime,key);
+					return false;
+				}
+				if(retainedUntil>now){
+					kept.emplace_back(retainedUntil,key);
+					return false;
+				}
+				return true;
+			});
+		}
+		for(auto& entry : kept)
+			expirationWheel().schedule(entry.first,reclaimer,std::move(entry.second));
+	}
+};
+
+///A multimap of records in which each record, and each category, is removed
+///soon after it expires. The records in a category which has not expired are
+///all kept, since the category's contents may be listed while it is valid. 
+///Only operations which keep the expiration schedule consistent are exposed. 
+template <typename RecordType>
+class ExpiringMultimap{
+	using map_type=concurrent_multimap<std::string,CacheRecord<RecordType>>;
+public:
+	using record_type=CacheRecord<RecordType>;
+	using category_type=typename map_type::category_type;
+	using size_type=typename map_type::size_type;
+	using time_point=std::chrono::steady_clock::time_point;
+	
+	ExpiringMultimap():reclaimer(std::make_shared<Reclaimer>(*this)){}
+	~ExpiringMultimap(){ reclaimer->detach(); }
+	ExpiringMultimap(const ExpiringMultimap&)=delete;
+	ExpiringMultimap& operator=(const ExpiringMultimap&)=delete;
+	
+	///\return a snapshot of the records in a category, and the category's 
+	///        expiration time
+	template <typename K>
+	category_type find(const K& key) const{
+		return data.find(key);
+	}
+	
+	///Look up a record within a category
+	///\param key the category in which to search
+	///\param record the record for which to search, replaced by the stored 
+	///              version if it is found
+	///\return whether the record was found
+	template <typename K>
+	bool find(const K& key, record_type& record) const{
+		return data.find(key,record);
+	}
+	
+	template <typename K>
+	bool contains(const K& key) const{
+		return data.contains(key);
+	}
+	
+	template <typename K>
+	size_type count(const K& key) const{
+		return data.count(key);
+	}
+	
+	///Insert or replace a record. Expiration is scheduled only when a new 
+	///category is created; each time a category's scheduled expiration passes
+	///it is scheduled again for the earliest expiration among the records
+	///which remain, so a record expiring sooner than those already present is
+	///reclaimed late, which is harmless since lookups check expiration.
+	template <typename K, typename V>
+	bool insert_or_assign(K&& key, V&& val){
+		const record_type& record=val;
+		std::string keyCopy(key);
+		bool newKey=false;
+		bool result=data.insert_or_assign(std::forward<K>(key),record,&newKey);
+		if(newKey)
+			expirationWheel().schedule(record.expirationTime,reclaimer,std::move(keyCopy));
+		return result;
+	}
+	
+	template <typename K>
+	bool update_expiration(K&& key, time_point time){
+		bool result=data.update_expiration(key,time);
+		if(result)
+			expirationWheel().schedule(time,reclaimer,std::string(key));
+		return result;
+	}
+	
+	///Remove a whole category
+	template <typename K>
+	size_type erase(const K& key){
+		return data.erase(key);
+	}
+	
+	///Remove one record from a category
+	template <typename K>
+	size_type erase(const K& key, const record_type& record){
+		return data.erase(key,record);
+	}
+	
+	void clear(){ data.clear(); }
+	
+private:
+	///The object through which the timing wheel refers to the multimap, which 
+	///stops forwarding to it once it is destroyed
+	class Reclaimer : public ExpiryTarget{
+	public:
+		explicit Reclaimer(ExpiringMultimap& map):map(&map){}
+		void reclaim(const std::vector<std::string>& keys) override{
+			std::lock_guard<std::mutex> lock(mut);
+			if(!map)
+				return;
+			const time_point now=coarse_clock::now();
+			std::vector<std::string> unique(keys);
+			std::sort(unique.begin(),unique.end());
+			unique.erase(std::unique(unique.begin(),unique.end()),unique.end());
+			for(auto& key : unique){
+				map->data.erase_expired(key,now,[now](const record_type& record){
+					return record.expirationTime<now;
+				});
+				//whatever remains must be checked again when it next expires
+				auto remaining=map->data.find(key);
+				if(remaining.first->empty())
+					continue;
+				time_point next=remaining.second;
+				if(next<=now){
+					next=time_point::max();
+					for(const auto& record : *remaining.first)
+						next=std::min(next,record.expirationTime);
+				}
+				expirationWheel().schedule(next,map->reclaimer,std::move(key));
+			}
+		}
+		void detach(){
+			std::lock_guard<std::mutex> lock(mut);
+			map=nullptr;
+		}
+	private:
+		std::mutex mut;
+		ExpiringMultimap* map;
+	};
+	
+	map_type data;
+	std::shared_ptr<Reclaimer> reclaimer;
+};
+
+///A pre-rendered list entry, tagged with the version of the data from which it
+///was rendered so that a copy rendered from data which has since changed is 
+///not mistaken for a current one
+struct ListFragment{
+	///A digest of the rendered record, combined with the generations of any 
+	///other kinds of records whose data the entry embeds
+	std::size_t version=0;
+	std::string text;
+};
+
+///A DynamoDB client which records a trace span for each request it makes.
+///The operations used by the PersistentStore are hidden by versions which
+///record the span and then defer to the base class.
+///When running as one of several worker processes, the client also tracks 
+///modifications made by the other workers to each table, so that stale cached
+///data can be discarded.
+class TracedDynamoDBClient : public Aws::DynamoDB::DynamoDBClient{
+public:
+	using Aws::DynamoDB::DynamoDBClient::DynamoDBClient;
+	
+	///Set which tables' modifications are tracked. Must be called before the
+	///client is used from multiple threads. 
+	///\param tables the names of the tables, whose positions in the list are 
+	///              used to identify them. At most sharedStoreGenerationCount 
+	///              tables may be tracked. 
+	void trackTables(std::vector<std::string> tables);
+	
+	///\param table the position of the table in the list given to trackTables
+	///\return whether another worker process has modified the table since the
+	///        last time this was checked
+	bool modifiedElsewhere(std::size_t table);
+	
+	Aws::DynamoDB::Model::GetItemOutcome GetItem(const Aws::DynamoDB::Model::GetItemRequest& request) const;
+	Aws::DynamoDB::Model::PutItemOutcome PutItem(const Aws::DynamoDB::Model::PutItemRequest& request) const;
+	Aws::DynamoDB::Model::UpdateItemOutcome UpdateItem(const Aws::DynamoDB::Model::UpdateItemRequest& request) const;
+	Aws::DynamoDB::Model::DeleteItemOutcome DeleteItem(const Aws::DynamoDB::Model::DeleteItemRequest& request) const;
+	Aws::DynamoDB::Model::QueryOutcome Query(const Aws::DynamoDB::Model::QueryRequest& request) const;
+	Aws::DynamoDB::Model::ScanOutcome Scan(const Aws::DynamoDB::Model::ScanRequest& request) const;
+	Aws::DynamoDB::Model::DescribeTableOutcome DescribeTable(const Aws::DynamoDB::Model::DescribeTableRequest& request) const;
+	Aws::DynamoDB::Model::CreateTableOutcome CreateTable(const Aws::DynamoDB::Model::CreateTableRequest& request) const;
+	Aws::DynamoDB::Model::UpdateTableOutcome UpdateTable(const Aws::DynamoDB::Model::UpdateTableRequest& request) const;
+	Aws::DynamoDB::Model::DeleteTableOutcome DeleteTable(const Aws::DynamoDB::Model::DeleteTableRequest& request) const;
+	
+private:
+	///The names of the tracked tables
+	std::vector<std::string> trackedTables;
+	///The values of the tables' shared modification counters which this 
+	///process has accounted for
+	mutable std::atomic<unsigned long long> observedGenerations[sharedStoreGenerationCount]{};
+	
+	///Inform other worker processes that this one has modified a table
+	///\param table the name of the table which was modified
+	void recordModification(const std::string& table) const;
+};
+
 class PersistentStore{
 public:
+	///Construct a store. InitializeTables must be called before any other 
+	///member function is used. 
 	///\param credentials the AWS credentials used for authenitcation with the 
 	///                   database
 	///\param clientConfig specification of the database endpoint to contact
@@ -130,6 +446,11 @@ public:
 	                std::string appLoggingServerName,
 	                unsigned int appLoggingServerPort);
 	
+	///Check that all necessary tables exist in the database, and create or 
+	///update them if they do not. The tables are initialized concurrently. 
+	///\throws std::runtime_error if any table cannot be initialized
+	void InitializeTables();
+	
 	///Store a record for a new user
 	///\return Whether the user record was successfully added to the database
 	bool addUser(const User& user);
@@ -170,6 +491,12 @@ public:
 	///\return all users from the given group, but with only IDs, names, and email addresses
 	std::vector<User> listUsersByGroup(const std::string& group);
 	
+	///Get the pre-rendered JSON list entry for a user, rendering it if no 
+	///valid cached copy exists
+	///\param user the user whose entry is wanted
+	///\return the serialized list entry object
+	std::string getUserListFragment(const User& user);
+	
 	///Mark a user as a member of a group
 	///\param uID the ID of the user to add
 	///\param groupID the ID of the group to which to add the user
@@ -247,6 +574,13 @@ public:
 	///\return the group corresponding to the name, or an invalid group if none exists
 	Group getGroup(const std::string& idOrName);
 	
+	///Get the pre-rendered JSON list entry for a group, rendering it if no 
+	///valid cached copy exists. Entries are rendered from the current record 
+	///for the group, which may be newer than the copy passed in. 
+	///\param group the group whose entry is wanted
+	///\return the serialized list entry object
+	std::string getGroupListFragment(const Group& group);
+	
 	//----
 	
 	///Store a record for a new cluster
@@ -377,6 +711,13 @@ public:
 	///\return Whether the record was successfully added to the database
 	bool setLocationsForCluster(std::string idOrName, const std::vector<GeoLocation>& locations);
 	
+	///Get the pre-rendered JSON list entry for a cluster, rendering it if no 
+	///valid cached copy exists. The entry includes the owning group's name and
+	///the cluster's locations. 
+	///\param cluster the cluster whose entry is wanted
+	///\return the serialized list entry object
+	std::string getClusterListFragment(const Cluster& cluster);
+	
 	///\param idOrName the ID or name of the cluster
 	///\return The cached information about whether the specified cluster was
 	///        reachable recently. Note that a result is always returned, even 
@@ -434,6 +775,13 @@ public:
 	///\return all matching instance records
 	std::vector<ApplicationInstance> findInstancesByName(const std::string& name);
 	
+	///Get the pre-rendered JSON list entry for an application instance, 
+	///rendering it if no valid cached copy exists. The entry includes the 
+	///names of the owning group and the cluster. 
+	///\param inst the instance whose entry is wanted
+	///\return the serialized list entry object
+	std::string getInstanceListFragment(const ApplicationInstance& inst);
+	
 	//----
 	
 	std::string encryptSecret(const SecretData& s) const;
@@ -480,6 +828,11 @@ public:
 	///Return human-readable performance statistics
 	std::string getStatistics() const;
 	
+	///Load all user, group, cluster, and application instance records into 
+	///the caches, so that a newly started server does not need to make a 
+	///database query for each record the first time it is used
+	void preloadCaches();
+	
 	///The pseudo-ID associated with wildcard permissions.
 	const static std::string wildcard;
 	///The pseudo-name associated with wildcard permissions.
@@ -487,7 +840,7 @@ public:
 	
 private:
 	///Database interface object
-	Aws::DynamoDB::DynamoDBClient dbClient;
+	TracedDynamoDBClient dbClient;
 	///Name of the users table in the database
 	const std::string userTableName;
 	///Name of the groups table in the database
@@ -499,6 +852,10 @@ private:
 	///Name of the secrets instances table in the database
 	const std::string secretTableName;
 	
+	///Path from which the initial portal user credentials are loaded if the 
+	///user table must be created
+	const std::string bootstrapUserFile;
+	
 	///Path to the temporary directory where cluster config files are written 
 	///in order for kubectl and helm to read
 	const FileHandle clusterConfigDir;
@@ -506,48 +863,52 @@ private:
 	///duration for which cached user records should remain valid
 	const std::chrono::seconds userCacheValidity;
 	slate_atomic<std::chrono::steady_clock::time_point> userCacheExpirationTime;
-	cuckoohash_map<std::string,CacheRecord<User>> userCache;
-	cuckoohash_map<std::string,CacheRecord<User>> userByTokenCache;
-	cuckoohash_map<std::string,CacheRecord<User>> userByGlobusIDCache;
-	concurrent_multimap<std::string,CacheRecord<std::string>> userByGroupCache;
+	ExpiringCache<User> userCache;
+	ExpiringCache<User> userByTokenCache;
+	ExpiringCache<User> userByGlobusIDCache;
+	ExpiringMultimap<std::string> userByGroupCache;
+	ExpiringCache<ListFragment> userFragmentCache;
 	///duration for which cached group records should remain valid
 	const std::chrono::seconds groupCacheValidity;
 	slate_atomic<std::chrono::steady_clock::time_point> groupCacheExpirationTime;
-	cuckoohash_map<std::string,CacheRecord<Group>> groupCache;
-	cuckoohash_map<std::string,CacheRecord<Group>> groupByNameCache;
-	concurrent_multimap<std::string,CacheRecord<Group>> groupByUserCache;
+	ExpiringCache<Group> groupCache;
+	ExpiringCache<Group> groupByNameCache;
+	ExpiringMultimap<Group> groupByUserCache;
+	ExpiringCache<ListFragment> groupFragmentCache;
 	///duration for which cached cluster records should remain valid
 	const std::chrono::seconds clusterCacheValidity;
 	slate_atomic<std::chrono::steady_clock::time_point> clusterCacheExpirationTime;
-	cuckoohash_map<std::string,CacheRecord<Cluster>> clusterCache;
-	cuckoohash_map<std::string,CacheRecord<Cluster>> clusterByNameCache;
-	concurrent_multimap<std::string,CacheRecord<Cluster>> clusterByGroupCache;
+	ExpiringCache<Cluster> clusterCache;
+	ExpiringCache<Cluster> clusterByNameCache;
+	ExpiringMultimap<Cluster> clusterByGroupCache;
 	cuckoohash_map<std::string,SharedFileHandle> clusterConfigs;
-	concurrent_multimap<std::string,CacheRecord<std::string>> clusterGroupAccessCache;
-	cuckoohash_map<std::string,CacheRecord<std::set<std::string>>> clusterGroupApplicationCache;
-	cuckoohash_map<std::string,CacheRecord<std::vector<GeoLocation>>> clusterLocationCache;
+	ExpiringMultimap<std::string> clusterGroupAccessCache;
+	ExpiringCache<std::set<std::string>> clusterGroupApplicationCache;
+	ExpiringCache<std::vector<GeoLocation>> clusterLocationCache;
+	///Rendered list entries embed the owning group's name and the cluster's 
+	///locations, so they must be dropped when either of those changes
+	ExpiringCache<ListFragment> clusterFragmentCache;
 	///This cache is a little tricky since it represents state of the network, 
 	///not something stored in the database, so it's data isn't directly handled
 	///by the persistent store. 
-	cuckoohash_map<std::string,CacheRecord<bool>> clusterConnectivityCache;
+	ExpiringCache<bool> clusterConnectivityCache;
 	///duration for which cached instance records should remain valid
 	const std::chrono::seconds instanceCacheValidity;
 	slate_atomic<std::chrono::steady_clock::time_point> instanceCacheExpirationTime;
-	cuckoohash_map<std::string,CacheRecord<ApplicationInstance>> instanceCache;
-	cuckoohash_map<std::string,CacheRecord<std::string>> instanceConfigCache;
-	concurrent_multimap<std::string,CacheRecord<ApplicationInstance>> instanceByGroupCache;
-	concurrent_multimap<std::string,CacheRecord<ApplicationInstance>> instanceByNameCache;
-	concurrent_multimap<std::string,CacheRecord<ApplicationInstance>> instanceByClusterCache;
-	concurrent_multimap<std::string,CacheRecord<ApplicationInstance>> instanceByGroupAndClusterCache;
+	ExpiringCache<ApplicationInstance> instanceCache;
+	ExpiringCache<std::string> instanceConfigCache;
+	ExpiringMultimap<ApplicationInstance> instanceByGroupCache;
+	ExpiringMultimap<ApplicationInstance> instanceByNameCache;
+	ExpiringMultimap<ApplicationInstance> instanceByClusterCache;
+	ExpiringMultimap<ApplicationInstance> instanceByGroupAndClusterCache;
+	///Rendered list entries embed group and cluster names, so they must be 
+	///dropped when either of those entities changes
+	ExpiringCache<ListFragment> instanceFragmentCache;
 	///duration for which cached secret records should remain valid
 	const std::chrono::seconds secretCacheValidity;
-	cuckoohash_map<std::string,CacheRecord<Secret>> secretCache;
-	concurrent_multimap<std::string,CacheRecord<Secret>> secretByGroupCache;
-	concurrent_multimap<std::string,CacheRecord<Secret>> secretByGroupAndClusterCache;
-	
-	///Check that all necessary tables exist in the database, and create them if 
-	///they do not
-	void InitializeTables(std::string bootstrapUserFile);
+	ExpiringCache<Secret> secretCache;
+	ExpiringMultimap<Secret> secretByGroupCache;
+	ExpiringMultimap<Secret> secretByGroupAndClusterCache;
 	
 	void InitializeUserTable(std::string bootstrapUserFile);
 	void InitializeGroupTable();
@@ -557,6 +918,22 @@ private:
 	
 	void loadEncyptionKey(const std::string& fileName);
 	
+	///The tables whose modifications by other worker processes are tracked, 
+	///in the order given to the database client
+	enum TrackedTable : std::size_t{
+		UserTable,
+		GroupTable,
+		ClusterTable,
+		InstanceTable,
+		SecretTable,
+	};
+	
+	///Drop the data cached from a table if another worker process has 
+	///modified it, since the data may now be out of date. Every operation 
+	///which may answer from the caches of a table checks this first. 
+	///\param table the table from which the data to be read comes
+	void discardCachesIfModifiedElsewhere(TrackedTable table);
+	
 	///For consumption by kubectl we store configs in the filesystem
 	///These files have implicit validity derived from the corresponding entries
 	///in clusterCache.
@@ -585,6 +962,30 @@ private:
 	unsigned int appLoggingServerPort;
 	
 	std::atomic<size_t> cacheHits, databaseQueries, databaseScans;
+	
+	//Generation counters are incremented whenever records of the corresponding 
+	//kind are modified, or when reloading them from the database finds that 
+	//they differ from what was previously loaded (because they were changed 
+	//elsewhere). Reloads which merely refresh expired cache entries leave the 
+	//generations alone. Data derived from the store's records, such as a 
+	//rendered list entry, is therefore unchanged as long as the generations of
+	//all of the kinds of records it uses are unchanged. 
+	std::atomic<unsigned long long> groupGeneration, clusterGeneration, instanceGeneration;
+	///Digests of the data most recently loaded from the database, keyed by 
+	///the kind of data and the record or query which produced it. Entries 
+	///expire along with the cached data, and are removed with their records. 
+	ExpiringCache<std::size_t> loadedDigests;
+	
+	///Note that data was loaded from the database, and advance the 
+	///corresponding generation if it differs from what was last loaded under 
+	///the same key
+	///\param generation the generation counter for the kind of data loaded
+	///\param validity the duration for which the kind of data is cached
+	///\param key the identity of the record or query which was loaded
+	///\param digest a digest of the contents of the loaded data
+	void noteLoaded(std::atomic<unsigned long long>& generation, 
+	                std::chrono::seconds validity,
+	                const std::string& key, std::size_t digest);
 };
 
 ///\param store the database in which to look up the user
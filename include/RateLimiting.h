@@ -0,0 +1,86 @@
+#ifndef SLATE_RATE_LIMITING_H
+#define SLATE_RATE_LIMITING_H
+
+#include <functional>
+#include <string>
+
+#include "crow.h"
+
+///The relative cost of handling a request, which determines which of a
+///user's budgets it is charged against
+enum class RequestCost{
+	///Requests which are answered from the persistent store or its caches
+	Cheap,
+	///Requests which run subprocesses against clusters, such as installing or
+	///deleting instances, fetching logs, and verifying clusters
+	Expensive,
+};
+
+struct AdmissionLimits{
+	///The sustained number of cheap requests per second allowed for each
+	///user. Zero disables rate limiting of cheap requests.
+	double cheapRate;
+	///The number of cheap requests a user may make in a burst
+	double cheapBurst;
+	///The sustained number of expensive requests per second allowed for each
+	///user. Zero disables rate limiting of expensive requests.
+	double expensiveRate;
+	///The number of expensive requests a user may make in a burst
+	double expensiveBurst;
+	///The maximum number of requests which may be in progress at once. Zero
+	///disables the limit.
+	unsigned int maxConcurrent;
+	///The maximum number of expensive requests which may be in progress at
+	///once. Zero disables the limit.
+	unsigned int maxConcurrentExpensive;
+};
+
+///Set the limits used to admit requests. Should be called before any requests
+///are handled.
+void setAdmissionLimits(const AdmissionLimits& limits);
+
+///Set the function used to find the user whose budget is charged for a request
+///made with a given token. Should be called before any requests are handled.
+///\param lookup a function which returns the ID of the user to whom a token 
+///              belongs, or an empty string if the token is not valid
+void setTokenOwnerLookup(std::function<std::string(const std::string&)> lookup);
+
+///\return the number of admitted requests which are currently in progress
+unsigned int requestsInProgress();
+
+///A decision whether to handle a request.
+///Requests are rejected with status 503 while the server is still starting or
+///when too many requests are already in progress, and with status 429 when the user who made them has
+///exhausted their budget for their cost. Requests without a token, or with a 
+///token which does not belong to any user, share a single anonymous budget, so
+///that making up tokens does not earn fresh budgets. An admitted request counts as being in progress until the Admission
+///object is destroyed. The individual requests of a multiplexed bundle are 
+///each admitted in the same way, according to their own tokens and costs.
+class Admission{
+public:
+	Admission(const crow::request& req, RequestCost cost);
+	~Admission();
+	Admission(const Admission&)=delete;
+	Admission& operator=(const Admission&)=delete;
+
+	///\return whether the request should be handled
+	explicit operator bool() const{ return admitted; }
+
+	///\pre the request was not admitted
+	///\return the response which should be sent in place of handling the request,
+	///        with a Retry-After header
+	crow::response rejection() const;
+
+private:
+	RequestCost cost;
+	bool admitted;
+	///Whether this object holds slots in the in-progress counts
+	bool holdsSlot;
+	int status;
+	///The explanation given for rejecting the request
+	const char* message;
+	///The number of seconds after which the client should try again
+	unsigned long retryAfter;
+};
+
+#endif //SLATE_RATE_LIMITING_H
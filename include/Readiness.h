@@ -0,0 +1,45 @@
+#ifndef SLATE_READINESS_H
+#define SLATE_READINESS_H
+
+#include <string>
+
+#include "crow.h"
+
+///The steps which the server carries out in the background after it begins
+///listening for requests
+enum class StartupStage{
+	///Creating or updating the database tables and loading the caches. 
+	///Requests cannot be handled until this has completed. 
+	Database,
+	///Refreshing the indices of the helm chart repositories. Requests may be
+	///handled while this is in progress. 
+	HelmRepositories,
+};
+
+enum class StageStatus{
+	Pending,
+	InProgress,
+	Complete,
+	Failed,
+};
+
+///Record the progress of a startup stage
+///\param stage the stage whose status has changed
+///\param status the new status of the stage
+///\param detail an explanation of the status, such as the reason for a failure
+void setStageStatus(StartupStage stage, StageStatus status, const std::string& detail="");
+
+///\return whether every stage which must finish before requests can be handled
+///        has completed
+bool serverReady();
+
+///Report whether the server is functioning. The result is 200 unless a stage 
+///which is required before requests can be handled has failed, in which case
+///the server will never become ready and should be restarted. 
+crow::response checkLiveness();
+
+///Report whether the server can handle requests, along with the status of each
+///startup stage. The result is 200 if the server is ready, and 503 otherwise. 
+crow::response checkReadiness();
+
+#endif //SLATE_READINESS_H
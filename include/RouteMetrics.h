@@ -0,0 +1,139 @@
+#ifndef SLATE_ROUTE_METRICS_H
+#define SLATE_ROUTE_METRICS_H
+
+#include <array>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "RateLimiting.h"
+#include "ServerUtilities.h"
+#include "Tracing.h"
+
+class PersistentStore;
+
+///Aggregate measurements of the requests handled by a single route
+class RouteStatistics{
+public:
+	static const std::size_t boundCount=14;
+	///The upper bounds, in milliseconds, of the latency histogram buckets.
+	///A final bucket holds all requests slower than the last bound.
+	static const double bucketBounds[boundCount];
+
+	explicit RouteStatistics(std::string name);
+
+	///Record a completed request
+	void record(tracing::Clock::duration duration, int status);
+
+	const std::string& getName() const{ return name; }
+
+	///Write this route's measurements as a JSON object
+	void writeJSON(JSONWriter& writer) const;
+
+private:
+	const std::string name;
+	mutable std::mutex mutex;
+	unsigned long long count;
+	tracing::Clock::duration totalTime;
+	std::array<unsigned long long,boundCount+1> buckets;
+	std::map<int,unsigned long long> statusCounts;
+};
+
+///Get the statistics object for a route, creating it if necessary
+///\param name the name of the route, conventionally the HTTP method followed
+///            by the route pattern
+RouteStatistics& routeStatistics(const std::string& name);
+
+///A wrapper for a crow handler which subjects each request to admission
+///control, measures the time spent handling it, records it in the route's
+///statistics, and collects a trace of the request, which is retained if the
+///request is slow.
+template<typename Handler, typename... Args>
+class InstrumentedHandler{
+public:
+	typedef RequestCost (*CostClassifier)(const crow::request&);
+
+	InstrumentedHandler(RouteStatistics& statistics, Handler handler, RequestCost cost):
+	statistics(&statistics),handler(std::move(handler)),cost(cost),classify(nullptr){}
+
+	InstrumentedHandler(RouteStatistics& statistics, Handler handler, CostClassifier classify):
+	statistics(&statistics),handler(std::move(handler)),cost(RequestCost::Cheap),classify(classify){}
+
+	crow::response operator()(const crow::request& req, Args... args) const{
+		tracing::RequestTrace trace(statistics->getName(),req.url);
+		Admission admission(req,classify ? classify(req) : cost);
+		if(!admission){
+			crow::response response=admission.rejection();
+			complete(trace,response.code);
+			return response;
+		}
+		try{
+			crow::response response;
+			{
+				tracing::ActiveTrace active(trace);
+				response=crow::response(handler(req,args...));
+			}
+			complete(trace,response.code);
+			return response;
+		}catch(...){
+			complete(trace,500);
+			throw;
+		}
+	}
+
+private:
+	RouteStatistics* statistics;
+	Handler handler;
+	RequestCost cost;
+	///If set, used to determine the cost of each request in place of cost
+	CostClassifier classify;
+
+	void complete(tracing::RequestTrace& trace, int status) const{
+		trace.finish(status);
+		statistics->record(trace.duration,status);
+		tracing::offerSlowTrace(std::move(trace));
+	}
+};
+
+namespace detail{
+	template<typename Handler, typename CallOperator>
+	struct InstrumentedHandlerFor;
+
+	template<typename Handler, typename Class, typename Result, typename... Args>
+	struct InstrumentedHandlerFor<Handler,Result(Class::*)(const crow::request&, Args...) const>{
+		typedef InstrumentedHandler<Handler,Args...> type;
+	};
+}
+
+///Wrap a route handler so that its requests are subject to admission control
+///and are measured.
+///\param route the name under which to record the route's statistics
+///\param handler a callable object whose first argument is the request
+///\param cost the budget against which the route's requests are charged
+template<typename Handler>
+typename detail::InstrumentedHandlerFor<Handler,decltype(&Handler::operator())>::type
+instrumented(const std::string& route, Handler handler, RequestCost cost=RequestCost::Cheap){
+	return typename detail::InstrumentedHandlerFor<Handler,decltype(&Handler::operator())>::type
+		(routeStatistics(route),std::move(handler),cost);
+}
+
+///Wrap a route handler so that its requests are subject to admission control
+///and are measured, for a route whose requests vary in cost.
+///\param route the name under which to record the route's statistics
+///\param handler a callable object whose first argument is the request
+///\param classify a function which determines the cost of each request
+template<typename Handler>
+typename detail::InstrumentedHandlerFor<Handler,decltype(&Handler::operator())>::type
+instrumented(const std::string& route, Handler handler, RequestCost (*classify)(const crow::request&)){
+	return typename detail::InstrumentedHandlerFor<Handler,decltype(&Handler::operator())>::type
+		(routeStatistics(route),std::move(handler),classify);
+}
+
+///Report the latency histograms and status code counts of all routes.
+///Only administrators may use this.
+crow::response getRouteStatistics(PersistentStore& store, const crow::request& req);
+
+///Report the traces of recent slow requests. Only administrators may use this.
+crow::response getSlowRequestTraces(PersistentStore& store, const crow::request& req);
+
+#endif //SLATE_ROUTE_METRICS_H
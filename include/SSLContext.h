@@ -0,0 +1,39 @@
+#ifndef SLATE_SSL_CONTEXT_H
+#define SLATE_SSL_CONTEXT_H
+
+#include <chrono>
+#include <string>
+
+#include <boost/asio/ssl/context.hpp>
+
+struct SSLSettings{
+	///Path to the PEM encoded certificate chain
+	std::string certificate;
+	///Path to the PEM encoded private key
+	std::string key;
+	///OpenSSL cipher list used for TLS 1.2 and earlier.
+	///If empty the library default is used.
+	std::string ciphers;
+	///OpenSSL cipher suites used for TLS 1.3. If empty the library default is
+	///used.
+	std::string cipherSuites;
+	///Colon separated list of elliptic curves to offer for ECDH key exchange,
+	///in order of preference. If empty the library default is used.
+	std::string curves;
+	///The maximum number of sessions kept in the server side session cache.
+	///Zero disables the session cache.
+	unsigned long sessionCacheSize;
+	///How long cached sessions and session tickets remain valid
+	std::chrono::seconds sessionTimeout;
+	///How often the keys used to encrypt session tickets are replaced.
+	///Tickets remain valid for up to twice this long, since the previous key is
+	///still accepted. Zero disables session tickets.
+	std::chrono::seconds ticketKeyLifetime;
+};
+
+///Create an SSL context for the server with session resumption (via both a
+///server side session cache and session tickets) configured
+///\throws std::runtime_error if the settings are not valid
+boost::asio::ssl::context createSSLContext(const SSLSettings& settings);
+
+#endif //SLATE_SSL_CONTEXT_H
@@ -6,18 +6,51 @@
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
 
+#include <algorithm>
+#include <ctime>
 #include <sstream>
+#include <utility>
+#include <vector>
 #include "Entities.h"
 #include "Utilities.h"
 
 ///\return a timestamp rendered as a string with format "YYYY-mmm-DD HH:MM:SS UTC"
 std::string timestamp();
 
+///\param time the time to render
+///\return the time rendered in the same format as timestamp()
+std::string timestamp(std::time_t time);
+
 ///Construct a JSON error object
 ///\param message the explanation to include in the error
 ///\return a JSON object with a 'kind' of "Error"
 std::string generateError(const std::string& message);
 
+///Construct a strong entity tag from the content of a response. The tag 
+///depends only on the content, so every server process, including those 
+///started later, issues the same tag for the same content. 
+///\param content the body of the response
+///\return a quoted entity tag suitable for use as the value of an ETag header
+std::string makeETag(const std::string& content);
+
+///Check whether a request's If-None-Match header matches an entity tag
+///\param req the request to examine
+///\param etag the tag of the current representation of the resource
+///\return true if the client already has the current representation
+bool requestMatchesETag(const crow::request& req, const std::string& etag);
+
+///Construct a '304 Not Modified' response
+///\param etag the tag of the current representation of the resource
+crow::response notModified(const std::string& etag);
+
+///Tag a successful response with an entity tag made from its body, or replace 
+///it with a '304 Not Modified' response if the request shows that the client 
+///already has the same content
+///\param req the request being answered
+///\param response the complete response to the request
+///\return the response which should be sent
+crow::response conditionalResponse(const crow::request& req, crow::response response);
+
 ///Replace escaped characters with appropriate character to create valid yaml
 ///\param message the string to replace escaped characters in
 ///\return a string with replaced, now valid characters
@@ -81,12 +114,107 @@ std::string trim(const std::string& s);
 ///removed
 std::string reduceYAML(const std::string& input);
 
+///Remove all text contained between the strings
+///"### SLATE-START ###" and "### SLATE-END ###", inclusive
+std::string filterValuesFile(const std::string& data);
+
+///A rapidjson output stream which appends directly to a string, such as the 
+///body of a crow::response, so that serialized JSON need not pass through an
+///intermediate StringBuffer and then be copied out of it
+class StringOutputStream{
+public:
+	typedef char Ch;
+	
+	explicit StringOutputStream(std::string& target):target(target){}
+	
+	void Put(Ch c){ target.push_back(c); }
+	void Flush(){}
+	///Ensure that at least \p count more characters can be appended without 
+	///reallocation, growing geometrically
+	void Reserve(std::size_t count){
+		if(target.capacity()-target.size()<count)
+			target.reserve(std::max(target.size()+count,2*target.capacity()));
+	}
+	
+private:
+	std::string& target;
+};
+
+///Allow the Writer to reserve space for whole strings at once
+///(Found by ADL, so this must live in the same namespace as the stream.)
+inline void PutReserve(StringOutputStream& stream, std::size_t count){
+	stream.Reserve(count);
+}
+
+///The base allocator from which a RequestArena's memory pool obtains its 
+///chunks. The first chunk is served from a reusable buffer supplied by the 
+///arena, if one was given; further chunks spill into the heap, and are tracked
+///so that they can be cleared as they are released, since they may hold 
+///sensitive request data. 
+class ArenaChunkAllocator{
+public:
+	static const bool kNeedFree=true;
+	
+	///\param buffer the reusable buffer from which to serve the first chunk, 
+	///               or null to allocate all chunks from the heap
+	///\param bufferSize the size of \p buffer in bytes
+	explicit ArenaChunkAllocator(char* buffer=nullptr, std::size_t bufferSize=0):
+	buffer(buffer),bufferSize(bufferSize),bufferInUse(false){}
+	~ArenaChunkAllocator();
+	ArenaChunkAllocator(const ArenaChunkAllocator&)=delete;
+	ArenaChunkAllocator& operator=(const ArenaChunkAllocator&)=delete;
+	
+	void* Malloc(std::size_t size);
+	void* Realloc(void* originalPtr, std::size_t originalSize, std::size_t newSize);
+	void Free(void* ptr);
+	
+private:
+	char* buffer;
+	std::size_t bufferSize;
+	bool bufferInUse;
+	///The chunks allocated from the heap, with their sizes
+	std::vector<std::pair<void*,std::size_t>> spilled;
+};
+
+///A reusable, per-thread memory arena from which the JSON documents used while 
+///handling a single request allocate, instead of making many small allocations
+///from the global heap. Constructing a RequestArena enters the arena for the 
+///current thread; when the outermost RequestArena on the thread is destroyed 
+///all memory allocated from it is cleared and released in bulk, and the 
+///arena's buffer is kept (grown, if necessary, up to a limit of 16 MB) for the
+///next request. Therefore, any documents 
+///using the arena must be destroyed before the RequestArena object which 
+///provided it, which is most easily arranged by declaring it first. 
+class RequestArena{
+public:
+	using Allocator=rapidjson::MemoryPoolAllocator<ArenaChunkAllocator>;
+	///The document type which can use the arena's allocator
+	using Document=rapidjson::GenericDocument<rapidjson::UTF8<>,Allocator>;
+	using Value=Document::ValueType;
+	
+	RequestArena();
+	~RequestArena();
+	RequestArena(const RequestArena&)=delete;
+	RequestArena& operator=(const RequestArena&)=delete;
+	
+	///\return the allocator for the current thread's arena
+	Allocator& allocator();
+	///Copy a string into the arena so that it may be parsed in situ
+	///\return a mutable, NUL terminated copy of \p str which lives until the
+	///        arena is reset
+	char* copyString(const std::string& str);
+};
+
+///The writer type used to serialize responses
+using JSONWriter=rapidjson::Writer<StringOutputStream>;
+
 template<typename JSONDocument>
 std::string to_string(const JSONDocument& json){
-	rapidjson::StringBuffer buf;
-	rapidjson::Writer<rapidjson::StringBuffer> writer(buf);
+	std::string result;
+	StringOutputStream stream(result);
+	JSONWriter writer(stream);
 	json.Accept(writer);
-	return buf.GetString();
+	return result;
 }
 
 
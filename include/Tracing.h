@@ -0,0 +1,109 @@
+#ifndef SLATE_TRACING_H
+#define SLATE_TRACING_H
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+///Lightweight per-request tracing.
+///While a RequestTrace is active on a thread, TraceSpan objects created on that
+///thread record how long the operations they cover took, and countTraceEvent
+///tallies cheap events (like cache hits) which are too frequent to record
+///individually. When no trace is active, spans and events cost only a check of
+///a thread local pointer, so code shared with the client may use them freely.
+namespace tracing{
+
+typedef std::chrono::steady_clock Clock;
+
+struct Span{
+	///The kind of operation, e.g. "dynamodb", "subprocess", or "crypto"
+	const char* category;
+	///The particular operation, e.g. "GetItem"
+	const char* operation;
+	///Further information, such as a table name or executable name
+	std::string detail;
+	///The number of spans which enclosed this one when it began
+	unsigned int depth;
+	///The time at which the operation began, relative to the start of the trace
+	Clock::duration offset;
+	Clock::duration duration;
+};
+
+struct RequestTrace{
+	///Begin a trace
+	///\param route the name of the route handling the request
+	///\param target the request path, which should not include the query string
+	///              since it may contain credentials
+	RequestTrace(std::string route, std::string target);
+
+	std::string route;
+	std::string target;
+	///The status code with which the request completed
+	int status;
+	std::chrono::system_clock::time_point wallStart;
+	Clock::time_point start;
+	Clock::duration duration;
+	std::vector<Span> spans;
+	///The number of spans not recorded because the trace was already full
+	std::size_t droppedSpans;
+	std::map<std::string,unsigned long> events;
+	///The number of spans currently open
+	unsigned int depth;
+
+	///Mark the trace as complete
+	void finish(int status);
+
+	///The maximum number of spans which will be recorded for a single request
+	static const std::size_t maxSpans=256;
+};
+
+///Make a trace the active trace for the current thread for the lifetime of
+///this object
+class ActiveTrace{
+public:
+	explicit ActiveTrace(RequestTrace& trace);
+	~ActiveTrace();
+	ActiveTrace(const ActiveTrace&)=delete;
+	ActiveTrace& operator=(const ActiveTrace&)=delete;
+private:
+	RequestTrace* previous;
+};
+
+///Record a span covering the lifetime of this object in the current thread's
+///active trace, if any
+class TraceSpan{
+public:
+	///\param category the kind of operation, which must be a string literal
+	///\param operation the operation being performed, which must be a string literal
+	///\param detail any additional information
+	TraceSpan(const char* category, const char* operation, const char* detail="");
+	TraceSpan(const char* category, const char* operation, const std::string& detail);
+	~TraceSpan();
+	TraceSpan(const TraceSpan&)=delete;
+	TraceSpan& operator=(const TraceSpan&)=delete;
+private:
+	RequestTrace* trace;
+	std::size_t index;
+	Clock::time_point start;
+};
+
+///Count an occurrence of an event in the current thread's active trace, if any
+///\param name the name of the event, e.g. "cache hit"
+void countTraceEvent(const char* name);
+
+///Set the minimum duration for a request to be retained as a slow request
+void setSlowThreshold(Clock::duration threshold);
+
+///Keep a completed trace in the ring of recent slow requests if its duration
+///meets the slow threshold. Only the most recent traces are retained.
+void offerSlowTrace(RequestTrace&& trace);
+
+///\return a JSON serialization of the retained slow request traces, most
+///        recent first
+std::string slowTracesJSON();
+
+} //namespace tracing
+
+#endif //SLATE_TRACING_H
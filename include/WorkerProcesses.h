@@ -0,0 +1,52 @@
+#ifndef SLATE_WORKER_PROCESSES_H
+#define SLATE_WORKER_PROCESSES_H
+
+#include <atomic>
+#include <cstddef>
+
+///Split the service into several worker processes which handle requests
+///independently while all listening on the same port. The calling process
+///becomes a supervisor which restarts workers that exit unexpectedly, and
+///which, on receiving SIGINT or SIGTERM, passes SIGTERM on to the workers and
+///exits once they have all finished draining their requests. SIGUSR1 and 
+///SIGUSR2, which change the log level, are passed on to the workers. 
+///Must be called before any other threads are started, since only the calling
+///thread continues in the worker processes.
+///\param count the number of worker processes to run
+///\return only in the worker processes
+void runWorkerProcesses(unsigned int count);
+
+///\return whether this process is one of several workers
+bool isWorkerProcess();
+
+///\return the position of this process among the workers, counting from 0.
+///        A worker started to replace one which exited takes the same 
+///        position. 0 if this process is not one of several workers. 
+unsigned int workerIndex();
+
+///The progress of the first worker in initializing the database tables
+enum class DatabaseInitialization : int{
+	Pending,
+	Complete,
+	///The first worker was unable to initialize the tables, so the other 
+	///workers should not wait for it
+	Failed,
+};
+
+///Get the state, kept in memory shared by all of the workers, which the first
+///worker sets once it has finished, or failed, initializing the database tables
+///\return the shared state, or null if this process is not a worker
+std::atomic<DatabaseInitialization>* sharedDatabaseInitialization();
+
+///The number of separately counted kinds of modifications to the persistent 
+///store which workers share
+const std::size_t sharedStoreGenerationCount=8;
+
+///Get a counter, kept in memory shared by all of the workers, which is 
+///incremented whenever any worker modifies part of the persistent store
+///\param index which of the counters to get, less than 
+///             sharedStoreGenerationCount
+///\return the shared counter, or null if this process is not a worker
+std::atomic<unsigned long long>* sharedStoreGeneration(std::size_t index);
+
+#endif //SLATE_WORKER_PROCESSES_H
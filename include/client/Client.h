@@ -13,6 +13,7 @@
 #include <thread>
 #include <iostream>
 #include <functional>
+#include <memory>
 
 #include "rapidjson/document.h"
 #include "rapidjson/pointer.h"
@@ -124,7 +125,8 @@ struct GroupClusterAppUseOptions : public ClusterOptions{
 	std::string appName;
 };
 
-struct ClusterPingOptions : public ClusterOptions{
+struct ClusterPingOptions{
+	std::vector<std::string> clusterNames;
 };
 
 struct ApplicationOptions{
@@ -203,6 +205,15 @@ struct SecretDeleteOptions : public SecretOptions{
 	SecretDeleteOptions():force(false),assumeYes(false){}
 };
 
+struct BatchOptions{
+	///The path to the file listing operations, or "-" to read from stdin
+	std::string inputPath;
+	///The maximum number of operations to send to the server in one request
+	std::size_t bundleSize;
+	
+	BatchOptions():inputPath("-"),bundleSize(50){}
+};
+
 ///Try to get the value of an enviroment variable and store it to a string object.
 ///If the variable was not set \p target will not be modified. 
 ///\param name the name of the environment variable to get
@@ -293,6 +304,10 @@ public:
 	void copySecret(const SecretCopyOptions& opt);
 
 	void deleteSecret(const SecretDeleteOptions& opt);
+	
+	///Carry out many simple operations, listed one per line, by sending them 
+	///to the server in multiplexed bundles.
+	void runBatch(const BatchOptions& opt);
 
 	bool clientShouldPrintOnlyJson() const;
 
@@ -323,6 +338,11 @@ private:
 	}
 	
 	httpRequests::Options defaultOptions();
+	///Options for requests whose responses may be reused from the cache for 
+	///a short time, for data which changes rarely
+	httpRequests::Options cachedOptions();
+	///\return the cache of responses, or null if it cannot be used
+	httpRequests::ResponseCache* getResponseCache();
 	
 #ifdef USE_CURLOPT_CAINFO
 	void detectCABundlePath();
@@ -436,6 +456,11 @@ private:
 #ifdef USE_CURLOPT_CAINFO
 	std::string caBundlePath;
 #endif
+	///Connections kept open for reuse by all of the requests made by this client
+	httpRequests::Session httpSession;
+	///Responses kept for reuse by later invocations
+	std::unique_ptr<httpRequests::ResponseCache> responseCache;
+	bool responseCacheUnavailable;
 	
 	friend void registerCommonOptions(CLI::App&, Client&);
 };
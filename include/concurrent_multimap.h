@@ -1,7 +1,11 @@
 #ifndef SLATE_CONCURRENT_MULTIMAP_H
 #define SLATE_CONCURRENT_MULTIMAP_H
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <functional>
+#include <memory>
 #include <unordered_set>
 
 #include <libcuckoo/cuckoohash_map.hh>
@@ -13,6 +17,9 @@
 ///in the underlying cuckoohash_map can proceed concurrently, however, operations
 ///involving different values with the same key are guaranteed to map to the same
 ///bucket and thus will block each other waiting for its lock. 
+///The values for each key are held as an immutable, reference counted snapshot,
+///so that looking up a key only copies a pointer while the bucket is locked; 
+///modifications copy the set only if a reader still holds the previous snapshot.
 ///Does not currently have allocation or iteration support.
 template<typename Key, typename Value, 
          typename KeyHash=std::hash<Key>, typename KeyEqual=std::equal_to<Key>, 
@@ -22,13 +29,20 @@ public:
 	using steady_clock=std::chrono::steady_clock;
 	///The collection of values to which a key maps
 	using set_type=std::unordered_set<Value,ValueHash,ValueEqual>;
+	///A shared, read-only view of the values to which a key mapped
+	using snapshot_type=std::shared_ptr<const set_type>;
 	///The set of values the key maps to with its associated expiration time
-	using category_type=std::pair<set_type,steady_clock::time_point>;
-	///The underlying hash table type
-	using Table=cuckoohash_map<Key,category_type,KeyHash,KeyEqual>;
+	using category_type=std::pair<snapshot_type,steady_clock::time_point>;
 	using key_type=Key;
 	using mapped_type=Value;
-	using value_type=std::pair<const Key,category_type>;
+private:
+	///The form in which categories are stored, which permits modification of
+	///sets not shared with any reader
+	using stored_category_type=std::pair<std::shared_ptr<set_type>,steady_clock::time_point>;
+public:
+	///The underlying hash table type
+	using Table=cuckoohash_map<Key,stored_category_type,KeyHash,KeyEqual>;
+	using value_type=std::pair<const Key,stored_category_type>;
 	using size_type=typename Table::size_type;
 
 	concurrent_multimap(){}
@@ -80,8 +94,8 @@ public:
 	template <typename K>
 	size_type erase(const K& k){
 		size_type erased=0;
-		data.erase_fn(k,[&erased](const category_type& cat){
-			erased=cat.first.size();
+		data.erase_fn(k,[&erased](const stored_category_type& cat){
+			erased=cat.first->size();
 			return true;
 		});
 		return erased;
@@ -93,23 +107,61 @@ public:
 	template <typename K>
 	size_type erase(const K& k, const mapped_type& v){
 		size_type erased=0;
-		data.erase_fn(k,[&erased,&v](category_type& cat){
-			erased=cat.first.erase(v);
-			return cat.first.empty(); //only erase whole category if empty
+		data.erase_fn(k,[&erased,&v](stored_category_type& cat){
+			if(!cat.first->count(v))
+				return false;
+			erased=writable(cat).erase(v);
+			return cat.first->empty(); //only erase whole category if empty
+		});
+		return erased;
+	}
+	
+	///Erases the values associated with a key which satisfy a predicate, and
+	///the key itself if no values remain, but only if the key's category has 
+	///expired. The values in a category which has not expired are left in 
+	///place, since the collection may be relied upon to be complete. 
+	///\tparam K type of the key
+	///\tparam Pred type of the predicate
+	///\param key the key whose values should be examined
+	///\param time the time by which the category must have expired
+	///\param pred a function returning true for values which should be erased
+	///\return the number of values erased
+	template <typename K, typename Pred>
+	size_type erase_expired(const K& key, steady_clock::time_point time, Pred pred){
+		size_type erased=0;
+		data.erase_fn(key,[&](stored_category_type& cat){
+			if(cat.second>time)
+				return false;
+			if(std::none_of(cat.first->begin(),cat.first->end(),pred))
+				return cat.first->empty();
+			set_type& items=writable(cat);
+			for(auto it=items.begin(); it!=items.end(); ){
+				if(pred(*it)){
+					it=items.erase(it);
+					erased++;
+				}
+				else
+					++it;
+			}
+			return items.empty();
 		});
 		return erased;
 	}
 	
 	///Searches the table for \p k and returns the associated value it
-	///finds. @c mapped_type must be @c CopyConstructible.
+	///finds. The values are not copied; the returned snapshot remains valid, 
+	///and unchanged, regardless of later modifications to the table.
 	///\tparam K type of the key
 	///\param k the key for which to search
-	///\return the collection of values associated with the key, or any empty 
+	///\return the collection of values associated with the key, or an empty 
 	///        collection if the key is not found
 	template <typename K>
 	category_type find(const K& key) const{
-		category_type items;
-		data.find_fn(key,[&items](const category_type& cat){ items=cat;	});
+		category_type items(emptySet(),steady_clock::time_point());
+		data.find_fn(key,[&items](const stored_category_type& cat){ 
+			items.first=cat.first;
+			items.second=cat.second;
+		});
 		return items;
 	}
 	
@@ -119,38 +171,50 @@ public:
 	///\tparam K type of the key
 	///\param key the key for which to search
 	///\param val the value for which to search
+	///\param newKey if not null, set to whether the key was not previously in 
+	///              the table, so that a new category was created for it
 	///\return true if the key was newly inserted, false if the key was already 
 	///        in the table
 	template<typename K, typename V>
-	bool insert_or_assign(K&& key, V&& val){
+	bool insert_or_assign(K&& key, V&& val, bool* newKey=nullptr){
 		bool inserted=true;
 		//Unfortunately, since val does not match up with Table::mapped_type we 
 		//need to preemptively construct an entire category_type object which
 		//may be unneeded.
-		data.upsert(std::forward<K>(key), 
-					[&](category_type& cat){
-						if(cat.first.count(val)){
+		const bool created=data.upsert(std::forward<K>(key), 
+					[&](stored_category_type& cat){
+						set_type& items=writable(cat);
+						if(items.count(val)){
 							inserted=false;
 							//ensure replacement
-							cat.first.erase(val);
+							items.erase(val);
 						}
-						cat.first.emplace(val);
-			    },category_type({val}, steady_clock::now()));
+						items.emplace(val);
+			    },stored_category_type(std::make_shared<set_type>(set_type{val}), steady_clock::now()));
+		if(newKey)
+			*newKey=created;
 		return inserted;
 	}
 	
 	///Inserts the key-value pair into the table.
+	///\param newKey if not null, set to whether the key was not previously in 
+	///              the table, so that a new category was created for it
 	///\returns true if the pair was newly inserted, false if it was already present
 	template<typename K, typename V>
-	bool insert(K&& key, V&& val){
+	bool insert(K&& key, V&& val, bool* newKey=nullptr){
 		bool inserted=true;
 		//Unfortunately, since val does not match up with Table::mapped_type we 
 		//need to preemptively construct an entire category_type object which
 		//may be unneeded.
-		data.upsert(std::forward<K>(key), 
-					[&](category_type& cat){
-						inserted=cat.first.emplace(val).second;
-			    },category_type({mapped_type{val}}, steady_clock::now()));
+		const bool created=data.upsert(std::forward<K>(key), 
+					[&](stored_category_type& cat){
+						if(cat.first->count(val))
+							inserted=false;
+						else
+							writable(cat).emplace(val);
+			    },stored_category_type(std::make_shared<set_type>(set_type{mapped_type{val}}), steady_clock::now()));
+		if(newKey)
+			*newKey=created;
 		return inserted;
 	}
 	
@@ -165,12 +229,13 @@ public:
 	template<typename K, typename V>
 	bool update(K&& key, V&& val){
 		bool updated=false;
-		data.update_fn(key,[&](category_type& cat){
-			if(cat.first.count(val)){
+		data.update_fn(key,[&](stored_category_type& cat){
+			if(cat.first->count(val)){
 				updated=true;
 				//ensure replacement
-				cat.first.erase(val);
-				cat.first.emplace(val);
+				set_type& items=writable(cat);
+				items.erase(val);
+				items.emplace(val);
 			}
 		});
 		return updated;
@@ -184,7 +249,7 @@ public:
 	template <typename K>
 	bool update_expiration(K&& key, steady_clock::time_point time){
 		bool updated=false;
-		data.update_fn(key,[&](category_type& cat){
+		data.update_fn(key,[&](stored_category_type& cat){
 		    cat.second = time;
 		    updated=true;
 		});
@@ -209,7 +274,7 @@ public:
 	template <typename K, typename V>
 	bool contains(const K& key, V&& val) const{
 		bool found=false;
-		data.find_fn(key,[&](const category_type& cat){ found=cat.first.count(val); });
+		data.find_fn(key,[&](const stored_category_type& cat){ found=cat.first->count(val); });
 		return found;
 	}
 	
@@ -221,7 +286,7 @@ public:
 	template <typename K>
 	size_type count(const K& k) const{
 		size_type n=0;
-		data.find_fn(k,[&n](const category_type& cat){ n=cat.first.size(); });
+		data.find_fn(k,[&n](const stored_category_type& cat){ n=cat.first->size(); });
 		return n;
 	}
 	
@@ -234,7 +299,7 @@ public:
 	template <typename K, typename V>
 	size_type count(const K& k, V&& v) const{
 		size_type n=0;
-		data.find_fn(k,[&](const category_type& cat){ n=cat.first.count(v); });
+		data.find_fn(k,[&](const stored_category_type& cat){ n=cat.first->count(v); });
 		return n;
 	}
 	
@@ -247,16 +312,38 @@ public:
 	template <typename K, typename V>
 	bool find(const K& key, V&& val) const{
 		bool found=false;
-		data.find_fn(key,[&](const category_type& cat){
-			found=cat.first.count(val);
+		data.find_fn(key,[&](const stored_category_type& cat){
+			auto it=cat.first->find(val);
+			found=(it!=cat.first->end());
 			if(found)
-				val=*cat.first.find(val);
+				val=*it;
 		});
 		return found;
 	}
 
 private:
 	Table data;
+	
+	///Get a modifiable version of a category's set of values, copying it first
+	///if any snapshot of it may still be in use. Must only be called while the
+	///category's bucket is locked, so that no new snapshot can be taken. 
+	static set_type& writable(stored_category_type& cat){
+		if(cat.first.use_count()!=1)
+			cat.first=std::make_shared<set_type>(*cat.first);
+		else{
+			//use_count is a relaxed load, so it does not ensure that reads of
+			//the set by the thread which released the last snapshot have 
+			//finished before the set is modified
+			std::atomic_thread_fence(std::memory_order_acquire);
+		}
+		return *cat.first;
+	}
+	
+	///\return a snapshot of an empty set, shared by all failed lookups
+	static snapshot_type emptySet(){
+		static const snapshot_type empty=std::make_shared<const set_type>();
+		return empty;
+	}
 };
 
 #endif //SLATE_CONCURRENT_MULTIMAP_H
@@ -78,6 +78,22 @@ namespace crow
             return *this;
         }
 
+        /// Allow other processes to listen on the same port at the same time
+        self_t& reuse_port(bool reuse = true)
+        {
+            reuse_port_ = reuse;
+            return *this;
+        }
+
+        /// Drain in-progress requests before exiting on SIGINT or SIGTERM.
+        /// See Server::set_graceful_shutdown.
+        self_t& graceful_shutdown(std::chrono::milliseconds timeout, std::function<bool()> is_idle)
+        {
+            drain_timeout_ = timeout;
+            is_idle_ = is_idle;
+            return *this;
+        }
+
         self_t& multithreaded()
         {
             return concurrency(std::thread::hardware_concurrency());
@@ -109,16 +125,20 @@ namespace crow
 #ifdef CROW_ENABLE_SSL
             if (use_ssl_)
             {
-                ssl_server_ = std::move(std::unique_ptr<ssl_server_t>(new ssl_server_t(this, bindaddr_, port_, &middlewares_, concurrency_, &ssl_context_)));
+                ssl_server_ = std::move(std::unique_ptr<ssl_server_t>(new ssl_server_t(this, bindaddr_, port_, &middlewares_, concurrency_, &ssl_context_, reuse_port_)));
                 ssl_server_->set_tick_function(tick_interval_, tick_function_);
+                if (is_idle_)
+                    ssl_server_->set_graceful_shutdown(drain_timeout_, is_idle_);
                 notify_server_start();
                 ssl_server_->run();
             }
             else
 #endif
             {
-                server_ = std::move(std::unique_ptr<server_t>(new server_t(this, bindaddr_, port_, &middlewares_, concurrency_, nullptr)));
+                server_ = std::move(std::unique_ptr<server_t>(new server_t(this, bindaddr_, port_, &middlewares_, concurrency_, nullptr, reuse_port_)));
                 server_->set_tick_function(tick_interval_, tick_function_);
+                if (is_idle_)
+                    server_->set_graceful_shutdown(drain_timeout_, is_idle_);
                 notify_server_start();
                 server_->run();
             }
@@ -249,6 +269,9 @@ namespace crow
         uint16_t port_ = 80;
         uint16_t concurrency_ = 1;
         std::string bindaddr_ = "0.0.0.0";
+        bool reuse_port_ = false;
+        std::chrono::milliseconds drain_timeout_{0};
+        std::function<bool()> is_idle_;
         Router router_;
 
         std::chrono::milliseconds tick_interval_;
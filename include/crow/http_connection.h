@@ -520,7 +520,7 @@ namespace crow
                     {
                         if (close_connection_)
                         {
-                            adaptor_.close();
+                            adaptor_.close_cleanly();
                             CROW_LOG_DEBUG << this << " from write(1)";
                             check_destroy();
                         }
@@ -559,7 +559,7 @@ namespace crow
                 {
                     return;
                 }
-                adaptor_.close();
+                adaptor_.close_cleanly();
             });
             CROW_LOG_DEBUG << this << " timer added: " << timer_cancel_key_.first << ' ' << timer_cancel_key_.second;
         }
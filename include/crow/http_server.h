@@ -26,10 +26,11 @@ namespace crow
     class Server
     {
     public:
-    Server(Handler* handler, std::string bindaddr, uint16_t port, std::tuple<Middlewares...>* middlewares = nullptr, uint16_t concurrency = 1, typename Adaptor::context* adaptor_ctx = nullptr)
-            : acceptor_(io_service_, tcp::endpoint(boost::asio::ip::address::from_string(bindaddr), port)),
+    Server(Handler* handler, std::string bindaddr, uint16_t port, std::tuple<Middlewares...>* middlewares = nullptr, uint16_t concurrency = 1, typename Adaptor::context* adaptor_ctx = nullptr, bool reuse_port = false)
+            : acceptor_(io_service_),
             signals_(io_service_, SIGINT, SIGTERM),
             tick_timer_(io_service_),
+            drain_timer_(io_service_),
             handler_(handler),
             concurrency_(concurrency),
             port_(port),
@@ -37,6 +38,30 @@ namespace crow
             middlewares_(middlewares),
             adaptor_ctx_(adaptor_ctx)
         {
+            tcp::endpoint endpoint(boost::asio::ip::address::from_string(bindaddr), port);
+            acceptor_.open(endpoint.protocol());
+            acceptor_.set_option(tcp::acceptor::reuse_address(true));
+#ifdef SO_REUSEPORT
+            // allows several processes to listen on the same port, with the
+            // kernel distributing incoming connections among them
+            if (reuse_port)
+                acceptor_.set_option(asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true));
+#else
+            if (reuse_port)
+                throw std::runtime_error("SO_REUSEPORT is not supported on this platform");
+#endif
+            acceptor_.bind(endpoint);
+            acceptor_.listen();
+        }
+
+        /// Make SIGINT and SIGTERM shut the server down gracefully: new
+        /// connections stop being accepted, and the server stops once
+        /// `is_idle` reports that no requests are in progress, or once
+        /// `timeout` has passed, whichever is first.
+        void set_graceful_shutdown(std::chrono::milliseconds timeout, std::function<bool()> is_idle)
+        {
+            drain_timeout_ = timeout;
+            is_idle_ = is_idle;
         }
 
         void set_tick_function(std::chrono::milliseconds d, std::function<void()> f)
@@ -154,7 +179,10 @@ namespace crow
 
             signals_.async_wait(
                 [&](const boost::system::error_code& /*error*/, int /*signal_number*/){
-                    stop();
+                    if (is_idle_)
+                        drain();
+                    else
+                        stop();
                 });
 
             while(concurrency_ != init_count)
@@ -176,6 +204,31 @@ namespace crow
         }
 
     private:
+        void drain()
+        {
+            CROW_LOG_INFO << "Draining requests before exiting";
+            boost::system::error_code ec;
+            acceptor_.close(ec);
+            drain_deadline_ = std::chrono::steady_clock::now() + drain_timeout_;
+            check_drained();
+        }
+
+        void check_drained()
+        {
+            if (is_idle_() || std::chrono::steady_clock::now() >= drain_deadline_)
+            {
+                stop();
+                return;
+            }
+            drain_timer_.expires_from_now(boost::posix_time::milliseconds(100));
+            drain_timer_.async_wait([this](const boost::system::error_code& ec)
+                    {
+                        if (ec)
+                            return;
+                        check_drained();
+                    });
+        }
+
         asio::io_service& pick_io_service()
         {
             // TODO load balancing
@@ -205,6 +258,9 @@ namespace crow
                     else
                     {
                         delete p;
+                        // the acceptor has been closed to drain the server
+                        if (ec == boost::asio::error::operation_aborted)
+                            return;
                     }
                     do_accept();
                 });
@@ -218,6 +274,7 @@ namespace crow
         tcp::acceptor acceptor_;
         boost::asio::signal_set signals_;
         boost::asio::deadline_timer tick_timer_;
+        boost::asio::deadline_timer drain_timer_;
 
         Handler* handler_;
         uint16_t concurrency_{1};
@@ -229,6 +286,10 @@ namespace crow
         std::chrono::milliseconds tick_interval_;
         std::function<void()> tick_function_;
 
+        std::chrono::milliseconds drain_timeout_{0};
+        std::function<bool()> is_idle_;
+        std::chrono::steady_clock::time_point drain_deadline_;
+
         std::tuple<Middlewares...>* middlewares_;
 
 #ifdef CROW_ENABLE_SSL
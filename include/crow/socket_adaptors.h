@@ -48,6 +48,11 @@ namespace crow
             socket_.close(ec);
         }
 
+        void close_cleanly()
+        {
+            close();
+        }
+
         template <typename F> 
         void start(F f)
         {
@@ -94,6 +99,17 @@ namespace crow
             raw_socket().close(ec);
         }
 
+        // Close a connection which ended normally, after a complete response
+        // or by going idle. Closing without a TLS shutdown exchange would
+        // otherwise cause OpenSSL to evict the session from the server's
+        // session cache, preventing clients from resuming it. Connections
+        // closed because of errors must not be marked this way.
+        void close_cleanly()
+        {
+            SSL_set_shutdown(ssl_socket_->native_handle(), SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+            close();
+        }
+
         boost::asio::io_service& get_io_service()
         {
             return raw_socket().get_io_service();
@@ -12,6 +12,7 @@
 #include <yaml-cpp/node/parse.h>
 
 #include "KubeInterface.h"
+#include "KubeOutput.h"
 #include "Logging.h"
 #include "Archive.h"
 #include "FileSystem.h"
@@ -34,27 +35,6 @@ std::string getRepoName(Application::Repository repo){
 	}
 }
 
-///Remove all text contained between the strings
-///"### SLATE-START ###" and "### SLATE-END ###"
-std::string filterValuesFile(std::string data){
-	const static std::string startMarker="### SLATE-START ###";
-	const static std::string endMarker="### SLATE-END ###";
-	std::size_t pos=0;
-	while(true){
-		std::size_t startPos=data.find(startMarker,pos);
-		if(startPos==std::string::npos)
-			break;
-		std::size_t endPos=data.find(endMarker,startPos);
-		if(endPos==std::string::npos){
-			log_error("Unbalanced SLATE-internal markers in values data");
-			break;
-		}
-		data.erase(startPos,endPos-startPos + endMarker.size());
-		pos=startPos;
-	}
-	return data;
-}
-
 crow::response listApplications(PersistentStore& store, const crow::request& req){
 	const User user=authenticateUser(store, req.url_params.get("token"));
 	if(!user) //non-users _are_ allowed to list applications
@@ -65,80 +45,75 @@ crow::response listApplications(PersistentStore& store, const crow::request& req
 
 	std::string repoName=getRepoName(selectRepo(req));
 	
-	auto commandResult=runCommand("helm", {"search",repoName+"/","--col-width=1024"});
+	auto commandResult=runCommand("helm", {"search",repoName+"/","--output","json"});
 	if(commandResult.status){
 		log_error("helm search failed: [err] " << commandResult.error << " [out] " << commandResult.output);
 		return crow::response(500,generateError("helm search failed"));
 	}
-	std::vector<std::string> lines = string_split_lines(commandResult.output);
+	std::vector<kubernetes::ChartInfo> charts;
+	try{
+		charts=kubernetes::parseHelmSearch(commandResult.output);
+	}catch(std::runtime_error& err){
+		log_error("Unable to parse helm search output: " << err.what());
+		return crow::response(500,generateError("helm search failed"));
+	}
 
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena arena;
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha3", alloc);
 
-	rapidjson::Value resultItems(rapidjson::kArrayType);
-        int n = 0;
-	while (n < lines.size()) {
-		if (n > 0) {
-			auto tokens = string_split_columns(lines[n], '\t');
-	  	    
-			rapidjson::Value applicationResult(rapidjson::kObjectType);
-			applicationResult.AddMember("apiVersion", "v1alpha3", alloc);
-			applicationResult.AddMember("kind", "Application", alloc);
-			rapidjson::Value applicationData(rapidjson::kObjectType);
-
-			rapidjson::Value name;
-			//strip the leading repository name and slash from the chart name
-			name.SetString(tokens[0].substr(repoName.size()+1), alloc);
-			applicationData.AddMember("name", name, alloc);
-			rapidjson::Value app_version;
-			app_version.SetString(tokens[2], alloc);
-			applicationData.AddMember("app_version", app_version, alloc);
-			rapidjson::Value chart_version;
-			chart_version.SetString(tokens[1], alloc);
-			applicationData.AddMember("chart_version", chart_version, alloc);
-			rapidjson::Value description;
-			description.SetString(tokens[3], alloc);
-			applicationData.AddMember("description", description, alloc);
-	    
-			applicationResult.AddMember("metadata", applicationData, alloc);
-			resultItems.PushBack(applicationResult, alloc);
-		}
-		n++;
+	RequestArena::Value resultItems(rapidjson::kArrayType);
+	resultItems.Reserve(charts.size(), alloc);
+	for(const auto& chart : charts){
+		RequestArena::Value applicationResult(rapidjson::kObjectType);
+		applicationResult.AddMember("apiVersion", "v1alpha3", alloc);
+		applicationResult.AddMember("kind", "Application", alloc);
+		RequestArena::Value applicationData(rapidjson::kObjectType);
+
+		RequestArena::Value name;
+		//strip the leading repository name and slash from the chart name
+		name.SetString(chart.name.substr(repoName.size()+1), alloc);
+		applicationData.AddMember("name", name, alloc);
+		applicationData.AddMember("app_version", chart.appVersion, alloc);
+		applicationData.AddMember("chart_version", chart.chartVersion, alloc);
+		applicationData.AddMember("description", chart.description, alloc);
+		
+		applicationResult.AddMember("metadata", applicationData, alloc);
+		resultItems.PushBack(applicationResult, alloc);
 	}
 
 	result.AddMember("items", resultItems, alloc);
 
-	return crow::response(to_string(result));
+	return conditionalResponse(req,crow::response(to_string(result)));
 }
 
 Application findApplication(std::string appName, Application::Repository repo){
 	std::string repoName=getRepoName(repo);
 	std::string target=repoName+"/"+appName;
-	auto result=runCommand("helm", {"search",target});
+	auto result=runCommand("helm", {"search",target,"--output","json"});
 	if(result.status){
 		log_error("Command failed: helm search " << target << ": [err] " << result.error << " [out] " << result.output);
 		return Application();
 	}
 	
-	if(result.output.find("No results found")!=std::string::npos)
+	std::vector<kubernetes::ChartInfo> charts;
+	try{
+		charts=kubernetes::parseHelmSearch(result.output);
+	}catch(std::runtime_error& err){
+		log_error("Unable to parse output of helm search " << target << ": " << err.what());
 		return Application();
+	}
 	
 	//Deal with the possibility of multiple results, which could happen if
 	//both "slate/stuff" and "slate/superduper" existed and the user requested
 	//the application "s". Multiple results might also not indicate ambiguity, 
 	//if the user searches for the full name of an application, which is also a
 	//prefix of the name another application which exists
-	std::vector<std::string> lines = string_split_lines(result.output);
-	//ignore initial header line printed by helm
-	for(size_t i=1; i<lines.size(); i++){
-		auto tokens=string_split_columns(lines[i], '\t');
-		if(trim(tokens.front())==target){
-			if(tokens.size()>=3)
-				return Application(appName,tokens[2],tokens[1]);
-			return Application(appName,"unknown","unknown");
-		}
+	for(const auto& chart : charts){
+		if(chart.name==target)
+			return Application(appName,chart.appVersion,chart.chartVersion);
 	}
 	
 	return Application();
@@ -154,7 +129,7 @@ crow::response fetchApplicationConfig(PersistentStore& store, const crow::reques
 
 	auto repo=selectRepo(req);
 	std::string repoName=getRepoName(repo);
-		
+	
 	const Application application=findApplication(appName,repo);
 	if(!application)
 		return crow::response(404,generateError("Application not found"));
@@ -165,23 +140,24 @@ crow::response fetchApplicationConfig(PersistentStore& store, const crow::reques
 		return crow::response(500, generateError("Unable to fetch application config"));
 	}
 
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena arena;
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha3", alloc);
 	result.AddMember("kind", "Configuration", alloc);
 
-	rapidjson::Value metadata(rapidjson::kObjectType);
+	RequestArena::Value metadata(rapidjson::kObjectType);
 	metadata.AddMember("name", appName, alloc);
 	metadata.AddMember("version", application.version, alloc);
 	metadata.AddMember("chartVersion", application.chartVersion, alloc);
 	result.AddMember("metadata", metadata, alloc);
 
-	rapidjson::Value spec(rapidjson::kObjectType);
+	RequestArena::Value spec(rapidjson::kObjectType);
 	spec.AddMember("body", filterValuesFile(commandResult.output), alloc);
 	result.AddMember("spec", spec, alloc);
 
-	return crow::response(to_string(result));
+	return conditionalResponse(req,crow::response(to_string(result)));
 }
 
 crow::response fetchApplicationDocumentation(PersistentStore& store, const crow::request& req, const std::string& appName){
@@ -194,7 +170,7 @@ crow::response fetchApplicationDocumentation(PersistentStore& store, const crow:
 
 	auto repo=selectRepo(req);
 	std::string repoName=getRepoName(repo);
-		
+	
 	const Application application=findApplication(appName,repo);
 	if(!application)
 		return crow::response(404,generateError("Application not found"));
@@ -205,27 +181,28 @@ crow::response fetchApplicationDocumentation(PersistentStore& store, const crow:
 		return crow::response(500, generateError("Unable to fetch application readme"));
 	}
 
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena arena;
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha3", alloc);
 	result.AddMember("kind", "Configuration", alloc);
 
-	rapidjson::Value metadata(rapidjson::kObjectType);
+	RequestArena::Value metadata(rapidjson::kObjectType);
 	metadata.AddMember("name", appName, alloc);
 	metadata.AddMember("version", application.version, alloc);
 	metadata.AddMember("chartVersion", application.chartVersion, alloc);
 	result.AddMember("metadata", metadata, alloc);
 
-	rapidjson::Value spec(rapidjson::kObjectType);
+	RequestArena::Value spec(rapidjson::kObjectType);
 	spec.AddMember("body", commandResult.output, alloc);
 	result.AddMember("spec", spec, alloc);
 
-	return crow::response(to_string(result));
+	return conditionalResponse(req,crow::response(to_string(result)));
 }
 
 ///Internal function which requires that initial authorization checks have already been performed
-crow::response installApplicationImpl(PersistentStore& store, const User& user, const std::string& appName, const std::string& installSrc, const rapidjson::Document& body){
+crow::response installApplicationImpl(PersistentStore& store, const User& user, const std::string& appName, const std::string& installSrc, const RequestArena::Document& body){
 	if(!body.HasMember("group"))
 		return crow::response(400,generateError("Missing Group"));
 	if(!body["group"].IsString())
@@ -410,28 +387,36 @@ crow::response installApplicationImpl(PersistentStore& store, const User& user,
 	         << " to " << cluster << " on behalf of " << user);
 
 	auto listResult = runCommand("helm",
-	  {"list",instance.name,"--tiller-namespace",cluster.systemNamespace},
+	  {"list",instance.name,"--output","json","--tiller-namespace",cluster.systemNamespace},
 	  {{"KUBECONFIG",*clusterConfig}});
 	if(listResult.status){
 		log_error("helm list " << instance.name << " failed: [err] " << listResult.error << " [out] " << listResult.output);
 		return crow::response(500,generateError("Failed to query helm for instance information"));
 	}
-	auto lines = string_split_lines(listResult.output);
+	kubernetes::ReleaseList releases;
+	try{
+		releases=kubernetes::parseHelmList(listResult.output);
+	}catch(std::runtime_error& err){
+		log_error("Unable to parse output of helm list " << instance.name << ": " << err.what());
+		return crow::response(500,generateError("Failed to query helm for instance information"));
+	}
 
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena arena;
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha3", alloc);
 	result.AddMember("kind", "Configuration", alloc);
-	rapidjson::Value metadata(rapidjson::kObjectType);
+	RequestArena::Value metadata(rapidjson::kObjectType);
 	metadata.AddMember("id", instance.id, alloc);
 	metadata.AddMember("name", instance.name, alloc);
-	if(lines.size()>1){
-		auto cols = string_split_columns(lines[1], '\t');
-		if(cols.size()>3){
-			metadata.AddMember("revision", cols[1], alloc);
-			metadata.AddMember("updated", cols[2], alloc);
-		}
+	//helm treats the name as a pattern, so other releases may also be listed
+	for(const auto& release : releases.releases){
+		if(release.name!=instance.name)
+			continue;
+		metadata.AddMember("revision", std::to_string(release.revision), alloc);
+		metadata.AddMember("updated", release.updated, alloc);
+		break;
 	}
 	if(!metadata.HasMember("revision")){
 		metadata.AddMember("revision", "?", alloc);
@@ -460,7 +445,8 @@ crow::response installApplication(PersistentStore& store, const crow::request& r
 		return crow::response(403,generateError("Not authorized"));
 	
 	//collect data out of JSON body
-	rapidjson::Document body;
+	RequestArena arena;
+	RequestArena::Document body(&arena.allocator());
 	try{
 		body.Parse(req.body.c_str());
 	}catch(std::runtime_error& err){
@@ -501,9 +487,10 @@ crow::response installAdHocApplication(PersistentStore& store, const crow::reque
 		return crow::response(403,generateError("Not authorized"));
 	
 	//collect data out of JSON body
-	rapidjson::Document body;
+	RequestArena arena;
+	RequestArena::Document body(&arena.allocator());
 	try{
-		body.Parse(req.body.c_str());
+		body.ParseInsitu(arena.copyString(req.body));
 	}catch(std::runtime_error& err){
 		return crow::response(400,generateError("Invalid JSON in request body"));
 	}
@@ -526,10 +513,16 @@ crow::response installAdHocApplication(PersistentStore& store, const crow::reque
 	} dirCleaner{chartDir};
 	try{
 		chartDir=makeTemporaryDir("/tmp/slate_chart_");
-		std::stringstream gzipStream(decodeBase64(body["chart"].GetString())), tarStream;
-		gzipDecompress(gzipStream,tarStream);
-		TarReader tr(tarStream);
-		tr.extractToFileSystem(chartDir+"/");
+		//decode straight from the request body, and then decompress and unpack
+		//in one pass, so that the chart is held in memory only in compressed form
+		const RequestArena::Value& encodedChart=body["chart"];
+		if(!encodedChart.GetStringLength())
+			throw std::runtime_error("Chart data is empty");
+		std::string chart(base64DecodedLength(encodedChart.GetStringLength()),'\0');
+		std::size_t chartLength;
+		if(!decodeBase64(encodedChart.GetString(),encodedChart.GetStringLength(),&chart[0],chartLength))
+			throw std::runtime_error("Chart data is not valid base64");
+		extractGzippedTarball(chart.data(),chartLength,chartDir+"/");
 		log_info("Extracted chart to " << chartDir.path());
 	}catch(std::exception& ex){
 		log_error("Unable to extract application chart: " << ex.what());
@@ -570,10 +563,16 @@ crow::response updateCatalog(PersistentStore& store, const crow::request& req){
 	if(!user)
 		return crow::response(403,generateError("Not authorized"));
 	
+	if(!refreshCatalog())
+		return crow::response(500,generateError("helm repo update failed"));
+	return crow::response(200);
+}
+
+bool refreshCatalog(){
 	auto result = runCommand("helm",{"repo","update"});
 	if(result.status){
 		log_error("helm repo update failed: [err] " << result.error << " [out] " << result.output);
-		return crow::response(500,generateError("helm repo update failed"));
+		return false;
 	}
-	return crow::response(200);
+	return true;
 }
@@ -11,19 +11,19 @@
 #include "yaml-cpp/node/detail/impl.h"
 #include <yaml-cpp/node/parse.h>
 
+#include "EntitySerialization.h"
 #include "KubeInterface.h"
+#include "KubeOutput.h"
 #include "Logging.h"
 #include "ServerUtilities.h"
 
-#include <chrono>
-
 crow::response listApplicationInstances(PersistentStore& store, const crow::request& req){
 	const User user=authenticateUser(store, req.url_params.get("token"));
 	log_info(user << " requested to list application instances");
 	if(!user)
 		return crow::response(403,generateError("Not authorized"));
 	//All users are allowed to list application instances
-
+	
 	std::vector<ApplicationInstance> instances;
 
 	auto group = req.url_params.get("group");
@@ -42,33 +42,17 @@ crow::response listApplicationInstances(PersistentStore& store, const crow::requ
 	} else
 		instances=store.listApplicationInstances();
 	
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
-	
-	result.AddMember("apiVersion", "v1alpha3", alloc);
-	rapidjson::Value resultItems(rapidjson::kArrayType);
-	resultItems.Reserve(instances.size(), alloc);
+	crow::response response;
+	StringOutputStream stream(response.body);
+	JSONWriter writer(stream);
+	beginListResult(writer);
 	for(const ApplicationInstance& instance : instances){
-		rapidjson::Value instanceResult(rapidjson::kObjectType);
-		instanceResult.AddMember("apiVersion", "v1alpha3", alloc);
-		instanceResult.AddMember("kind", "ApplicationInstance", alloc);
-		rapidjson::Value instanceData(rapidjson::kObjectType);
-		instanceData.AddMember("id", instance.id, alloc);
-		instanceData.AddMember("name", instance.name, alloc);
-		std::string application=instance.application;
-		if(application.find('/')!=std::string::npos && application.find('/')<application.size()-1)
-			application=application.substr(application.find('/')+1);
-		instanceData.AddMember("application", application, alloc);
-		instanceData.AddMember("group", store.getGroup(instance.owningGroup).name, alloc);
-		instanceData.AddMember("cluster", store.getCluster(instance.cluster).name, alloc);
-		instanceData.AddMember("created", instance.ctime, alloc);
-		instanceResult.AddMember("metadata", instanceData, alloc);
-		resultItems.PushBack(instanceResult, alloc);
+		writeListFragment(writer, store.getInstanceListFragment(instance));
 		//TODO: query helm to get current status (helm list {instance.name})?
 	}
-	result.AddMember("items", resultItems, alloc);
+	endListResult(writer);
 
-	return crow::response(to_string(result));
+	return conditionalResponse(req,std::move(response));
 }
 
 struct ServiceInterface{
@@ -88,13 +72,9 @@ std::map<std::string,ServiceInterface> getServices(const SharedFileHandle& confi
                                                    const std::string& nspace,
                                                    const std::string& systemNamespace){
 	//first try to get from helm the list of services in the 'release' (instance)
-	using namespace std::chrono;
-	high_resolution_clock::time_point t1 = high_resolution_clock::now();
 	auto helmInfo=runCommand("helm",
 	  {"get",releaseName,"--tiller-namespace",systemNamespace},
 	  {{"KUBECONFIG",*configPath}});
-	high_resolution_clock::time_point t2 = high_resolution_clock::now();
-	log_info("helm get completed in " << duration_cast<duration<double>>(t2-t1).count() << " seconds");
 	if(helmInfo.status || helmInfo.output.find("Error:")==0){
 		log_error(helmInfo.error);
 		return {};
@@ -124,16 +104,13 @@ std::map<std::string,ServiceInterface> getServices(const SharedFileHandle& confi
 	for(const auto& serviceName : serviceNames){
 		ServiceInterface interface;
 		
-		t1 = high_resolution_clock::now();
 		auto serviceResult=kubernetes::kubectl(*configPath,{"get","service",serviceName,"--namespace",nspace,"-o=json"});
-		t2 = high_resolution_clock::now();
-		log_info("kubectl get service completed in " << duration_cast<duration<double>>(t2-t1).count() << " seconds");
 		if(serviceResult.status){
 			log_error("kubectl get service '" << serviceName << "' --namespace '" 
 			          << nspace << "' failed: " << serviceResult.error);
 			continue;
 		}
-		rapidjson::Document serviceData;
+		RequestArena::Document serviceData;
 		try{
 			serviceData.Parse(serviceResult.output.c_str());
 		}catch(std::runtime_error& err){
@@ -183,16 +160,13 @@ std::map<std::string,ServiceInterface> getServices(const SharedFileHandle& confi
 				filter+=selector.name.GetString()+std::string("=")+selector.value.GetString();
 			}
 			//now try to locate the pod in question
-			t1 = high_resolution_clock::now();
 			auto podResult=kubernetes::kubectl(*configPath,{"get","pod","-l",filter,"--namespace",nspace,"-o=json"});
-			t2 = high_resolution_clock::now();
-			log_info("kubectl get pod completed in " << duration_cast<duration<double>>(t2-t1).count() << " seconds");
 			if(serviceResult.status){
 				log_error("kubectl get pod -l " << filter << " --namespace " 
 				          << nspace << " failed: " << podResult.error);
 				continue;
 			}
-			rapidjson::Document podData;
+			RequestArena::Document podData;
 			try{
 				podData.Parse(podResult.output.c_str());
 			}catch(std::runtime_error& err){
@@ -227,33 +201,14 @@ std::vector<std::string> findInstancePods(const ApplicationInstance& instance,
                                           const std::string& systemNamespace, 
                                           const std::string& clusterConfig){
 	std::vector<std::string> pods;
-	//This is awful an should be replaced if possible. 
-	using namespace std::chrono;
-	high_resolution_clock::time_point t1 = high_resolution_clock::now();
 	auto helmInfo=runCommand("helm",
-							 {"status",instance.name,"--tiller-namespace",systemNamespace},
+							 {"status",instance.name,"--output","json","--tiller-namespace",systemNamespace},
 							 {{"KUBECONFIG",clusterConfig}});
-	high_resolution_clock::time_point t2 = high_resolution_clock::now();
-	log_info("helm status completed in " << duration_cast<duration<double>>(t2-t1).count() << " seconds");
 	if(helmInfo.status){
 		log_error("Failed to get helm status for instance " << instance << ": " << helmInfo.error);
 		throw std::runtime_error("Failed to get helm status for instance: " + helmInfo.error);
 	}
-	bool foundPods=false;
-	for(const auto& line : string_split_lines(helmInfo.output)){
-		if(line.find("==> v1/Pod")==0)
-			foundPods=true;
-		else if(foundPods){
-			if(line.find("==>")==0 || line.find("NOTES")==0){
-				foundPods=false;
-				break;
-			}
-			auto items=string_split_columns(line, ' ', false);
-			if(items.empty() || items.front()=="NAME")
-				continue;
-			pods.push_back(items.front());
-		}
-	}
+	pods=kubernetes::parseHelmStatusPods(helmInfo.output);
 	if(pods.empty()){
 		log_error("Found no pods for instance " << instance);
 		throw std::runtime_error("Found no pods for instance");
@@ -264,11 +219,11 @@ std::vector<std::string> findInstancePods(const ApplicationInstance& instance,
 
 ///\pre authorization must have already been checked
 ///\throws std::runtime_error
-rapidjson::Value fetchInstanceDetails(PersistentStore& store, 
+RequestArena::Value fetchInstanceDetails(PersistentStore& store, 
                                       const ApplicationInstance& instance, 
                                       const std::string& systemNamespace, 
-                                      rapidjson::Document::AllocatorType& alloc){
-	rapidjson::Value instanceDetails(rapidjson::kObjectType);
+                                      RequestArena::Allocator& alloc){
+	RequestArena::Value instanceDetails(rapidjson::kObjectType);
 	
 	const Group group=store.getGroup(instance.owningGroup);
 	const std::string nspace=group.namespaceName();
@@ -277,16 +232,10 @@ rapidjson::Value fetchInstanceDetails(PersistentStore& store,
 	std::vector<std::string> pods;
 	pods=internal::findInstancePods(instance, systemNamespace, *configPath);
 	
-	using namespace std::chrono;
-	high_resolution_clock::time_point t1,t2;
-	
-	rapidjson::Value podDetails(rapidjson::kArrayType);
+	RequestArena::Value podDetails(rapidjson::kArrayType);
 	for(const auto& pod : pods){
-		rapidjson::Value podInfo(rapidjson::kObjectType);
-		t1 = high_resolution_clock::now();
+		RequestArena::Value podInfo(rapidjson::kObjectType);
 		auto result=kubernetes::kubectl(*configPath,{"get","pod",pod,"-n",nspace,"-o=json"});
-		t2 = high_resolution_clock::now();
-		log_info("kubectl get pod completed in " << duration_cast<duration<double>>(t2-t1).count() << " seconds");
 		if(result.status){
 			podInfo.AddMember("kind", "Error", alloc);
 			podInfo.AddMember("message", "Failed to get information for pod "+pod, alloc);
@@ -294,7 +243,7 @@ rapidjson::Value fetchInstanceDetails(PersistentStore& store,
 			continue;
 		}
 		
-		rapidjson::Document data(rapidjson::kObjectType,&alloc);
+		RequestArena::Document data(rapidjson::kObjectType,&alloc);
 		try{
 			data.Parse(result.output.c_str());
 		}catch(std::runtime_error& err){
@@ -323,9 +272,9 @@ rapidjson::Value fetchInstanceDetails(PersistentStore& store,
 			if(data["status"].HasMember("conditions"))
 				podInfo.AddMember("conditions",data["status"]["conditions"],alloc);
 			if(data["status"].HasMember("containerStatuses")){
-				rapidjson::Value containers(rapidjson::kArrayType);
+				RequestArena::Value containers(rapidjson::kArrayType);
 				for(auto& item : data["status"]["containerStatuses"].GetArray()){
-					rapidjson::Value container(rapidjson::kObjectType);
+					RequestArena::Value container(rapidjson::kObjectType);
 					if(item.HasMember("image"))
 						container.AddMember("image",item["image"],alloc);
 					if(item.HasMember("name"))
@@ -355,9 +304,9 @@ rapidjson::Value fetchInstanceDetails(PersistentStore& store,
 				log_warn("Unable to parse event data as JSON");
 			}
 			if(haveEventData && data.HasMember("items") && data["items"].IsArray()){
-				rapidjson::Value events(rapidjson::kArrayType);
+				RequestArena::Value events(rapidjson::kArrayType);
 				for(auto& item : data["items"].GetArray()){
-					rapidjson::Value eventInfo(rapidjson::kObjectType);
+					RequestArena::Value eventInfo(rapidjson::kObjectType);
 					if(item.HasMember("count"))
 						eventInfo.AddMember("count",item["count"],alloc);
 					if(item.HasMember("firstTimestamp"))
@@ -402,18 +351,16 @@ crow::response fetchApplicationInstanceInfo(PersistentStore& store, const crow::
 	const Group group=store.getGroup(instance.owningGroup);
 	
 	//TODO: serialize the instance configuration as JSON
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena arena;
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha3", alloc);
 	result.AddMember("kind", "ApplicationInstance", alloc);
-	rapidjson::Value instanceData(rapidjson::kObjectType);
+	RequestArena::Value instanceData(rapidjson::kObjectType);
 	instanceData.AddMember("id", rapidjson::StringRef(instance.id.c_str()), alloc);
 	instanceData.AddMember("name", rapidjson::StringRef(instance.name.c_str()), alloc);
-	std::string application=instance.application;
-	if(application.find('/')!=std::string::npos && application.find('/')<application.size()-1)
-			application=application.substr(application.find('/')+1);
-	instanceData.AddMember("application", application, alloc);
+	instanceData.AddMember("application", unqualifiedApplicationName(instance.application), alloc);
 	instanceData.AddMember("group", store.getGroup(instance.owningGroup).name, alloc);
 	instanceData.AddMember("cluster", store.getCluster(instance.cluster).name, alloc);
 	instanceData.AddMember("created", rapidjson::StringRef(instance.ctime.c_str()), alloc);
@@ -425,9 +372,9 @@ crow::response fetchApplicationInstanceInfo(PersistentStore& store, const crow::
 	auto configPath=store.configPathForCluster(instance.cluster);
 	auto systemNamespace=store.getCluster(instance.cluster).systemNamespace;
 	auto services=getServices(configPath,instance.name,group.namespaceName(),systemNamespace);
-	rapidjson::Value serviceData(rapidjson::kArrayType);
+	RequestArena::Value serviceData(rapidjson::kArrayType);
 	for(const auto& service : services){
-		rapidjson::Value serviceEntry(rapidjson::kObjectType);
+		RequestArena::Value serviceEntry(rapidjson::kObjectType);
 		serviceEntry.AddMember("name", rapidjson::StringRef(service.first.c_str()), alloc);
 		serviceEntry.AddMember("clusterIP", rapidjson::StringRef(service.second.clusterIP.c_str()),
 				       alloc);
@@ -442,7 +389,7 @@ crow::response fetchApplicationInstanceInfo(PersistentStore& store, const crow::
 		try{
 			result.AddMember("details",fetchInstanceDetails(store,instance,systemNamespace,alloc),alloc);
 		}catch(std::runtime_error& err){
-			rapidjson::Value error(rapidjson::kObjectType);
+			RequestArena::Value error(rapidjson::kObjectType);
 			error.AddMember("kind", "Error", alloc);
 			error.AddMember("message", std::string("Failed to detailed information for instance: ")+err.what(), alloc);
 			result.AddMember("details",error,alloc);
@@ -670,12 +617,20 @@ crow::response getApplicationInstanceLogs(PersistentStore& store,
 	for(const auto& pod : pods){
 		//find out what containers are in the pod
 		auto containersResult=kubernetes::kubectl(*configPath,{"get","pod",pod,
-			"-o=jsonpath={.spec.containers[*].name}","-n",nspace});
+			"-o=json","-n",nspace});
+		std::vector<std::string> containers;
 		if(containersResult.status){
 			log_error("Failed to get pod " << pod << " instance " << instance << ": " << containersResult.error);
 			logData+="Failed to get pod "+pod+"\n";
 		}
-		const auto containers=string_split_columns(containersResult.output, ' ', false);
+		else{
+			try{
+				containers=kubernetes::parsePodContainerNames(containersResult.output);
+			}catch(std::runtime_error& err){
+				log_error("Failed to parse pod " << pod << " instance " << instance << ": " << err.what());
+				logData+="Failed to get pod "+pod+"\n";
+			}
+		}
 	
 		if(!container.empty()){
 			if(std::find(containers.begin(),containers.end(),container)!=containers.end())
@@ -689,12 +644,13 @@ crow::response getApplicationInstanceLogs(PersistentStore& store,
 		}
 	}
 	
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena arena;
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha3", alloc);
 	result.AddMember("kind", "ApplicationInstance", alloc);
-	rapidjson::Value instanceData(rapidjson::kObjectType);
+	RequestArena::Value instanceData(rapidjson::kObjectType);
 	instanceData.AddMember("id", instance.id, alloc);
 	instanceData.AddMember("name", instance.name, alloc);
 	instanceData.AddMember("application", instance.application, alloc);
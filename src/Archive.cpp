@@ -1,17 +1,24 @@
 #include <Archive.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cerrno>
 #include <climits>
 #include <cmath>
+#include <condition_variable>
 #include <cstddef>
 #include <cstring>
+#include <deque>
 #include <fstream>
+#include <future>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <stdexcept>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 #include <unistd.h>
 #include <sys/types.h>
@@ -20,6 +27,10 @@
 
 #include <zlib.h>
 
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+	#include <immintrin.h>
+#endif
+
 #include <FileSystem.h>
 
 namespace{
@@ -28,6 +39,243 @@ namespace{
 		"abcdefghijklmnopqrstuvwxyz"
 		"0123456789"
 		"+/";
+	
+	//the value of each base64 character, or -1 for characters which are not
+	//part of the alphabet (including the padding character)
+	const signed char base64ValueTable[256]={
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,62,-1,-1,-1,63,
+		52,53,54,55,56,57,58,59,60,61,-1,-1,-1,-1,-1,-1,
+		-1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,
+		15,16,17,18,19,20,21,22,23,24,25,-1,-1,-1,-1,-1,
+		-1,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,
+		41,42,43,44,45,46,47,48,49,50,51,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+	};
+	
+	///A base64 implementation which handles the bulk of the data in fixed size
+	///blocks, leaving the remainder to the scalar code
+	struct Base64Implementation{
+		Base64Kernel kind;
+		///Encode as many whole blocks of data as possible
+		///\return the number of bytes consumed, always a multiple of 3
+		std::size_t (*encodeBlocks)(const unsigned char* data, std::size_t length, char* out);
+		///Decode as many whole blocks of data as possible, stopping before any
+		///block which contains invalid characters
+		///\return the number of characters consumed, always a multiple of 4
+		std::size_t (*decodeBlocks)(const unsigned char* coded, std::size_t length, unsigned char* out);
+	};
+	
+	std::size_t encodeNoBlocks(const unsigned char*, std::size_t, char*){ return 0; }
+	std::size_t decodeNoBlocks(const unsigned char*, std::size_t, unsigned char*){ return 0; }
+	
+	const Base64Implementation scalarBase64={Base64Kernel::Scalar,&encodeNoBlocks,&decodeNoBlocks};
+	
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SLATE_BASE64_X86 1
+	//The vector kernels follow the techniques described by Wojciech Muła and
+	//Daniel Lemire in "Faster Base64 Encoding and Decoding Using AVX2
+	//Instructions" (ACM Transactions on the Web, 2018). Each is compiled for
+	//its instruction set individually, and chosen at runtime, so that the
+	//rest of the program does not depend on the processor supporting it.
+	
+	///Encode 12 bytes, from the low 12 bytes of each lane of in, to 16
+	///characters
+	__attribute__((target("ssse3")))
+	inline __m128i encodeLane(__m128i in){
+		//gather the three bytes containing each group of four sextets into
+		//each 32 bit word, with the sextets in the order in which they will be
+		//separated
+		in=_mm_shuffle_epi8(in,_mm_set_epi8(10,11,9,10,7,8,6,7,4,5,3,4,1,2,0,1));
+		//shift each sextet into its own byte
+		const __m128i t0=_mm_and_si128(in,_mm_set1_epi32(0x0fc0fc00));
+		const __m128i t1=_mm_mulhi_epu16(t0,_mm_set1_epi32(0x04000040));
+		const __m128i t2=_mm_and_si128(in,_mm_set1_epi32(0x003f03f0));
+		const __m128i t3=_mm_mullo_epi16(t2,_mm_set1_epi32(0x01000010));
+		const __m128i indices=_mm_or_si128(t1,t3);
+		//map each sextet to the offset between it and its character: 0-25 to
+		//13, 26-51 to 0, 52-61 to 1-10, and 62 and 63 to 11 and 12
+		__m128i offsetIndex=_mm_subs_epu8(indices,_mm_set1_epi8(51));
+		const __m128i upper=_mm_cmpgt_epi8(_mm_set1_epi8(26),indices);
+		offsetIndex=_mm_or_si128(offsetIndex,_mm_and_si128(upper,_mm_set1_epi8(13)));
+		const __m128i offsets=_mm_setr_epi8('a'-26,'0'-52,'0'-52,'0'-52,'0'-52,'0'-52,
+		                                    '0'-52,'0'-52,'0'-52,'0'-52,'0'-52,'+'-62,
+		                                    '/'-63,'A',0,0);
+		return _mm_add_epi8(indices,_mm_shuffle_epi8(offsets,offsetIndex));
+	}
+	
+	///Decode 16 characters to 12 bytes, placed in the low 12 bytes of the
+	///result
+	///\param valid set to false if any of the characters is not part of the
+	///             base64 alphabet
+	__attribute__((target("ssse3")))
+	inline __m128i decodeLane(__m128i in, bool& valid){
+		//classify each character by its low and high nibbles; a character is
+		//valid only if the classes have no bit in common
+		const __m128i lowClasses=_mm_setr_epi8(0x15,0x11,0x11,0x11,0x11,0x11,0x11,0x11,
+		                                       0x11,0x11,0x13,0x1A,0x1B,0x1B,0x1B,0x1A);
+		const __m128i highClasses=_mm_setr_epi8(0x10,0x10,0x01,0x02,0x04,0x08,0x04,0x08,
+		                                        0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x10);
+		const __m128i rolls=_mm_setr_epi8(0,16,19,4,-65,-65,-71,-71,0,0,0,0,0,0,0,0);
+		const __m128i mask=_mm_set1_epi8(0x2F);
+		const __m128i highNibbles=_mm_and_si128(_mm_srli_epi32(in,4),mask);
+		const __m128i lowNibbles=_mm_and_si128(in,mask);
+		const __m128i classes=_mm_and_si128(_mm_shuffle_epi8(lowClasses,lowNibbles),
+		                                    _mm_shuffle_epi8(highClasses,highNibbles));
+		valid=_mm_movemask_epi8(_mm_cmpeq_epi8(classes,_mm_setzero_si128()))==0xFFFF;
+		//convert each character to its sextet by adding an offset chosen by
+		//its high nibble, with '/' distinguished from '+'
+		const __m128i isSlash=_mm_cmpeq_epi8(in,mask);
+		in=_mm_add_epi8(in,_mm_shuffle_epi8(rolls,_mm_add_epi8(isSlash,highNibbles)));
+		//pack the four sextets in each 32 bit word into three bytes
+		in=_mm_maddubs_epi16(in,_mm_set1_epi32(0x01400140));
+		in=_mm_madd_epi16(in,_mm_set1_epi32(0x00011000));
+		return _mm_shuffle_epi8(in,_mm_setr_epi8(2,1,0,6,5,4,10,9,8,14,13,12,-1,-1,-1,-1));
+	}
+	
+	__attribute__((target("ssse3")))
+	std::size_t encodeBlocksSSSE3(const unsigned char* data, std::size_t length, char* out){
+		std::size_t consumed=0;
+		//each block reads 16 bytes, of which 12 are used
+		for(; length-consumed>=16; consumed+=12, out+=16){
+			__m128i in=_mm_loadu_si128((const __m128i*)(data+consumed));
+			_mm_storeu_si128((__m128i*)out,encodeLane(in));
+		}
+		return consumed;
+	}
+	
+	__attribute__((target("ssse3")))
+	std::size_t decodeBlocksSSSE3(const unsigned char* coded, std::size_t length, unsigned char* out){
+		std::size_t consumed=0;
+		for(; length-consumed>=16; consumed+=16, out+=12){
+			bool valid;
+			__m128i decoded=decodeLane(_mm_loadu_si128((const __m128i*)(coded+consumed)),valid);
+			if(!valid)
+				break;
+			//write exactly the 12 decoded bytes, since the output buffer may
+			//have no space beyond them
+			_mm_storel_epi64((__m128i*)out,decoded);
+			const int last=_mm_cvtsi128_si32(_mm_srli_si128(decoded,8));
+			std::memcpy(out+8,&last,4);
+		}
+		return consumed;
+	}
+	
+	__attribute__((target("avx2")))
+	std::size_t encodeBlocksAVX2(const unsigned char* data, std::size_t length, char* out){
+		std::size_t consumed=0;
+		//each block reads 28 bytes, of which 24 are used
+		for(; length-consumed>=28; consumed+=24, out+=32){
+			__m256i in=_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(data+consumed)));
+			in=_mm256_inserti128_si256(in,_mm_loadu_si128((const __m128i*)(data+consumed+12)),1);
+			in=_mm256_shuffle_epi8(in,_mm256_set_epi8(10,11,9,10,7,8,6,7,4,5,3,4,1,2,0,1,
+			                                          10,11,9,10,7,8,6,7,4,5,3,4,1,2,0,1));
+			const __m256i t0=_mm256_and_si256(in,_mm256_set1_epi32(0x0fc0fc00));
+			const __m256i t1=_mm256_mulhi_epu16(t0,_mm256_set1_epi32(0x04000040));
+			const __m256i t2=_mm256_and_si256(in,_mm256_set1_epi32(0x003f03f0));
+			const __m256i t3=_mm256_mullo_epi16(t2,_mm256_set1_epi32(0x01000010));
+			const __m256i indices=_mm256_or_si256(t1,t3);
+			__m256i offsetIndex=_mm256_subs_epu8(indices,_mm256_set1_epi8(51));
+			const __m256i upper=_mm256_cmpgt_epi8(_mm256_set1_epi8(26),indices);
+			offsetIndex=_mm256_or_si256(offsetIndex,_mm256_and_si256(upper,_mm256_set1_epi8(13)));
+			const __m256i offsets=_mm256_setr_epi8('a'-26,'0'-52,'0'-52,'0'-52,'0'-52,'0'-52,
+			                                       '0'-52,'0'-52,'0'-52,'0'-52,'0'-52,'+'-62,
+			                                       '/'-63,'A',0,0,
+			                                       'a'-26,'0'-52,'0'-52,'0'-52,'0'-52,'0'-52,
+			                                       '0'-52,'0'-52,'0'-52,'0'-52,'0'-52,'+'-62,
+			                                       '/'-63,'A',0,0);
+			_mm256_storeu_si256((__m256i*)out,_mm256_add_epi8(indices,_mm256_shuffle_epi8(offsets,offsetIndex)));
+		}
+		return consumed+encodeBlocksSSSE3(data+consumed,length-consumed,out);
+	}
+	
+	__attribute__((target("avx2")))
+	std::size_t decodeBlocksAVX2(const unsigned char* coded, std::size_t length, unsigned char* out){
+		const __m256i lowClasses=_mm256_setr_epi8(0x15,0x11,0x11,0x11,0x11,0x11,0x11,0x11,
+		                                          0x11,0x11,0x13,0x1A,0x1B,0x1B,0x1B,0x1A,
+		                                          0x15,0x11,0x11,0x11,0x11,0x11,0x11,0x11,
+		                                          0x11,0x11,0x13,0x1A,0x1B,0x1B,0x1B,0x1A);
+		const __m256i highClasses=_mm256_setr_epi8(0x10,0x10,0x01,0x02,0x04,0x08,0x04,0x08,
+		                                           0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x10,
+		                                           0x10,0x10,0x01,0x02,0x04,0x08,0x04,0x08,
+		                                           0x10,0x10,0x10,0x10,0x10,0x10,0x10,0x10);
+		const __m256i rolls=_mm256_setr_epi8(0,16,19,4,-65,-65,-71,-71,0,0,0,0,0,0,0,0,
+		                                     0,16,19,4,-65,-65,-71,-71,0,0,0,0,0,0,0,0);
+		const __m256i mask=_mm256_set1_epi8(0x2F);
+		std::size_t consumed=0;
+		for(; length-consumed>=32; consumed+=32, out+=24){
+			__m256i in=_mm256_loadu_si256((const __m256i*)(coded+consumed));
+			const __m256i highNibbles=_mm256_and_si256(_mm256_srli_epi32(in,4),mask);
+			const __m256i lowNibbles=_mm256_and_si256(in,mask);
+			const __m256i classes=_mm256_and_si256(_mm256_shuffle_epi8(lowClasses,lowNibbles),
+			                                       _mm256_shuffle_epi8(highClasses,highNibbles));
+			if(!_mm256_testz_si256(classes,classes))
+				break;
+			const __m256i isSlash=_mm256_cmpeq_epi8(in,mask);
+			in=_mm256_add_epi8(in,_mm256_shuffle_epi8(rolls,_mm256_add_epi8(isSlash,highNibbles)));
+			in=_mm256_maddubs_epi16(in,_mm256_set1_epi32(0x01400140));
+			in=_mm256_madd_epi16(in,_mm256_set1_epi32(0x00011000));
+			in=_mm256_shuffle_epi8(in,_mm256_setr_epi8(2,1,0,6,5,4,10,9,8,14,13,12,-1,-1,-1,-1,
+			                                           2,1,0,6,5,4,10,9,8,14,13,12,-1,-1,-1,-1));
+			//move the 12 bytes from the upper lane down to follow those from the
+			//lower lane, and write exactly the 24 decoded bytes
+			in=_mm256_permutevar8x32_epi32(in,_mm256_setr_epi32(0,1,2,4,5,6,-1,-1));
+			_mm_storeu_si128((__m128i*)out,_mm256_castsi256_si128(in));
+			_mm_storel_epi64((__m128i*)(out+16),_mm256_extracti128_si256(in,1));
+		}
+		return consumed+decodeBlocksSSSE3(coded+consumed,length-consumed,out);
+	}
+	
+	const Base64Implementation ssse3Base64={Base64Kernel::SSSE3,&encodeBlocksSSSE3,&decodeBlocksSSSE3};
+	const Base64Implementation avx2Base64={Base64Kernel::AVX2,&encodeBlocksAVX2,&decodeBlocksAVX2};
+#endif
+	
+	const Base64Implementation* implementationFor(Base64Kernel kernel){
+#ifdef SLATE_BASE64_X86
+		__builtin_cpu_init();
+#endif
+		switch(kernel){
+			case Base64Kernel::Scalar:
+				return &scalarBase64;
+#ifdef SLATE_BASE64_X86
+			case Base64Kernel::SSSE3:
+				return __builtin_cpu_supports("ssse3") ? &ssse3Base64 : nullptr;
+			case Base64Kernel::AVX2:
+				return __builtin_cpu_supports("avx2") ? &avx2Base64 : nullptr;
+#endif
+			default:
+				return nullptr;
+		}
+	}
+	
+	std::atomic<const Base64Implementation*>& base64Implementation(){
+		static std::atomic<const Base64Implementation*> implementation(implementationFor(bestBase64Kernel()));
+		return implementation;
+	}
+}
+
+Base64Kernel bestBase64Kernel(){
+	for(Base64Kernel kernel : {Base64Kernel::AVX2,Base64Kernel::SSSE3}){
+		if(implementationFor(kernel))
+			return kernel;
+	}
+	return Base64Kernel::Scalar;
+}
+
+bool selectBase64Kernel(Base64Kernel kernel){
+	const Base64Implementation* implementation=implementationFor(kernel);
+	if(!implementation)
+		return false;
+	base64Implementation().store(implementation);
+	return true;
 }
 
 bool sanityCheckBase64(const std::string& str){
@@ -39,85 +287,84 @@ bool sanityCheckBase64(const std::string& str){
 	return pos==std::string::npos;
 }
 
+std::size_t encodeBase64(const char* data, std::size_t length, char* out){
+	const unsigned char* in=(const unsigned char*)data;
+	char* const start=out;
+	std::size_t i=base64Implementation().load(std::memory_order_relaxed)->encodeBlocks(in,length,out);
+	out+=i/3*4;
+	for(; length-i>=3; i+=3, out+=4){
+		const unsigned int group=(in[i]<<16)|(in[i+1]<<8)|in[i+2];
+		out[0]=base64lookupTable[group>>18];
+		out[1]=base64lookupTable[(group>>12)&0x3F];
+		out[2]=base64lookupTable[(group>>6)&0x3F];
+		out[3]=base64lookupTable[group&0x3F];
+	}
+	if(i<length){ //one or two bytes remain, and must be padded
+		const unsigned int group=(in[i]<<16)|(i+1<length ? in[i+1]<<8 : 0);
+		out[0]=base64lookupTable[group>>18];
+		out[1]=base64lookupTable[(group>>12)&0x3F];
+		out[2]=(i+1<length ? base64lookupTable[(group>>6)&0x3F] : '=');
+		out[3]='=';
+		out+=4;
+	}
+	return out-start;
+}
+
+bool decodeBase64(const char* coded, std::size_t length, char* out, std::size_t& decodedLength){
+	const unsigned char* in=(const unsigned char*)coded;
+	unsigned char* outData=(unsigned char*)out;
+	//the data ends at the first '=', which should begin the padding; as has 
+	//always been the case, anything following it is ignored
+	if(const void* padding=std::memchr(coded,'=',length))
+		length=(const char*)padding-coded;
+	std::size_t i=base64Implementation().load(std::memory_order_relaxed)->decodeBlocks(in,length,outData);
+	outData+=i/4*3;
+	for(; length-i>=4; i+=4, outData+=3){
+		const int a=base64ValueTable[in[i]], b=base64ValueTable[in[i+1]],
+		          c=base64ValueTable[in[i+2]], d=base64ValueTable[in[i+3]];
+		if((a|b|c|d)<0)
+			return false;
+		const unsigned int group=(a<<18)|(b<<12)|(c<<6)|d;
+		outData[0]=group>>16;
+		outData[1]=(group>>8)&0xFF;
+		outData[2]=group&0xFF;
+	}
+	//a partial group yields as many whole bytes as it has bits for
+	unsigned int group=0;
+	const std::size_t remaining=length-i;
+	for(std::size_t j=0; j<remaining; j++){
+		const int value=base64ValueTable[in[i+j]];
+		if(value<0)
+			return false;
+		group|=value<<(18-6*j);
+	}
+	if(remaining>=2)
+		*outData++=group>>16;
+	if(remaining==3)
+		*outData++=(group>>8)&0xFF;
+	decodedLength=outData-(unsigned char*)out;
+	return true;
+}
+
 std::string decodeBase64(const std::string& coded){
-	//table used by boost::archive::iterators::detail::to_6_bit
-	static const signed char lookupTable[] = {
-		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,62,-1,-1,-1,63,
-		52,53,54,55,56,57,58,59,60,61,-1,-1,-1, 0,-1,-1,
-		-1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,
-		15,16,17,18,19,20,21,22,23,24,25,-1,-1,-1,-1,-1,
-		-1,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,
-		41,42,43,44,45,46,47,48,49,50,51,-1,-1,-1,-1,-1
-	};
-	std::size_t codedSize=coded.size();
-	while(codedSize && coded[codedSize-1]=='=')
-		codedSize--;
-	std:size_t outLen=(codedSize*3)/4;
-	std::string decoded(outLen,'\0');
-	char* outData=&decoded.front();
-	unsigned char curBits=0;
-	for(const unsigned char next : coded){
-		if(next=='=')
-			break;
-		if(next>=128 || lookupTable[next]==-1)
-			throw std::runtime_error("Illegal base64 character: '"+std::string(1,next)+"'");
-		unsigned char newBits=lookupTable[next];
-		unsigned char putBits=0;
-		//shove as many bits into the current byte as will fit
-		{
-			putBits=std::min(CHAR_BIT-curBits,6);
-			unsigned int mask=(((1u<<putBits)-1)<<(6-putBits));
-			*outData|=((newBits&mask)>>(6-putBits))<<(CHAR_BIT-curBits-putBits);
-			curBits+=putBits;
-		}
-		if(curBits==CHAR_BIT){ //if the byte is full, advance to the next
-			curBits=0;
-			outData++;
-			//if more bits need to be written put them in now
-			if(putBits<6){
-				putBits=6-putBits;
-				unsigned int mask=(1u<<putBits)-1;
-				*outData|=(newBits&mask)<<(CHAR_BIT-putBits);
-				curBits=putBits;
-			}
-		}
+	if(coded.empty())
+		return {};
+	std::string decoded(base64DecodedLength(coded.size()),'\0');
+	std::size_t decodedLength;
+	if(!decodeBase64(coded.data(),coded.size(),&decoded[0],decodedLength)){
+		//the first character outside the alphabet must precede any padding
+		const std::size_t pos=coded.find_first_not_of(base64lookupTable);
+		throw std::runtime_error("Illegal base64 character: '"+std::string(1,coded[pos])+"'");
 	}
+	decoded.resize(decodedLength);
 	return decoded;
 }
 
 std::string encodeBase64(const std::string& raw){
-	std::size_t pad=(3-raw.size()%3)%3;
-	std:size_t outLen=4*std::ceil(raw.size()/3.);
-	std::string encoded(outLen,'\0');
-	unsigned char availBits=CHAR_BIT;
-	size_t inputIdx=0;
-	for(size_t i=0; i<outLen-pad; i++){
-		unsigned char getBits=0;
-		unsigned char lutIdx=0;
-		//grab as many bits as possible from the current byte
-		{
-			getBits=std::min((unsigned char)6,availBits);
-			unsigned int mask=((1u<<getBits)-1)<<(availBits-getBits);
-			lutIdx|=((raw[inputIdx]&mask)>>(availBits-getBits))<<(6-getBits);
-			availBits-=getBits;
-		}
-		if(availBits==0){ //if that byte is exhausted, advance to the next
-			inputIdx++;
-			availBits=CHAR_BIT;
-			//if more bits are needed get them now
-			if(getBits<6){
-				getBits=6-getBits;
-				unsigned int mask=((1u<<getBits)-1)<<(availBits-getBits);
-				lutIdx|=((raw[inputIdx]&mask)>>(availBits-getBits));
-				availBits-=getBits;
-			}
-		}
-		encoded[i]=base64lookupTable[lutIdx];
-	}
-	for(size_t i=0; i<pad; i++)
-		encoded[outLen-pad+i]='=';
+	if(raw.empty())
+		return {};
+	std::string encoded(base64EncodedLength(raw.size()),'\0');
+	encodeBase64(raw.data(),raw.size(),&encoded[0]);
 	return encoded;
 }
 
@@ -512,6 +759,28 @@ static_assert(sizeof(header_posix_ustar)==512, "a UStar header must be 512 bytes
 ///converts from tar type indicator flags to FileRecord::fileType values
 TarReader::FileRecord::fileType typeForTarTypeFlag(char typeFlag);
 
+///Check that a header is intact and extract the size and mode of the file it
+///describes
+void parseHeaderFields(const header_posix_ustar& h, long long& size, int& mode){
+	if(!h.checksumValid())
+		throw std::runtime_error("Invalid UStar header checksum");
+	
+	auto properlyTerminated=[](const char* field, unsigned int maxLen){
+		for(unsigned int i=0; i<maxLen; i++)
+			if(field[i]==0 || field[i]==' ')
+				return true;
+		return false;
+	};
+	if(!properlyTerminated(h.size,12))
+		throw std::runtime_error("Improperly terminated file size field in UStar header");
+	sscanf(h.size,"%llo",&size);
+	if(size>0x1FFFFFFFF)
+		throw std::runtime_error("Overlarge file size in UStar header");
+	if(!properlyTerminated(h.mode,8))
+		throw std::runtime_error("Improperly terminated file size field in UStar header");
+	sscanf(h.mode,"%o",&mode);
+}
+
 TarReader::FileRecord::FileRecord():
 type(REGULAR_FILE),data(""),mode(0644){}
 TarReader::FileRecord::FileRecord(fileType t, int m):
@@ -520,9 +789,8 @@ TarReader::FileRecord::FileRecord(fileType t, const std::string& d, int m):
 type(t),data(d),mode(m){}
 TarReader::FileRecord::FileRecord(fileType t, unsigned long long dataSize, std::istream& dataSrc, int m):
 type(t),data(""),mode(m){
-	data.reserve(dataSize);
-	for(unsigned long i=0; i<dataSize; i++)
-		data+=dataSrc.get();
+	data.resize(dataSize);
+	dataSrc.read(&data[0],dataSize);
 }
 
 const std::string& TarReader::FileRecord::getData() const{
@@ -558,58 +826,126 @@ TarReader::FileRecord::fileType typeForTarTypeFlag(char typeFlag){
 	}
 }
 
-TarReader::TarReader(std::istream& source):src(source),fileEnded(false){}
+namespace{
+///A read-only stream buffer over data held in memory, used to provide streams
+///for files without copying their contents
+class MemoryStreamBuffer : public std::streambuf{
+public:
+	MemoryStreamBuffer(const char* data, std::size_t length){
+		char* start=const_cast<char*>(data);
+		setg(start,start,start+length);
+	}
+};
 
-std::unique_ptr<std::istream> TarReader::streamForFile(const std::string& name){
-	std::map< std::string,FileRecord >::const_iterator it = files.find(name);
-	if(it==files.end()){
-		if(src.eof())
-			throw missing_file_exception("File '"+name+"' not found");
-		readFiles(name);
-		it = files.find(name);
-		if(it==files.end())
-			throw missing_file_exception("File '"+name+"' not found");
+class MemoryInputStream : public std::istream{
+public:
+	MemoryInputStream(const char* data, std::size_t length):
+	std::istream(nullptr),buffer(data,length){ rdbuf(&buffer); }
+private:
+	MemoryStreamBuffer buffer;
+};
+} //anonymous namespace
+
+TarReader::TarReader(std::istream& source):src(&source),fileEnded(false),
+buffer(nullptr),bufferLength(0),nextIndexed(0){}
+
+TarReader::TarReader(const char* data, std::size_t length):src(nullptr),fileEnded(false),
+buffer(data),bufferLength(length),nextIndexed(0){
+	buildIndex();
+}
+
+void TarReader::buildIndex(){
+	header_posix_ustar h;
+	unsigned short nEmpty=0;
+	std::size_t pos=0;
+	while(bufferLength-pos>=sizeof(h)){
+		std::memcpy(&h,buffer+pos,sizeof(h));
+		pos+=sizeof(h);
+		if(h.isEmpty()){
+			if(++nEmpty==2)
+				break;
+			continue;
+		}
+		nEmpty=0;
+		long long size;
+		int mode;
+		parseHeaderFields(h,size,mode);
+		if((unsigned long long)size>bufferLength-pos)
+			throw std::runtime_error("Unexpected end of tar archive");
+		FileRecord::fileType type=typeForTarTypeFlag(*h.typeflag);
+		IndexEntry entry{type,mode,pos,(std::size_t)size,""};
+		if(type==FileRecord::SYMBOLIC_LINK)
+			entry.linkTarget.assign(h.linkname,strnlen(h.linkname,sizeof(h.linkname)));
+		const std::string name=h.getName();
+		if(index.emplace(name,std::move(entry)).second)
+			archiveOrder.push_back(name);
+		//skip over the data, and its padding, without touching it
+		pos+=size;
+		if(size%512)
+			pos=std::min<std::size_t>(bufferLength,pos+512-(size%512));
 	}
-	return(std::unique_ptr<std::istream>(new std::istringstream(it->second.getData())));
 }
 
-const std::string& TarReader::stringForFile(const std::string& name){
+const TarReader::IndexEntry& TarReader::indexEntry(const std::string& name) const{
+	auto it=index.find(name);
+	if(it==index.end())
+		throw missing_file_exception("File '"+name+"' not found");
+	return it->second;
+}
+
+const TarReader::FileRecord& TarReader::recordForFile(const std::string& name){
 	std::map< std::string,FileRecord >::const_iterator it = files.find(name);
 	if(it==files.end()){
-		if(src.eof())
+		if(buffer){ //materialize the file from the index
+			const IndexEntry& entry=indexEntry(name);
+			if(entry.type==FileRecord::REGULAR_FILE)
+				it=files.emplace(name,FileRecord(entry.type,std::string(buffer+entry.offset,entry.size),entry.mode)).first;
+			else
+				it=files.emplace(name,FileRecord(entry.type,entry.linkTarget,entry.mode)).first;
+			return(it->second);
+		}
+		if(src->eof())
 			throw missing_file_exception("File '"+name+"' not found");
 		readFiles(name);
 		it = files.find(name);
 		if(it==files.end())
 			throw missing_file_exception("File '"+name+"' not found");
 	}
-	return(it->second.getData());
+	return(it->second);
 }
 
-TarReader::FileRecord::fileType TarReader::typeForFile(const std::string& name){
-	std::map< std::string,FileRecord >::const_iterator it = files.find(name);
-	if(it==files.end()){
-		if(src.eof())
-			throw missing_file_exception("File '"+name+"' not found");
-		readFiles(name);
-		it = files.find(name);
-		if(it==files.end())
-			throw missing_file_exception("File '"+name+"' not found");
+std::unique_ptr<std::istream> TarReader::streamForFile(const std::string& name){
+	if(buffer && !files.count(name)){
+		const IndexEntry& entry=indexEntry(name);
+		if(entry.type==FileRecord::REGULAR_FILE)
+			return(std::unique_ptr<std::istream>(new MemoryInputStream(buffer+entry.offset,entry.size)));
 	}
-	return(it->second.getType());
+	return(std::unique_ptr<std::istream>(new std::istringstream(recordForFile(name).getData())));
+}
+
+const std::string& TarReader::stringForFile(const std::string& name){
+	return(recordForFile(name).getData());
+}
+
+std::pair<const char*,std::size_t> TarReader::viewForFile(const std::string& name) const{
+	if(!buffer)
+		throw std::logic_error("File views are only available for tarballs held in memory");
+	const IndexEntry& entry=indexEntry(name);
+	if(entry.type!=FileRecord::REGULAR_FILE)
+		return(std::make_pair(entry.linkTarget.data(),entry.linkTarget.size()));
+	return(std::make_pair(buffer+entry.offset,entry.size));
+}
+
+TarReader::FileRecord::fileType TarReader::typeForFile(const std::string& name){
+	if(buffer)
+		return(indexEntry(name).type);
+	return(recordForFile(name).getType());
 }
 
 int TarReader::modeForFile(const std::string& name){
-	std::map< std::string,FileRecord >::const_iterator it = files.find(name);
-	if(it==files.end()){
-		if(src.eof())
-			throw missing_file_exception("File '"+name+"' not found");
-		readFiles(name);
-		it = files.find(name);
-		if(it==files.end())
-			throw missing_file_exception("File '"+name+"' not found");
-	}
-	return(it->second.getMode());
+	if(buffer)
+		return(indexEntry(name).mode);
+	return(recordForFile(name).getMode());
 }
 
 void TarReader::dropFile(const std::string& name){
@@ -618,6 +954,11 @@ void TarReader::dropFile(const std::string& name){
 }
 
 std::string TarReader::nextFile(){
+	if(buffer){
+		if(nextIndexed==archiveOrder.size())
+			return("");
+		return(archiveOrder[nextIndexed++]);
+	}
 	while(true){
 		std::string name=readFiles("");
 		if(name=="")
@@ -630,6 +971,14 @@ std::string TarReader::nextFile(){
 }
 
 std::string TarReader::nextFileOfType(FileRecord::fileType type){
+	if(buffer){
+		while(nextIndexed<archiveOrder.size()){
+			const std::string& name=archiveOrder[nextIndexed++];
+			if(index.find(name)->second.type==type)
+				return(name);
+		}
+		return("");
+	}
 	while(true){
 		std::string name=readFiles("");
 		if(name=="")
@@ -642,6 +991,8 @@ std::string TarReader::nextFileOfType(FileRecord::fileType type){
 }
 
 bool TarReader::eof() const{
+	if(buffer)
+		return(nextIndexed==archiveOrder.size());
 	return(fileEnded);
 }
 
@@ -652,9 +1003,9 @@ std::string TarReader::readFiles(const std::string& target){
 	std::string name;
 	while(true){
 		name="";
-		src.read((char*)&h,sizeof(h));
+		src->read((char*)&h,sizeof(h));
 		
-		if(src.eof() || src.fail()){
+		if(src->eof() || src->fail()){
 			fileEnded=true;
 			break;
 		}
@@ -671,37 +1022,21 @@ std::string TarReader::readFiles(const std::string& target){
 		else
 			nEmpty = 0;
 			
-		if(!h.checksumValid())
-			throw std::runtime_error("Invalid UStar header checksum");
-		
-		auto properlyTerminated=[](const char* field, unsigned int maxLen){
-			for(unsigned int i=0; i<maxLen; i++)
-				if(field[i]==0 || field[i]==' ')
-					return true;
-			return false;
-		};
-		if(!properlyTerminated(h.size,12))
-			throw std::runtime_error("Improperly terminated file size field in UStar header");
-		sscanf(h.size,"%llo",&size);
-		if(size>0x1FFFFFFFF)
-			throw std::runtime_error("Overlarge file size in UStar header");
-		if(!properlyTerminated(h.mode,8))
-			throw std::runtime_error("Improperly terminated file size field in UStar header");
 		int mode;
-		sscanf(h.mode,"%o",&mode);
+		parseHeaderFields(h,size,mode);
 		
 		FileRecord::fileType type = typeForTarTypeFlag(*h.typeflag);
 		name=h.getName();
 		
 		if(type==FileRecord::REGULAR_FILE)
-			files.insert(std::make_pair(name,FileRecord(type,size,src,mode)));
+			files.insert(std::make_pair(name,FileRecord(type,size,*src,mode)));
 		else if(type == FileRecord::SYMBOLIC_LINK)
 			files.insert(std::make_pair(name,FileRecord(type,h.linkname,mode)));
 		else
 			files.insert(std::make_pair(name,FileRecord(type,mode)));
 		
 		if(size%512)
-			src.ignore(512-(size%512));
+			src->ignore(512-(size%512));
 		if(name==target || target=="")
 			break;
 	}
@@ -840,78 +1175,815 @@ std::string realpathHyp(std::string orig){
 	return assemble();
 }
 
+namespace{
+
+///The directory into which files from a tarball are extracted, which ensures
+///that nothing is placed outside of it
+class ExtractionDestination{
+public:
+	explicit ExtractionDestination(const std::string& prefix):
+	truePrefix(prefix.empty() ? prefix : realpathHyp(prefix)){}
+	
+	///\return the path at which to place a file from the tarball
+	///\throws std::runtime_error if the file would be outside the destination
+	std::string pathFor(const std::string& name) const{
+		std::string filePath=name;
+		if(!truePrefix.empty())
+			filePath=truePrefix+"/"+filePath;
+		filePath=realpathHyp(filePath);
+		if(filePath.find(truePrefix)!=0)
+			throw std::runtime_error("Refusing to extract "+name+" to "+filePath+" which is not within "+truePrefix);
+		return filePath;
+	}
+	
+	void makeSymlink(const std::string& filePath, const std::string& target) const{
+		std::string linkPath=realpathHyp(target);
+		if(linkPath.find(truePrefix)!=0)
+			throw std::runtime_error("Refusing to extract symlink pointing to "+linkPath+" which is not within "+truePrefix);
+		int err=symlink(linkPath.c_str(),filePath.c_str());
+		if(err){
+			err=errno;
+			throw std::runtime_error("Unable to extract symlink: error "+std::to_string(err));
+		}
+	}
+	
+	///Apply the permissions recorded in the archive to an extracted file.
+	///Permissions such as whether the file is executable are kept, but the file
+	///is never made unreadable to its owner or given special bits.
+	void setPermissions(const std::string& filePath, int mode) const{
+		if(chmod(filePath.c_str(),(mode&0777)|0600)!=0)
+			throw std::runtime_error("Unable to set permissions of "+filePath);
+	}
+	
+private:
+	const std::string truePrefix;
+};
+
+///Extracts a tarball to the filesystem as its data arrives, writing the
+///contents of each file directly from the supplied buffers
+class TarStreamExtractor{
+public:
+	explicit TarStreamExtractor(const std::string& prefix):
+	destination(prefix),headerFill(0),dataRemaining(0),skipRemaining(0),
+	emptyHeaders(0),ended(false){}
+	
+	///Process the next portion of the tarball
+	void consume(const char* data, std::size_t length){
+		while(length && !ended){
+			std::size_t used;
+			if(dataRemaining){
+				used=std::min<unsigned long long>(dataRemaining,length);
+				file.write(data,used);
+				if(file.fail())
+					throw std::runtime_error("Failed while writing to "+filePath);
+				dataRemaining-=used;
+				if(!dataRemaining)
+					finishFile();
+			}
+			else if(skipRemaining){
+				used=std::min<unsigned long long>(skipRemaining,length);
+				skipRemaining-=used;
+			}
+			else{
+				used=std::min(sizeof(header)-headerFill,length);
+				std::memcpy((char*)&header+headerFill,data,used);
+				headerFill+=used;
+				if(headerFill==sizeof(header)){
+					headerFill=0;
+					beginEntry();
+				}
+			}
+			data+=used;
+			length-=used;
+		}
+	}
+	
+	///Check that the tarball did not end part way through an entry
+	void finish(){
+		if(dataRemaining || skipRemaining || headerFill)
+			throw std::runtime_error("Unexpected end of tar archive");
+	}
+	
+private:
+	ExtractionDestination destination;
+	header_posix_ustar header;
+	///The amount of the current header which has been received
+	std::size_t headerFill;
+	///The amount of the current file which has yet to be written
+	unsigned long long dataRemaining;
+	///The amount of data, such as padding, which is to be ignored
+	unsigned long long skipRemaining;
+	unsigned short emptyHeaders;
+	bool ended;
+	std::ofstream file;
+	std::string filePath;
+	
+	void beginEntry(){
+		if(header.isEmpty()){
+			if(++emptyHeaders==2)
+				ended=true;
+			return;
+		}
+		emptyHeaders=0;
+		long long size;
+		int mode;
+		parseHeaderFields(header,size,mode);
+		const unsigned long long padding=(size%512 ? 512-size%512 : 0);
+		filePath=destination.pathFor(header.getName());
+		switch(typeForTarTypeFlag(*header.typeflag)){
+			case TarReader::FileRecord::REGULAR_FILE:
+				file.open(filePath,std::ios::binary|std::ios::trunc);
+				if(!file)
+					throw std::runtime_error("Unable to open "+filePath+" for writing");
+				destination.setPermissions(filePath,mode);
+				dataRemaining=size;
+				skipRemaining=padding;
+				if(!dataRemaining)
+					finishFile();
+				break;
+			case TarReader::FileRecord::SYMBOLIC_LINK:
+				destination.makeSymlink(filePath,std::string(header.linkname,strnlen(header.linkname,sizeof(header.linkname))));
+				skipRemaining=size+padding;
+				break;
+			case TarReader::FileRecord::DIRECTORY:
+				mkdir_p(filePath,0755);
+				skipRemaining=size+padding;
+				break;
+			default:
+				throw std::runtime_error("Extraction not implemented for file type "+std::to_string(typeForTarTypeFlag(*header.typeflag)));
+		}
+	}
+	
+	void finishFile(){
+		file.close();
+		if(file.fail())
+			throw std::runtime_error("Failed while writing to "+filePath);
+	}
+};
+
+///Check the header of a gzip stream held in memory
+///\return the length of the header
+std::size_t gzipHeaderLength(const unsigned char* data, std::size_t length){
+	//https://tools.ietf.org/html/rfc1952 section 2.2
+	if(length<10 || data[0]!=0x1F || data[1]!=0x8B)
+		throw std::runtime_error("Invalid gzip header");
+	if(data[2]!=0x08)
+		throw std::runtime_error("Unsupported gzip compression method");
+	const unsigned char flg=data[3];
+	std::size_t pos=10;
+	if(flg&0x4){ //FEXTRA
+		if(length<pos+2)
+			throw std::runtime_error("Invalid gzip header");
+		pos+=2+(data[pos] | (data[pos+1]<<8));
+	}
+	for(unsigned char mask : {0x8,0x10}){ //FNAME and FCOMMENT are NUL terminated
+		if(!(flg&mask))
+			continue;
+		const void* end=pos<length ? memchr(data+pos,0,length-pos) : nullptr;
+		if(!end)
+			throw std::runtime_error("Invalid gzip header");
+		pos=(const unsigned char*)end-data+1;
+	}
+	if(flg&0x2) //FHCRC
+		pos+=2;
+	if(pos>length)
+		throw std::runtime_error("Invalid gzip header");
+	return pos;
+}
+
+///Read a 32 bit little-endian value
+uint32_t readLE32(const unsigned char* data){
+	return data[0] | (data[1]<<8) | (data[2]<<16) | ((uint32_t)data[3]<<24);
+}
+
+///Write a 32 bit little-endian value
+void writeLE32(uint32_t value, char* data){
+	for(unsigned int i=0; i<4; i++)
+		data[i]=(value>>(8*i))&0xFF;
+}
+
+///The amount of input compressed as one unit when compressing in parallel
+const std::size_t parallelBlockSize=128*1024;
+///The amount of the preceding block used to prime the compressor for each
+///block, which is the largest window deflate can use
+const std::size_t dictionarySize=32*1024;
+
+///Compresses a sequence of blocks independently on a set of worker threads,
+///in the manner of pigz. Every block but the last is ended with a sync flush,
+///so that the compressed blocks can simply be concatenated to form a single
+///deflate stream, and each is primed with the end of the preceding block as a
+///dictionary, so that little compression is lost at the block boundaries.
+class BlockCompressor{
+public:
+	struct Job{
+		///The data to compress
+		const char* data;
+		std::size_t length;
+		///The data which precedes this block
+		const char* dictionary;
+		std::size_t dictionaryLength;
+		///Whether this is the final block of the stream
+		bool last;
+		///Optional owners of the data and dictionary, which keep them valid
+		///until the job is complete
+		std::shared_ptr<const std::string> storage, dictionaryStorage;
+		///The result, valid once the job is retrieved
+		std::string compressed;
+		uLong crc;
+
+		std::promise<void> done;
+	};
+
+	explicit BlockCompressor(unsigned int threads):stop(false){
+		for(unsigned int i=0; i<threads; i++)
+			workers.emplace_back([this]{ work(); });
+	}
+
+	~BlockCompressor(){
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop=true;
+		}
+		available.notify_all();
+		for(auto& worker : workers)
+			worker.join();
+	}
+
+	///Queue a block for compression. Blocks are retrieved in the order in
+	///which they are submitted.
+	void submit(std::shared_ptr<Job> job){
+		results.push_back(job->done.get_future());
+		submitted.push_back(job);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.push_back(std::move(job));
+		}
+		available.notify_one();
+	}
+
+	///\return the number of blocks submitted but not yet retrieved
+	std::size_t pending() const{ return submitted.size(); }
+
+	///Wait for the oldest outstanding block to be compressed
+	///\return the completed block
+	///\throws std::runtime_error if compressing the block failed
+	std::shared_ptr<Job> next(){
+		results.front().get();
+		std::shared_ptr<Job> job=std::move(submitted.front());
+		results.pop_front();
+		submitted.pop_front();
+		return job;
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable available;
+	std::deque<std::shared_ptr<Job>> queue;
+	bool stop;
+
+	//only used by the thread which submits the jobs
+	std::deque<std::shared_ptr<Job>> submitted;
+	std::deque<std::future<void>> results;
+
+	void work(){
+		while(true){
+			std::shared_ptr<Job> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				available.wait(lock,[this]{ return stop || !queue.empty(); });
+				if(stop)
+					return;
+				job=std::move(queue.front());
+				queue.pop_front();
+			}
+			try{
+				compress(*job);
+				job->done.set_value();
+			}catch(...){
+				job->done.set_exception(std::current_exception());
+			}
+		}
+	}
+
+	static void compress(Job& job){
+		z_stream zs;
+		zs.zalloc = Z_NULL;
+		zs.zfree = Z_NULL;
+		zs.opaque = Z_NULL;
+		if(deflateInit2(&zs,Z_BEST_COMPRESSION,Z_DEFLATED,-15,8,Z_DEFAULT_STRATEGY)!=Z_OK)
+			throw std::runtime_error("zlib initilization failed");
+		struct deflateCleanup{
+			z_stream* s;
+			~deflateCleanup(){ deflateEnd(s); }
+		} c{&zs};
+		if(job.dictionaryLength
+		   && deflateSetDictionary(&zs,(const unsigned char*)job.dictionary,job.dictionaryLength)!=Z_OK)
+			throw std::runtime_error("zlib compression failed");
+
+		const int flush=job.last ? Z_FINISH : Z_SYNC_FLUSH;
+		//leave room for the marker written by the sync flush
+		job.compressed.resize(deflateBound(&zs,job.length)+16);
+		zs.next_in=(unsigned char*)job.data;
+		zs.avail_in=job.length;
+		std::size_t produced=0;
+		while(true){
+			zs.next_out=(unsigned char*)&job.compressed[produced];
+			zs.avail_out=job.compressed.size()-produced;
+			int result=deflate(&zs,flush);
+			if(result==Z_STREAM_ERROR)
+				throw std::runtime_error("zlib compression failed");
+			produced=job.compressed.size()-zs.avail_out;
+			//a sync flush is complete only if it did not run out of space
+			if(flush==Z_FINISH ? result==Z_STREAM_END : zs.avail_out!=0)
+				break;
+			job.compressed.resize(2*job.compressed.size());
+		}
+		job.compressed.resize(produced);
+		job.crc=crc32(crc32(0,Z_NULL,0),(const unsigned char*)job.data,job.length);
+	}
+};
+
+std::string gzipCompressParallel(const char* data, std::size_t length, unsigned int threads){
+	BlockCompressor compressor(threads);
+	for(std::size_t offset=0; offset<length; offset+=parallelBlockSize){
+		auto job=std::make_shared<BlockCompressor::Job>();
+		job->data=data+offset;
+		job->length=std::min(parallelBlockSize,length-offset);
+		job->dictionaryLength=std::min(dictionarySize,offset);
+		job->dictionary=data+offset-job->dictionaryLength;
+		job->last=(offset+job->length==length);
+		compressor.submit(std::move(job));
+	}
+
+	//the same header as written by gzipCompress
+	std::string compressed={0x1F,(char)0x8B,0x08,0,0,0,0,0,2,(char)255};
+	uLong crc=crc32(0,Z_NULL,0);
+	while(compressor.pending()){
+		auto job=compressor.next();
+		compressed+=job->compressed;
+		crc=crc32_combine(crc,job->crc,job->length);
+	}
+	char trailer[8];
+	writeLE32(crc,trailer);
+	writeLE32(length,trailer+4);
+	compressed.append(trailer,sizeof(trailer));
+	return compressed;
+}
+
+///Choose the number of threads to use for compression
+///\param requested the number of threads requested, or zero for one per core
+unsigned int compressionThreads(unsigned int requested){
+	if(requested)
+		return requested;
+	return std::max(1u,std::thread::hardware_concurrency());
+}
+
+} //anonymous namespace
+
+std::string gzipCompress(const char* data, std::size_t length, unsigned int threads){
+	threads=compressionThreads(threads);
+	//there is nothing to gain from splitting up small inputs
+	if(threads>1 && length>2*parallelBlockSize)
+		return gzipCompressParallel(data,length,threads);
+	if(length>UINT_MAX)
+		throw std::length_error("Data too large to compress in one piece");
+	z_stream zs;
+	zs.zalloc = Z_NULL;
+	zs.zfree = Z_NULL;
+	zs.opaque = Z_NULL;
+	if(deflateInit2(&zs,Z_BEST_COMPRESSION,Z_DEFLATED,-15,8,Z_DEFAULT_STRATEGY)!=Z_OK)
+		throw std::runtime_error("zlib initilization failed");
+	struct deflateCleanup{
+		z_stream* s;
+		~deflateCleanup(){ deflateEnd(s); }
+	} c{&zs};
+	
+	const std::size_t headerSize=10, trailerSize=8;
+	std::string compressed(headerSize+deflateBound(&zs,length)+trailerSize,'\0');
+	//the same header as written by the stream version
+	const char header[headerSize]={0x1F,(char)0x8B,0x08,0,0,0,0,0,2,(char)255};
+	std::copy_n(header,headerSize,&compressed.front());
+	zs.next_in=(unsigned char*)data;
+	zs.avail_in=length;
+	zs.next_out=(unsigned char*)&compressed[headerSize];
+	zs.avail_out=compressed.size()-headerSize-trailerSize;
+	//the output buffer is large enough that this always completes in one call
+	if(deflate(&zs,Z_FINISH)!=Z_STREAM_END)
+		throw std::runtime_error("zlib compression failed");
+	const std::size_t end=headerSize+zs.total_out;
+	writeLE32(crc32(crc32(0,Z_NULL,0),(const unsigned char*)data,length),&compressed[end]);
+	writeLE32(length,&compressed[end+4]);
+	compressed.resize(end+trailerSize);
+	return compressed;
+}
+
+class GzipOutputStream::Buffer : public std::streambuf{
+public:
+	Buffer(std::ostream& dest, unsigned int threads):
+	dest(dest),input(new char[inputSize]),output(new unsigned char[outputSize]),
+	crc(crc32(0,Z_NULL,0)),totalSize(0),finished(false),threads(compressionThreads(threads)){
+		zs.zalloc = Z_NULL;
+		zs.zfree = Z_NULL;
+		zs.opaque = Z_NULL;
+		if(deflateInit2(&zs,Z_BEST_COMPRESSION,Z_DEFLATED,-15,8,Z_DEFAULT_STRATEGY)!=Z_OK)
+			throw std::runtime_error("zlib initilization failed");
+		//the same header as written by gzipCompress
+		const char header[10]={0x1F,(char)0x8B,0x08,0,0,0,0,0,2,(char)255};
+		dest.write(header,sizeof(header));
+		if(this->threads>1){
+			parallel.reset(new BlockCompressor(this->threads));
+			block=std::make_shared<std::string>(parallelBlockSize,'\0');
+			setp(&(*block)[0],&(*block)[0]+parallelBlockSize);
+		}
+		else
+			setp(input.get(),input.get()+inputSize);
+	}
+	
+	~Buffer(){
+		deflateEnd(&zs);
+	}
+	
+	void finish(){
+		if(finished)
+			return;
+		finished=true;
+		if(parallel){
+			submitBlock(true);
+			writeCompletedBlocks(0);
+		}
+		else
+			compress(Z_FINISH);
+		char trailer[8];
+		writeLE32(crc,trailer);
+		writeLE32(totalSize,trailer+4);
+		dest.write(trailer,sizeof(trailer));
+		if(dest.fail())
+			throw std::runtime_error("Output stream failure");
+	}
+	
+protected:
+	int_type overflow(int_type c) override{
+		if(finished)
+			return traits_type::eof();
+		try{
+			if(parallel){
+				submitBlock(false);
+				//keep all of the workers busy, without letting the amount of
+				//buffered data grow without bound
+				writeCompletedBlocks(2*threads);
+			}
+			else
+				compress(Z_NO_FLUSH);
+		}catch(std::runtime_error&){
+			return traits_type::eof();
+		}
+		if(!traits_type::eq_int_type(c,traits_type::eof())){
+			*pptr()=traits_type::to_char_type(c);
+			pbump(1);
+		}
+		return traits_type::not_eof(c);
+	}
+	
+private:
+	static const std::size_t inputSize=128*1024;
+	static const std::size_t outputSize=128*1024;
+	
+	std::ostream& dest;
+	std::unique_ptr<char[]> input;
+	std::unique_ptr<unsigned char[]> output;
+	z_stream zs;
+	uLong crc;
+	uint32_t totalSize;
+	bool finished;
+	unsigned int threads;
+	///Used in place of zs when compressing with multiple threads
+	std::unique_ptr<BlockCompressor> parallel;
+	///When compressing in parallel, the block being filled, and the one
+	///before it, which supplies the next block's dictionary
+	std::shared_ptr<std::string> block, previousBlock;
+	
+	///Compress the data in the put area, and empty it
+	void compress(int flush){
+		const std::size_t available=pptr()-pbase();
+		crc=crc32(crc,(const unsigned char*)pbase(),available);
+		totalSize+=available;
+		zs.next_in=(unsigned char*)pbase();
+		zs.avail_in=available;
+		int result;
+		do{
+			zs.next_out=output.get();
+			zs.avail_out=outputSize;
+			result=deflate(&zs,flush);
+			if(result==Z_STREAM_ERROR)
+				throw std::runtime_error("zlib compression failed");
+			dest.write((const char*)output.get(),outputSize-zs.avail_out);
+			if(dest.fail())
+				throw std::runtime_error("Output stream failure");
+		}while(zs.avail_out==0 || (flush==Z_FINISH && result!=Z_STREAM_END));
+		setp(input.get(),input.get()+inputSize);
+	}
+	
+	///Hand the data in the put area to the worker threads, and start a new block
+	void submitBlock(bool last){
+		block->resize(pptr()-pbase());
+		auto job=std::make_shared<BlockCompressor::Job>();
+		job->data=block->data();
+		job->length=block->size();
+		job->storage=block;
+		if(previousBlock){
+			job->dictionaryLength=std::min(dictionarySize,previousBlock->size());
+			job->dictionary=previousBlock->data()+previousBlock->size()-job->dictionaryLength;
+			job->dictionaryStorage=previousBlock;
+		}
+		else
+			job->dictionaryLength=0;
+		job->last=last;
+		totalSize+=job->length;
+		parallel->submit(std::move(job));
+		previousBlock=std::move(block);
+		block=std::make_shared<std::string>(parallelBlockSize,'\0');
+		setp(&(*block)[0],&(*block)[0]+parallelBlockSize);
+	}
+	
+	///Write out compressed blocks, in order, until no more than a given number
+	///remain outstanding
+	void writeCompletedBlocks(std::size_t outstanding){
+		while(parallel->pending()>outstanding){
+			auto job=parallel->next();
+			crc=crc32_combine(crc,job->crc,job->length);
+			dest.write(job->compressed.data(),job->compressed.size());
+			if(dest.fail())
+				throw std::runtime_error("Output stream failure");
+		}
+	}
+};
+
+GzipOutputStream::GzipOutputStream(std::ostream& dest, unsigned int threads):
+std::ostream(nullptr),buffer(new Buffer(dest,threads)){
+	rdbuf(buffer.get());
+}
+
+GzipOutputStream::~GzipOutputStream(){
+	try{
+		buffer->finish();
+	}catch(...){}
+}
+
+void GzipOutputStream::finish(){
+	buffer->finish();
+}
+
+class Base64OutputStream::Buffer : public std::streambuf{
+public:
+	explicit Buffer(std::ostream& dest):
+	dest(dest),input(new char[inputSize]),output(new char[base64EncodedLength(inputSize)]),
+	finished(false){
+		setp(input.get(),input.get()+inputSize);
+	}
+	
+	void finish(){
+		if(finished)
+			return;
+		finished=true;
+		encode(pptr()-pbase());
+		if(dest.fail())
+			throw std::runtime_error("Output stream failure");
+	}
+	
+protected:
+	int_type overflow(int_type c) override{
+		if(finished)
+			return traits_type::eof();
+		//the buffer size is a multiple of 3, so no padding is produced
+		encode(inputSize);
+		if(dest.fail())
+			return traits_type::eof();
+		if(!traits_type::eq_int_type(c,traits_type::eof())){
+			*pptr()=traits_type::to_char_type(c);
+			pbump(1);
+		}
+		return traits_type::not_eof(c);
+	}
+	
+private:
+	static const std::size_t inputSize=3*16*1024;
+	
+	std::ostream& dest;
+	std::unique_ptr<char[]> input;
+	std::unique_ptr<char[]> output;
+	bool finished;
+	
+	///Encode the first length bytes of the put area, and empty it
+	void encode(std::size_t length){
+		dest.write(output.get(),encodeBase64(pbase(),length,output.get()));
+		setp(input.get(),input.get()+inputSize);
+	}
+};
+
+Base64OutputStream::Base64OutputStream(std::ostream& dest):
+std::ostream(nullptr),buffer(new Buffer(dest)){
+	rdbuf(buffer.get());
+}
+
+Base64OutputStream::~Base64OutputStream(){
+	try{
+		buffer->finish();
+	}catch(...){}
+}
+
+void Base64OutputStream::finish(){
+	buffer->finish();
+}
+
+namespace{
+///Decompress a gzip stream held in memory, checking its trailer
+///\param consume called with each portion of the decompressed data
+template<typename Consumer>
+void inflateBuffer(const char* data, std::size_t length, Consumer consume){
+	const unsigned char* input=(const unsigned char*)data;
+	const std::size_t headerLength=gzipHeaderLength(input,length);
+	if(length-headerLength>UINT_MAX)
+		throw std::length_error("Compressed data too large to decompress in one piece");
+	
+	z_stream zs;
+	zs.next_in=(unsigned char*)input+headerLength;
+	zs.avail_in=length-headerLength;
+	zs.zalloc = Z_NULL;
+	zs.zfree = Z_NULL;
+	zs.opaque = Z_NULL;
+	if(inflateInit2(&zs,-15)!=Z_OK)
+		throw std::runtime_error("Failed to initialize zlib decompression");
+	struct inflateCleanup{
+		z_stream* s;
+		~inflateCleanup(){ inflateEnd(s); }
+	} c{&zs};
+	
+	const std::size_t outputSize=256*1024;
+	std::unique_ptr<unsigned char[]> output(new unsigned char[outputSize]);
+	uLong crc=crc32(0,Z_NULL,0);
+	uint32_t totalSize=0;
+	int result;
+	do{
+		zs.next_out=output.get();
+		zs.avail_out=outputSize;
+		result=inflate(&zs,Z_NO_FLUSH);
+		if(result==Z_BUF_ERROR) //no progress possible, so the input is incomplete
+			throw std::runtime_error("Unexpected end of compressed stream");
+		if(result!=Z_OK && result!=Z_STREAM_END){
+			std::ostringstream ss;
+			ss << "Zlib decompression error: " << result;
+			if(zs.msg!=Z_NULL)
+				ss << " (" << zs.msg << ')';
+			throw std::runtime_error(ss.str());
+		}
+		const std::size_t produced=outputSize-zs.avail_out;
+		crc=crc32(crc,output.get(),produced);
+		totalSize+=produced;
+		consume((const char*)output.get(),produced);
+	}while(result!=Z_STREAM_END);
+	
+	if(zs.avail_in<8)
+		throw std::runtime_error("Unexpected end of compressed stream");
+	if(readLE32(zs.next_in)!=crc || readLE32(zs.next_in+4)!=totalSize)
+		throw std::runtime_error("Compressed data is corrupt: checksum mismatch");
+}
+} //anonymous namespace
+
+std::string gzipDecompress(const char* data, std::size_t length){
+	std::string decompressed;
+	//the trailer records the uncompressed size (modulo 2^32), which is a
+	//useful hint, provided it is not absurd
+	if(length>=18)
+		decompressed.reserve(std::min<std::size_t>(readLE32((const unsigned char*)data+length-4),1032*length));
+	inflateBuffer(data,length,[&decompressed](const char* output, std::size_t produced){
+		decompressed.append(output,produced);
+	});
+	return decompressed;
+}
+
+void extractGzippedTarball(const char* data, std::size_t length, const std::string& prefix){
+	TarStreamExtractor extractor(prefix);
+	inflateBuffer(data,length,[&extractor](const char* output, std::size_t produced){
+		extractor.consume(output,produced);
+	});
+	extractor.finish();
+}
+
+class GzippedTarballExtractor::Impl{
+public:
+	explicit Impl(const std::string& prefix):
+	extractor(prefix),output(new unsigned char[outputSize]),ended(false){
+		zs.next_in=Z_NULL;
+		zs.avail_in=0;
+		zs.zalloc = Z_NULL;
+		zs.zfree = Z_NULL;
+		zs.opaque = Z_NULL;
+		//let zlib handle the gzip header and trailer, including checking the CRC
+		if(inflateInit2(&zs,15+16)!=Z_OK)
+			throw std::runtime_error("Failed to initialize zlib decompression");
+	}
+	
+	~Impl(){
+		inflateEnd(&zs);
+	}
+	
+	void consume(const char* data, std::size_t length){
+		while(length && !ended){
+			const std::size_t block=std::min<std::size_t>(length,UINT_MAX);
+			zs.next_in=(unsigned char*)data;
+			zs.avail_in=block;
+			do{
+				zs.next_out=output.get();
+				zs.avail_out=outputSize;
+				int result=inflate(&zs,Z_NO_FLUSH);
+				if(result==Z_STREAM_END)
+					ended=true;
+				//Z_BUF_ERROR only means that more input is needed
+				else if(result!=Z_OK && result!=Z_BUF_ERROR){
+					std::ostringstream ss;
+					ss << "Zlib decompression error: " << result;
+					if(zs.msg!=Z_NULL)
+						ss << " (" << zs.msg << ')';
+					throw std::runtime_error(ss.str());
+				}
+				extractor.consume((const char*)output.get(),outputSize-zs.avail_out);
+			}while(!ended && (zs.avail_in || !zs.avail_out));
+			//any data after the end of the gzip stream is ignored
+			data+=block;
+			length-=block;
+		}
+	}
+	
+	void finish(){
+		if(!ended)
+			throw std::runtime_error("Unexpected end of compressed stream");
+		extractor.finish();
+	}
+	
+private:
+	static const std::size_t outputSize=256*1024;
+	TarStreamExtractor extractor;
+	std::unique_ptr<unsigned char[]> output;
+	z_stream zs;
+	bool ended;
+};
+
+GzippedTarballExtractor::GzippedTarballExtractor(const std::string& prefix):
+impl(new Impl(prefix)){}
+
+GzippedTarballExtractor::~GzippedTarballExtractor(){}
+
+void GzippedTarballExtractor::consume(const char* data, std::size_t length){
+	impl->consume(data,length);
+}
+
+void GzippedTarballExtractor::finish(){
+	impl->finish();
+}
+
 void TarReader::extractToFileSystem(const std::string& prefix, bool dropAfterExtracting){
 	//TODO: this won't play well with any previous calls to other extraction functions. 
 	//We can't just dump out the contents of files because the order of directories
 	//and their contents matters, and we don't store that. For now just error out. 
-	if(!files.empty())
+	//Tarballs held in memory do not have this problem, since they are indexed.
+	if(!buffer && !files.empty())
 		throw std::runtime_error("extractToFileSystem does not correctly handle already extracted files");
-
-	using StringDeleter=void(*)(char *);
-	StringDeleter sfree=[](char* p){ free(p); };
 	
-	//figure out the true path to which we are extracting
-	const std::string truePrefix=[&prefix,sfree](){
-		if(prefix.empty())
-			return prefix;
-		return realpathHyp(prefix);
-		std::unique_ptr<char[],StringDeleter> rawPrefix(realpath(prefix.c_str(),nullptr),sfree);
-		if(!rawPrefix){
-			int err=errno;
-			throw std::runtime_error("realpath failed with error "+std::to_string(err));
-		}
-		return std::string(rawPrefix.get());
-	}();
+	const ExtractionDestination destination(prefix);
 	
 	while(!eof()){
-		std::string baseFileName=readFiles("");
+		std::string baseFileName=(buffer ? nextFile() : readFiles(""));
 		if(baseFileName.empty())
 			break;
-		std::string filePath=baseFileName;
-		if(!truePrefix.empty())
-			filePath=truePrefix+"/"+filePath;
-		/*std::unique_ptr<char[],StringDeleter> rawPath(realpath(filePath.c_str(),nullptr),sfree);
-		if(!rawPath){
-			int err=errno;
-			throw std::runtime_error("realpath failed with error "+std::to_string(err));
-		}
-		filePath=rawPath.get();*/
-		filePath=realpathHyp(filePath);
-		if(filePath.find(truePrefix)!=0)
-			throw std::runtime_error("Refusing to extract "+baseFileName+" to "+filePath+" which is not within "+truePrefix);
+		const std::string filePath=destination.pathFor(baseFileName);
 		
-		const FileRecord& file=files[baseFileName];
-		//TODO: set permissions on extracted files
-		switch(file.getType()){
+		//files in memory are written directly from the tarball
+		const FileRecord::fileType type=typeForFile(baseFileName);
+		const std::pair<const char*,std::size_t> fileData=(buffer ? viewForFile(baseFileName) :
+			std::make_pair(files[baseFileName].getData().data(),files[baseFileName].getData().size()));
+		switch(type){
 			case FileRecord::REGULAR_FILE:
 			{
-				std::ofstream outfile(filePath);
+				std::ofstream outfile(filePath,std::ios::binary|std::ios::trunc);
 				if(!outfile)
 					throw std::runtime_error("Unable to open "+filePath+" for writing");
-				std::ostreambuf_iterator<char> out_it (outfile);
-				const std::string& fileData=file.getData();
-				std::copy(fileData.begin(), fileData.end(), out_it);
+				destination.setPermissions(filePath,modeForFile(baseFileName));
+				outfile.write(fileData.first,fileData.second);
+				if(outfile.fail())
+					throw std::runtime_error("Failed while writing to "+filePath);
 				break;
 			}
 			case FileRecord::SYMBOLIC_LINK:
-			{
-				std::string linkPath=realpathHyp(file.getData());
-				if(linkPath.find(truePrefix)!=0)
-					throw std::runtime_error("Refusing to extract symlink pointing to "+linkPath+" which is not within "+truePrefix);
-				int err=symlink(linkPath.c_str(),filePath.c_str());
-				if(err){
-					err=errno;
-					throw std::runtime_error("Unable to extract symlink: error "+std::to_string(err));
-				}
+				destination.makeSymlink(filePath,std::string(fileData.first,fileData.second));
 				break;
-			}
 			case FileRecord::DIRECTORY:
 			{
 				mkdir_p(filePath,0755);
 				break;
 			}
 			default:
-				throw std::runtime_error("Extraction not implemented for file type "+std::to_string(file.getType()));
+				throw std::runtime_error("Extraction not implemented for file type "+std::to_string(type));
 		}
 		if(dropAfterExtracting)
 			dropFile(baseFileName);
@@ -950,10 +2022,35 @@ void TarWriter::appendSymLink(const std::string& filepath, const std::string& li
 	sink.write((const char*)&symEntry,sizeof(header_posix_ustar));
 }
 
+void TarWriter::appendFile(const std::string& filepath, std::istream& data, unsigned long long size){
+	if(ended)
+		throw std::runtime_error("Cannot append to an ended tar stream");
+	header_posix_ustar header(filepath,size);
+	sink.write((const char*)&header,sizeof(header));
+	const std::size_t chunkSize=64*1024;
+	std::unique_ptr<char[]> chunk(new char[chunkSize]);
+	for(unsigned long long remaining=size; remaining;){
+		const std::size_t count=std::min<unsigned long long>(remaining,chunkSize);
+		data.read(chunk.get(),count);
+		if((std::size_t)data.gcount()!=count)
+			throw std::runtime_error("Unable to read all data for "+filepath);
+		sink.write(chunk.get(),count);
+		if(sink.fail())
+			throw std::runtime_error("Failed to write "+filepath+" to tar stream");
+		remaining-=count;
+	}
+	static const char padding[512]={0};
+	if(size%512)
+		sink.write(padding,512-size%512);
+	if(sink.fail())
+		throw std::runtime_error("Failed to write "+filepath+" to tar stream");
+}
+
 void TarWriter::endStream(){
 	if(!ended){
 		for(unsigned int i=0; i<2*sizeof(header_posix_ustar); i++)
 			sink.put('\0');
+		ended=true;
 	}
 }
 
@@ -995,14 +2092,14 @@ void recursivelyArchive(std::string basePath, TarWriter& writer, bool stripPrefi
 			if(is_directory(*it))
 				todo.push(it->path().str());
 			else if(is_regular_file(*it)){
-				//TODO: get file contents!
-				std::ifstream infile(it->path().str());
+				//stream the file's contents, rather than holding them in memory
+				std::ifstream infile(it->path().str(),std::ios::binary);
 				if(!infile)
 					throw std::runtime_error("Unable to open "+it->path().str()+" for reading");
-				std::istreambuf_iterator<char> input(infile), eof;
-				std::ostringstream fileData;
-				std::copy(input, eof, std::ostreambuf_iterator<char>(fileData));
-				writer.appendFile(cleanPath(it->path().str()),fileData.str());
+				struct stat info;
+				if(stat(it->path().str().c_str(),&info)!=0)
+					throw std::runtime_error("Unable to stat "+it->path().str());
+				writer.appendFile(cleanPath(it->path().str()),infile,info.st_size);
 			}
 			else if(is_symlink(*it)){
 				const size_t len=2048;
@@ -1010,7 +2107,7 @@ void recursivelyArchive(std::string basePath, TarWriter& writer, bool stripPrefi
 				ssize_t res=readlink(it->path().str().c_str(), buf.get(), len-1);
 				if(res==-1)
 					throw std::runtime_error("readlink failed on "+it->path().str());
-				buf[len]=0;
+				buf[res]=0;
 				//std::cout << "  Link refers to to " << buf.get() << std::endl;
 				writer.appendSymLink(cleanPath(it->path().str()),buf.get());
 			}
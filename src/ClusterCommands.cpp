@@ -15,12 +15,46 @@
 #include "yaml-cpp/node/detail/impl.h"
 #include <yaml-cpp/node/parse.h>
 
+#include "EntitySerialization.h"
 #include "KubeInterface.h"
+#include "KubeOutput.h"
 #include "Logging.h"
 #include "ServerUtilities.h"
 #include "ApplicationInstanceCommands.h"
 #include "SecretCommands.h"
 
+namespace{
+
+///\param result the result of a command of the form `kubectl get <kind> -o=json`
+///\return the names of the objects which were listed, or nothing if the 
+///        command failed or its output could not be understood
+std::vector<std::string> listedNames(const commandResult& result){
+	if(result.status)
+		return {};
+	try{
+		return kubernetes::parseItemNames(result.output);
+	}catch(std::runtime_error& err){
+		log_error("Unable to parse kubectl output: " << err.what());
+		return {};
+	}
+}
+
+///\param result the result of a command of the form 
+///              `kubectl get <kind> -o=custom-columns=NAME:.metadata.name --no-headers`
+///\return the names of the objects which were listed, or nothing if the 
+///        command failed
+std::vector<std::string> listedNameColumn(const commandResult& result){
+	if(result.status)
+		return {};
+	return kubernetes::parseNameColumn(result.output);
+}
+
+bool contains(const std::vector<std::string>& names, const std::string& name){
+	return std::find(names.begin(),names.end(),name)!=names.end();
+}
+
+}
+
 crow::response listClusters(PersistentStore& store, const crow::request& req){
 	std::vector<Cluster> clusters;
 	const User user=authenticateUser(store, req.url_params.get("token"));
@@ -28,43 +62,21 @@ crow::response listClusters(PersistentStore& store, const crow::request& req){
 	if(!user)
 		return crow::response(403,generateError("Not authorized"));
 	//All users are allowed to list clusters
-
+	
 	if (auto group = req.url_params.get("group"))
 		clusters=store.listClustersByGroup(group);
 	else
 		clusters=store.listClusters();
 
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
-	
-	result.AddMember("apiVersion", "v1alpha3", alloc);
-	rapidjson::Value resultItems(rapidjson::kArrayType);
-	resultItems.Reserve(clusters.size(), alloc);
-	for(const Cluster& cluster : clusters){
-		rapidjson::Value clusterResult(rapidjson::kObjectType);
-		clusterResult.AddMember("apiVersion", "v1alpha3", alloc);
-		clusterResult.AddMember("kind", "Cluster", alloc);
-		rapidjson::Value clusterData(rapidjson::kObjectType);
-		clusterData.AddMember("id", cluster.id, alloc);
-		clusterData.AddMember("name", cluster.name, alloc);
-		clusterData.AddMember("owningGroup", store.findGroupByID(cluster.owningGroup).name, alloc);
-		clusterData.AddMember("owningOrganization", cluster.owningOrganization, alloc);
-		std::vector<GeoLocation> locations=store.getLocationsForCluster(cluster.id);
-		rapidjson::Value clusterLocation(rapidjson::kArrayType);
-		clusterLocation.Reserve(locations.size(), alloc);
-		for(const auto& location : locations){
-			rapidjson::Value entry(rapidjson::kObjectType);
-			entry.AddMember("lat",location.lat, alloc);
-			entry.AddMember("lon",location.lon, alloc);
-			clusterLocation.PushBack(entry, alloc);
-		}
-		clusterData.AddMember("location", clusterLocation, alloc);
-		clusterResult.AddMember("metadata", clusterData, alloc);
-		resultItems.PushBack(clusterResult, alloc);
-	}
-	result.AddMember("items", resultItems, alloc);
+	crow::response response;
+	StringOutputStream stream(response.body);
+	JSONWriter writer(stream);
+	beginListResult(writer);
+	for(const Cluster& cluster : clusters)
+		writeListFragment(writer, store.getClusterListFragment(cluster));
+	endListResult(writer);
 
-	return crow::response(to_string(result));
+	return conditionalResponse(req,std::move(response));
 }
 
 crow::response createCluster(PersistentStore& store, const crow::request& req){
@@ -76,9 +88,10 @@ crow::response createCluster(PersistentStore& store, const crow::request& req){
 	//TODO: What other information is required to register a cluster?
 	
 	//unpack the target cluster info
-	rapidjson::Document body;
+	RequestArena arena;
+	RequestArena::Document body(&arena.allocator());
 	try{
-		body.Parse(req.body);
+		body.ParseInsitu(arena.copyString(req.body));
 	}catch(std::runtime_error& err){
 		return crow::response(400,generateError("Invalid JSON in request body"));
 	}
@@ -174,9 +187,9 @@ crow::response createCluster(PersistentStore& store, const crow::request& req){
 	
 	auto configPath=store.configPathForCluster(cluster.id);
 	log_info("Attempting to access " << cluster);
-	auto clusterInfo=kubernetes::kubectl(*configPath,{"get","serviceaccounts","-o=jsonpath={.items[*].metadata.name}"});
-	if(clusterInfo.status || 
-	   clusterInfo.output.find("default")==std::string::npos){
+	auto clusterInfo=kubernetes::kubectl(*configPath,{"get","serviceaccounts","-o=json"});
+	const auto serviceAccounts=listedNames(clusterInfo);
+	if(!contains(serviceAccounts,"default")){
 		log_info("Failure contacting " << cluster << "; deleting its record");
 		log_error("Error was: " << clusterInfo.error);
 		//things aren't working, delete our apparently non-functional record
@@ -188,15 +201,7 @@ crow::response createCluster(PersistentStore& store, const crow::request& req){
 		log_info("Success contacting " << cluster);
 	{
 		//check that there is a service account matching our namespace
-		auto serviceAccounts=string_split_columns(clusterInfo.output,' ',false);
-		if(serviceAccounts.empty()){
-			log_error("Found no ServiceAccounts: " << clusterInfo.error);
-			//things aren't working, delete our apparently non-functional record
-			store.removeCluster(cluster.id);
-			return crow::response(500,generateError("Cluster registration failed: "
-			                                        "Found no SeviceAccounts in the default namespace"));
-		}
-		if(std::find(serviceAccounts.begin(),serviceAccounts.end(),systemNamespace)==serviceAccounts.end())
+		if(!contains(serviceAccounts,systemNamespace))
 			return crow::response(500,generateError("Cluster registration failed: "
 			  "Unable to find matching service account in default namespace"));
 		//now double-check that the namespace name really does match the serviceaccount name
@@ -253,14 +258,8 @@ crow::response createCluster(PersistentStore& store, const crow::request& req){
 	if(commandResult.output.find("Warning: Tiller is already installed in the cluster")!=std::string::npos){
 		bool okay=false;
 		//check whether tiller is already in this namespace, or in some other and helm is just screwing things up.
-		auto commandResult = kubernetes::kubectl(*configPath,{"get","deployments","--namespace",cluster.systemNamespace,"-o=jsonpath={.items[*].metadata.name}"});
-		
-		if(commandResult.status==0){
-			for(const auto& deployment : string_split_columns(commandResult.output, ' ', false)){
-				if(deployment=="tiller-deploy")
-					okay=true;
-			}
-		}
+		auto commandResult = kubernetes::kubectl(*configPath,{"get","deployments","--namespace",cluster.systemNamespace,"-o=json"});
+		okay=contains(listedNames(commandResult),"tiller-deploy");
 		
 		if(!okay){
 			log_info("Cannot install tiller correctly because it is already installed (probably in the kube-system namespace)");
@@ -320,12 +319,12 @@ crow::response createCluster(PersistentStore& store, const crow::request& req){
 	log_info("Created " << cluster << " owned by " << cluster.owningGroup 
 	         << " on behalf of " << user);
 	
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha3", alloc);
 	result.AddMember("kind", "Cluster", alloc);
-	rapidjson::Value metadata(rapidjson::kObjectType);
+	RequestArena::Value metadata(rapidjson::kObjectType);
 	metadata.AddMember("id", rapidjson::StringRef(cluster.id.c_str()), alloc);
 	metadata.AddMember("name", rapidjson::StringRef(cluster.name.c_str()), alloc);
 	result.AddMember("metadata", metadata, alloc); 
@@ -344,23 +343,25 @@ crow::response getClusterInfo(PersistentStore& store, const crow::request& req,
 	const Cluster cluster=store.getCluster(clusterID);
 	if(!cluster)
 		return crow::response(404,generateError("Cluster not found"));
+	const std::string owningGroupName=store.findGroupByID(cluster.owningGroup).name;
+	std::vector<GeoLocation> locations=store.getLocationsForCluster(cluster.id);
 	
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena arena;
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
-	rapidjson::Value clusterResult(rapidjson::kObjectType);
+	RequestArena::Value clusterResult(rapidjson::kObjectType);
 	clusterResult.AddMember("apiVersion", "v1alpha3", alloc);
 	clusterResult.AddMember("kind", "Cluster", alloc);
-	rapidjson::Value clusterData(rapidjson::kObjectType);
+	RequestArena::Value clusterData(rapidjson::kObjectType);
 	clusterData.AddMember("id", cluster.id, alloc);
 	clusterData.AddMember("name", cluster.name, alloc);
-	clusterData.AddMember("owningGroup", store.findGroupByID(cluster.owningGroup).name, alloc);
+	clusterData.AddMember("owningGroup", owningGroupName, alloc);
 	clusterData.AddMember("owningOrganization", cluster.owningOrganization, alloc);
-	std::vector<GeoLocation> locations=store.getLocationsForCluster(cluster.id);
-	rapidjson::Value clusterLocation(rapidjson::kArrayType);
+	RequestArena::Value clusterLocation(rapidjson::kArrayType);
 	clusterLocation.Reserve(locations.size(), alloc);
 	for(const auto& location : locations){
-		rapidjson::Value entry(rapidjson::kObjectType);
+		RequestArena::Value entry(rapidjson::kObjectType);
 		entry.AddMember("lat",location.lat, alloc);
 		entry.AddMember("lon",location.lon, alloc);
 		clusterLocation.PushBack(entry, alloc);
@@ -368,7 +369,7 @@ crow::response getClusterInfo(PersistentStore& store, const crow::request& req,
 	clusterData.AddMember("location", clusterLocation, alloc);
 	clusterResult.AddMember("metadata", clusterData, alloc);
 
-	return crow::response(to_string(clusterResult));
+	return conditionalResponse(req,crow::response(to_string(clusterResult)));
 }
 
 crow::response deleteCluster(PersistentStore& store, const crow::request& req, 
@@ -469,9 +470,10 @@ crow::response updateCluster(PersistentStore& store, const crow::request& req,
 	 //TODO: other restrictions on cluster alterations?
 	
 	//unpack the new cluster info
-	rapidjson::Document body;
+	RequestArena arena;
+	RequestArena::Document body(&arena.allocator());
 	try{
-		body.Parse(req.body.c_str());
+		body.ParseInsitu(arena.copyString(req.body));
 	}catch(std::runtime_error& err){
 		return crow::response(400,generateError("Invalid JSON in request body"));
 	}
@@ -534,9 +536,8 @@ crow::response updateCluster(PersistentStore& store, const crow::request& req,
 	if(updateConfig){
 		auto configPath=store.configPathForCluster(cluster.id);
 		log_info("Attempting to access " << cluster);
-		auto clusterInfo=kubernetes::kubectl(*configPath,{"get","serviceaccounts","-o=jsonpath={.items[*].metadata.name}"});
-		if(clusterInfo.status || 
-		   clusterInfo.output.find("default")==std::string::npos){
+		auto clusterInfo=kubernetes::kubectl(*configPath,{"get","serviceaccounts","-o=json"});
+		if(!contains(listedNames(clusterInfo),"default")){
 			log_info("Failure contacting " << cluster << " with updated info");
 			log_error("Error was: " << clusterInfo.error);
 			return crow::response(400,generateError("Unable to contact cluster with kubectl after configuration update"));
@@ -560,19 +561,20 @@ crow::response listClusterAllowedgroups(PersistentStore& store, const crow::requ
 	if(!cluster)
 		return crow::response(404,generateError("Cluster not found"));
 	
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena arena;
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	result.AddMember("apiVersion", "v1alpha3", alloc);
-	rapidjson::Value resultItems(rapidjson::kArrayType);
+	RequestArena::Value resultItems(rapidjson::kArrayType);
 	
 	std::vector<std::string> groupIDs=store.listgroupsAllowedOnCluster(cluster.id);
 	//if result is a wildcard skip the usual steps
 	if(groupIDs.size()==1 && groupIDs.front()==PersistentStore::wildcard){
-		rapidjson::Value metadata(rapidjson::kObjectType);
+		RequestArena::Value metadata(rapidjson::kObjectType);
 		metadata.AddMember("id", PersistentStore::wildcard, alloc);
 		metadata.AddMember("name", PersistentStore::wildcardName, alloc);
 		
-		rapidjson::Value groupResult(rapidjson::kObjectType);
+		RequestArena::Value groupResult(rapidjson::kObjectType);
 		groupResult.AddMember("apiVersion", "v1alpha3", alloc);
 		groupResult.AddMember("kind", "Group", alloc);
 		groupResult.AddMember("metadata", metadata, alloc);
@@ -591,11 +593,11 @@ crow::response listClusterAllowedgroups(PersistentStore& store, const crow::requ
 				continue;
 			}
 			
-			rapidjson::Value metadata(rapidjson::kObjectType);
+			RequestArena::Value metadata(rapidjson::kObjectType);
 			metadata.AddMember("id", groupID, alloc);
 			metadata.AddMember("name", group.name, alloc);
 			
-			rapidjson::Value groupResult(rapidjson::kObjectType);
+			RequestArena::Value groupResult(rapidjson::kObjectType);
 			groupResult.AddMember("apiVersion", "v1alpha3", alloc);
 			groupResult.AddMember("kind", "Group", alloc);
 			groupResult.AddMember("metadata", metadata, alloc);
@@ -714,12 +716,13 @@ crow::response listClusterGroupAllowedApplications(PersistentStore& store,
 	
 	std::set<std::string> allowed=store.listApplicationsGroupMayUseOnCluster(group.id, cluster.id);
 	
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena arena;
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	result.AddMember("apiVersion", "v1alpha3", alloc);
-	rapidjson::Value resultItems(rapidjson::kArrayType);
+	RequestArena::Value resultItems(rapidjson::kArrayType);
 	for(const auto& application : allowed)
-		resultItems.PushBack(rapidjson::Value(application,alloc), alloc);
+		resultItems.PushBack(RequestArena::Value(application,alloc), alloc);
 	result.AddMember("items", resultItems, alloc);
 	
 	return crow::response(to_string(result));
@@ -812,7 +815,7 @@ struct ClusterConsistencyResult{
 	
 	ClusterConsistencyResult(PersistentStore& store, const Cluster& cluster);
 	
-	rapidjson::Document toJSON() const;
+	RequestArena::Document toJSON() const;
 };
 
 namespace internal{
@@ -822,9 +825,8 @@ bool pingCluster(PersistentStore& store, const Cluster& cluster){
 
 	bool contactable=false;
 	//check that the cluster can be reached
-	auto clusterInfo=kubernetes::kubectl(*configPath,{"get","serviceaccounts","-o=jsonpath={.items[*].metadata.name}"});
-	if(clusterInfo.status || 
-	   clusterInfo.output.find("default")==std::string::npos){
+	auto clusterInfo=kubernetes::kubectl(*configPath,{"get","serviceaccounts","-o=json"});
+	if(!contains(listedNames(clusterInfo),"default")){
 		log_info("Unable to contact " << cluster);
 		return false;
 	}
@@ -848,25 +850,32 @@ ClusterConsistencyResult::ClusterConsistencyResult(PersistentStore& store, const
 	}
 	
 	//figure out what instances helm thinks exist
-	auto instanceInfo=kubernetes::helm(*configPath,cluster.systemNamespace,{"list"});
-	if(instanceInfo.status){
-		log_info("Unable to list helm releases on " << cluster);
-		status=ClusterConsistencyState::HelmFailure;
-		return;
-	}
-	{
-		bool first=true;
-		for(const auto& line : string_split_lines(instanceInfo.output)){
-			if(first){ //skip helm's header line
-				first=false;
-				continue;
-			}
-			auto items=string_split_columns(line,'\t',false);
-			if(items.empty())
-				continue;
-			existingInstanceNames.insert(items.front());
+	//helm lists a limited number of releases at a time, so fetch each page
+	std::string offset;
+	do{
+		std::vector<std::string> arguments={"list","--output","json"};
+		if(!offset.empty()){
+			arguments.push_back("--offset");
+			arguments.push_back(offset);
 		}
-	}
+		auto instanceInfo=kubernetes::helm(*configPath,cluster.systemNamespace,arguments);
+		if(instanceInfo.status){
+			log_info("Unable to list helm releases on " << cluster);
+			status=ClusterConsistencyState::HelmFailure;
+			return;
+		}
+		kubernetes::ReleaseList releases;
+		try{
+			releases=kubernetes::parseHelmList(instanceInfo.output);
+		}catch(std::runtime_error& err){
+			log_error("Unable to parse helm releases on " << cluster << ": " << err.what());
+			status=ClusterConsistencyState::HelmFailure;
+			return;
+		}
+		for(const auto& release : releases.releases)
+			existingInstanceNames.insert(release.name);
+		offset=std::move(releases.next);
+	}while(!offset.empty());
 	
 	//figure out what instances are supposed to exist
 	expectedInstances=store.listApplicationInstancesByClusterOrGroup("", cluster.id);
@@ -894,8 +903,8 @@ ClusterConsistencyResult::ClusterConsistencyResult(PersistentStore& store, const
 	
 	//figure out what secrets currently exist
 	//start by learning which namespaces we can see, in which we should search for secrets
-	auto namespaceInfo=kubernetes::kubectl(*configPath,{"get","clusternamespaces","-o=jsonpath={.items[*].metadata.name}"});
-	std::vector<std::string> namespaceNames=string_split_columns(namespaceInfo.output,' ',false);
+	auto namespaceInfo=kubernetes::kubectl(*configPath,{"get","clusternamespaces","-o=json"});
+	std::vector<std::string> namespaceNames=listedNames(namespaceInfo);
 	//iterate over namespaces, listing secrets
 	for(const auto& namespaceName : namespaceNames){
 		if(namespaceName.find(Group::namespacePrefix())!=0){
@@ -903,8 +912,10 @@ ClusterConsistencyResult::ClusterConsistencyResult(PersistentStore& store, const
 			continue;
 		}
 		std::string groupName=namespaceName.substr(Group::namespacePrefix().size());
-		auto secretsInfo=kubernetes::kubectl(*configPath,{"get","secrets","-n",namespaceName,"-o=jsonpath={.items[*].metadata.name}"});
-		for(const auto& secretName : string_split_columns(secretsInfo.output,' ',false)){
+		//only the names are needed, so avoid fetching the secrets' contents
+		auto secretsInfo=kubernetes::kubectl(*configPath,{"get","secrets","-n",namespaceName,
+		                                     "-o=custom-columns=NAME:.metadata.name","--no-headers"});
+		for(const auto& secretName : listedNameColumn(secretsInfo)){
 			if(secretName.find("default-token-")==0)
 				continue; //ignore kubernetes infrastructure
 			existingSecretNames.insert(groupName+":"+secretName);
@@ -939,9 +950,9 @@ ClusterConsistencyResult::ClusterConsistencyResult(PersistentStore& store, const
 	
 }
 
-rapidjson::Document ClusterConsistencyResult::toJSON() const{
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+RequestArena::Document ClusterConsistencyResult::toJSON() const{
+	RequestArena::Document result(rapidjson::kObjectType);
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha3", alloc);
 	
@@ -956,14 +967,14 @@ rapidjson::Document ClusterConsistencyResult::toJSON() const{
 			result.AddMember("status", "Consistent", alloc); break;
 	}
 	
-	rapidjson::Value missingResults(rapidjson::kArrayType);
+	RequestArena::Value missingResults(rapidjson::kArrayType);
 	missingResults.Reserve(missingInstances.size(), alloc);
 	for(const auto& missing : missingInstances){
 		const ApplicationInstance& instance=expectedInstancesByName.find(missing)->second;
-		rapidjson::Value missingResult(rapidjson::kObjectType);
+		RequestArena::Value missingResult(rapidjson::kObjectType);
 		missingResult.AddMember("apiVersion", "v1alpha3", alloc);
 		missingResult.AddMember("kind", "ApplicationInstance", alloc);
-		rapidjson::Value instanceData(rapidjson::kObjectType);
+		RequestArena::Value instanceData(rapidjson::kObjectType);
 		instanceData.AddMember("id", instance.id, alloc);
 		instanceData.AddMember("name", instance.name, alloc);
 		instanceData.AddMember("application", instance.application, alloc);
@@ -975,17 +986,17 @@ rapidjson::Document ClusterConsistencyResult::toJSON() const{
 	}
 	result.AddMember("missingInstances", missingResults, alloc);
 	
-	rapidjson::Value unexpectedResults(rapidjson::kArrayType);
+	RequestArena::Value unexpectedResults(rapidjson::kArrayType);
 	unexpectedResults.Reserve(unexpectedInstances.size(), alloc);
 	for(const auto& extra : unexpectedInstances){
-		rapidjson::Value unexpectedResult(rapidjson::kStringType);
+		RequestArena::Value unexpectedResult(rapidjson::kStringType);
 		unexpectedResult.SetString(extra,alloc);
 		unexpectedResults.PushBack(unexpectedResult,alloc);
 	}
 	result.AddMember("unexpectedInstances", unexpectedResults, alloc);
 	
-	result.AddMember("missingSecrets", rapidjson::Value((uint64_t)missingSecrets.size()), alloc);
-	result.AddMember("unexpectedSecrets", rapidjson::Value((uint64_t)unexpectedSecrets.size()), alloc);
+	result.AddMember("missingSecrets", RequestArena::Value((uint64_t)missingSecrets.size()), alloc);
+	result.AddMember("unexpectedSecrets", RequestArena::Value((uint64_t)unexpectedSecrets.size()), alloc);
 	
 	return result;
 }
@@ -1017,8 +1028,9 @@ crow::response pingCluster(PersistentStore& store, const crow::request& req,
 		store.cacheClusterReachability(cluster.id, reachable);
 	}
 	
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena arena;
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha3", alloc);
 	result.AddMember("reachable", reachable, alloc);
@@ -1,10 +1,15 @@
 #include "Entities.h"
 
-#include <boost/lexical_cast.hpp>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
 
-#include <boost/archive/iterators/base64_from_binary.hpp>
-#include <boost/archive/iterators/transform_width.hpp>
-#include <boost/archive/iterators/ostream_iterator.hpp>
+#include <boost/lexical_cast.hpp>
 
 bool operator==(const User& u1, const User& u2){
 	return(u1.valid==u2.valid && u1.id==u2.id);
@@ -105,21 +110,180 @@ const std::string IDGenerator::groupIDPrefix="group_";
 const std::string IDGenerator::instanceIDPrefix="instance_";
 const std::string IDGenerator::secretIDPrefix="secret_";
 
-std::string IDGenerator::generateRawID(){
-	uint64_t value;
-	{
-		std::lock_guard<std::mutex> lock(mut);
-		value=std::uniform_int_distribution<uint64_t>()(idSource);
+namespace{
+
+///Fill a buffer with random data from the operating system
+void systemRandomBytes(unsigned char* dest, std::size_t length){
+#ifdef SYS_getrandom
+	while(length){
+		long result=syscall(SYS_getrandom,dest,length,0);
+		if(result<0){
+			if(errno==EINTR)
+				continue;
+			break; //fall back to the standard library
+		}
+		dest+=result;
+		length-=result;
+	}
+#endif
+	if(!length)
+		return;
+	std::random_device source;
+	while(length){
+		auto value=source();
+		std::size_t count=std::min(length,sizeof(value));
+		std::memcpy(dest,&value,count);
+		dest+=count;
+		length-=count;
+	}
+}
+
+///Incremented in each child process created by fork, so that threads can tell
+///that their random state was copied from the parent and must be replaced
+std::atomic<unsigned int> forkGeneration(0);
+const int forkHandlerInstalled=pthread_atfork(nullptr,nullptr,[](){ forkGeneration++; });
+
+inline uint32_t rotateLeft(uint32_t value, unsigned int count){
+	return (value<<count)|(value>>(32-count));
+}
+
+inline void quarterRound(uint32_t* x, unsigned int a, unsigned int b, unsigned int c, unsigned int d){
+	x[a]+=x[b]; x[d]=rotateLeft(x[d]^x[a],16);
+	x[c]+=x[d]; x[b]=rotateLeft(x[b]^x[c],12);
+	x[a]+=x[b]; x[d]=rotateLeft(x[d]^x[a],8);
+	x[c]+=x[d]; x[b]=rotateLeft(x[b]^x[c],7);
+}
+
+///Each key is used for only one refill, so the nonce need not vary
+const uint32_t zeroNonce[3]={0,0,0};
+
+///A cryptographically secure generator used by a single thread. Each refill 
+///of the buffer replaces the key with part of the keystream it produced and 
+///output is erased as it is used, so earlier output cannot be recovered from 
+///the generator's state. The key is replaced from the operating system's 
+///random source periodically, and after fork. 
+class ThreadRandomSource{
+public:
+	void fill(unsigned char* dest, std::size_t length){
+		if(!seeded || generation!=forkGeneration.load(std::memory_order_relaxed))
+			seed();
+		while(length){
+			if(!available)
+				refill();
+			std::size_t count=std::min(length,available);
+			unsigned char* source=buffer+sizeof(buffer)-available;
+			std::memcpy(dest,source,count);
+			insecure_memzero(source,count);
+			dest+=count;
+			length-=count;
+			available-=count;
+		}
+	}
+	
+private:
+	constexpr static std::size_t blocksPerRefill=16;
+	///The number of refills after which the key is replaced from the 
+	///operating system, about 64 MB of output
+	constexpr static unsigned int refillsPerSeed=1u<<16;
+	
+	uint32_t key[8];
+	unsigned char buffer[64*blocksPerRefill];
+	///The number of unused bytes at the end of the buffer
+	std::size_t available=0;
+	unsigned int refills=0;
+	unsigned int generation=0;
+	bool seeded=false;
+	
+	void seed(){
+		unsigned char keyBytes[sizeof(key)];
+		systemRandomBytes(keyBytes,sizeof(keyBytes));
+		setKey(keyBytes);
+		insecure_memzero(keyBytes,sizeof(keyBytes));
+		insecure_memzero(buffer,sizeof(buffer));
+		available=0;
+		refills=0;
+		generation=forkGeneration.load();
+		seeded=true;
 	}
-	std::ostringstream os;
-	using namespace boost::archive::iterators;
-	using base64_text=base64_from_binary<transform_width<const unsigned char*,6,8>>;
-	std::copy(base64_text((char*)&value),base64_text((char*)&value+sizeof(value)),ostream_iterator<char>(os));
-	std::string result=os.str();
-	//convert to RFC 4648 URL- and filename-safe base64
-	for(char& c : result){
-		if(c=='+') c='-';
-		if(c=='/') c='_';
+	
+	void setKey(const unsigned char* bytes){
+		for(unsigned int i=0; i<8; i++)
+			key[i]=uint32_t(bytes[4*i]) | uint32_t(bytes[4*i+1])<<8 
+			       | uint32_t(bytes[4*i+2])<<16 | uint32_t(bytes[4*i+3])<<24;
 	}
-	return result;
+	
+	void refill(){
+		if(++refills==refillsPerSeed)
+			seed();
+		for(unsigned int i=0; i<blocksPerRefill; i++)
+			detail::chacha20Block(key,zeroNonce,i,buffer+64*i);
+		setKey(buffer);
+		insecure_memzero(buffer,sizeof(key));
+		available=sizeof(buffer)-sizeof(key);
+	}
+};
+
+thread_local ThreadRandomSource randomSource;
+
+const char urlSafeBase64[]="ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+///Encode 64 bits as 11 characters of unpadded, URL- and filename-safe base64 
+///(RFC 4648 section 5)
+void encodeRawID(const unsigned char* data, char* output){
+	uint64_t bits=0;
+	for(unsigned int i=0; i<8; i++)
+		bits=(bits<<8)|data[i];
+	for(unsigned int i=0; i<10; i++)
+		output[i]=urlSafeBase64[(bits>>(58-6*i))&63];
+	//the final character holds the last four bits, padded with zeros
+	output[10]=urlSafeBase64[(bits<<2)&63];
+}
+
+}
+
+void detail::chacha20Block(const uint32_t key[8], const uint32_t nonce[3], uint32_t counter, unsigned char* output){
+	uint32_t state[16]={0x61707865,0x3320646e,0x79622d32,0x6b206574,
+	                    key[0],key[1],key[2],key[3],key[4],key[5],key[6],key[7],
+	                    counter,nonce[0],nonce[1],nonce[2]};
+	uint32_t x[16];
+	std::memcpy(x,state,sizeof(x));
+	for(unsigned int i=0; i<10; i++){
+		quarterRound(x,0,4,8,12);
+		quarterRound(x,1,5,9,13);
+		quarterRound(x,2,6,10,14);
+		quarterRound(x,3,7,11,15);
+		quarterRound(x,0,5,10,15);
+		quarterRound(x,1,6,11,12);
+		quarterRound(x,2,7,8,13);
+		quarterRound(x,3,4,9,14);
+	}
+	for(unsigned int i=0; i<16; i++){
+		uint32_t word=x[i]+state[i];
+		output[4*i]=word;
+		output[4*i+1]=word>>8;
+		output[4*i+2]=word>>16;
+		output[4*i+3]=word>>24;
+	}
+	insecure_memzero(x,sizeof(x));
+	insecure_memzero(state,sizeof(state));
+}
+
+std::string IDGenerator::generateRawID(){
+	unsigned char value[8];
+	randomSource.fill(value,sizeof(value));
+	char text[11];
+	encodeRawID(value,text);
+	insecure_memzero(value,sizeof(value));
+	return std::string(text,sizeof(text));
+}
+
+std::string IDGenerator::generateUserToken(){
+	//the concatenation of two raw IDs, as tokens have always been formed
+	unsigned char value[16];
+	randomSource.fill(value,sizeof(value));
+	char text[22];
+	encodeRawID(value,text);
+	encodeRawID(value+8,text+11);
+	insecure_memzero(value,sizeof(value));
+	return std::string(text,sizeof(text));
 }
@@ -0,0 +1,116 @@
+#include "EntitySerialization.h"
+
+namespace{
+	///Write the common leading portion of a list entry, leaving the metadata
+	///object open
+	void beginListEntry(JSONWriter& writer, const char* kind){
+		writer.StartObject();
+		writer.Key("apiVersion");
+		writer.String("v1alpha3");
+		writer.Key("kind");
+		writer.String(kind);
+		writer.Key("metadata");
+		writer.StartObject();
+	}
+
+	///Close the metadata and entry objects opened by beginListEntry
+	void endListEntry(JSONWriter& writer){
+		writer.EndObject();
+		writer.EndObject();
+	}
+
+	void writeMember(JSONWriter& writer, const char* key, const std::string& value){
+		writer.Key(key);
+		writer.String(value);
+	}
+}
+
+void writeUserListEntry(JSONWriter& writer, const User& user){
+	beginListEntry(writer, "User");
+	writeMember(writer, "id", user.id);
+	writeMember(writer, "name", user.name);
+	writeMember(writer, "email", user.email);
+	writeMember(writer, "phone", user.phone);
+	writeMember(writer, "institution", user.institution);
+	endListEntry(writer);
+}
+
+void writeGroupListEntry(JSONWriter& writer, const Group& group){
+	beginListEntry(writer, "Group");
+	writeMember(writer, "id", group.id);
+	writeMember(writer, "name", group.name);
+	writeMember(writer, "email", group.email);
+	writeMember(writer, "phone", group.phone);
+	writeMember(writer, "scienceField", group.scienceField);
+	writeMember(writer, "description", group.description);
+	endListEntry(writer);
+}
+
+void writeClusterListEntry(JSONWriter& writer, const Cluster& cluster,
+                           const std::string& owningGroupName,
+                           const std::vector<GeoLocation>& locations){
+	beginListEntry(writer, "Cluster");
+	writeMember(writer, "id", cluster.id);
+	writeMember(writer, "name", cluster.name);
+	writeMember(writer, "owningGroup", owningGroupName);
+	writeMember(writer, "owningOrganization", cluster.owningOrganization);
+	writer.Key("location");
+	writer.StartArray();
+	for(const auto& location : locations){
+		writer.StartObject();
+		writer.Key("lat");
+		writer.Double(location.lat);
+		writer.Key("lon");
+		writer.Double(location.lon);
+		writer.EndObject();
+	}
+	writer.EndArray();
+	endListEntry(writer);
+}
+
+void writeInstanceListEntry(JSONWriter& writer, const ApplicationInstance& instance,
+                            const std::string& groupName, const std::string& clusterName){
+	beginListEntry(writer, "ApplicationInstance");
+	writeMember(writer, "id", instance.id);
+	writeMember(writer, "name", instance.name);
+	writeMember(writer, "application", unqualifiedApplicationName(instance.application));
+	writeMember(writer, "group", groupName);
+	writeMember(writer, "cluster", clusterName);
+	writeMember(writer, "created", instance.ctime);
+	endListEntry(writer);
+}
+
+void writeSecretListEntry(JSONWriter& writer, const Secret& secret,
+                          const std::string& groupName, const std::string& clusterName){
+	beginListEntry(writer, "Secret");
+	writeMember(writer, "id", secret.id);
+	writeMember(writer, "name", secret.name);
+	writeMember(writer, "group", groupName);
+	writeMember(writer, "cluster", clusterName);
+	writeMember(writer, "created", secret.ctime);
+	endListEntry(writer);
+}
+
+void writeListFragment(JSONWriter& writer, const std::string& fragment){
+	writer.RawValue(fragment.data(), fragment.size(), rapidjson::kObjectType);
+}
+
+void beginListResult(JSONWriter& writer){
+	writer.StartObject();
+	writer.Key("apiVersion");
+	writer.String("v1alpha3");
+	writer.Key("items");
+	writer.StartArray();
+}
+
+void endListResult(JSONWriter& writer){
+	writer.EndArray();
+	writer.EndObject();
+}
+
+std::string unqualifiedApplicationName(const std::string& application){
+	std::size_t slashPos=application.find('/');
+	if(slashPos!=std::string::npos && slashPos<application.size()-1)
+		return application.substr(slashPos+1);
+	return application;
+}
@@ -0,0 +1,180 @@
+#include "Expiration.h"
+
+#include <algorithm>
+#include <thread>
+
+#include <pthread.h>
+
+#include "Logging.h"
+
+const std::chrono::milliseconds coarse_clock::resolution(10);
+std::atomic<coarse_clock::rep> coarse_clock::currentTime(0);
+std::atomic<bool> coarse_clock::threadFailed(false);
+
+namespace{
+
+///Serializes starting the background thread
+std::mutex clockStartMutex;
+
+///Threads do not survive fork, so a child process must start its own
+///background thread. The start lock is held across the fork so that the child
+///does not inherit it in a locked state.
+void prepareFork(){
+	clockStartMutex.lock();
+}
+void resumeParent(){
+	clockStartMutex.unlock();
+}
+void resumeChild(){
+	clockStartMutex.unlock();
+	coarse_clock::restartAfterFork();
+}
+
+}
+
+coarse_clock::time_point coarse_clock::start() noexcept{
+	if(threadFailed.load(std::memory_order_relaxed))
+		return std::chrono::steady_clock::now();
+	std::lock_guard<std::mutex> lock(clockStartMutex);
+	if(currentTime.load()!=0)
+		return time_point(duration(currentTime.load()));
+	if(threadFailed.load())
+		return std::chrono::steady_clock::now();
+	static bool forkHandlersInstalled=false;
+	if(!forkHandlersInstalled){
+		pthread_atfork(&prepareFork,&resumeParent,&resumeChild);
+		forkHandlersInstalled=true;
+	}
+	//creating the wheel first ensures that it exists before the thread uses it
+	TimingWheel& wheel=expirationWheel();
+	time_point now=std::chrono::steady_clock::now();
+	currentTime.store(now.time_since_epoch().count());
+	try{
+		std::thread ticker([&wheel](){
+			while(true){
+				std::this_thread::sleep_for(resolution);
+				time_point now=std::chrono::steady_clock::now();
+				currentTime.store(now.time_since_epoch().count(),std::memory_order_relaxed);
+				wheel.advance(now);
+			}
+		});
+		ticker.detach();
+	}catch(std::exception& ex){
+		//without the thread the clock would never advance, so fall back to
+		//reading the system clock each time from now on
+		currentTime.store(0);
+		threadFailed.store(true);
+		log_error("Unable to start coarse clock thread: " << ex.what());
+	}
+	return now;
+}
+
+void coarse_clock::restartAfterFork() noexcept{
+	currentTime.store(0);
+	threadFailed.store(false);
+}
+
+TimingWheel::TimingWheel(std::chrono::steady_clock::duration resolution, time_point start):
+resolution(resolution),start(start),currentTick(0),count(0){}
+
+void TimingWheel::schedule(time_point deadline, const std::shared_ptr<ExpiryTarget>& target, std::string key){
+	std::uint64_t tick=0;
+	if(deadline>start){
+		//round up, so that the entry is never reclaimed early
+		auto offset=deadline-start;
+		tick=offset/resolution;
+		if(offset%resolution!=decltype(offset)::zero())
+			tick++;
+	}
+	std::lock_guard<std::mutex> lock(mut);
+	//entries whose times have already passed are handled by the next advance,
+	//rather than calling the target while the caller may hold its locks
+	tick=std::max(tick,currentTick+1);
+	std::vector<Entry> due;
+	place(Entry{tick,target,std::move(key)},due);
+	count++;
+}
+
+void TimingWheel::place(Entry&& entry, std::vector<Entry>& due){
+	if(entry.tick<=currentTick){
+		due.push_back(std::move(entry));
+		return;
+	}
+	std::uint64_t delta=entry.tick-currentTick;
+	for(unsigned int level=0; level<levels; level++){
+		if(delta < (std::uint64_t(1)<<(slotBits*(level+1)))){
+			slots[level][(entry.tick>>(slotBits*level))%slotsPerLevel].push_back(std::move(entry));
+			return;
+		}
+	}
+	//Beyond the span of the top level: park the entry in the furthest slot
+	//which can be reached, from which it will be placed again when that slot
+	//is reached.
+	std::uint64_t furthest=currentTick+(std::uint64_t(1)<<(slotBits*levels))-1;
+	slots[levels-1][(furthest>>(slotBits*(levels-1)))%slotsPerLevel].push_back(std::move(entry));
+}
+
+void TimingWheel::advance(time_point now){
+	if(now<=start)
+		return;
+	const std::uint64_t target=(now-start)/resolution;
+	std::vector<Entry> due;
+	{
+		std::lock_guard<std::mutex> lock(mut);
+		if(count==0 && target>currentTick)
+			currentTick=target; //nothing to do for the intervening ticks
+		while(currentTick<target){
+			currentTick++;
+			//when a level's slot is reached, its entries move to lower levels,
+			//starting from the top so that they cascade as far as necessary
+			for(unsigned int level=levels-1; level>0; level--){
+				if(currentTick % (std::uint64_t(1)<<(slotBits*level)))
+					continue;
+				std::vector<Entry> cascading;
+				std::swap(cascading,slots[level][(currentTick>>(slotBits*level))%slotsPerLevel]);
+				for(auto& entry : cascading)
+					place(std::move(entry),due);
+			}
+			auto& slot=slots[0][currentTick%slotsPerLevel];
+			std::move(slot.begin(),slot.end(),std::back_inserter(due));
+			slot.clear();
+		}
+		count-=due.size();
+	}
+	if(due.empty())
+		return;
+
+	//group the entries by target, so that each is called only once
+	std::sort(due.begin(),due.end(),[](const Entry& e1, const Entry& e2){
+		return e1.target.owner_before(e2.target);
+	});
+	std::vector<std::string> keys;
+	for(auto group=due.begin(); group!=due.end(); ){
+		auto end=std::find_if(group,due.end(),[&group](const Entry& e){
+			return group->target.owner_before(e.target) || e.target.owner_before(group->target);
+		});
+		std::shared_ptr<ExpiryTarget> target=group->target.lock();
+		if(target){
+			keys.clear();
+			for(auto it=group; it!=end; it++)
+				keys.push_back(std::move(it->key));
+			try{
+				target->reclaim(keys);
+			}catch(std::exception& ex){
+				log_error("Failed to reclaim expired entries: " << ex.what());
+			}
+		}
+		group=end;
+	}
+}
+
+std::size_t TimingWheel::size() const{
+	std::lock_guard<std::mutex> lock(mut);
+	return count;
+}
+
+TimingWheel& expirationWheel(){
+	//never destroyed, since the background thread may use it during exit
+	static TimingWheel* wheel=new TimingWheel(coarse_clock::resolution,std::chrono::steady_clock::now());
+	return *wheel;
+}
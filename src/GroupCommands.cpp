@@ -6,6 +6,7 @@
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
 
+#include "EntitySerialization.h"
 #include "Logging.h"
 #include "ServerUtilities.h"
 #include "KubeInterface.h"
@@ -106,7 +107,7 @@ crow::response listGroups(PersistentStore& store, const crow::request& req){
 	if(!user)
 		return crow::response(403,generateError("Not authorized"));
 	//All users are allowed to list groups
-
+	
 	std::vector<Group> vos;
 
 	if (req.url_params.get("user"))
@@ -114,30 +115,15 @@ crow::response listGroups(PersistentStore& store, const crow::request& req){
 	else
 		vos=store.listgroups();
 
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
-	
-	result.AddMember("apiVersion", "v1alpha3", alloc);
-	rapidjson::Value resultItems(rapidjson::kArrayType);
-	resultItems.Reserve(vos.size(), alloc);
-	for (const Group& group : vos){
-		rapidjson::Value metadata(rapidjson::kObjectType);
-		metadata.AddMember("id", rapidjson::StringRef(group.id.c_str()), alloc);
-		metadata.AddMember("name", rapidjson::StringRef(group.name.c_str()), alloc);
-		metadata.AddMember("email", rapidjson::StringRef(group.email.c_str()), alloc);
-		metadata.AddMember("phone", rapidjson::StringRef(group.phone.c_str()), alloc);
-		metadata.AddMember("scienceField", rapidjson::StringRef(group.scienceField.c_str()), alloc);
-		metadata.AddMember("description", rapidjson::StringRef(group.description.c_str()), alloc);
-
-		rapidjson::Value groupResult(rapidjson::kObjectType);
-		groupResult.AddMember("apiVersion", "v1alpha3", alloc);
-		groupResult.AddMember("kind", "Group", alloc);
-		groupResult.AddMember("metadata", metadata, alloc);
-		resultItems.PushBack(groupResult, alloc);
-	}
-	result.AddMember("items", resultItems, alloc);
-	
-	return crow::response(to_string(result));
+	crow::response response;
+	StringOutputStream stream(response.body);
+	JSONWriter writer(stream);
+	beginListResult(writer);
+	for (const Group& group : vos)
+		writeListFragment(writer, store.getGroupListFragment(group));
+	endListResult(writer);
+	
+	return conditionalResponse(req,std::move(response));
 }
 
 crow::response createGroup(PersistentStore& store, const crow::request& req){
@@ -149,7 +135,8 @@ crow::response createGroup(PersistentStore& store, const crow::request& req){
 	//TODO: What other information is required to register a Group?
 	
 	//unpack the target user info
-	rapidjson::Document body;
+	RequestArena arena;
+	RequestArena::Document body(&arena.allocator());
 	try{
 		body.Parse(req.body.c_str());
 	}catch(std::runtime_error& err){
@@ -244,12 +231,12 @@ crow::response createGroup(PersistentStore& store, const crow::request& req){
 	
 	log_info("Created " << group << " on behalf of " << user);
 
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha3", alloc);
 	result.AddMember("kind", "Group", alloc);
-	rapidjson::Value metadata(rapidjson::kObjectType);
+	RequestArena::Value metadata(rapidjson::kObjectType);
 	metadata.AddMember("id", rapidjson::StringRef(group.id.c_str()), alloc);
 	metadata.AddMember("name", rapidjson::StringRef(group.name.c_str()), alloc);
 	metadata.AddMember("email", rapidjson::StringRef(group.email.c_str()), alloc);
@@ -273,11 +260,12 @@ crow::response getGroupInfo(PersistentStore& store, const crow::request& req, co
 	if(!group)
 		return crow::response(404,generateError("Group not found"));
 
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena arena;
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha3", alloc);
-	rapidjson::Value metadata(rapidjson::kObjectType);
+	RequestArena::Value metadata(rapidjson::kObjectType);
 	metadata.AddMember("id", rapidjson::StringRef(group.id.c_str()), alloc);
 	metadata.AddMember("name", rapidjson::StringRef(group.name.c_str()), alloc);
 	metadata.AddMember("email", rapidjson::StringRef(group.email.c_str()), alloc);
@@ -287,7 +275,7 @@ crow::response getGroupInfo(PersistentStore& store, const crow::request& req, co
 	result.AddMember("kind", "Group", alloc);
 	result.AddMember("metadata", metadata, alloc);
 	
-	return crow::response(to_string(result));
+	return conditionalResponse(req,crow::response(to_string(result)));
 }
 
 crow::response updateGroup(PersistentStore& store, const crow::request& req, const std::string& groupID){
@@ -305,7 +293,8 @@ crow::response updateGroup(PersistentStore& store, const crow::request& req, con
 		return crow::response(404,generateError("Group not found"));
 	
 	//unpack the new Group info
-	rapidjson::Document body;
+	RequestArena arena;
+	RequestArena::Document body(&arena.allocator());
 	try{
 		body.Parse(req.body.c_str());
 	}catch(std::runtime_error& err){
@@ -442,18 +431,19 @@ crow::response listGroupMembers(PersistentStore& store, const crow::request& req
 	
 	auto userIDs=store.getMembersOfGroup(targetGroup.id);
 	
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena arena;
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha3", alloc);
-	rapidjson::Value resultItems(rapidjson::kArrayType);
+	RequestArena::Value resultItems(rapidjson::kArrayType);
 	resultItems.Reserve(userIDs.size(), alloc);
 	for(const std::string& userID : userIDs){
 		User user=store.getUser(userID);
-		rapidjson::Value userResult(rapidjson::kObjectType);
+		RequestArena::Value userResult(rapidjson::kObjectType);
 		userResult.AddMember("apiVersion", "v1alpha3", alloc);
 		userResult.AddMember("kind", "User", alloc);
-		rapidjson::Value userData(rapidjson::kObjectType);
+		RequestArena::Value userData(rapidjson::kObjectType);
 		userData.AddMember("id", user.id, alloc);
 		userData.AddMember("name", user.name, alloc);
 		userData.AddMember("email", user.email, alloc);
@@ -480,18 +470,19 @@ crow::response listGroupClusters(PersistentStore& store, const crow::request& re
 	
 	auto clusterIDs=store.clustersOwnedByGroup(targetGroup.id);
 	
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena arena;
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha3", alloc);
-	rapidjson::Value resultItems(rapidjson::kArrayType);
+	RequestArena::Value resultItems(rapidjson::kArrayType);
 	resultItems.Reserve(clusterIDs.size(), alloc);
 	for(const std::string& clusterID : clusterIDs){
 		Cluster cluster=store.getCluster(clusterID);
-		rapidjson::Value clusterResult(rapidjson::kObjectType);
+		RequestArena::Value clusterResult(rapidjson::kObjectType);
 		clusterResult.AddMember("apiVersion", "v1alpha3", alloc);
 		clusterResult.AddMember("kind", "Cluster", alloc);
-		rapidjson::Value clusterData(rapidjson::kObjectType);
+		RequestArena::Value clusterData(rapidjson::kObjectType);
 		clusterData.AddMember("id", cluster.id, alloc);
 		clusterData.AddMember("name", cluster.name, alloc);
 		clusterData.AddMember("owningGroup", targetGroup.name, alloc);
@@ -1,9 +1,29 @@
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
 
 #include <curl/curl.h>
 
@@ -57,6 +77,155 @@ size_t collectCurlOutput(void* buffer, size_t size, size_t nmemb, void* userp){
 	return(size*nmemb);//return full size to indicate success
 }
 
+///Helper data used for passing output data from libcurl to a sink
+struct CurlSinkData{
+	///The handle of the request whose output is being received
+	CURL* handle;
+	///The destination for the body of a successful response
+	const std::function<void(const char*,std::size_t)>& sink;
+	///The HTTP status of the response, once known
+	long status;
+	///The collected body of an unsuccessful response
+	std::string errorOutput;
+	///The exception thrown by the sink, if any
+	std::exception_ptr error;
+};
+
+///Callback function for passing data from libcurl to a sink, and only to be
+///called by libcurl. 
+///See https://curl.haxx.se/libcurl/c/CURLOPT_WRITEFUNCTION.html
+///\param userp pointer to a CurlSinkData object
+size_t sendCurlOutputToSink(void* buffer, size_t size, size_t nmemb, void* userp){
+	CurlSinkData& data=*static_cast<CurlSinkData*>(userp);
+	//curl can't tolerate exceptions, so store them to be rethrown later
+	try{
+		//all headers have arrived by the time any of the body does
+		if(!data.status && curl_easy_getinfo(data.handle,CURLINFO_RESPONSE_CODE,&data.status)!=CURLE_OK)
+			throw std::runtime_error("Failed to get HTTP response code from curl");
+		if(data.status>=200 && data.status<300)
+			data.sink((const char*)buffer,size*nmemb);
+		else
+			data.errorOutput.append((const char*)buffer,size*nmemb);
+	}catch(...){
+		data.error=std::current_exception();
+		return(size*nmemb?0:1); //return a different number to indicate error
+	}
+	return(size*nmemb);//return full size to indicate success
+}
+
+///Callback function for extracting the ETag header from a response, and only to
+///be called by libcurl. 
+///See https://curl.haxx.se/libcurl/c/CURLOPT_HEADERFUNCTION.html
+///\param buffer the header line being provided by libcurl, not NUL terminated
+///\param size always 1
+///\param nitems the length of the header line
+///\param userp pointer to a std::string where the tag should be stored
+size_t collectETagHeader(char* buffer, size_t size, size_t nitems, void* userp){
+	const static std::string name="etag:";
+	const size_t length=size*nitems;
+	if(length<=name.size())
+		return length;
+	for(size_t i=0; i<name.size(); i++){
+		if(std::tolower(buffer[i])!=name[i])
+			return length;
+	}
+	std::string& etag=*static_cast<std::string*>(userp);
+	//this should not throw, but curl can't tolerate exceptions
+	try{
+		etag.assign(buffer+name.size(),length-name.size());
+		//strip surrounding whitespace, including the trailing CRLF
+		etag.erase(0,etag.find_first_not_of(" \t"));
+		etag.erase(etag.find_last_not_of(" \t\r\n")+1);
+	}catch(...){
+		etag.clear();
+	}
+	return length;
+}
+
+///Callback function for extracting the Retry-After header from a response, and 
+///only to be called by libcurl. Only the delay-seconds form of the header is 
+///understood. 
+///See https://curl.haxx.se/libcurl/c/CURLOPT_HEADERFUNCTION.html
+///\param buffer the header line being provided by libcurl, not NUL terminated
+///\param size always 1
+///\param nitems the length of the header line
+///\param userp pointer to an unsigned long where the delay should be stored
+size_t collectRetryAfterHeader(char* buffer, size_t size, size_t nitems, void* userp){
+	const static std::string name="retry-after:";
+	const size_t length=size*nitems;
+	if(length<=name.size())
+		return length;
+	for(size_t i=0; i<name.size(); i++){
+		if(std::tolower(buffer[i])!=name[i])
+			return length;
+	}
+	unsigned long& delay=*static_cast<unsigned long*>(userp);
+	delay=0;
+	size_t i=name.size();
+	while(i<length && (buffer[i]==' ' || buffer[i]=='\t'))
+		i++;
+	for(; i<length && std::isdigit(buffer[i]); i++)
+		delay=10*delay+(buffer[i]-'0');
+	return length;
+}
+
+///A previously received response body and the entity tag which identifies it
+struct CachedResponse{
+	std::string etag;
+	std::string body;
+};
+
+///Responses to earlier GET requests which carried entity tags, by URL
+std::map<std::string,CachedResponse> validatorCache;
+std::mutex validatorCacheMutex;
+
+///Find an earlier response to a GET request
+///\param cached set to the earlier response, if there is one
+///\return whether the earlier response is recent enough to be used without 
+///        contacting the server
+bool findCachedResponse(const std::string& url, const Options& options, CachedResponse& cached){
+	if(options.cache){
+		std::chrono::seconds age;
+		return options.cache->lookup(url,cached.etag,cached.body,age) && age<options.maxAge;
+	}
+	std::lock_guard<std::mutex> lock(validatorCacheMutex);
+	auto it=validatorCache.find(url);
+	if(it!=validatorCache.end())
+		cached=it->second;
+	return false;
+}
+
+///Record the result of a GET request in the appropriate cache
+///\param cached the earlier response whose tag was sent as a validator
+///\return the response to report to the caller
+Response finishGet(const std::string& url, const Options& options, long code, 
+                   std::string body, const std::string& etag, const CachedResponse& cached){
+	//the data we already have is still current
+	if(code==304 && !cached.etag.empty()){
+		if(options.cache)
+			options.cache->refresh(url);
+		return Response{200,cached.body};
+	}
+	if(code==200){
+		//a response can be reused later only if it can be revalidated, or may
+		//be used for some time without revalidation
+		if(options.cache && (!etag.empty() || options.maxAge.count()>0))
+			options.cache->store(url,etag,body);
+		else if(!options.cache && !etag.empty()){
+			std::lock_guard<std::mutex> lock(validatorCacheMutex);
+			validatorCache[url]=CachedResponse{etag,body};
+		}
+	}
+	return Response{(unsigned int)code,std::move(body)};
+}
+
+///Discard cached responses after a request which may have changed data on the
+///server
+void noteModification(const Options& options, long code){
+	if(options.cache && code>=200 && code<300)
+		options.cache->clear();
+}
+
 ///Callback function for sending data to libcurl, and only to be called by libcurl. 
 ///See https://curl.haxx.se/libcurl/c/CURLOPT_READFUNCTION.html
 ///\param buffer the location to which data is to be written
@@ -76,6 +245,119 @@ auto sendCurlInput(char* buffer, size_t size, size_t nitems, void* userp)->size_
 	return(data.input.gcount());
 }
 
+///A bounded queue through which a request body is passed from the thread 
+///which produces it to libcurl
+class BodyPipe{
+public:
+	BodyPipe():offset(0),closed(false),cancelled(false){}
+	
+	///Add data to the queue, waiting until there is space for it
+	///\return false if the data will never be consumed
+	bool write(std::string data){
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock,[this]{ return chunks.size()<maxChunks || cancelled; });
+		if(cancelled)
+			return false;
+		chunks.push_back(std::move(data));
+		changed.notify_all();
+		return true;
+	}
+	
+	///Mark the end of the data
+	///\param error the reason the data is incomplete, if it is
+	void close(std::exception_ptr error=nullptr){
+		std::lock_guard<std::mutex> lock(mutex);
+		closed=true;
+		failure=error;
+		changed.notify_all();
+	}
+	
+	///Stop accepting data, because it will not be consumed
+	void cancel(){
+		std::lock_guard<std::mutex> lock(mutex);
+		cancelled=true;
+		changed.notify_all();
+	}
+	
+	///Take data from the queue, waiting until some is available
+	///\return the amount of data taken, zero if the end of the data has been
+	///        reached, or CURL_READFUNC_ABORT if it could not be completed
+	std::size_t read(char* buffer, std::size_t length){
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock,[this]{ return !chunks.empty() || closed; });
+		if(chunks.empty())
+			return failure ? CURL_READFUNC_ABORT : 0;
+		const std::string& chunk=chunks.front();
+		const std::size_t count=std::min(length,chunk.size()-offset);
+		std::copy_n(chunk.data()+offset,count,buffer);
+		offset+=count;
+		if(offset==chunk.size()){
+			chunks.pop_front();
+			offset=0;
+			changed.notify_all();
+		}
+		return count;
+	}
+	
+	std::exception_ptr error(){
+		std::lock_guard<std::mutex> lock(mutex);
+		return failure;
+	}
+	
+private:
+	static const std::size_t maxChunks=8;
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<std::string> chunks;
+	///The amount of the first chunk which has already been taken
+	std::size_t offset;
+	bool closed;
+	bool cancelled;
+	std::exception_ptr failure;
+};
+
+///A stream buffer which collects data into chunks and passes them to a BodyPipe
+class BodyPipeBuffer : public std::streambuf{
+public:
+	explicit BodyPipeBuffer(BodyPipe& pipe):pipe(pipe),chunk(chunkSize,'\0'){
+		setp(&chunk[0],&chunk[0]+chunkSize);
+	}
+	
+protected:
+	int_type overflow(int_type c) override{
+		if(sync()!=0)
+			return traits_type::eof();
+		if(!traits_type::eq_int_type(c,traits_type::eof())){
+			*pptr()=traits_type::to_char_type(c);
+			pbump(1);
+		}
+		return traits_type::not_eof(c);
+	}
+	
+	int sync() override{
+		const std::size_t used=pptr()-pbase();
+		if(!used)
+			return 0;
+		std::string full(chunkSize,'\0');
+		std::swap(full,chunk);
+		full.resize(used);
+		setp(&chunk[0],&chunk[0]+chunkSize);
+		return pipe.write(std::move(full)) ? 0 : -1;
+	}
+	
+private:
+	static const std::size_t chunkSize=64*1024;
+	BodyPipe& pipe;
+	std::string chunk;
+};
+
+///Callback function for sending data from a BodyPipe to libcurl, and only to 
+///be called by libcurl. 
+///See https://curl.haxx.se/libcurl/c/CURLOPT_READFUNCTION.html
+size_t sendPipeInput(char* buffer, size_t size, size_t nitems, void* userp){
+	return static_cast<BodyPipe*>(userp)->read(buffer,size*nitems);
+}
+
 ///Attempt to extract an error code from libcurl into a more meaningful message, and throw it as an
 ///exception. Never returns normally. 
 ///\param expl any contextual information to be prepended to the error message
@@ -88,15 +370,364 @@ auto sendCurlInput(char* buffer, size_t size, size_t nitems, void* userp)->size_
 		throw std::runtime_error(expl+"\n curl error: "+curl_easy_strerror(err));
 }
 
+struct SessionState{
+	SessionState():share(curl_share_init(),curl_share_cleanup){
+		if(!share)
+			throw std::runtime_error("Failed to initialize curl share");
+		if(curl_share_setopt(share.get(),CURLSHOPT_LOCKFUNC,lockData)!=CURLSHE_OK
+		   || curl_share_setopt(share.get(),CURLSHOPT_UNLOCKFUNC,unlockData)!=CURLSHE_OK
+		   || curl_share_setopt(share.get(),CURLSHOPT_USERDATA,this)!=CURLSHE_OK)
+			throw std::runtime_error("Failed to set curl share locking");
+		if(curl_share_setopt(share.get(),CURLSHOPT_SHARE,CURL_LOCK_DATA_DNS)!=CURLSHE_OK
+		   || curl_share_setopt(share.get(),CURLSHOPT_SHARE,CURL_LOCK_DATA_SSL_SESSION)!=CURLSHE_OK)
+			throw std::runtime_error("Failed to set curl share data");
+#if LIBCURL_VERSION_NUM >= 0x073900 //connection sharing was added in 7.57.0
+		if(curl_share_setopt(share.get(),CURLSHOPT_SHARE,CURL_LOCK_DATA_CONNECT)!=CURLSHE_OK)
+			throw std::runtime_error("Failed to set curl share data");
+#endif
+	}
+	
+	~SessionState(){
+		//all handles must be cleaned up before the share they use
+		for(CURL* handle : idle)
+			curl_easy_cleanup(handle);
+	}
+	
+	///The locks used by the share, which must be declared before it so that 
+	///they are destroyed after it, since cleaning up the share uses them
+	std::mutex locks[CURL_LOCK_DATA_LAST];
+	std::unique_ptr<CURLSH,CURLSHcode (*)(CURLSH*)> share;
+	///Handles not currently in use
+	std::vector<CURL*> idle;
+	std::mutex idleMutex;
+	
+	static void lockData(CURL*, curl_lock_data data, curl_lock_access, void* userp){
+		static_cast<SessionState*>(userp)->locks[data].lock();
+	}
+	
+	static void unlockData(CURL*, curl_lock_data data, void* userp){
+		static_cast<SessionState*>(userp)->locks[data].unlock();
+	}
+};
+
+///A libcurl easy handle, taken from a session's pool if one is specified in 
+///the request options, and otherwise used for only a single request
+class CurlHandle{
+public:
+	explicit CurlHandle(const Options& options):
+	handle(nullptr),session(options.session ? options.session->state.get() : nullptr){
+		if(session){
+			std::lock_guard<std::mutex> lock(session->idleMutex);
+			if(!session->idle.empty()){
+				handle=session->idle.back();
+				session->idle.pop_back();
+			}
+		}
+		if(!handle)
+			handle=curl_easy_init();
+		if(!handle)
+			throw std::runtime_error("Failed to initialize curl handle");
+		if(session && curl_easy_setopt(handle,CURLOPT_SHARE,session->share.get())!=CURLE_OK){
+			release();
+			throw std::runtime_error("Failed to set curl share");
+		}
+#ifdef CURL_HTTP_VERSION_2TLS
+		//use HTTP/2 when the server offers it during the TLS handshake. This 
+		//fails harmlessly if libcurl was built without HTTP/2 support. 
+		curl_easy_setopt(handle,CURLOPT_HTTP_VERSION,(long)CURL_HTTP_VERSION_2TLS);
+#endif
+	}
+	
+	~CurlHandle(){ release(); }
+	
+	CurlHandle(const CurlHandle&)=delete;
+	CurlHandle& operator=(const CurlHandle&)=delete;
+	
+	CURL* get() const{ return handle; }
+	
+private:
+	CURL* handle;
+	SessionState* session;
+	
+	///Return the handle to the session's pool, or destroy it
+	void release(){
+		if(session){
+			//discard per-request settings, which may refer to data which is 
+			//about to be destroyed, while keeping the handle's connections
+			curl_easy_reset(handle);
+			std::lock_guard<std::mutex> lock(session->idleMutex);
+			try{
+				session->idle.push_back(handle);
+				return;
+			}catch(...){}
+		}
+		curl_easy_cleanup(handle);
+	}
+};
+
+///Set an option on a curl handle
+///\param description what the option is, for use in error messages
+template<typename T>
+void setCurlOption(CURL* handle, CURLoption option, T value, 
+                   const std::string& description, const char* errBuf){
+	CURLcode err=curl_easy_setopt(handle,option,value);
+	if(err!=CURLE_OK)
+		reportCurlError("Failed to set "+description,err,errBuf);
+}
+
+std::string methodName(Request::Method method){
+	switch(method){
+		case Request::Method::Get: return "GET";
+		case Request::Method::Put: return "PUT";
+		case Request::Method::Post: return "POST";
+		case Request::Method::Delete: return "DELETE";
+	}
+	return "";
+}
+
+///The state of one request in a batch
+struct Transfer{
+	Transfer(const Request& request, std::size_t index):
+	request(request),index(index),handle(request.options),errBuf(new char[CURL_ERROR_SIZE]),
+	input(request.body,methodName(request.method)+" "+request.url),
+	output{{},methodName(request.method)+" "+request.url},
+	headerList(nullptr,curl_slist_free_all),fresh(false){
+		errBuf[0]=0;
+		configure();
+	}
+	
+	const Request& request;
+	///The position of the request in the batch
+	const std::size_t index;
+	CurlHandle handle;
+	std::unique_ptr<char[]> errBuf;
+	CurlInputData input;
+	CurlOutputData output;
+	std::string etag;
+	CachedResponse cached;
+	std::unique_ptr<curl_slist,void (*)(curl_slist*)> headerList;
+	///Whether the cached response can be used without making the request
+	bool fresh;
+	
+	///Collect the result of the request once curl has finished with it
+	///\param result the result reported by curl
+	Response finish(CURLcode result){
+		if(result!=CURLE_OK)
+			reportCurlError("curl perform "+methodName(request.method)+" failed",result,errBuf.get());
+		long code;
+		CURLcode err=curl_easy_getinfo(handle.get(),CURLINFO_RESPONSE_CODE,&code);
+		if(err!=CURLE_OK)
+			reportCurlError("Failed to get HTTP response code from curl",err,errBuf.get());
+		assert(code>=0);
+		if(request.method==Request::Method::Get)
+			return finishGet(request.url,request.options,code,std::move(output.output),etag,cached);
+		noteModification(request.options,code);
+		return Response{(unsigned int)code,output.output};
+	}
+	
+private:
+	void configure(){
+		CURL* h=handle.get();
+		if(curl_easy_setopt(h, CURLOPT_ERRORBUFFER, errBuf.get())!=CURLE_OK)
+			throw std::runtime_error("Failed to set curl error buffer");
+		setCurlOption(h, CURLOPT_PRIVATE, (void*)this, "curl private data", errBuf.get());
+		setCurlOption(h, CURLOPT_URL, request.url.c_str(), "curl URL option", errBuf.get());
+		setCurlOption(h, CURLOPT_WRITEFUNCTION, collectCurlOutput, "curl output callback", errBuf.get());
+		setCurlOption(h, CURLOPT_WRITEDATA, &output, "curl output callback data", errBuf.get());
+		switch(request.method){
+			case Request::Method::Get:
+				setCurlOption(h, CURLOPT_HTTPGET, 1L, "curl GET option", errBuf.get());
+				setCurlOption(h, CURLOPT_HEADERFUNCTION, collectETagHeader, "curl header callback", errBuf.get());
+				setCurlOption(h, CURLOPT_HEADERDATA, &etag, "curl header callback data", errBuf.get());
+				if(findCachedResponse(request.url,request.options,cached)){
+					fresh=true;
+					return;
+				}
+				if(!cached.etag.empty())
+					headerList.reset(curl_slist_append(headerList.release(),("If-None-Match: "+cached.etag).c_str()));
+				break;
+			case Request::Method::Put:
+				setCurlOption(h, CURLOPT_UPLOAD, 1L, "curl PUT/upload option", errBuf.get());
+				setCurlOption(h, CURLOPT_READFUNCTION, sendCurlInput, "curl input callback", errBuf.get());
+				setCurlOption(h, CURLOPT_READDATA, &input, "curl input callback data", errBuf.get());
+				setCurlOption(h, CURLOPT_INFILESIZE_LARGE, (curl_off_t)request.body.size(), "curl input data size", errBuf.get());
+				headerList.reset(curl_slist_append(headerList.release(),("Content-Type: "+request.options.contentType).c_str()));
+				break;
+			case Request::Method::Post:
+				setCurlOption(h, CURLOPT_POSTFIELDS, request.body.c_str(), "curl POST data", errBuf.get());
+				setCurlOption(h, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)request.body.size(), "curl POST data size", errBuf.get());
+				headerList.reset(curl_slist_append(headerList.release(),("Content-Type: "+request.options.contentType).c_str()));
+				break;
+			case Request::Method::Delete:
+				setCurlOption(h, CURLOPT_CUSTOMREQUEST, "DELETE", "curl DELETE option", errBuf.get());
+				break;
+		}
+		if(headerList)
+			setCurlOption(h, CURLOPT_HTTPHEADER, headerList.get(), "request headers", errBuf.get());
+		if(!request.options.caBundlePath.empty())
+			setCurlOption(h, CURLOPT_CAINFO, request.options.caBundlePath.c_str(), "curl CA bundle path", errBuf.get());
+	}
+};
+
 } //namespace detail
 
+namespace{
+
+///Compute a 64 bit FNV-1a hash
+uint64_t fnv1a(const std::string& data, uint64_t basis){
+	uint64_t hash=basis;
+	for(unsigned char c : data){
+		hash^=c;
+		hash*=0x100000001b3ULL;
+	}
+	return hash;
+}
+
+} //anonymous namespace
+
+ResponseCache::ResponseCache(std::string directory, std::size_t maxSize, 
+                             std::chrono::seconds maxEntryAge):
+directory(std::move(directory)){
+	if(mkdir(this->directory.c_str(),0700)!=0 && errno!=EEXIST)
+		throw std::runtime_error("Unable to create cache directory "+this->directory
+		                         +": error "+std::to_string(errno));
+	evict(maxSize,maxEntryAge);
+}
+
+void ResponseCache::evict(std::size_t maxSize, std::chrono::seconds maxEntryAge){
+	std::unique_ptr<DIR,int (*)(DIR*)> dir(opendir(directory.c_str()),closedir);
+	if(!dir)
+		return;
+	struct Entry{
+		std::string path;
+		time_t modified;
+		std::size_t size;
+	};
+	std::vector<Entry> entries;
+	std::size_t totalSize=0;
+	//the age of an entry is the age of its file; this also catches temporary 
+	//files left behind by interrupted stores
+	const time_t expired=time(nullptr)-maxEntryAge.count();
+	while(struct dirent* entry=readdir(dir.get())){
+		const std::string name=entry->d_name;
+		if(name=="." || name=="..")
+			continue;
+		const std::string path=directory+"/"+name;
+		struct stat info;
+		if(stat(path.c_str(),&info)!=0 || !S_ISREG(info.st_mode))
+			continue;
+		if(info.st_mtime<expired){
+			unlink(path.c_str());
+			continue;
+		}
+		entries.push_back(Entry{path,info.st_mtime,(std::size_t)info.st_size});
+		totalSize+=info.st_size;
+	}
+	if(totalSize<=maxSize)
+		return;
+	std::sort(entries.begin(),entries.end(),
+	          [](const Entry& e1, const Entry& e2){ return e1.modified<e2.modified; });
+	for(const Entry& entry : entries){
+		if(totalSize<=maxSize)
+			break;
+		if(unlink(entry.path.c_str())==0)
+			totalSize-=entry.size;
+	}
+}
+
+std::string ResponseCache::pathFor(const std::string& url) const{
+	//two independent hashes make collisions vanishingly unlikely
+	char name[33];
+	snprintf(name,sizeof(name),"%016llx%016llx",
+	         (unsigned long long)fnv1a(url,0xcbf29ce484222325ULL),
+	         (unsigned long long)fnv1a(url,0x84222325cbf29ce4ULL));
+	return directory+"/"+name;
+}
+
+bool ResponseCache::lookup(const std::string& url, std::string& etag, std::string& body, 
+                           std::chrono::seconds& age) const{
+	const std::string path=pathFor(url);
+	std::ifstream file(path,std::ios::binary);
+	struct stat info;
+	if(!file || stat(path.c_str(),&info)!=0)
+		return false;
+	//the first line is the entity tag, which cannot contain a newline, and the
+	//rest is the body
+	std::string storedTag;
+	if(!std::getline(file,storedTag))
+		return false;
+	std::string storedBody((std::istreambuf_iterator<char>(file)),std::istreambuf_iterator<char>());
+	if(file.bad())
+		return false;
+	etag=std::move(storedTag);
+	body=std::move(storedBody);
+	const auto stored=std::chrono::system_clock::from_time_t(info.st_mtime);
+	age=std::max(std::chrono::seconds(0),
+	             std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now()-stored));
+	return true;
+}
+
+void ResponseCache::store(const std::string& url, const std::string& etag, const std::string& body){
+	//the cache is only an optimization, so failures are ignored
+	const std::string path=pathFor(url);
+	std::string tempPath=path+".XXXXXX";
+	//the file is created accessible only to the current user
+	int fd=mkstemp(&tempPath[0]);
+	if(fd<0)
+		return;
+	const std::string header=etag+'\n';
+	bool ok=true;
+	for(const std::string* part : {&header,&body}){
+		std::size_t written=0;
+		while(ok && written<part->size()){
+			ssize_t result=write(fd,part->data()+written,part->size()-written);
+			if(result>0)
+				written+=result;
+			else if(result==0 || errno!=EINTR)
+				ok=false;
+		}
+	}
+	if(close(fd)!=0)
+		ok=false;
+	//replace any earlier entry atomically, so concurrent readers never see a
+	//partial one
+	if(!ok || rename(tempPath.c_str(),path.c_str())!=0)
+		unlink(tempPath.c_str());
+}
+
+void ResponseCache::refresh(const std::string& url){
+	//the age of an entry is the age of its file
+	utime(pathFor(url).c_str(),nullptr);
+}
+
+void ResponseCache::clear(){
+	std::unique_ptr<DIR,int (*)(DIR*)> dir(opendir(directory.c_str()),closedir);
+	if(!dir)
+		return;
+	while(struct dirent* entry=readdir(dir.get())){
+		const std::string name=entry->d_name;
+		if(name!="." && name!="..")
+			unlink((directory+"/"+name).c_str());
+	}
+}
+
+Session::Session():state(new detail::SessionState){}
+
+Session::~Session(){}
+
 Response httpGet(const std::string& url, const Options& options){
 	detail::CurlOutputData data{{},"GET "+url};
+	std::string etag;
+	//If an earlier response for this URL carried a tag, ask the server to 
+	//send the data again only if it has changed
+	detail::CachedResponse cached;
+	if(detail::findCachedResponse(url,options,cached))
+		return Response{200,cached.body};
 	
 	CURLcode err;
 	std::unique_ptr<char[]> errBuf(new char[CURL_ERROR_SIZE]);
 	errBuf[0]=0;
-	std::unique_ptr<CURL,void (*)(CURL*)> curlSession(curl_easy_init(),curl_easy_cleanup);
+	detail::CurlHandle curlSession(options);
 	using detail::reportCurlError;
 	
 	err=curl_easy_setopt(curlSession.get(), CURLOPT_ERRORBUFFER, errBuf.get());
@@ -114,6 +745,19 @@ Response httpGet(const std::string& url, const Options& options){
 	err=curl_easy_setopt(curlSession.get(), CURLOPT_WRITEDATA, &data);
 	if(err!=CURLE_OK)
 		detail::reportCurlError("Failed to set curl output callback data",err,errBuf.get());
+	err=curl_easy_setopt(curlSession.get(), CURLOPT_HEADERFUNCTION, detail::collectETagHeader);
+	if(err!=CURLE_OK)
+		reportCurlError("Failed to set curl header callback",err,errBuf.get());
+	err=curl_easy_setopt(curlSession.get(), CURLOPT_HEADERDATA, &etag);
+	if(err!=CURLE_OK)
+		reportCurlError("Failed to set curl header callback data",err,errBuf.get());
+	std::unique_ptr<curl_slist,void (*)(curl_slist*)> headerList(nullptr,curl_slist_free_all);
+	if(!cached.etag.empty()){
+		headerList.reset(curl_slist_append(headerList.release(),("If-None-Match: "+cached.etag).c_str()));
+		err=curl_easy_setopt(curlSession.get(), CURLOPT_HTTPHEADER, headerList.get());
+		if(err!=CURLE_OK)
+			reportCurlError("Failed to set request headers",err,errBuf.get());
+	}
 	if(!options.caBundlePath.empty()){
 		err=curl_easy_setopt(curlSession.get(), CURLOPT_CAINFO, options.caBundlePath.c_str());
 		if(err!=CURLE_OK)
@@ -128,8 +772,53 @@ Response httpGet(const std::string& url, const Options& options){
 	if(err!=CURLE_OK)
 		detail::reportCurlError("Failed to get HTTP response code from curl",err,errBuf.get());
 	assert(code>=0);
-		
-	return Response{(unsigned int)code,data.output};
+	
+	return detail::finishGet(url,options,code,std::move(data.output),etag,cached);
+}
+
+Response httpGetStreaming(const std::string& url, 
+                          const std::function<void(const char*,std::size_t)>& sink,
+                          const Options& options){
+	CURLcode err;
+	std::unique_ptr<char[]> errBuf(new char[CURL_ERROR_SIZE]);
+	errBuf[0]=0;
+	detail::CurlHandle curlSession(options);
+	detail::CurlSinkData data{curlSession.get(),sink,0,{},nullptr};
+	using detail::reportCurlError;
+	
+	err=curl_easy_setopt(curlSession.get(), CURLOPT_ERRORBUFFER, errBuf.get());
+	if(err!=CURLE_OK)
+		throw std::runtime_error("Failed to set curl error buffer");
+	err=curl_easy_setopt(curlSession.get(), CURLOPT_URL, url.c_str());
+	if(err!=CURLE_OK)
+		reportCurlError("Failed to set curl URL option",err,errBuf.get());
+	err=curl_easy_setopt(curlSession.get(), CURLOPT_HTTPGET, 1);
+	if(err!=CURLE_OK)
+		reportCurlError("Failed to set curl GET option",err,errBuf.get());
+	err=curl_easy_setopt(curlSession.get(), CURLOPT_WRITEFUNCTION, detail::sendCurlOutputToSink);
+	if(err!=CURLE_OK)
+		reportCurlError("Failed to set curl output callback",err,errBuf.get());
+	err=curl_easy_setopt(curlSession.get(), CURLOPT_WRITEDATA, &data);
+	if(err!=CURLE_OK)
+		reportCurlError("Failed to set curl output callback data",err,errBuf.get());
+	if(!options.caBundlePath.empty()){
+		err=curl_easy_setopt(curlSession.get(), CURLOPT_CAINFO, options.caBundlePath.c_str());
+		if(err!=CURLE_OK)
+			reportCurlError("Failed to set curl CA bundle path",err,errBuf.get());
+	}
+	err=curl_easy_perform(curlSession.get());
+	if(data.error)
+		std::rethrow_exception(data.error);
+	if(err!=CURLE_OK)
+		reportCurlError("curl perform GET failed",err,errBuf.get());
+	
+	long code;
+	err=curl_easy_getinfo(curlSession.get(),CURLINFO_RESPONSE_CODE,&code);
+	if(err!=CURLE_OK)
+		reportCurlError("Failed to get HTTP response code from curl",err,errBuf.get());
+	assert(code>=0);
+	
+	return Response{(unsigned int)code,data.errorOutput};
 }
 
 Response httpDelete(const std::string& url, const Options& options){
@@ -138,7 +827,7 @@ Response httpDelete(const std::string& url, const Options& options){
 	CURLcode err;
 	std::unique_ptr<char[]> errBuf(new char[CURL_ERROR_SIZE]);
 	errBuf[0]=0;
-	std::unique_ptr<CURL,void (*)(CURL*)> curlSession(curl_easy_init(),curl_easy_cleanup);
+	detail::CurlHandle curlSession(options);
 	using detail::reportCurlError;
 	
 	err=curl_easy_setopt(curlSession.get(), CURLOPT_ERRORBUFFER, errBuf.get());
@@ -170,6 +859,7 @@ Response httpDelete(const std::string& url, const Options& options){
 	if(err!=CURLE_OK)
 		reportCurlError("Failed to get HTTP response code from curl",err,errBuf.get());
 	assert(code>=0);
+	detail::noteModification(options,code);
 		
 	return Response{(unsigned int)code,data.output};
 }
@@ -183,7 +873,7 @@ Response httpPut(const std::string& url, const std::string& body,
 	CURLcode err;
 	std::unique_ptr<char[]> errBuf(new char[CURL_ERROR_SIZE]);
 	errBuf[0]=0;
-	std::unique_ptr<CURL,void (*)(CURL*)> curlSession(curl_easy_init(),curl_easy_cleanup);
+	detail::CurlHandle curlSession(options);
 	using detail::reportCurlError;
 	
 	err=curl_easy_setopt(curlSession.get(), CURLOPT_ERRORBUFFER, errBuf.get());
@@ -230,6 +920,7 @@ Response httpPut(const std::string& url, const std::string& body,
 	if(err!=CURLE_OK)
 		reportCurlError("Failed to get HTTP response code from curl",err,errBuf.get());
 	assert(code>=0);
+	detail::noteModification(options,code);
 		
 	return Response{(unsigned int)code,output.output};
 }
@@ -242,7 +933,7 @@ Response httpPost(const std::string& url, const std::string& body,
 	CURLcode err;
 	std::unique_ptr<char[]> errBuf(new char[CURL_ERROR_SIZE]);
 	errBuf[0]=0;
-	std::unique_ptr<CURL,void (*)(CURL*)> curlSession(curl_easy_init(),curl_easy_cleanup);
+	detail::CurlHandle curlSession(options);
 	using detail::reportCurlError;
 	
 	err=curl_easy_setopt(curlSession.get(), CURLOPT_ERRORBUFFER, errBuf.get());
@@ -263,6 +954,13 @@ Response httpPost(const std::string& url, const std::string& body,
 	err=curl_easy_setopt(curlSession.get(), CURLOPT_WRITEDATA, &output);
 	if(err!=CURLE_OK)
 		reportCurlError("Failed to set curl output callback data",err,errBuf.get());	
+	unsigned long retryAfter=0;
+	err=curl_easy_setopt(curlSession.get(), CURLOPT_HEADERFUNCTION, detail::collectRetryAfterHeader);
+	if(err!=CURLE_OK)
+		reportCurlError("Failed to set curl header callback",err,errBuf.get());
+	err=curl_easy_setopt(curlSession.get(), CURLOPT_HEADERDATA, &retryAfter);
+	if(err!=CURLE_OK)
+		reportCurlError("Failed to set curl header callback data",err,errBuf.get());
 	std::unique_ptr<curl_slist,void (*)(curl_slist*)> headerList(nullptr,curl_slist_free_all);
 	headerList.reset(curl_slist_append(headerList.release(),("Content-Type: "+options.contentType).c_str()));
 	err=curl_easy_setopt(curlSession.get(), CURLOPT_HTTPHEADER, headerList.get());
@@ -283,8 +981,183 @@ Response httpPost(const std::string& url, const std::string& body,
 	if(err!=CURLE_OK)
 		reportCurlError("Failed to get HTTP response code from curl",err,errBuf.get());
 	assert(code>=0);
+	detail::noteModification(options,code);
 		
+	return Response{(unsigned int)code,output.output,retryAfter};
+}
+
+Response httpPostStreaming(const std::string& url, 
+                           const std::function<void(std::ostream&)>& writeBody,
+                           const Options& options){
+	detail::CurlOutputData output{{},"POST "+url};
+	detail::BodyPipe pipe;
+	std::thread producer([&pipe,&writeBody]{
+		std::exception_ptr error;
+		try{
+			detail::BodyPipeBuffer buffer(pipe);
+			std::ostream body(&buffer);
+			//stop producing as soon as the data cannot be sent
+			body.exceptions(std::ios::badbit);
+			writeBody(body);
+			body.flush();
+		}catch(...){
+			error=std::current_exception();
+		}
+		pipe.close(error);
+	});
+	//ensure that the producer is never left waiting for the request to consume
+	//its data
+	struct ProducerCleanup{
+		std::thread& producer;
+		detail::BodyPipe& pipe;
+		~ProducerCleanup(){
+			pipe.cancel();
+			producer.join();
+		}
+	} cleanup{producer,pipe};
+	
+	CURLcode err;
+	std::unique_ptr<char[]> errBuf(new char[CURL_ERROR_SIZE]);
+	errBuf[0]=0;
+	detail::CurlHandle curlSession(options);
+	using detail::reportCurlError;
+	
+	err=curl_easy_setopt(curlSession.get(), CURLOPT_ERRORBUFFER, errBuf.get());
+	if(err!=CURLE_OK)
+		throw std::runtime_error("Failed to set curl error buffer");
+	err=curl_easy_setopt(curlSession.get(), CURLOPT_URL, url.c_str());
+	if(err!=CURLE_OK)
+		reportCurlError("Failed to set curl URL option",err,errBuf.get());
+	err=curl_easy_setopt(curlSession.get(), CURLOPT_POST, 1);
+	if(err!=CURLE_OK)
+		reportCurlError("Failed to set curl POST option",err,errBuf.get());
+	err=curl_easy_setopt(curlSession.get(), CURLOPT_READFUNCTION, detail::sendPipeInput);
+	if(err!=CURLE_OK)
+		reportCurlError("Failed to set curl input callback",err,errBuf.get());
+	err=curl_easy_setopt(curlSession.get(), CURLOPT_READDATA, &pipe);
+	if(err!=CURLE_OK)
+		reportCurlError("Failed to set curl input callback data",err,errBuf.get());
+	err=curl_easy_setopt(curlSession.get(), CURLOPT_WRITEFUNCTION, detail::collectCurlOutput);
+	if(err!=CURLE_OK)
+		reportCurlError("Failed to set curl output callback",err,errBuf.get());
+	err=curl_easy_setopt(curlSession.get(), CURLOPT_WRITEDATA, &output);
+	if(err!=CURLE_OK)
+		reportCurlError("Failed to set curl output callback data",err,errBuf.get());
+	std::unique_ptr<curl_slist,void (*)(curl_slist*)> headerList(nullptr,curl_slist_free_all);
+	headerList.reset(curl_slist_append(headerList.release(),("Content-Type: "+options.contentType).c_str()));
+	//the length of the body is not known in advance
+	headerList.reset(curl_slist_append(headerList.release(),"Transfer-Encoding: chunked"));
+	err=curl_easy_setopt(curlSession.get(), CURLOPT_HTTPHEADER, headerList.get());
+	if(err!=CURLE_OK)
+		reportCurlError("Failed to set request headers",err,errBuf.get());
+	if(!options.caBundlePath.empty()){
+		err=curl_easy_setopt(curlSession.get(), CURLOPT_CAINFO, options.caBundlePath.c_str());
+		if(err!=CURLE_OK)
+			reportCurlError("Failed to set curl CA bundle path",err,errBuf.get());
+	}
+	
+	err=curl_easy_perform(curlSession.get());
+	if(err==CURLE_ABORTED_BY_CALLBACK && pipe.error())
+		std::rethrow_exception(pipe.error());
+	if(err!=CURLE_OK)
+		reportCurlError("curl perform POST failed",err,errBuf.get());
+	
+	long code;
+	err=curl_easy_getinfo(curlSession.get(),CURLINFO_RESPONSE_CODE,&code);
+	if(err!=CURLE_OK)
+		reportCurlError("Failed to get HTTP response code from curl",err,errBuf.get());
+	assert(code>=0);
+	detail::noteModification(options,code);
+	
 	return Response{(unsigned int)code,output.output};
 }
 
+std::vector<std::future<Response>> 
+httpBatch(const std::vector<Request>& requests, unsigned int maxConcurrent,
+          const std::function<void(std::size_t,std::future<Response>&)>& onComplete){
+	if(!maxConcurrent)
+		maxConcurrent=1;
+	std::vector<std::promise<Response>> promises(requests.size());
+	std::vector<std::future<Response>> results;
+	results.reserve(requests.size());
+	for(auto& promise : promises)
+		results.push_back(promise.get_future());
+	
+	std::unique_ptr<CURLM,CURLMcode (*)(CURLM*)> multi(curl_multi_init(),curl_multi_cleanup);
+	if(!multi)
+		throw std::runtime_error("Failed to initialize curl multi handle");
+	std::vector<std::unique_ptr<detail::Transfer>> transfers(requests.size());
+	//handles must be detached from the multi handle before either is destroyed
+	struct TransferCleanup{
+		CURLM* multi;
+		std::vector<std::unique_ptr<detail::Transfer>>& transfers;
+		~TransferCleanup(){
+			for(auto& transfer : transfers){
+				if(transfer)
+					curl_multi_remove_handle(multi,transfer->handle.get());
+			}
+		}
+	} cleanup{multi.get(),transfers};
+	
+	auto complete=[&](std::size_t index){
+		transfers[index].reset();
+		if(onComplete)
+			onComplete(index,results[index]);
+	};
+	
+	std::size_t next=0, active=0;
+	while(next<requests.size() || active){
+		while(next<requests.size() && active<maxConcurrent){
+			const std::size_t index=next++;
+			try{
+				transfers[index].reset(new detail::Transfer(requests[index],index));
+				if(transfers[index]->fresh){
+					promises[index].set_value(Response{200,transfers[index]->cached.body});
+					complete(index);
+					continue;
+				}
+				if(curl_multi_add_handle(multi.get(),transfers[index]->handle.get())!=CURLM_OK)
+					throw std::runtime_error("Failed to add request to curl multi handle");
+				active++;
+			}catch(...){
+				promises[index].set_exception(std::current_exception());
+				complete(index);
+			}
+		}
+		if(!active)
+			continue;
+		
+		int running;
+		CURLMcode err=curl_multi_perform(multi.get(),&running);
+		if(err!=CURLM_OK)
+			throw std::runtime_error(std::string("curl multi perform failed: ")+curl_multi_strerror(err));
+		int remaining;
+		while(CURLMsg* message=curl_multi_info_read(multi.get(),&remaining)){
+			if(message->msg!=CURLMSG_DONE)
+				continue;
+			//the message is invalidated when the handle is removed
+			CURL* handle=message->easy_handle;
+			const CURLcode result=message->data.result;
+			char* transferPtr=nullptr;
+			curl_easy_getinfo(handle,CURLINFO_PRIVATE,&transferPtr);
+			detail::Transfer& transfer=*reinterpret_cast<detail::Transfer*>(transferPtr);
+			curl_multi_remove_handle(multi.get(),handle);
+			active--;
+			try{
+				promises[transfer.index].set_value(transfer.finish(result));
+			}catch(...){
+				promises[transfer.index].set_exception(std::current_exception());
+			}
+			complete(transfer.index);
+		}
+		//wait for activity unless there are more requests which can be started
+		if(running && !(next<requests.size() && active<maxConcurrent)){
+			err=curl_multi_wait(multi.get(),nullptr,0,1000,nullptr);
+			if(err!=CURLM_OK)
+				throw std::runtime_error(std::string("curl multi wait failed: ")+curl_multi_strerror(err));
+		}
+	}
+	return results;
+}
+
 } //namespace httpRequests
@@ -0,0 +1,374 @@
+#include "KubeOutput.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include "rapidjson/reader.h"
+#include "rapidjson/error/en.h"
+
+namespace{
+
+///A SAX handler which gathers records of a single type from a JSON document.
+///Records are the objects found at a fixed path within the document, and
+///only the scalar fields whose names are listed are read from them;
+///everything else is skipped without being stored.
+template<typename Record>
+class RecordHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>,RecordHandler<Record>>{
+public:
+	using Setter=void(*)(Record&, const char*, std::size_t);
+	struct Field{
+		const char* name;
+		Setter set;
+	};
+
+	///\param path the sequence of keys leading from the root of the document
+	///            to the records, where "*" matches any element of an array
+	///\param fields the fields to be read from each record
+	///\param records the destination for the records which are found
+	RecordHandler(std::vector<std::string> path, std::vector<Field> fields,
+	              std::vector<Record>& records):
+	path(std::move(path)),fields(std::move(fields)),records(records),matched(0),
+	keyMatchesPath(false),keyField(nullptr){}
+
+	bool StartObject(){ return enter(false); }
+	bool EndObject(rapidjson::SizeType){ return leave(); }
+	bool StartArray(){ return enter(true); }
+	bool EndArray(rapidjson::SizeType){ return leave(); }
+	bool Key(const char* str, rapidjson::SizeType length, bool){
+		//Keys are only of interest if they continue the path, or name a field 
+		//of a record, so resolve them immediately rather than storing them.
+		std::size_t level=containers.size()-1;
+		keyMatchesPath=(matched==level && level<path.size() && 
+		                path[level].size()==length && path[level].compare(0,length,str,length)==0);
+		keyField=nullptr;
+		if(atRecord()){
+			for(const auto& field : fields){
+				if(std::strlen(field.name)==length && std::memcmp(field.name,str,length)==0){
+					keyField=&field;
+					break;
+				}
+			}
+		}
+		return true;
+	}
+	bool String(const char* str, rapidjson::SizeType length, bool){
+		return scalar(str,length);
+	}
+	bool RawNumber(const char* str, rapidjson::SizeType length, bool){
+		return scalar(str,length);
+	}
+	bool Bool(bool value){
+		return value ? scalar("true",4) : scalar("false",5);
+	}
+	bool Default(){ return true; }
+
+private:
+	const std::vector<std::string> path;
+	const std::vector<Field> fields;
+	std::vector<Record>& records;
+	///Whether each enclosing container is an array, starting from the root
+	std::vector<bool> containers;
+	///The number of elements of the path matched by the enclosing containers
+	std::size_t matched;
+	///Whether the most recent object key continues the path
+	bool keyMatchesPath;
+	///The record field named by the most recent object key, if any
+	const Field* keyField;
+
+	bool enter(bool isArray){
+		if(!containers.empty()){
+			//the new container matches the next element of the path if all of
+			//its ancestors matched and its name within its parent does
+			std::size_t level=containers.size()-1;
+			if(containers.back() ? (matched==level && level<path.size() && path[level]=="*")
+			                     : keyMatchesPath)
+				matched++;
+		}
+		containers.push_back(isArray);
+		if(!isArray && atRecord())
+			records.emplace_back();
+		return true;
+	}
+
+	bool leave(){
+		if(matched && matched==containers.size()-1)
+			matched--;
+		containers.pop_back();
+		return true;
+	}
+
+	bool atRecord() const{
+		return matched==path.size() && containers.size()==path.size()+1;
+	}
+
+	bool scalar(const char* str, std::size_t length){
+		if(containers.empty() || containers.back() || !keyField || !atRecord())
+			return true;
+		keyField->set(records.back(),str,length);
+		return true;
+	}
+};
+
+///\return whether the output contains nothing but whitespace, as some helm
+///        commands print nothing when there are no results
+bool blank(const std::string& output){
+	return output.find_first_not_of(" \t\r\n")==std::string::npos;
+}
+
+///Run a SAX handler over command output
+///\throws std::runtime_error if the output is not valid JSON
+template<typename Handler>
+void parseOutput(const std::string& output, Handler& handler){
+	rapidjson::Reader reader;
+	rapidjson::StringStream stream(output.c_str());
+	rapidjson::ParseResult result=reader.Parse<rapidjson::kParseNumbersAsStringsFlag>(stream,handler);
+	if(!result)
+		throw std::runtime_error(std::string("Unable to parse command output as JSON: ")
+		                         +rapidjson::GetParseError_En(result.Code())
+		                         +" at offset "+std::to_string(result.Offset()));
+}
+
+template<typename Record>
+std::vector<Record> parseRecords(const std::string& output, std::vector<std::string> path,
+                                 std::vector<typename RecordHandler<Record>::Field> fields){
+	std::vector<Record> records;
+	if(blank(output))
+		return records;
+	RecordHandler<Record> handler(std::move(path),std::move(fields),records);
+	parseOutput(output,handler);
+	return records;
+}
+
+///A SAX handler which passes each event to two other handlers, so that 
+///different kinds of records can be gathered in a single pass
+template<typename First, typename Second>
+struct PairedHandler{
+	First& first;
+	Second& second;
+	
+	bool Null(){ return first.Null() && second.Null(); }
+	bool Bool(bool b){ return first.Bool(b) && second.Bool(b); }
+	bool Int(int i){ return first.Int(i) && second.Int(i); }
+	bool Uint(unsigned i){ return first.Uint(i) && second.Uint(i); }
+	bool Int64(int64_t i){ return first.Int64(i) && second.Int64(i); }
+	bool Uint64(uint64_t i){ return first.Uint64(i) && second.Uint64(i); }
+	bool Double(double d){ return first.Double(d) && second.Double(d); }
+	bool RawNumber(const char* s, rapidjson::SizeType l, bool c){ return first.RawNumber(s,l,c) && second.RawNumber(s,l,c); }
+	bool String(const char* s, rapidjson::SizeType l, bool c){ return first.String(s,l,c) && second.String(s,l,c); }
+	bool StartObject(){ return first.StartObject() && second.StartObject(); }
+	bool Key(const char* s, rapidjson::SizeType l, bool c){ return first.Key(s,l,c) && second.Key(s,l,c); }
+	bool EndObject(rapidjson::SizeType n){ return first.EndObject(n) && second.EndObject(n); }
+	bool StartArray(){ return first.StartArray() && second.StartArray(); }
+	bool EndArray(rapidjson::SizeType n){ return first.EndArray(n) && second.EndArray(n); }
+};
+
+///A SAX handler which notes the keys of the root object, so that the presence
+///of fields which hold containers, rather than scalars, can be checked
+struct RootKeys : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>,RootKeys>{
+	std::vector<std::string> keys;
+	unsigned int depth=0;
+	
+	bool StartObject(){ depth++; return true; }
+	bool EndObject(rapidjson::SizeType){ depth--; return true; }
+	bool StartArray(){ depth++; return true; }
+	bool EndArray(rapidjson::SizeType){ depth--; return true; }
+	bool Key(const char* str, rapidjson::SizeType length, bool){
+		if(depth==1)
+			keys.emplace_back(str,length);
+		return true;
+	}
+	bool Default(){ return true; }
+	
+	bool contains(const std::string& key) const{
+		return std::find(keys.begin(),keys.end(),key)!=keys.end();
+	}
+};
+
+///\return the first character of the output which is not whitespace, or a 
+///        null character if there is none
+char firstSignificant(const std::string& output){
+	std::size_t pos=output.find_first_not_of(" \t\r\n");
+	return pos==std::string::npos ? '\0' : output[pos];
+}
+
+///A record with only a name
+struct Named{
+	std::string name;
+};
+
+void setName(Named& record, const char* str, std::size_t length){
+	record.name.assign(str,length);
+}
+
+///\return the names of the records, omitting any which had no name
+std::vector<std::string> names(std::vector<Named>&& records){
+	std::vector<std::string> result;
+	result.reserve(records.size());
+	for(auto& record : records){
+		if(!record.name.empty())
+			result.push_back(std::move(record.name));
+	}
+	return result;
+}
+
+///A record holding the status of a release, of which only the resource
+///summary is of interest
+struct ReleaseStatus{
+	std::string resources;
+	bool hasResources=false;
+};
+
+///\return the fields of a release listed by `helm list`, for helm 2, which 
+///        capitalizes the field names, or for helm 3, which does not
+std::vector<RecordHandler<kubernetes::ReleaseInfo>::Field> releaseFields(bool helm3){
+	using kubernetes::ReleaseInfo;
+	return {
+		{helm3 ? "name" : "Name",[](ReleaseInfo& r, const char* s, std::size_t l){ r.name.assign(s,l); }},
+		{helm3 ? "revision" : "Revision",[](ReleaseInfo& r, const char* s, std::size_t){ r.revision=std::strtoul(s,nullptr,10); }},
+		{helm3 ? "updated" : "Updated",[](ReleaseInfo& r, const char* s, std::size_t l){ r.updated.assign(s,l); }},
+		{helm3 ? "status" : "Status",[](ReleaseInfo& r, const char* s, std::size_t l){ r.status.assign(s,l); }},
+		{helm3 ? "chart" : "Chart",[](ReleaseInfo& r, const char* s, std::size_t l){ r.chart.assign(s,l); }},
+		{helm3 ? "app_version" : "AppVersion",[](ReleaseInfo& r, const char* s, std::size_t l){ r.appVersion.assign(s,l); }},
+		{helm3 ? "namespace" : "Namespace",[](ReleaseInfo& r, const char* s, std::size_t l){ r.namespaceName.assign(s,l); }},
+	};
+}
+
+}
+
+namespace kubernetes{
+
+std::vector<ChartInfo> parseHelmSearch(const std::string& output){
+	//helm reports the absence of results as plain text, even when asked for JSON
+	if(output.find("No results found")!=std::string::npos && output.find('[')==std::string::npos)
+		return {};
+	//helm 2 capitalizes the field names, while helm 3 does not
+	auto charts=parseRecords<ChartInfo>(output,{"*"},{
+		{"Name",[](ChartInfo& c, const char* s, std::size_t l){ c.name.assign(s,l); }},
+		{"name",[](ChartInfo& c, const char* s, std::size_t l){ c.name.assign(s,l); }},
+		{"Version",[](ChartInfo& c, const char* s, std::size_t l){ c.chartVersion.assign(s,l); }},
+		{"version",[](ChartInfo& c, const char* s, std::size_t l){ c.chartVersion.assign(s,l); }},
+		{"AppVersion",[](ChartInfo& c, const char* s, std::size_t l){ c.appVersion.assign(s,l); }},
+		{"app_version",[](ChartInfo& c, const char* s, std::size_t l){ c.appVersion.assign(s,l); }},
+		{"Description",[](ChartInfo& c, const char* s, std::size_t l){ c.description.assign(s,l); }},
+		{"description",[](ChartInfo& c, const char* s, std::size_t l){ c.description.assign(s,l); }},
+	});
+	for(const auto& chart : charts){
+		if(chart.name.empty())
+			throw std::runtime_error("Unrecognized helm search output: chart has no name");
+	}
+	return charts;
+}
+
+ReleaseList parseHelmList(const std::string& output){
+	ReleaseList list;
+	const char first=firstSignificant(output);
+	if(!first) //helm prints nothing at all when there are no releases
+		return list;
+	if(first=='['){
+		//helm 3 lists the releases alone, without paging
+		RecordHandler<ReleaseInfo> releases({"*"},releaseFields(true),list.releases);
+		parseOutput(output,releases);
+	}
+	else{
+		//helm 2 wraps the releases in an object with a continuation marker,
+		//which is a field of the root object
+		RecordHandler<ReleaseInfo> releases({"Releases","*"},releaseFields(false),list.releases);
+		std::vector<Named> root;
+		RecordHandler<Named> next({},{{"Next",&setName}},root);
+		RootKeys keys;
+		PairedHandler<RecordHandler<Named>,RootKeys> rootHandler{next,keys};
+		PairedHandler<RecordHandler<ReleaseInfo>,decltype(rootHandler)> handler{releases,rootHandler};
+		parseOutput(output,handler);
+		if(!keys.contains("Releases"))
+			throw std::runtime_error("Unrecognized helm list output: no Releases field");
+		if(!root.empty())
+			list.next=std::move(root.front().name);
+	}
+	for(const auto& release : list.releases){
+		if(release.name.empty())
+			throw std::runtime_error("Unrecognized helm list output: release has no name");
+	}
+	return list;
+}
+
+std::vector<std::string> parseHelmStatusPods(const std::string& output){
+	if(blank(output))
+		throw std::runtime_error("Unrecognized helm status output: no output");
+	//helm 2 summarizes the release's resources in info.status.resources, while 
+	//helm 3 has only a status string there, and lists the resources as objects
+	//in info.resources, if they were requested with --show-resources
+	std::vector<ReleaseStatus> status;
+	RecordHandler<ReleaseStatus> summary({"info","status"},{
+		{"resources",[](ReleaseStatus& r, const char* s, std::size_t l){ r.resources.assign(s,l); r.hasResources=true; }},
+	},status);
+	std::vector<Named> resourceLists, relatedPods, releasePods;
+	RecordHandler<Named> resourceList({"info","resources"},{},resourceLists);
+	RecordHandler<Named> related({"info","resources","v1/Pod(related)","*","metadata"},{{"name",&setName}},relatedPods);
+	RecordHandler<Named> direct({"info","resources","v1/Pod","*","metadata"},{{"name",&setName}},releasePods);
+	PairedHandler<RecordHandler<Named>,RecordHandler<Named>> podHandler{related,direct};
+	PairedHandler<RecordHandler<Named>,decltype(podHandler)> helm3Handler{resourceList,podHandler};
+	PairedHandler<RecordHandler<ReleaseStatus>,decltype(helm3Handler)> handler{summary,helm3Handler};
+	parseOutput(output,handler);
+	
+	if(!resourceLists.empty()){
+		std::vector<std::string> pods=names(std::move(relatedPods));
+		for(auto& pod : names(std::move(releasePods)))
+			pods.push_back(std::move(pod));
+		return pods;
+	}
+	if(status.empty() || !status.front().hasResources)
+		throw std::runtime_error("Unrecognized helm status output: the release's resources are not listed");
+	
+	std::vector<std::string> pods;
+	//helm 2 only summarizes the release's resources as a set of tables, one
+	//per kind, each introduced by a line like "==> v1/Pod(related)"
+	const std::string& resources=status.front().resources;
+	bool inPods=false;
+	std::size_t pos=0;
+	while(pos<resources.size()){
+		std::size_t end=resources.find('\n',pos);
+		if(end==std::string::npos)
+			end=resources.size();
+		if(resources.compare(pos,3,"==>")==0)
+			inPods=resources.compare(pos,10,"==> v1/Pod")==0;
+		else if(inPods){
+			std::size_t nameEnd=resources.find_first_of(" \t\r\n",pos);
+			if(nameEnd>end)
+				nameEnd=end;
+			if(nameEnd>pos && resources.compare(pos,nameEnd-pos,"NAME")!=0)
+				pods.emplace_back(resources,pos,nameEnd-pos);
+		}
+		pos=end+1;
+	}
+	return pods;
+}
+
+std::vector<std::string> parseItemNames(const std::string& output){
+	return names(parseRecords<Named>(output,{"items","*","metadata"},{{"name",&setName}}));
+}
+
+std::vector<std::string> parseNameColumn(const std::string& output){
+	std::vector<std::string> names;
+	std::size_t pos=0;
+	while(pos<output.size()){
+		std::size_t end=output.find('\n',pos);
+		if(end==std::string::npos)
+			end=output.size();
+		std::size_t first=output.find_first_not_of(" \t\r",pos);
+		if(first<end){
+			std::size_t last=output.find_last_not_of(" \t\r",end-1);
+			names.emplace_back(output,first,last+1-first);
+		}
+		pos=end+1;
+	}
+	return names;
+}
+
+std::vector<std::string> parsePodContainerNames(const std::string& output){
+	return names(parseRecords<Named>(output,{"spec","containers","*"},{{"name",&setName}}));
+}
+
+}
@@ -0,0 +1,304 @@
+#include "Logging.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+#include "ServerUtilities.h"
+
+namespace logging{
+
+namespace detail{
+	std::atomic<int> minimumLevel(Info);
+}
+
+namespace{
+
+std::atomic<int> outputFormat(Text);
+
+struct Record{
+	///Position of the record in the global order of submission
+	unsigned long long sequence;
+	std::time_t time;
+	Level level;
+	std::string message;
+};
+
+///A fixed size queue of records with a single producer (the thread which owns
+///it) and a single consumer (the writer thread), which therefore needs no locks
+class RingBuffer{
+public:
+	static const std::size_t capacity=1024;
+
+	RingBuffer():slots(new Record[capacity]),head(0),tail(0){}
+
+	///Called only by the producer
+	///\return false if the buffer is full
+	bool push(Record&& record){
+		const std::size_t t=tail.load(std::memory_order_relaxed);
+		if(t-head.load(std::memory_order_acquire)==capacity)
+			return false;
+		slots[t%capacity]=std::move(record);
+		tail.store(t+1,std::memory_order_release);
+		return true;
+	}
+
+	///Called only by the consumer
+	///\param output the vector to which all available records will be moved
+	void drain(std::vector<Record>& output){
+		std::size_t h=head.load(std::memory_order_relaxed);
+		const std::size_t t=tail.load(std::memory_order_acquire);
+		for(; h!=t; h++)
+			output.push_back(std::move(slots[h%capacity]));
+		head.store(h,std::memory_order_release);
+	}
+
+	bool empty() const{
+		return head.load(std::memory_order_acquire)==tail.load(std::memory_order_acquire);
+	}
+
+private:
+	std::unique_ptr<Record[]> slots;
+	std::atomic<std::size_t> head, tail;
+};
+
+const char* levelName(Level level){
+	switch(level){
+		case Info: return "INFO";
+		case Warning: return "WARNING";
+		case Error: return "ERROR";
+		case Fatal: return "FATAL";
+	}
+	return "UNKNOWN";
+}
+
+void writeRecord(const Record& record){
+	std::ostream& out=(record.level==Info ? std::cout : std::cerr);
+	if(outputFormat.load(std::memory_order_relaxed)==JSONLines){
+		rapidjson::StringBuffer buffer;
+		rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+		writer.StartObject();
+		writer.Key("time");
+		writer.String(timestamp(record.time));
+		writer.Key("level");
+		writer.String(levelName(record.level));
+		writer.Key("message");
+		writer.String(record.message);
+		writer.EndObject();
+		out << buffer.GetString() << '\n';
+	}
+	else
+		out << levelName(record.level) << ": [" << timestamp(record.time) << "] "
+		    << record.message << '\n';
+}
+
+struct WriterState{
+	///Protects all of the following members, except running and nextSequence
+	std::mutex mutex;
+	std::vector<std::shared_ptr<RingBuffer>> buffers;
+	std::thread thread;
+	///Signals the writer thread that it should not wait before its next cycle
+	std::condition_variable wake;
+	bool wakeRequested=false;
+	///Signals threads waiting for the writer to make progress
+	std::condition_variable cycleDone;
+	///The number of collection cycles the writer has completed
+	unsigned long long cycles=0;
+
+	std::atomic<bool> running{false};
+	std::atomic<unsigned long long> nextSequence{0};
+
+	///Serializes synchronous writes when the writer thread is not running
+	std::mutex syncMutex;
+
+	~WriterState(){ stopWriter(); }
+};
+WriterState state;
+
+///Wake the writer thread and wait until it has completed a full collection
+///cycle which began after this call
+void waitForWriter(){
+	std::unique_lock<std::mutex> lock(state.mutex);
+	//a cycle already in progress might have passed the caller's buffer, so
+	//wait for it to finish and then for one more
+	const unsigned long long target=state.cycles+2;
+	while(state.cycles<target && state.thread.joinable()){
+		state.wakeRequested=true;
+		state.wake.notify_one();
+		state.cycleDone.wait(lock);
+	}
+}
+
+std::shared_ptr<RingBuffer> registerBuffer(){
+	auto buffer=std::make_shared<RingBuffer>();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	state.buffers.push_back(buffer);
+	return buffer;
+}
+
+RingBuffer& localBuffer(){
+	thread_local std::shared_ptr<RingBuffer> buffer=registerBuffer();
+	return *buffer;
+}
+
+///Move all pending records out of the ring buffers.
+///Must be called with state.mutex held.
+void collect(std::vector<Record>& batch){
+	for(const auto& buffer : state.buffers)
+		buffer->drain(batch);
+	//forget buffers whose threads have exited, once they have been emptied
+	state.buffers.erase(std::remove_if(state.buffers.begin(),state.buffers.end(),
+	                                   [](const std::shared_ptr<RingBuffer>& buffer){
+	                                   	return buffer.use_count()==1 && buffer->empty();
+	                                   }),state.buffers.end());
+}
+
+void writeBatch(std::vector<Record>& batch){
+	if(batch.empty())
+		return;
+	std::sort(batch.begin(),batch.end(),
+	          [](const Record& r1, const Record& r2){ return r1.sequence<r2.sequence; });
+	for(const auto& record : batch)
+		writeRecord(record);
+	std::cout.flush();
+	std::cerr.flush();
+	batch.clear();
+}
+
+void writerLoop(){
+	std::vector<Record> batch;
+	while(true){
+		const bool stopping=!state.running.load();
+		{
+			std::lock_guard<std::mutex> lock(state.mutex);
+			collect(batch);
+		}
+		writeBatch(batch);
+		std::unique_lock<std::mutex> lock(state.mutex);
+		state.cycles++;
+		state.cycleDone.notify_all();
+		if(stopping)
+			break;
+		if(!state.wakeRequested)
+			state.wake.wait_for(lock,std::chrono::milliseconds(20));
+		state.wakeRequested=false;
+	}
+}
+
+///Signal handler which steps the minimum level down for SIGUSR1 and up for 
+///SIGUSR2. Only touches the (lock-free) atomic level, so is safe to run at any 
+///point. 
+void stepLevel(int signal){
+	int level=detail::minimumLevel.load();
+	if(signal==SIGUSR1 && level>Info)
+		detail::minimumLevel.store(level-1);
+	else if(signal==SIGUSR2 && level<Fatal)
+		detail::minimumLevel.store(level+1);
+}
+
+} //anonymous namespace
+
+void setLevel(Level level){
+	detail::minimumLevel.store(std::min(level,Fatal));
+}
+
+void handleLevelSignals(){
+	static_assert(ATOMIC_INT_LOCK_FREE==2,"The level must be lock-free to be changed by a signal handler");
+	struct sigaction action;
+	action.sa_handler=stepLevel;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags=SA_RESTART;
+	sigaction(SIGUSR1,&action,nullptr);
+	sigaction(SIGUSR2,&action,nullptr);
+}
+
+Level parseLevel(const std::string& name){
+	std::string lower(name);
+	std::transform(lower.begin(),lower.end(),lower.begin(),[](char c)->char{ return std::tolower(c); });
+	if(lower=="info")
+		return Info;
+	if(lower=="warning" || lower=="warn")
+		return Warning;
+	if(lower=="error")
+		return Error;
+	if(lower=="fatal")
+		return Fatal;
+	throw std::runtime_error("Unrecognized log level: "+name);
+}
+
+void setFormat(Format format){
+	outputFormat.store(format);
+}
+
+void startWriter(){
+	std::lock_guard<std::mutex> lock(state.mutex);
+	if(state.thread.joinable())
+		return;
+	state.running=true;
+	state.thread=std::thread(writerLoop);
+}
+
+void stopWriter(){
+	std::thread writer;
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		if(!state.thread.joinable())
+			return;
+		state.running=false;
+		state.wakeRequested=true;
+		state.wake.notify_one();
+		writer=std::move(state.thread);
+	}
+	writer.join();
+	//pick up anything which was submitted while the writer was finishing
+	std::vector<Record> batch;
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		collect(batch);
+	}
+	std::lock_guard<std::mutex> lock(state.syncMutex);
+	writeBatch(batch);
+}
+
+void flush(){
+	if(state.running.load())
+		waitForWriter();
+}
+
+void submit(Level level, std::string&& message){
+	Record record{state.nextSequence++,std::time(nullptr),level,std::move(message)};
+	if(!state.running.load()){
+		std::lock_guard<std::mutex> lock(state.syncMutex);
+		writeRecord(record);
+		(level==Info ? std::cout : std::cerr).flush();
+		return;
+	}
+	RingBuffer& buffer=localBuffer();
+	while(!buffer.push(std::move(record))){
+		//the buffer is full; let the writer catch up
+		waitForWriter();
+		if(!state.running.load()){
+			std::lock_guard<std::mutex> lock(state.syncMutex);
+			writeRecord(record);
+			(level==Info ? std::cout : std::cerr).flush();
+			return;
+		}
+	}
+	//fatal messages generally precede the program stopping, so make sure
+	//they are not left in the buffer
+	if(level==Fatal)
+		flush();
+}
+
+} //namespace logging
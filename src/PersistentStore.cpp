@@ -5,6 +5,7 @@
 #include <cstdio>
 #include <cstring>
 #include <fstream>
+#include <future>
 #include <thread>
 
 #include <unistd.h>
@@ -25,8 +26,11 @@
 #include <aws/dynamodb/model/DescribeTableRequest.h>
 #include <aws/dynamodb/model/UpdateTableRequest.h>
 
+#include <EntitySerialization.h>
 #include <Logging.h>
 #include <ServerUtilities.h>
+#include <Tracing.h>
+#include <WorkerProcesses.h>
 extern "C"{
 	#include <scrypt/scryptenc/scryptenc.h>
 }
@@ -94,12 +98,22 @@ updateTableWithNewSecondaryIndex(const std::string& tableName, const Aws::Dynamo
 	return request;
 }
 	
+///Sleep before checking again whether a change to a table has finished. 
+///Changes are nearly immediate with a local DynamoDB instance but may take
+///minutes with the real service, so the delay starts short and grows.
+///\param delay the time to sleep, which is increased for the next call
+void backOff(std::chrono::milliseconds& delay){
+	std::this_thread::sleep_for(delay);
+	delay=std::min(2*delay,std::chrono::milliseconds(500));
+}
+
 void waitTableReadiness(Aws::DynamoDB::DynamoDBClient& dbClient, const std::string& tableName){
 	using namespace Aws::DynamoDB::Model;
 	log_info("Waiting for table " << tableName << " to reach active status");
 	DescribeTableOutcome outcome;
+	std::chrono::milliseconds delay(20);
 	do{
-		std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		backOff(delay);
 		outcome=dbClient.DescribeTable(DescribeTableRequest()
 		                               .WithTableName(tableName));
 	}while(outcome.IsSuccess() && 
@@ -118,8 +132,9 @@ void waitIndexReadiness(Aws::DynamoDB::DynamoDBClient& dbClient,
 	using GSID=GlobalSecondaryIndexDescription;
 	Aws::Vector<GSID> indices;
 	Aws::Vector<GSID>::iterator index;
+	std::chrono::milliseconds delay(20);
 	do{
-		std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		backOff(delay);
 		outcome=dbClient.DescribeTable(DescribeTableRequest()
 		                               .WithTableName(tableName));
 	}while(outcome.IsSuccess() && (
@@ -142,8 +157,9 @@ void waitUntilIndexDeleted(Aws::DynamoDB::DynamoDBClient& dbClient,
 	using GSID=GlobalSecondaryIndexDescription;
 	Aws::Vector<GSID> indices;
 	Aws::Vector<GSID>::iterator index;
+	std::chrono::milliseconds delay(20);
 	do{
-		std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		backOff(delay);
 		outcome=dbClient.DescribeTable(DescribeTableRequest()
 		                               .WithTableName(tableName));
 	}while(outcome.IsSuccess() &&
@@ -157,9 +173,225 @@ void waitUntilIndexDeleted(Aws::DynamoDB::DynamoDBClient& dbClient,
 ///A default string value to use in place of missing properties, when having a 
 ///trivial value is not a big concern
 const Aws::DynamoDB::Model::AttributeValue missingString(" ");
+
+///Count a cache hit both in the store's statistics and in the current request
+///trace
+void countCacheHit(std::atomic<size_t>& cacheHits){
+	cacheHits++;
+	tracing::countTraceEvent("cache hit");
+}
+
+///Mix a value into a running digest of the contents of some records
+void mixDigest(std::size_t& digest, std::size_t value){
+	digest^=value+std::size_t(0x9e3779b97f4a7c15ULL)+(digest<<6)+(digest>>2);
+}
+
+void mixDigest(std::size_t& digest, const std::string& value){
+	mixDigest(digest,std::hash<std::string>()(value));
+}
+
+std::size_t recordDigest(const User& user){
+	std::size_t digest=0;
+	for(const std::string* field : {&user.id,&user.name,&user.email,&user.phone,
+	                                &user.institution})
+		mixDigest(digest,*field);
+	return digest;
+}
+
+std::size_t recordDigest(const Group& group){
+	std::size_t digest=0;
+	for(const std::string* field : {&group.id,&group.name,&group.email,&group.phone,
+	                                &group.scienceField,&group.description})
+		mixDigest(digest,*field);
+	return digest;
+}
+
+std::size_t recordDigest(const Cluster& cluster){
+	std::size_t digest=0;
+	for(const std::string* field : {&cluster.id,&cluster.name,&cluster.config,
+	                                &cluster.systemNamespace,&cluster.owningGroup,
+	                                &cluster.owningOrganization})
+		mixDigest(digest,*field);
+	return digest;
+}
+
+std::size_t recordDigest(const ApplicationInstance& inst){
+	std::size_t digest=0;
+	for(const std::string* field : {&inst.id,&inst.name,&inst.application,
+	                                &inst.owningGroup,&inst.cluster,&inst.ctime})
+		mixDigest(digest,*field);
+	return digest;
+}
+
+std::size_t recordDigest(const GeoLocation& location){
+	std::size_t digest=0;
+	mixDigest(digest,std::hash<double>()(location.lat));
+	mixDigest(digest,std::hash<double>()(location.lon));
+	return digest;
+}
+
+///\return a digest of a collection of records which does not depend on the 
+///        order in which they were listed
+template<typename RecordType>
+std::size_t setDigest(const std::vector<RecordType>& records){
+	std::size_t digest=records.size();
+	for(const auto& record : records)
+		digest+=recordDigest(record);
+	return digest;
+}
+
+///Look up a cached, pre-rendered list entry, rendering and caching it anew if 
+///no valid copy is available
+///\param cache the fragment cache to search
+///\param id the ID of the entity whose entry is wanted
+///\param validity the duration for which a newly rendered entry should be kept
+///\param cacheHits the counter to increment if a cached copy is used
+///\param version a callable which returns the current version of the data 
+///               from which the entry is rendered. A cached entry is only used
+///               if its version matches, and a newly rendered entry is only 
+///               cached if the version did not change while it was rendered, 
+///               so that a render racing with an update cannot leave behind a
+///               stale entry. 
+///\param render a callable which writes the entry to a JSONWriter
+template<typename Version, typename Render>
+std::string getCachedFragment(ExpiringCache<ListFragment>& cache,
+                              const std::string& id, std::chrono::seconds validity,
+                              std::atomic<size_t>& cacheHits, Version version, 
+                              Render render){
+	const std::size_t expected=version();
+	{
+		CacheRecord<ListFragment> record;
+		if(cache.find(id,record) && record && record.record.version==expected){
+			countCacheHit(cacheHits);
+			return std::move(record.record.text);
+		}
+	}
+	ListFragment fragment;
+	fragment.version=expected;
+	StringOutputStream stream(fragment.text);
+	JSONWriter writer(stream);
+	render(writer);
+	if(version()==expected)
+		cache.insert_or_assign(id,CacheRecord<ListFragment>(fragment,validity));
+	return std::move(fragment.text);
+}
+
+///Combine the digest of a record with the generations of other data
+std::size_t fragmentVersion(std::size_t digest, 
+                            std::initializer_list<unsigned long long> generations){
+	for(unsigned long long generation : generations)
+		mixDigest(digest,std::size_t(generation));
+	return digest;
+}
 	
 } //anonymous namespace
 
+Aws::DynamoDB::Model::GetItemOutcome
+TracedDynamoDBClient::GetItem(const Aws::DynamoDB::Model::GetItemRequest& request) const{
+	tracing::TraceSpan span("dynamodb","GetItem",request.GetTableName().c_str());
+	return DynamoDBClient::GetItem(request);
+}
+
+Aws::DynamoDB::Model::PutItemOutcome
+TracedDynamoDBClient::PutItem(const Aws::DynamoDB::Model::PutItemRequest& request) const{
+	tracing::TraceSpan span("dynamodb","PutItem",request.GetTableName().c_str());
+	auto outcome=DynamoDBClient::PutItem(request);
+	if(outcome.IsSuccess())
+		recordModification(request.GetTableName());
+	return outcome;
+}
+
+Aws::DynamoDB::Model::UpdateItemOutcome
+TracedDynamoDBClient::UpdateItem(const Aws::DynamoDB::Model::UpdateItemRequest& request) const{
+	tracing::TraceSpan span("dynamodb","UpdateItem",request.GetTableName().c_str());
+	auto outcome=DynamoDBClient::UpdateItem(request);
+	if(outcome.IsSuccess())
+		recordModification(request.GetTableName());
+	return outcome;
+}
+
+Aws::DynamoDB::Model::DeleteItemOutcome
+TracedDynamoDBClient::DeleteItem(const Aws::DynamoDB::Model::DeleteItemRequest& request) const{
+	tracing::TraceSpan span("dynamodb","DeleteItem",request.GetTableName().c_str());
+	auto outcome=DynamoDBClient::DeleteItem(request);
+	if(outcome.IsSuccess())
+		recordModification(request.GetTableName());
+	return outcome;
+}
+
+Aws::DynamoDB::Model::QueryOutcome
+TracedDynamoDBClient::Query(const Aws::DynamoDB::Model::QueryRequest& request) const{
+	tracing::TraceSpan span("dynamodb","Query",request.GetTableName().c_str());
+	return DynamoDBClient::Query(request);
+}
+
+Aws::DynamoDB::Model::ScanOutcome
+TracedDynamoDBClient::Scan(const Aws::DynamoDB::Model::ScanRequest& request) const{
+	tracing::TraceSpan span("dynamodb","Scan",request.GetTableName().c_str());
+	return DynamoDBClient::Scan(request);
+}
+
+Aws::DynamoDB::Model::DescribeTableOutcome
+TracedDynamoDBClient::DescribeTable(const Aws::DynamoDB::Model::DescribeTableRequest& request) const{
+	tracing::TraceSpan span("dynamodb","DescribeTable",request.GetTableName().c_str());
+	return DynamoDBClient::DescribeTable(request);
+}
+
+Aws::DynamoDB::Model::CreateTableOutcome
+TracedDynamoDBClient::CreateTable(const Aws::DynamoDB::Model::CreateTableRequest& request) const{
+	tracing::TraceSpan span("dynamodb","CreateTable",request.GetTableName().c_str());
+	return DynamoDBClient::CreateTable(request);
+}
+
+Aws::DynamoDB::Model::UpdateTableOutcome
+TracedDynamoDBClient::UpdateTable(const Aws::DynamoDB::Model::UpdateTableRequest& request) const{
+	tracing::TraceSpan span("dynamodb","UpdateTable",request.GetTableName().c_str());
+	return DynamoDBClient::UpdateTable(request);
+}
+
+Aws::DynamoDB::Model::DeleteTableOutcome
+TracedDynamoDBClient::DeleteTable(const Aws::DynamoDB::Model::DeleteTableRequest& request) const{
+	tracing::TraceSpan span("dynamodb","DeleteTable",request.GetTableName().c_str());
+	return DynamoDBClient::DeleteTable(request);
+}
+
+void TracedDynamoDBClient::trackTables(std::vector<std::string> tables){
+	if(tables.size()>sharedStoreGenerationCount)
+		throw std::runtime_error("Too many tables to track");
+	trackedTables=std::move(tables);
+	for(std::size_t i=0; i<trackedTables.size(); i++){
+		std::atomic<unsigned long long>* shared=sharedStoreGeneration(i);
+		observedGenerations[i].store(shared ? shared->load() : 0);
+	}
+}
+
+bool TracedDynamoDBClient::modifiedElsewhere(std::size_t table){
+	std::atomic<unsigned long long>* shared=sharedStoreGeneration(table);
+	if(!shared)
+		return false;
+	const unsigned long long current=shared->load();
+	//avoid writing to the observed counter when nothing has changed, since 
+	//this is checked by every read
+	if(observedGenerations[table].load()==current)
+		return false;
+	return observedGenerations[table].exchange(current)!=current;
+}
+
+void TracedDynamoDBClient::recordModification(const std::string& table) const{
+	auto position=std::find(trackedTables.begin(),trackedTables.end(),table);
+	if(position==trackedTables.end())
+		return;
+	const std::size_t index=position-trackedTables.begin();
+	std::atomic<unsigned long long>* shared=sharedStoreGeneration(index);
+	if(!shared)
+		return;
+	unsigned long long previous=shared->fetch_add(1);
+	//This process's own change should not cause it to discard its caches, but
+	//if other workers have made changes it has not yet seen, those must still
+	//be noticed later.
+	observedGenerations[index].compare_exchange_strong(previous,previous+1);
+}
+
 const std::string PersistentStore::wildcard="*";
 const std::string PersistentStore::wildcardName="<all>";
 
@@ -175,6 +407,7 @@ PersistentStore::PersistentStore(Aws::Auth::AWSCredentials credentials,
 	clusterTableName("SLATE_clusters"),
 	instanceTableName("SLATE_instances"),
 	secretTableName("SLATE_secrets"),
+	bootstrapUserFile(std::move(bootstrapUserFile)),
 	clusterConfigDir(createConfigTempDir()),
 	userCacheValidity(std::chrono::minutes(5)),
 	userCacheExpirationTime(std::chrono::steady_clock::now()),
@@ -188,12 +421,18 @@ PersistentStore::PersistentStore(Aws::Auth::AWSCredentials credentials,
 	secretKey(1024),
 	appLoggingServerName(appLoggingServerName),
 	appLoggingServerPort(appLoggingServerPort),
-	cacheHits(0),databaseQueries(0),databaseScans(0)
+	cacheHits(0),databaseQueries(0),databaseScans(0),
+	groupGeneration(0),clusterGeneration(0),instanceGeneration(0)
 {
+	//these caches are listed in their entirety while the cache-wide 
+	//expiration time is valid, so their records must be kept until then
+	userCache.retainUntil(userCacheExpirationTime);
+	groupCache.retainUntil(groupCacheExpirationTime);
+	clusterCache.retainUntil(clusterCacheExpirationTime);
+	instanceCache.retainUntil(instanceCacheExpirationTime);
+	dbClient.trackTables({userTableName,groupTableName,clusterTableName,
+	                      instanceTableName,secretTableName});
 	loadEncyptionKey(encryptionKeyFile);
-	log_info("Starting database client");
-	InitializeTables(bootstrapUserFile);
-	log_info("Database client ready");
 }
 
 void PersistentStore::InitializeUserTable(std::string bootstrapUserFile){
@@ -322,7 +561,7 @@ void PersistentStore::InitializeUserTable(std::string bootstrapUserFile){
 			auto updateResult=dbClient.UpdateTable(req);
 			if(!updateResult.IsSuccess())
 				log_fatal("Failed to delete incomplete ByToken secondary index from user table: " + updateResult.GetError().GetMessage());
-			waitUntilIndexDeleted(dbClient,groupTableName,"ByToken");
+			waitUntilIndexDeleted(dbClient,userTableName,"ByToken");
 			changed=true;
 		}
 		if(hasIndex(tableDesc,"ByGlobusID") && 
@@ -334,7 +573,7 @@ void PersistentStore::InitializeUserTable(std::string bootstrapUserFile){
 			auto updateResult=dbClient.UpdateTable(req);
 			if(!updateResult.IsSuccess())
 				log_fatal("Failed to delete incomplete ByGlobusID secondary index from user table: " + updateResult.GetError().GetMessage());
-			waitUntilIndexDeleted(dbClient,groupTableName,"ByGlobusID");
+			waitUntilIndexDeleted(dbClient,userTableName,"ByGlobusID");
 			changed=true;
 		}
 		
@@ -834,12 +1073,29 @@ void PersistentStore::InitializeSecretTable(){
 	}
 }
 
-void PersistentStore::InitializeTables(std::string bootstrapUserFile){
-	InitializeUserTable(bootstrapUserFile);
-	InitializeGroupTable();
-	InitializeClusterTable();
-	InitializeInstanceTable();
-	InitializeSecretTable();
+void PersistentStore::InitializeTables(){
+	log_info("Starting database client");
+	//the tables are independent, so they can be created or updated concurrently
+	std::vector<std::future<void>> steps;
+	steps.push_back(std::async(std::launch::async,[&]{ InitializeUserTable(bootstrapUserFile); }));
+	steps.push_back(std::async(std::launch::async,[this]{ InitializeGroupTable(); }));
+	steps.push_back(std::async(std::launch::async,[this]{ InitializeClusterTable(); }));
+	steps.push_back(std::async(std::launch::async,[this]{ InitializeInstanceTable(); }));
+	steps.push_back(std::async(std::launch::async,[this]{ InitializeSecretTable(); }));
+	//wait for every step to finish before reporting a failure, so that none
+	//is left running
+	std::exception_ptr failure;
+	for(auto& step : steps){
+		try{
+			step.get();
+		}catch(...){
+			if(!failure)
+				failure=std::current_exception();
+		}
+	}
+	if(failure)
+		std::rethrow_exception(failure);
+	log_info("Database client ready");
 }
 
 void PersistentStore::loadEncyptionKey(const std::string& fileName){
@@ -884,13 +1140,14 @@ bool PersistentStore::addUser(const User& user){
 }
 
 User PersistentStore::getUser(const std::string& id){
+	discardCachesIfModifiedElsewhere(UserTable);
 	//first see if we have this cached
 	{
 		CacheRecord<User> record;
 		if(userCache.find(id,record)){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
-				cacheHits++;
+				countCacheHit(cacheHits);
 				return record;
 			}
 		}
@@ -932,13 +1189,14 @@ User PersistentStore::getUser(const std::string& id){
 }
 
 User PersistentStore::findUserByToken(const std::string& token){
+	discardCachesIfModifiedElsewhere(UserTable);
 	//first see if we have this cached
 	{
 		CacheRecord<User> record;
 		if(userByTokenCache.find(token,record)){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
-				cacheHits++;
+				countCacheHit(cacheHits);
 				return record;
 			}
 		}
@@ -990,13 +1248,14 @@ User PersistentStore::findUserByToken(const std::string& token){
 }
 
 User PersistentStore::findUserByGlobusID(const std::string& globusID){
+	discardCachesIfModifiedElsewhere(UserTable);
 	//first see if we have this cached
 	{
 		CacheRecord<User> record;
 		if(userByGlobusIDCache.find(globusID,record)){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
-				cacheHits++;
+				countCacheHit(cacheHits);
 				return record;
 			}
 		}
@@ -1073,6 +1332,7 @@ bool PersistentStore::updateUser(const User& user, const User& oldUser){
 		userByTokenCache.erase(oldUser.token);
 	userByTokenCache.insert_or_assign(user.token,record);
 	userByGlobusIDCache.insert_or_assign(user.globusID,record);
+	userFragmentCache.erase(user.id);
 	
 	return true;
 }
@@ -1095,6 +1355,8 @@ bool PersistentStore::removeUser(const std::string& id){
 			userByGlobusIDCache.erase(record.record.globusID);
 		}
 		userCache.erase(id);
+		userFragmentCache.erase(id);
+		loadedDigests.erase("members:"+id);
 	}
 	
 	using Aws::DynamoDB::Model::AttributeValue;
@@ -1111,16 +1373,14 @@ bool PersistentStore::removeUser(const std::string& id){
 }
 
 std::vector<User> PersistentStore::listUsers(){
+	discardCachesIfModifiedElsewhere(UserTable);
 	std::vector<User> collected;
 	//First check if users are cached
-	if(userCacheExpirationTime.load() > std::chrono::steady_clock::now()){
-		auto table = userCache.lock_table();
-		for(auto itr = table.cbegin(); itr != table.cend(); itr++){
-			auto user = itr->second;
-			cacheHits++;
-			collected.push_back(user);
-		}
-		table.unlock();
+	if(userCacheExpirationTime.load() > coarse_clock::now()){
+		userCache.for_each([&](const CacheRecord<User>& record){
+			countCacheHit(cacheHits);
+			collected.push_back(record.record);
+		});
 		return collected;
 	}
 	
@@ -1164,22 +1424,25 @@ std::vector<User> PersistentStore::listUsers(){
 
 			CacheRecord<User> record(user,userCacheValidity);
 			userCache.insert_or_assign(user.id,record);
+			userByTokenCache.insert_or_assign(user.token,record);
+			userByGlobusIDCache.insert_or_assign(user.globusID,record);
 		}
 	}while(keepGoing);
-	userCacheExpirationTime=std::chrono::steady_clock::now()+userCacheValidity;
+	userCacheExpirationTime=coarse_clock::now()+userCacheValidity;
 	
 	return collected;
 }
 
 std::vector<User> PersistentStore::listUsersByGroup(const std::string& group){
+	discardCachesIfModifiedElsewhere(UserTable);
 	//first check if list of users is cached
 	CacheRecord<std::string> record;
 	auto cached = userByGroupCache.find(group);
-	if (cached.second > std::chrono::steady_clock::now()) {
-		auto records = cached.first;
+	if (cached.second > coarse_clock::now()) {
+		const auto& records = *cached.first;
 		std::vector<User> users;
-		for (auto record : records) {
-			cacheHits++;
+		for (const auto& record : records) {
+			countCacheHit(cacheHits);
 			auto user = getUser(record);
 			users.push_back(user);
 		}
@@ -1220,11 +1483,18 @@ std::vector<User> PersistentStore::listUsersByGroup(const std::string& group){
 		CacheRecord<std::string> groupRecord(user.id,userCacheValidity);
 		userByGroupCache.insert_or_assign(group,groupRecord);
 	}
-	userByGroupCache.update_expiration(group,std::chrono::steady_clock::now()+userCacheValidity);
+	userByGroupCache.update_expiration(group,coarse_clock::now()+userCacheValidity);
 	
 	return users;	
 }
 
+std::string PersistentStore::getUserListFragment(const User& user){
+	discardCachesIfModifiedElsewhere(UserTable);
+	return getCachedFragment(userFragmentCache,user.id,userCacheValidity,cacheHits,
+	                         [&]{ return recordDigest(user); },
+	                         [&](JSONWriter& writer){ writeUserListEntry(writer,user); });
+}
+
 bool PersistentStore::addUserToGroup(const std::string& uID, std::string groupID){
 	//check whether the 'ID' we got was actually a name
 	if(!normalizeGroupID(groupID))
@@ -1253,6 +1523,7 @@ bool PersistentStore::addUserToGroup(const std::string& uID, std::string groupID
 	userByGroupCache.insert_or_assign(groupID,record);
 	CacheRecord<Group> groupRecord(group,groupCacheValidity); 
 	groupByUserCache.insert_or_assign(user.id, groupRecord);
+	groupGeneration++;
 	
 	return true;
 }
@@ -1280,6 +1551,7 @@ bool PersistentStore::removeUserFromGroup(const std::string& uID, std::string gr
 		log_error("Failed to delete user Group membership record: " << err.GetMessage());
 		return false;
 	}
+	groupGeneration++;
 	return true;
 }
 
@@ -1324,6 +1596,7 @@ std::vector<std::string> PersistentStore::getUserGroupMemberships(const std::str
 }
 
 bool PersistentStore::userInGroup(const std::string& uID, std::string groupID){
+	discardCachesIfModifiedElsewhere(UserTable);
 	//TODO: possible issue: We only store memberships, so repeated queries about
 	//a user's belonging to a Group to which that user does not in fact belong will
 	//never be in the cache, and will always incur a database query. This should
@@ -1340,7 +1613,7 @@ bool PersistentStore::userInGroup(const std::string& uID, std::string groupID){
 		if(userByGroupCache.find(groupID,record)){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
-				cacheHits++;
+				countCacheHit(cacheHits);
 				return record;
 			}
 		}
@@ -1401,6 +1674,7 @@ bool PersistentStore::addGroup(const Group& group){
 	CacheRecord<Group> record(group,groupCacheValidity);
 	groupCache.insert_or_assign(group.id,record);
 	groupByNameCache.insert_or_assign(group.name,record);
+	groupGeneration++;
         
 	return true;
 }
@@ -1430,7 +1704,12 @@ bool PersistentStore::removeGroup(const std::string& groupID){
 			groupByNameCache.erase(record.record.name);
 		}
 		groupCache.erase(groupID);
+		groupFragmentCache.erase(groupID);
+		loadedDigests.erase("group:"+groupID);
 	}
+	//rendered entries for clusters and instances may contain the group's name
+	clusterFragmentCache.clear();
+	instanceFragmentCache.clear();
 	
 	//delete the Group record itself
 	auto outcome=dbClient.DeleteItem(Aws::DynamoDB::Model::DeleteItemRequest()
@@ -1442,6 +1721,7 @@ bool PersistentStore::removeGroup(const std::string& groupID){
 		log_error("Failed to delete Group record: " << err.GetMessage());
 		return false;
 	}
+	groupGeneration++;
 	return true;
 }
 
@@ -1470,9 +1750,16 @@ bool PersistentStore::updateGroup(const Group& group){
 	CacheRecord<Group> record(group,groupCacheValidity);
 	groupCache.insert_or_assign(group.id,record);
 	groupByNameCache.insert_or_assign(group.name,record);
+	groupFragmentCache.erase(group.id);
+	//the group's name may have changed, which would make rendered entries for 
+	//its clusters and instances stale; renames are rare, so drop everything
+	clusterFragmentCache.clear();
+	instanceFragmentCache.clear();
 	//in principle we should update the groupByUserCache here, but we don't know 
-	//which users are the keys. However, that cache is used only for Group properties 
-	//which cannot be changed (ID, name), so failing to update it does not do any harm. 
+	//which users are the keys. Its records are only trusted for the group IDs, 
+	//and list entries are rendered from groupCache, so leaving them stale does 
+	//no harm. 
+	groupGeneration++;
 	
 	return true;
 }
@@ -1528,17 +1815,14 @@ std::vector<std::string> PersistentStore::clustersOwnedByGroup(const std::string
 }
 
 std::vector<Group> PersistentStore::listgroups(){
+	discardCachesIfModifiedElsewhere(GroupTable);
 	//First check if vos are cached
 	std::vector<Group> collected;
-	if(groupCacheExpirationTime.load() > std::chrono::steady_clock::now()){
-	        auto table = groupCache.lock_table();
-		for(auto itr = table.cbegin(); itr != table.cend(); itr++){
-		        auto group = itr->second;
-			cacheHits++;
-			collected.push_back(group);
-		}
-	
-		table.unlock();
+	if(groupCacheExpirationTime.load() > coarse_clock::now()){
+		groupCache.for_each([&](const CacheRecord<Group>& record){
+			countCacheHit(cacheHits);
+			collected.push_back(record.record);
+		});
 		return collected;
 	}	
 
@@ -1582,20 +1866,23 @@ std::vector<Group> PersistentStore::listgroups(){
 			groupByNameCache.insert_or_assign(group.name,record);
 		}
 	}while(keepGoing);
-	groupCacheExpirationTime=std::chrono::steady_clock::now()+groupCacheValidity;
+	groupCacheExpirationTime=coarse_clock::now()+groupCacheValidity;
+	noteLoaded(groupGeneration,groupCacheValidity,"groups",setDigest(collected));
 	
 	return collected;
 }
 
 std::vector<Group> PersistentStore::listgroupsForUser(const std::string& user){
+	discardCachesIfModifiedElsewhere(UserTable);
+	discardCachesIfModifiedElsewhere(GroupTable);
 	// first check if groups list is cached
 	CacheRecord<Group> record;
 	auto cached = groupByUserCache.find(user);
-	if (cached.second > std::chrono::steady_clock::now()) {
-		auto records = cached.first;
+	if (cached.second > coarse_clock::now()) {
+		const auto& records = *cached.first;
 		std::vector<Group> vos;
-		for (auto record : records) {
-			cacheHits++;
+		for (const auto& record : records) {
+			countCacheHit(cacheHits);
 			vos.push_back(record);
 		}
 		return vos;
@@ -1636,19 +1923,24 @@ std::vector<Group> PersistentStore::listgroupsForUser(const std::string& user){
 		groupByNameCache.insert_or_assign(group.name,record);
 		groupByUserCache.insert_or_assign(user,record);
 	}
-	groupByUserCache.update_expiration(user,std::chrono::steady_clock::now()+groupCacheValidity);
+	groupByUserCache.update_expiration(user,coarse_clock::now()+groupCacheValidity);
+	std::size_t membership=vos.size();
+	for(const Group& group : vos)
+		membership+=std::hash<std::string>()(group.id);
+	noteLoaded(groupGeneration,groupCacheValidity,"members:"+user,membership);
 	
 	return vos;
 }
 
 Group PersistentStore::findGroupByID(const std::string& id){
+	discardCachesIfModifiedElsewhere(GroupTable);
 	//first see if we have this cached
 	{
 		CacheRecord<Group> record;
 		if(groupCache.find(id,record)){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
-				cacheHits++;
+				countCacheHit(cacheHits);
 				return record;
 			}
 		}
@@ -1682,18 +1974,20 @@ Group PersistentStore::findGroupByID(const std::string& id){
 	CacheRecord<Group> record(group,groupCacheValidity);
 	groupCache.insert_or_assign(group.id,record);
 	groupByNameCache.insert_or_assign(group.name,record);
+	noteLoaded(groupGeneration,groupCacheValidity,"group:"+group.id,recordDigest(group));
 	
 	return group;
 }
 
 Group PersistentStore::findGroupByName(const std::string& name){
+	discardCachesIfModifiedElsewhere(GroupTable);
 	//first see if we have this cached
 	{
 		CacheRecord<Group> record;
 		if(groupByNameCache.find(name,record)){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
-				cacheHits++;
+				countCacheHit(cacheHits);
 				return record;
 			}
 		}
@@ -1734,6 +2028,7 @@ Group PersistentStore::findGroupByName(const std::string& name){
 	CacheRecord<Group> record(group,groupCacheValidity);
 	groupCache.insert_or_assign(group.id,record);
 	groupByNameCache.insert_or_assign(group.name,record);
+	noteLoaded(groupGeneration,groupCacheValidity,"group:"+group.id,recordDigest(group));
 	
 	return group;
 }
@@ -1744,6 +2039,18 @@ Group PersistentStore::getGroup(const std::string& idOrName){
 	return findGroupByName(idOrName);
 }
 
+std::string PersistentStore::getGroupListFragment(const Group& group){
+	discardCachesIfModifiedElsewhere(GroupTable);
+	return getCachedFragment(groupFragmentCache,group.id,groupCacheValidity,cacheHits,
+	                         [&]{ return fragmentVersion(0,{groupGeneration.load()}); },
+	                         [&](JSONWriter& writer){
+		//the record passed in may be a stale copy from groupByUserCache, which 
+		//updateGroup cannot update, so render from the authoritative record
+		const Group current=findGroupByID(group.id);
+		writeGroupListEntry(writer,current ? current : group);
+	});
+}
+
 //----
 
 SharedFileHandle PersistentStore::configPathForCluster(const std::string& cID){
@@ -1777,6 +2084,7 @@ bool PersistentStore::addCluster(const Cluster& cluster){
 	clusterByNameCache.insert_or_assign(cluster.name,record);
 	clusterByGroupCache.insert_or_assign(cluster.owningGroup,record);
 	writeClusterConfigToDisk(cluster);
+	clusterGeneration++;
 	
 	return true;
 }
@@ -1794,13 +2102,14 @@ void PersistentStore::writeClusterConfigToDisk(const Cluster& cluster){
 }
 
 Cluster PersistentStore::findClusterByID(const std::string& cID){
+	discardCachesIfModifiedElsewhere(ClusterTable);
 	//first see if we have this cached
 	{
 		CacheRecord<Cluster> record;
 		if(clusterCache.find(cID,record)){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
-				cacheHits++;
+				countCacheHit(cacheHits);
 				return record;
 			}
 		}
@@ -1836,18 +2145,20 @@ Cluster PersistentStore::findClusterByID(const std::string& cID){
 	clusterByNameCache.insert_or_assign(cluster.name,record);
 	clusterByGroupCache.insert_or_assign(cluster.owningGroup,record);
 	writeClusterConfigToDisk(cluster);
+	noteLoaded(clusterGeneration,clusterCacheValidity,"cluster:"+cluster.id,recordDigest(cluster));
 
 	return cluster;
 }
 
 Cluster PersistentStore::findClusterByName(const std::string& name){
+	discardCachesIfModifiedElsewhere(ClusterTable);
 	//first see if we have this cached
 	{
 		CacheRecord<Cluster> record;
 		if(clusterByNameCache.find(name,record)){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
-				cacheHits++;
+				countCacheHit(cacheHits);
 				return record;
 			}
 		}
@@ -1894,6 +2205,7 @@ Cluster PersistentStore::findClusterByName(const std::string& name){
 	clusterByNameCache.insert_or_assign(cluster.name,record);
 	clusterByGroupCache.insert_or_assign(cluster.owningGroup,record);
 	writeClusterConfigToDisk(cluster);
+	noteLoaded(clusterGeneration,clusterCacheValidity,"cluster:"+cluster.id,recordDigest(cluster));
 	
 	return cluster;
 }
@@ -1929,6 +2241,11 @@ bool PersistentStore::removeCluster(const std::string& cID){
 	clusterCache.erase(cID);
 	clusterConfigs.erase(cID);
 	clusterLocationCache.erase(cID);
+	clusterFragmentCache.erase(cID);
+	loadedDigests.erase("cluster:"+cID);
+	loadedDigests.erase("locations:"+cID);
+	//rendered entries for instances may contain the cluster's name
+	instanceFragmentCache.clear();
 	
 	using Aws::DynamoDB::Model::AttributeValue;
 	auto outcome=dbClient.DeleteItem(Aws::DynamoDB::Model::DeleteItemRequest()
@@ -1949,6 +2266,7 @@ bool PersistentStore::removeCluster(const std::string& cID){
 		log_error("Failed to delete cluster location record: " << err.GetMessage());
 		return false;
 	}
+	clusterGeneration++;
 	return true;
 }
 
@@ -1978,24 +2296,25 @@ bool PersistentStore::updateCluster(const Cluster& cluster){
 	clusterByNameCache.insert_or_assign(cluster.name,record);
 	clusterByGroupCache.insert_or_assign(cluster.owningGroup,record);
 	writeClusterConfigToDisk(cluster);
+	clusterFragmentCache.erase(cluster.id);
+	//the cluster's name may have changed, making rendered instance entries stale
+	instanceFragmentCache.clear();
+	clusterGeneration++;
 	
 	return true;
 }
 
 
 std::vector<Cluster> PersistentStore::listClusters(){
+	discardCachesIfModifiedElsewhere(ClusterTable);
 	std::vector<Cluster> collected;
 
 	// first check if clusters are cached
-	if(clusterCacheExpirationTime.load() > std::chrono::steady_clock::now()){
-		auto table = clusterCache.lock_table();
-		for(auto itr = table.cbegin(); itr != table.cend(); itr++){
-			auto cluster = itr->second;
-			cacheHits++;
-			collected.push_back(cluster);
-		 }
-		
-		table.unlock();
+	if(clusterCacheExpirationTime.load() > coarse_clock::now()){
+		clusterCache.for_each([&](const CacheRecord<Cluster>& record){
+			countCacheHit(cacheHits);
+			collected.push_back(record.record);
+		});
 		return collected;
 	}
 
@@ -2041,12 +2360,14 @@ std::vector<Cluster> PersistentStore::listClusters(){
 			writeClusterConfigToDisk(cluster);
 		}
 	}while(keepGoing);
-	clusterCacheExpirationTime=std::chrono::steady_clock::now()+clusterCacheValidity;
+	clusterCacheExpirationTime=coarse_clock::now()+clusterCacheValidity;
+	noteLoaded(clusterGeneration,clusterCacheValidity,"clusters",setDigest(collected));
 	
 	return collected;
 }
 
 std::vector<Cluster> PersistentStore::listClustersByGroup(std::string group){
+	discardCachesIfModifiedElsewhere(ClusterTable);
 	std::vector<Cluster> collected;
 
 	//check whether the Group 'ID' we got was actually a name
@@ -2095,6 +2416,7 @@ bool PersistentStore::addGroupToCluster(std::string groupID, std::string cID){
 	//update cache
 	CacheRecord<std::string> record(groupID,clusterCacheValidity);
 	clusterGroupAccessCache.insert_or_assign(cID,record);
+	clusterGeneration++;
 	
 	return true;
 }
@@ -2120,6 +2442,7 @@ bool PersistentStore::removeGroupFromCluster(std::string groupID, std::string cI
 		log_error("Failed to delete Group cluster access record: " << err.GetMessage());
 		return false;
 	}
+	clusterGeneration++;
 	return true;
 }
 
@@ -2175,6 +2498,7 @@ std::vector<std::string> PersistentStore::listgroupsAllowedOnCluster(std::string
 }
 
 bool PersistentStore::groupAllowedOnCluster(std::string groupID, std::string cID){
+	discardCachesIfModifiedElsewhere(ClusterTable);
 	//TODO: possible issue: We only store memberships, so repeated queries about
 	//a Group's access to a cluster to which it does not have access belong will
 	//never be in the cache, and will always incur a database query. This should
@@ -2198,7 +2522,7 @@ bool PersistentStore::groupAllowedOnCluster(std::string groupID, std::string cID
 		if(clusterGroupAccessCache.find(cID,record)){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
-				cacheHits++;
+				countCacheHit(cacheHits);
 				return record;
 			}
 		}
@@ -2228,12 +2552,13 @@ bool PersistentStore::groupAllowedOnCluster(std::string groupID, std::string cID
 }
 
 bool PersistentStore::clusterAllowsAllgroups(std::string cID){
+	discardCachesIfModifiedElsewhere(ClusterTable);
 	{ //check cache first
 		CacheRecord<std::string> record(wildcard);
 		if(clusterGroupAccessCache.find(cID,record)){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
-				cacheHits++;
+				countCacheHit(cacheHits);
 				return record;
 			}
 		}
@@ -2262,6 +2587,7 @@ bool PersistentStore::clusterAllowsAllgroups(std::string cID){
 }
 
 std::set<std::string> PersistentStore::listApplicationsGroupMayUseOnCluster(std::string groupID, std::string cID){
+	discardCachesIfModifiedElsewhere(ClusterTable);
 	//check whether the Group 'ID' we got was actually a name
 	if(!normalizeGroupID(groupID,true))
 		return {};
@@ -2276,7 +2602,7 @@ std::set<std::string> PersistentStore::listApplicationsGroupMayUseOnCluster(std:
 		if(clusterGroupApplicationCache.find(sortKey,record)){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
-				cacheHits++;
+				countCacheHit(cacheHits);
 				return record;
 			}
 		}
@@ -2430,6 +2756,7 @@ bool PersistentStore::groupMayUseApplication(std::string groupID, std::string cI
 }
 
 std::vector<GeoLocation> PersistentStore::getLocationsForCluster(std::string cID){
+	discardCachesIfModifiedElsewhere(ClusterTable);
 	//check whether the cluster 'ID' we got was actually a name
 	if(!normalizeClusterID(cID)){
 		log_error("Invalid cluster name");
@@ -2442,7 +2769,7 @@ std::vector<GeoLocation> PersistentStore::getLocationsForCluster(std::string cID
 		if(clusterLocationCache.find(cID,record)){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
-				cacheHits++;
+				countCacheHit(cacheHits);
 				return record;
 			}
 		}
@@ -2478,6 +2805,7 @@ std::vector<GeoLocation> PersistentStore::getLocationsForCluster(std::string cID
 	//update cache
 	CacheRecord<std::vector<GeoLocation>> record(result,clusterCacheValidity);
 	clusterLocationCache.insert_or_assign(cID,record);
+	noteLoaded(clusterGeneration,clusterCacheValidity,"locations:"+cID,setDigest(result));
 	
 	return result;
 }
@@ -2512,10 +2840,25 @@ bool PersistentStore::setLocationsForCluster(std::string cID, const std::vector<
 	//update cache
 	CacheRecord<std::vector<GeoLocation>> record(locations,clusterCacheValidity);
 	clusterLocationCache.insert_or_assign(cID,record);
+	clusterFragmentCache.erase(cID);
+	clusterGeneration++;
 	
 	return true;
 }
 
+std::string PersistentStore::getClusterListFragment(const Cluster& cluster){
+	discardCachesIfModifiedElsewhere(GroupTable);
+	discardCachesIfModifiedElsewhere(ClusterTable);
+	return getCachedFragment(clusterFragmentCache,cluster.id,clusterCacheValidity,cacheHits,
+	                         [&]{ return fragmentVersion(recordDigest(cluster),
+	                                                     {groupGeneration.load(),
+	                                                      clusterGeneration.load()}); },
+	                         [&](JSONWriter& writer){
+		writeClusterListEntry(writer,cluster,findGroupByID(cluster.owningGroup).name,
+		                      getLocationsForCluster(cluster.id));
+	});
+}
+
 CacheRecord<bool> PersistentStore::getCachedClusterReachability(std::string cID){
 	//check whether the cluster 'ID' we got was actually a name
 	if(!normalizeClusterID(cID)){
@@ -2583,6 +2926,7 @@ bool PersistentStore::addApplicationInstance(const ApplicationInstance& inst){
 	instanceByClusterCache.insert_or_assign(inst.cluster,record);
 	instanceByGroupAndClusterCache.insert_or_assign(inst.owningGroup+":"+inst.cluster,record);
 	instanceConfigCache.insert(inst.id,inst.config,instanceCacheValidity);
+	instanceGeneration++;
 	
 	return true;
 }
@@ -2608,6 +2952,8 @@ bool PersistentStore::removeApplicationInstance(const std::string& id){
 		}
 		instanceCache.erase(id);
 		instanceConfigCache.erase(id);
+		instanceFragmentCache.erase(id);
+		loadedDigests.erase("instance:"+id);
 	}
 	
 	using Aws::DynamoDB::Model::AttributeValue;
@@ -2629,17 +2975,19 @@ bool PersistentStore::removeApplicationInstance(const std::string& id){
 		log_error("Failed to delete instance config record: " << err.GetMessage());
 		return false;
 	}
+	instanceGeneration++;
 	return true;
 }
 
 ApplicationInstance PersistentStore::getApplicationInstance(const std::string& id){
+	discardCachesIfModifiedElsewhere(InstanceTable);
 	//first see if we have this cached
 	{
 		CacheRecord<ApplicationInstance> record;
 		if(instanceCache.find(id,record)){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
-				cacheHits++;
+				countCacheHit(cacheHits);
 				return record;
 			}
 		}
@@ -2676,17 +3024,19 @@ ApplicationInstance PersistentStore::getApplicationInstance(const std::string& i
 	instanceByNameCache.insert_or_assign(inst.name,record);
 	instanceByClusterCache.insert_or_assign(inst.cluster,record);
 	instanceByGroupAndClusterCache.insert_or_assign(inst.owningGroup+":"+inst.cluster,record);
+	noteLoaded(instanceGeneration,instanceCacheValidity,"instance:"+inst.id,recordDigest(inst));
 	return inst;
 }
 
 std::string PersistentStore::getApplicationInstanceConfig(const std::string& id){
+	discardCachesIfModifiedElsewhere(InstanceTable);
 	//first see if we have this cached
 	{
 		CacheRecord<std::string> record;
 		if(instanceConfigCache.find(id,record)){
 			//we have a cached record; is it still valid?
 			if(record){ //it is, just return it
-				cacheHits++;
+				countCacheHit(cacheHits);
 				return record;
 			}
 		}
@@ -2717,17 +3067,14 @@ std::string PersistentStore::getApplicationInstanceConfig(const std::string& id)
 }
 
 std::vector<ApplicationInstance> PersistentStore::listApplicationInstances(){
+	discardCachesIfModifiedElsewhere(InstanceTable);
 	//First check if instances are cached
 	std::vector<ApplicationInstance> collected;
-	if(instanceCacheExpirationTime.load() > std::chrono::steady_clock::now()){
-		auto table = instanceCache.lock_table();
-		for(auto itr = table.cbegin(); itr != table.cend(); itr++){
-			auto instance = itr->second;
-			cacheHits++;
-			collected.push_back(instance);
-		 }
-		
-		table.unlock();
+	if(instanceCacheExpirationTime.load() > coarse_clock::now()){
+		instanceCache.for_each([&](const CacheRecord<ApplicationInstance>& record){
+			countCacheHit(cacheHits);
+			collected.push_back(record.record);
+		});
 		return collected;
 	}
 
@@ -2773,12 +3120,14 @@ std::vector<ApplicationInstance> PersistentStore::listApplicationInstances(){
 			instanceByGroupAndClusterCache.insert_or_assign(inst.owningGroup+":"+inst.cluster,record);
 		}
 	}while(keepGoing);
-	instanceCacheExpirationTime=std::chrono::steady_clock::now()+instanceCacheValidity;
+	instanceCacheExpirationTime=coarse_clock::now()+instanceCacheValidity;
+	noteLoaded(instanceGeneration,instanceCacheValidity,"instances",setDigest(collected));
 	
 	return collected;
 }
 
 std::vector<ApplicationInstance> PersistentStore::listApplicationInstancesByClusterOrGroup(std::string group, std::string cluster){
+	discardCachesIfModifiedElsewhere(InstanceTable);
 	std::vector<ApplicationInstance> instances;
 	
 	//check whether the Group 'ID' we got was actually a name
@@ -2792,24 +3141,24 @@ std::vector<ApplicationInstance> PersistentStore::listApplicationInstancesByClus
 	if (!group.empty() && !cluster.empty()) {
 		CacheRecord<ApplicationInstance> record;
 		auto cached = instanceByGroupAndClusterCache.find(group+":"+cluster);
-		if(cached.second > std::chrono::steady_clock::now()){
-			auto records = cached.first;
+		if(cached.second > coarse_clock::now()){
+			const auto& records = *cached.first;
 			cacheHits+=records.size();
 			return std::vector<ApplicationInstance>(records.begin(),records.end());
 		}
 	} else if (!group.empty()) {
 		CacheRecord<ApplicationInstance> record;
 		auto cached = instanceByGroupCache.find(group);
-		if(cached.second > std::chrono::steady_clock::now()){
-			auto records = cached.first;
+		if(cached.second > coarse_clock::now()){
+			const auto& records = *cached.first;
 			cacheHits+=records.size();
 			return std::vector<ApplicationInstance>(records.begin(),records.end());
 		}
 	} else if (!cluster.empty()) {
 		CacheRecord<ApplicationInstance> record;
 		auto cached = instanceByClusterCache.find(cluster);
-		if(cached.second > std::chrono::steady_clock::now()){
-			auto records = cached.first;
+		if(cached.second > coarse_clock::now()){
+			const auto& records = *cached.first;
 			cacheHits+=records.size();
 			return std::vector<ApplicationInstance>(records.begin(),records.end());
 		}
@@ -2876,18 +3225,20 @@ std::vector<ApplicationInstance> PersistentStore::listApplicationInstancesByClus
 		instanceByClusterCache.insert_or_assign(instance.cluster,record);
 		instanceByGroupAndClusterCache.insert_or_assign(instance.owningGroup+":"+instance.cluster,record);
        	}
-	auto expirationTime = std::chrono::steady_clock::now() + instanceCacheValidity;
+	auto expirationTime = coarse_clock::now() + instanceCacheValidity;
 	if (!group.empty() && !cluster.empty())
 		instanceByGroupAndClusterCache.update_expiration(group+":"+cluster, expirationTime);
         else if (!group.empty())
 		instanceByGroupCache.update_expiration(group, expirationTime);
 	else if (!cluster.empty())
 		instanceByClusterCache.update_expiration(cluster, expirationTime);
+	noteLoaded(instanceGeneration,instanceCacheValidity,"instances:"+group+":"+cluster,setDigest(instances));
 	
 	return instances;	
 }
 
 std::vector<ApplicationInstance> PersistentStore::findInstancesByName(const std::string& name){
+	discardCachesIfModifiedElsewhere(InstanceTable);
 	//TODO: read from cache
 	std::vector<ApplicationInstance> instances;
 	
@@ -2934,10 +3285,26 @@ std::vector<ApplicationInstance> PersistentStore::findInstancesByName(const std:
 		instanceByClusterCache.insert_or_assign(instance.cluster,record);
 		instanceByGroupAndClusterCache.insert_or_assign(instance.owningGroup+":"+instance.cluster,record);
 	}
+	noteLoaded(instanceGeneration,instanceCacheValidity,"instancesNamed:"+name,setDigest(instances));
 	return instances;
 }
 
+std::string PersistentStore::getInstanceListFragment(const ApplicationInstance& inst){
+	discardCachesIfModifiedElsewhere(GroupTable);
+	discardCachesIfModifiedElsewhere(ClusterTable);
+	discardCachesIfModifiedElsewhere(InstanceTable);
+	return getCachedFragment(instanceFragmentCache,inst.id,instanceCacheValidity,cacheHits,
+	                         [&]{ return fragmentVersion(recordDigest(inst),
+	                                                     {groupGeneration.load(),
+	                                                      clusterGeneration.load()}); },
+	                         [&](JSONWriter& writer){
+		writeInstanceListEntry(writer,inst,getGroup(inst.owningGroup).name,
+		                       getCluster(inst.cluster).name);
+	});
+}
+
 std::string PersistentStore::encryptSecret(const SecretData& s) const{
+	tracing::TraceSpan span("crypto","encrypt");
 	std::size_t outLen=s.dataSize+128;
 	std::string result(outLen,'\0');
 	int err=scryptenc_buf((const uint8_t*)s.data.get(),s.dataSize,
@@ -2950,6 +3317,7 @@ std::string PersistentStore::encryptSecret(const SecretData& s) const{
 }
 
 SecretData PersistentStore::decryptSecret(const Secret& s) const{
+	tracing::TraceSpan span("crypto","decrypt");
 	if(s.data.size()<128)
 		throw std::runtime_error("Invalid encrypted data: too short to contain header");
 	std::size_t outLen=s.data.size()-128;
@@ -3031,6 +3399,7 @@ bool PersistentStore::removeSecret(const std::string& id){
 }
 
 Secret PersistentStore::getSecret(const std::string& id){
+	discardCachesIfModifiedElsewhere(SecretTable);
 	//first see if we have this cached
 	{
 		CacheRecord<Secret> record;
@@ -3038,7 +3407,7 @@ Secret PersistentStore::getSecret(const std::string& id){
 			//we have a cached record; is it still valid?
 			log_info("Found record of " << id << " in cache");
 			if(record){ //it is, just return it
-				cacheHits++;
+				countCacheHit(cacheHits);
 				return record;
 			}
 		}
@@ -3079,6 +3448,7 @@ Secret PersistentStore::getSecret(const std::string& id){
 }
 
 std::vector<Secret> PersistentStore::listSecrets(std::string group, std::string cluster){
+	discardCachesIfModifiedElsewhere(SecretTable);
 	std::vector<Secret> secrets;
 	
 	assert((!group.empty() || !cluster.empty()) && "Either a Group or a cluster must be specified");
@@ -3094,16 +3464,16 @@ std::vector<Secret> PersistentStore::listSecrets(std::string group, std::string
 	if (!group.empty() && !cluster.empty()) {
 		CacheRecord<ApplicationInstance> record;
 		auto cached = secretByGroupAndClusterCache.find(group+":"+cluster);
-		if(cached.second > std::chrono::steady_clock::now()){
-			auto records = cached.first;
+		if(cached.second > coarse_clock::now()){
+			const auto& records = *cached.first;
 			cacheHits+=records.size();
 			return std::vector<Secret>(records.begin(),records.end());
 		}
 	} else if (!group.empty()) {
 		CacheRecord<ApplicationInstance> record;
 		auto cached = secretByGroupCache.find(group);
-		if(cached.second > std::chrono::steady_clock::now()){
-			auto records = cached.first;
+		if(cached.second > coarse_clock::now()){
+			const auto& records = *cached.first;
 			cacheHits+=records.size();
 			return std::vector<Secret>(records.begin(),records.end());
 		}
@@ -3167,7 +3537,7 @@ std::vector<Secret> PersistentStore::listSecrets(std::string group, std::string
 		secretByGroupCache.insert_or_assign(secret.group,record);
 		secretByGroupAndClusterCache.insert_or_assign(secret.group+":"+secret.cluster,record);
 	}
-	auto expirationTime = std::chrono::steady_clock::now() + secretCacheValidity;
+	auto expirationTime = coarse_clock::now() + secretCacheValidity;
 	if (!cluster.empty())
 		secretByGroupAndClusterCache.update_expiration(group+":"+cluster, expirationTime);
 	else
@@ -3193,6 +3563,82 @@ std::string PersistentStore::getStatistics() const{
 	return os.str();
 }
 
+void PersistentStore::noteLoaded(std::atomic<unsigned long long>& generation, 
+                                 std::chrono::seconds validity,
+                                 const std::string& key, std::size_t digest){
+	//A digest which has expired, but not yet been reclaimed, is still good for
+	//comparison. One which has been reclaimed is treated as a change, since 
+	//nothing is known about what was served from it. 
+	CacheRecord<std::size_t> previous;
+	const bool changed=!loadedDigests.find(key,previous) || previous.record!=digest;
+	loadedDigests.insert_or_assign(key,CacheRecord<std::size_t>(digest,validity));
+	if(changed)
+		generation++;
+}
+
+void PersistentStore::preloadCaches(){
+	listUsers();
+	listgroups();
+	listClusters();
+	listApplicationInstances();
+}
+
+void PersistentStore::discardCachesIfModifiedElsewhere(TrackedTable table){
+	if(!dbClient.modifiedElsewhere(table))
+		return;
+	//expiring the bulk caches forces the next listing to rescan the table
+	const std::chrono::steady_clock::time_point expired;
+	switch(table){
+		case UserTable:
+			userCacheExpirationTime=expired;
+			userCache.clear();
+			userByTokenCache.clear();
+			userByGlobusIDCache.clear();
+			userFragmentCache.clear();
+			//group memberships are also stored in the user table
+			userByGroupCache.clear();
+			groupByUserCache.clear();
+			groupGeneration++;
+			break;
+		case GroupTable:
+			groupCacheExpirationTime=expired;
+			groupCache.clear();
+			groupByNameCache.clear();
+			groupByUserCache.clear();
+			groupFragmentCache.clear();
+			groupGeneration++;
+			break;
+		case ClusterTable:
+			//the cluster table also holds group access grants and locations
+			clusterCacheExpirationTime=expired;
+			clusterCache.clear();
+			clusterByNameCache.clear();
+			clusterByGroupCache.clear();
+			clusterGroupAccessCache.clear();
+			clusterGroupApplicationCache.clear();
+			clusterLocationCache.clear();
+			clusterFragmentCache.clear();
+			clusterGeneration++;
+			break;
+		case InstanceTable:
+			instanceCacheExpirationTime=expired;
+			instanceCache.clear();
+			instanceConfigCache.clear();
+			instanceByGroupCache.clear();
+			instanceByNameCache.clear();
+			instanceByClusterCache.clear();
+			instanceByGroupAndClusterCache.clear();
+			instanceFragmentCache.clear();
+			instanceGeneration++;
+			break;
+		case SecretTable:
+			secretCache.clear();
+			secretByGroupCache.clear();
+			secretByGroupAndClusterCache.clear();
+			break;
+	}
+}
+
 bool PersistentStore::normalizeGroupID(std::string& groupID, bool allowWildcard){
 	if(allowWildcard){
 		if(groupID==wildcard)
@@ -15,6 +15,7 @@
 
 #include <libcuckoo/cuckoohash_map.hh>
 
+#include <Tracing.h>
 #include <Utilities.h>
 
 void setNonblocking(int fd){
@@ -495,6 +496,7 @@ namespace{
 commandResult runCommand(const std::string& command, 
                          const std::vector<std::string>& args,
                          const std::map<std::string,std::string>& env){
+	tracing::TraceSpan span("subprocess","run",command);
 	commandResult result;
 	ProcessHandle child=startProcessAsync(command,args,env);
 	collectChildOutput(child,result);
@@ -505,6 +507,7 @@ commandResult runCommandWithInput(const std::string& command,
                                   const std::string& input,
                                   const std::vector<std::string>& args,
                                   const std::map<std::string,std::string>& env){
+	tracing::TraceSpan span("subprocess","run",command);
 	commandResult result;
 	ProcessHandle child=startProcessAsync(command,args,env);
 	child.getStdin() << input;
@@ -0,0 +1,168 @@
+#include "RateLimiting.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+#include "Readiness.h"
+#include "ServerUtilities.h"
+
+namespace{
+
+typedef std::chrono::steady_clock Clock;
+
+AdmissionLimits limits={20,100,0.5,10,256,32};
+
+std::atomic<unsigned int> inProgress(0), expensiveInProgress(0);
+
+///Finds the user to whose budget requests made with a token are charged
+std::function<std::string(const std::string&)> tokenOwnerLookup;
+
+struct TokenBucket{
+	double cheap;
+	double expensive;
+	Clock::time_point lastRefill;
+};
+
+///Token buckets, keyed by user ID, are spread over several independently 
+///locked maps so that requests from different users rarely contend
+struct BucketShard{
+	std::mutex mutex;
+	std::unordered_map<std::string,TokenBucket> buckets;
+	///The size at which to next discard idle buckets
+	std::size_t pruneThreshold=4096;
+};
+const std::size_t shardCount=16;
+BucketShard shards[shardCount];
+
+///Add the tokens accumulated since the bucket was last refilled
+void refill(TokenBucket& bucket, Clock::time_point now){
+	const double elapsed=std::chrono::duration_cast<std::chrono::duration<double>>(now-bucket.lastRefill).count();
+	bucket.cheap=std::min(limits.cheapBurst,bucket.cheap+elapsed*limits.cheapRate);
+	bucket.expensive=std::min(limits.expensiveBurst,bucket.expensive+elapsed*limits.expensiveRate);
+	bucket.lastRefill=now;
+}
+
+///Discard the buckets of users who have been idle long enough to be full,
+///since they are indistinguishable from new buckets.
+///Must be called with the shard's mutex held.
+void prune(BucketShard& shard, Clock::time_point now){
+	for(auto it=shard.buckets.begin(); it!=shard.buckets.end();){
+		refill(it->second,now);
+		if(it->second.cheap>=limits.cheapBurst && it->second.expensive>=limits.expensiveBurst)
+			it=shard.buckets.erase(it);
+		else
+			++it;
+	}
+	shard.pruneThreshold=std::max<std::size_t>(4096,2*shard.buckets.size());
+}
+
+///Charge one request against a user's budget
+///\param owner the ID of the user who made the request, or an empty string 
+///             for the anonymous budget
+///\param cost the budget to charge
+///\param retryAfter set to the number of seconds until the budget will allow
+///                  another request, if it does not now
+///\return whether the budget allowed the request
+bool takeFromBucket(const std::string& owner, RequestCost cost, unsigned long& retryAfter){
+	const double rate=(cost==RequestCost::Expensive ? limits.expensiveRate : limits.cheapRate);
+	if(rate<=0)
+		return true;
+	const Clock::time_point now=Clock::now();
+	BucketShard& shard=shards[std::hash<std::string>{}(owner)%shardCount];
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	if(shard.buckets.size()>=shard.pruneThreshold)
+		prune(shard,now);
+	auto it=shard.buckets.find(owner);
+	if(it==shard.buckets.end())
+		it=shard.buckets.emplace(owner,TokenBucket{limits.cheapBurst,limits.expensiveBurst,now}).first;
+	else
+		refill(it->second,now);
+	double& level=(cost==RequestCost::Expensive ? it->second.expensive : it->second.cheap);
+	if(level>=1){
+		level-=1;
+		return true;
+	}
+	retryAfter=std::max(1.0,std::ceil((1-level)/rate));
+	return false;
+}
+
+///Try to claim a place among the requests in progress
+///\return whether a place was available
+bool claimSlot(std::atomic<unsigned int>& counter, unsigned int limit){
+	if(counter.fetch_add(1)>=limit && limit){
+		counter--;
+		return false;
+	}
+	return true;
+}
+
+} //anonymous namespace
+
+void setAdmissionLimits(const AdmissionLimits& newLimits){
+	limits=newLimits;
+}
+
+void setTokenOwnerLookup(std::function<std::string(const std::string&)> lookup){
+	tokenOwnerLookup=std::move(lookup);
+}
+
+unsigned int requestsInProgress(){
+	return inProgress.load();
+}
+
+Admission::Admission(const crow::request& req, RequestCost cost):
+cost(cost),admitted(false),holdsSlot(false),status(0),message(nullptr),retryAfter(0){
+	if(!serverReady()){
+		status=503;
+		retryAfter=1;
+		message="Server is still starting";
+		return;
+	}
+	//next check whether the server has capacity, since this is cheap and
+	//rejecting for this reason should not consume the client's budget
+	if(!claimSlot(inProgress,limits.maxConcurrent)){
+		status=503;
+		retryAfter=1;
+		message="Server is too busy to handle the request";
+		return;
+	}
+	if(cost==RequestCost::Expensive && !claimSlot(expensiveInProgress,limits.maxConcurrentExpensive)){
+		inProgress--;
+		status=503;
+		retryAfter=1;
+		message="Server is too busy to handle the request";
+		return;
+	}
+	holdsSlot=true;
+	std::string owner;
+	if(const char* token=req.url_params.get("token")){
+		if(tokenOwnerLookup)
+			owner=tokenOwnerLookup(token);
+	}
+	if(!takeFromBucket(owner,cost,retryAfter)){
+		status=429;
+		message="Request rate limit exceeded";
+		return;
+	}
+	admitted=true;
+}
+
+Admission::~Admission(){
+	if(!holdsSlot)
+		return;
+	inProgress--;
+	if(cost==RequestCost::Expensive)
+		expensiveInProgress--;
+}
+
+crow::response Admission::rejection() const{
+	crow::response response(status,generateError(message));
+	response.set_header("Retry-After",std::to_string(retryAfter));
+	return response;
+}
+
@@ -0,0 +1,111 @@
+#include "Readiness.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#include "ServerUtilities.h"
+
+namespace{
+
+struct StageRecord{
+	const char* name;
+	///Whether the stage must complete before requests can be handled
+	bool required;
+	StageStatus status;
+	std::string detail;
+	std::chrono::steady_clock::time_point started;
+	std::chrono::steady_clock::duration duration;
+};
+
+std::mutex stagesMutex;
+StageRecord stages[]={
+	{"database",true,StageStatus::Pending,"",{},{}},
+	{"helmRepositories",false,StageStatus::Pending,"",{},{}},
+};
+std::atomic<bool> ready(false);
+std::atomic<bool> failed(false);
+
+const char* statusName(StageStatus status){
+	switch(status){
+		case StageStatus::Pending: return "Pending";
+		case StageStatus::InProgress: return "InProgress";
+		case StageStatus::Complete: return "Complete";
+		case StageStatus::Failed: return "Failed";
+	}
+	return "Unknown";
+}
+
+} //anonymous namespace
+
+void setStageStatus(StartupStage stage, StageStatus status, const std::string& detail){
+	std::lock_guard<std::mutex> lock(stagesMutex);
+	StageRecord& record=stages[static_cast<int>(stage)];
+	const auto now=std::chrono::steady_clock::now();
+	if(status==StageStatus::InProgress)
+		record.started=now;
+	else if(record.status==StageStatus::InProgress)
+		record.duration=now-record.started;
+	record.status=status;
+	record.detail=detail;
+	
+	bool allRequiredComplete=true, anyRequiredFailed=false;
+	for(const auto& s : stages){
+		if(!s.required)
+			continue;
+		allRequiredComplete&=(s.status==StageStatus::Complete);
+		anyRequiredFailed|=(s.status==StageStatus::Failed);
+	}
+	ready.store(allRequiredComplete);
+	failed.store(anyRequiredFailed);
+}
+
+bool serverReady(){
+	return ready.load();
+}
+
+crow::response checkLiveness(){
+	if(failed.load())
+		return crow::response(503,generateError("A required startup stage failed; see /readyz"));
+	return crow::response(200,"OK");
+}
+
+crow::response checkReadiness(){
+	crow::response response(serverReady() ? 200 : 503);
+	StringOutputStream stream(response.body);
+	JSONWriter writer(stream);
+	writer.StartObject();
+	writer.Key("kind");
+	writer.String("Readiness");
+	writer.Key("ready");
+	writer.Bool(serverReady());
+	writer.Key("stages");
+	writer.StartArray();
+	{
+		std::lock_guard<std::mutex> lock(stagesMutex);
+		const auto now=std::chrono::steady_clock::now();
+		for(const auto& stage : stages){
+			writer.StartObject();
+			writer.Key("name");
+			writer.String(stage.name);
+			writer.Key("required");
+			writer.Bool(stage.required);
+			writer.Key("status");
+			writer.String(statusName(stage.status));
+			if(!stage.detail.empty()){
+				writer.Key("detail");
+				writer.String(stage.detail);
+			}
+			if(stage.status!=StageStatus::Pending){
+				//for a stage still in progress, report how long it has run so far
+				auto duration=(stage.status==StageStatus::InProgress ? now-stage.started : stage.duration);
+				writer.Key("seconds");
+				writer.Double(std::chrono::duration_cast<std::chrono::duration<double>>(duration).count());
+			}
+			writer.EndObject();
+		}
+	}
+	writer.EndArray();
+	writer.EndObject();
+	return response;
+}
@@ -0,0 +1,114 @@
+#include "RouteMetrics.h"
+
+#include <algorithm>
+#include <deque>
+
+#include "Logging.h"
+#include "PersistentStore.h"
+
+const double RouteStatistics::bucketBounds[RouteStatistics::boundCount]={
+	1, 2.5, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000
+};
+
+namespace{
+	struct RouteRegistry{
+		std::mutex mutex;
+		///Deque so that references to entries remain valid as routes are added
+		std::deque<RouteStatistics> routes;
+	};
+	RouteRegistry registry;
+}
+
+RouteStatistics::RouteStatistics(std::string name):
+name(std::move(name)),count(0),totalTime(tracing::Clock::duration::zero()){
+	buckets.fill(0);
+}
+
+void RouteStatistics::record(tracing::Clock::duration duration, int status){
+	const double ms=std::chrono::duration_cast<std::chrono::duration<double,std::milli>>(duration).count();
+	const std::size_t bucket=std::lower_bound(bucketBounds,bucketBounds+boundCount,ms)-bucketBounds;
+	std::lock_guard<std::mutex> lock(mutex);
+	count++;
+	totalTime+=duration;
+	buckets[bucket]++;
+	statusCounts[status]++;
+}
+
+void RouteStatistics::writeJSON(JSONWriter& writer) const{
+	std::lock_guard<std::mutex> lock(mutex);
+	writer.StartObject();
+	writer.Key("route");
+	writer.String(name);
+	writer.Key("count");
+	writer.Uint64(count);
+	writer.Key("totalSeconds");
+	writer.Double(std::chrono::duration_cast<std::chrono::duration<double>>(totalTime).count());
+	//each bucket counts the requests which took longer than the previous
+	//bucket's bound, and no longer than its own
+	writer.Key("latencyMilliseconds");
+	writer.StartArray();
+	for(std::size_t i=0; i<buckets.size(); i++){
+		writer.StartObject();
+		writer.Key("le");
+		if(i<boundCount)
+			writer.Double(bucketBounds[i]);
+		else
+			writer.String("+Inf");
+		writer.Key("count");
+		writer.Uint64(buckets[i]);
+		writer.EndObject();
+	}
+	writer.EndArray();
+	writer.Key("statusCodes");
+	writer.StartObject();
+	for(const auto& status : statusCounts){
+		writer.Key(std::to_string(status.first));
+		writer.Uint64(status.second);
+	}
+	writer.EndObject();
+	writer.EndObject();
+}
+
+RouteStatistics& routeStatistics(const std::string& name){
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	for(auto& route : registry.routes){
+		if(route.getName()==name)
+			return route;
+	}
+	registry.routes.emplace_back(name);
+	return registry.routes.back();
+}
+
+crow::response getRouteStatistics(PersistentStore& store, const crow::request& req){
+	const User user=authenticateUser(store, req.url_params.get("token"));
+	log_info(user << " requested route statistics");
+	if(!user || !user.admin)
+		return crow::response(403,generateError("Not authorized"));
+
+	crow::response response;
+	StringOutputStream stream(response.body);
+	JSONWriter writer(stream);
+	writer.StartObject();
+	writer.Key("apiVersion");
+	writer.String("v1alpha3");
+	writer.Key("kind");
+	writer.String("RouteStatisticsList");
+	writer.Key("items");
+	writer.StartArray();
+	{
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		for(const auto& route : registry.routes)
+			route.writeJSON(writer);
+	}
+	writer.EndArray();
+	writer.EndObject();
+	return response;
+}
+
+crow::response getSlowRequestTraces(PersistentStore& store, const crow::request& req){
+	const User user=authenticateUser(store, req.url_params.get("token"));
+	log_info(user << " requested slow request traces");
+	if(!user || !user.admin)
+		return crow::response(403,generateError("Not authorized"));
+	return crow::response(tracing::slowTracesJSON());
+}
@@ -0,0 +1,180 @@
+#include "SSLContext.h"
+
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	#include <openssl/core_names.h>
+	#include <openssl/params.h>
+#endif
+
+namespace{
+
+struct TicketKey{
+	unsigned char name[16];
+	unsigned char aesKey[32];
+	unsigned char hmacKey[32];
+};
+
+///The keys used to protect session tickets. Tickets are always issued with
+///the current key, and the previous key is kept so that tickets issued shortly
+///before a rotation remain usable.
+struct TicketKeyRing{
+	std::mutex mutex;
+	std::chrono::seconds lifetime{0};
+	std::chrono::steady_clock::time_point created;
+	TicketKey current;
+	TicketKey previous;
+	bool havePrevious=false;
+};
+TicketKeyRing ticketKeys;
+
+bool generateTicketKey(TicketKey& key){
+	return RAND_bytes(key.name,sizeof(key.name))==1
+	    && RAND_bytes(key.aesKey,sizeof(key.aesKey))==1
+	    && RAND_bytes(key.hmacKey,sizeof(key.hmacKey))==1;
+}
+
+///Choose the key to use for a session ticket, rotating keys if the current one
+///has expired.
+///\param name the name of the key. Filled in when encrypting, and used to find
+///            the key when decrypting.
+///\param encrypt whether a ticket is being issued rather than accepted
+///\param key set to the chosen key
+///\return 1 if a key was chosen, 2 if a key was chosen but the ticket should
+///        be replaced with one using the current key, 0 if no key matches, or
+///        -1 if an error occurred
+int selectTicketKey(unsigned char* name, bool encrypt, TicketKey& key){
+	std::lock_guard<std::mutex> lock(ticketKeys.mutex);
+	const auto now=std::chrono::steady_clock::now();
+	const auto age=now-ticketKeys.created;
+	if(age>=ticketKeys.lifetime){
+		TicketKey fresh;
+		if(!generateTicketKey(fresh))
+			return -1;
+		ticketKeys.previous=ticketKeys.current;
+		//if the server was idle for long enough, even the previous key has expired
+		ticketKeys.havePrevious=(age<2*ticketKeys.lifetime);
+		ticketKeys.current=fresh;
+		ticketKeys.created=now;
+		OPENSSL_cleanse(&fresh,sizeof(fresh));
+	}
+	if(encrypt){
+		key=ticketKeys.current;
+		std::memcpy(name,key.name,sizeof(key.name));
+		return 1;
+	}
+	if(std::memcmp(name,ticketKeys.current.name,sizeof(key.name))==0){
+		key=ticketKeys.current;
+		return 1;
+	}
+	if(ticketKeys.havePrevious && std::memcmp(name,ticketKeys.previous.name,sizeof(key.name))==0){
+		key=ticketKeys.previous;
+		return 2;
+	}
+	return 0;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+int ticketKeyCallback(SSL*, unsigned char* name, unsigned char* iv,
+                      EVP_CIPHER_CTX* cipherContext, EVP_MAC_CTX* macContext, int encrypt){
+#else
+int ticketKeyCallback(SSL*, unsigned char* name, unsigned char* iv,
+                      EVP_CIPHER_CTX* cipherContext, HMAC_CTX* macContext, int encrypt){
+#endif
+	TicketKey key;
+	int result=selectTicketKey(name,encrypt,key);
+	if(result>0){
+		if(encrypt && RAND_bytes(iv,EVP_CIPHER_iv_length(EVP_aes_256_cbc()))!=1)
+			result=-1;
+		else if(EVP_CipherInit_ex(cipherContext,EVP_aes_256_cbc(),nullptr,key.aesKey,iv,encrypt)!=1)
+			result=-1;
+		else{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+			OSSL_PARAM params[]={
+				OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY,key.hmacKey,sizeof(key.hmacKey)),
+				OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,const_cast<char*>("SHA256"),0),
+				OSSL_PARAM_construct_end()
+			};
+			if(EVP_MAC_CTX_set_params(macContext,params)!=1)
+				result=-1;
+#else
+			if(HMAC_Init_ex(macContext,key.hmacKey,sizeof(key.hmacKey),EVP_sha256(),nullptr)!=1)
+				result=-1;
+#endif
+		}
+	}
+	OPENSSL_cleanse(&key,sizeof(key));
+	return result;
+}
+
+} //anonymous namespace
+
+boost::asio::ssl::context createSSLContext(const SSLSettings& settings){
+	using boost::asio::ssl::context;
+	context sslContext(context::sslv23);
+	//the same basic settings crow applies in ssl_file()
+	sslContext.set_verify_mode(boost::asio::ssl::verify_peer);
+	sslContext.use_certificate_chain_file(settings.certificate);
+	sslContext.use_private_key_file(settings.key,context::pem);
+	sslContext.set_options(context::default_workarounds | context::no_sslv2 | context::no_sslv3);
+
+	SSL_CTX* ctx=sslContext.native_handle();
+
+	if(!settings.ciphers.empty()){
+		if(SSL_CTX_set_cipher_list(ctx,settings.ciphers.c_str())!=1)
+			throw std::runtime_error("Invalid SSL cipher list: "+settings.ciphers);
+		SSL_CTX_set_options(ctx,SSL_OP_CIPHER_SERVER_PREFERENCE);
+	}
+	if(!settings.cipherSuites.empty()){
+#ifdef TLS1_3_VERSION
+		if(SSL_CTX_set_ciphersuites(ctx,settings.cipherSuites.c_str())!=1)
+			throw std::runtime_error("Invalid TLS 1.3 cipher suites: "+settings.cipherSuites);
+#else
+		throw std::runtime_error("TLS 1.3 cipher suites were specified, but this version of OpenSSL does not support TLS 1.3");
+#endif
+	}
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	//newer versions always select the curve automatically
+	SSL_CTX_set_ecdh_auto(ctx,1);
+#endif
+	if(!settings.curves.empty() && SSL_CTX_set1_curves_list(ctx,settings.curves.c_str())!=1)
+		throw std::runtime_error("Invalid ECDH curve list: "+settings.curves);
+
+	//sessions can only be resumed when a session ID context is set, since
+	//peer verification is enabled
+	static const unsigned char sessionContext[]="slate-service";
+	SSL_CTX_set_session_id_context(ctx,sessionContext,sizeof(sessionContext)-1);
+	if(settings.sessionCacheSize){
+		SSL_CTX_set_session_cache_mode(ctx,SSL_SESS_CACHE_SERVER);
+		SSL_CTX_sess_set_cache_size(ctx,settings.sessionCacheSize);
+	}
+	else
+		SSL_CTX_set_session_cache_mode(ctx,SSL_SESS_CACHE_OFF);
+	SSL_CTX_set_timeout(ctx,settings.sessionTimeout.count());
+
+	if(settings.ticketKeyLifetime.count()){
+		{
+			std::lock_guard<std::mutex> lock(ticketKeys.mutex);
+			ticketKeys.lifetime=settings.ticketKeyLifetime;
+			if(!generateTicketKey(ticketKeys.current))
+				throw std::runtime_error("Failed to generate session ticket key");
+			ticketKeys.havePrevious=false;
+			ticketKeys.created=std::chrono::steady_clock::now();
+		}
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+		SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx,&ticketKeyCallback);
+#else
+		SSL_CTX_set_tlsext_ticket_key_cb(ctx,&ticketKeyCallback);
+#endif
+	}
+	else
+		SSL_CTX_set_options(ctx,SSL_OP_NO_TICKET);
+
+	return sslContext;
+}
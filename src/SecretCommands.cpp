@@ -4,6 +4,7 @@
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
 
+#include "EntitySerialization.h"
 #include "Logging.h"
 #include "ServerUtilities.h"
 #include "KubeInterface.h"
@@ -99,29 +100,16 @@ crow::response listSecrets(PersistentStore& store, const crow::request& req){
 	
 	std::vector<Secret> secrets=store.listSecrets(group.id,cluster);
 	
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	crow::response response;
+	StringOutputStream stream(response.body);
+	JSONWriter writer(stream);
+	beginListResult(writer);
+	for(const Secret& secret : secrets)
+		writeSecretListEntry(writer, secret, store.getGroup(secret.group).name, 
+		                     store.getCluster(secret.cluster).name);
+	endListResult(writer);
 	
-	result.AddMember("apiVersion", "v1alpha3", alloc);
-	rapidjson::Value resultItems(rapidjson::kArrayType);
-	resultItems.Reserve(secrets.size(), alloc);
-	
-	for(const Secret& secret : secrets){
-		rapidjson::Value secretResult(rapidjson::kObjectType);
-		secretResult.AddMember("apiVersion", "v1alpha3", alloc);
-		secretResult.AddMember("kind", "Secret", alloc);
-		rapidjson::Value secretData(rapidjson::kObjectType);
-		secretData.AddMember("id", secret.id, alloc);
-		secretData.AddMember("name", secret.name, alloc);
-		secretData.AddMember("group", store.getGroup(secret.group).name, alloc);
-		secretData.AddMember("cluster", store.getCluster(secret.cluster).name, alloc);
-		secretData.AddMember("created", secret.ctime, alloc);
-		secretResult.AddMember("metadata", secretData, alloc);
-		resultItems.PushBack(secretResult, alloc);
-	}
-	result.AddMember("items", resultItems, alloc);
-	
-	return crow::response(to_string(result));
+	return response;
 }
 
 crow::response createSecret(PersistentStore& store, const crow::request& req){
@@ -131,9 +119,10 @@ crow::response createSecret(PersistentStore& store, const crow::request& req){
 		return crow::response(403,generateError("Not authorized"));
 	
 	//unpack the target cluster info
-	rapidjson::Document body;
+	RequestArena arena;
+	RequestArena::Document body(&arena.allocator());
 	try{
-		body.Parse(req.body);
+		body.ParseInsitu(arena.copyString(req.body));
 	}catch(std::runtime_error& err){
 		return crow::response(400,generateError("Invalid JSON in request body"));
 	}
@@ -173,6 +162,8 @@ crow::response createSecret(PersistentStore& store, const crow::request& req){
 	const static std::string allowedKeyCharacters="-._0123456789"
 	"abcdefghijklmnopqrstuvwxyz"
 	"ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+	//values are decoded as they are validated, so that each is only examined once
+	std::vector<std::string> decodedValues;
 	if(body.HasMember("contents")){
 		for(const auto& member : body["contents"].GetObject()){
 			if(!member.value.IsString())
@@ -184,10 +175,15 @@ crow::response createSecret(PersistentStore& store, const crow::request& req){
 			if(std::string(member.name.GetString())
 			   .find_first_not_of(allowedKeyCharacters)!=std::string::npos)
 				return crow::response(400,generateError("Secret key does not match [-._a-zA-Z0-9]+"));
-			if(!sanityCheckBase64(member.value.GetString())){
+			std::string value(base64DecodedLength(member.value.GetStringLength()),'\0');
+			std::size_t valueLength=0;
+			if(!value.empty() && 
+			   !decodeBase64(member.value.GetString(),member.value.GetStringLength(),&value[0],valueLength)){
 				log_warn("Secret data appears not to be base64 encoded");
 				return crow::response(400,generateError("Secret data items must be base64 encoded"));
 			}
+			value.resize(valueLength);
+			decodedValues.push_back(std::move(value));
 		}
 	}
 	
@@ -233,7 +229,7 @@ crow::response createSecret(PersistentStore& store, const crow::request& req){
 	if(body.HasMember("contents")){ //Re-serialize the contents and encrypt
 		SecretStringBuffer buf;
 		rapidjson::Writer<SecretStringBuffer> writer(buf);
-		rapidjson::Document tmp(rapidjson::kObjectType);
+		RequestArena::Document tmp(rapidjson::kObjectType);
 		body["contents"].Accept(writer);
 		//swizzle size and capacity so we encrypt only the useful data, but put
 		//things back when we're done
@@ -260,8 +256,10 @@ crow::response createSecret(PersistentStore& store, const crow::request& req){
 		//Unfortunately, we _also_ need to decrypt the secret in order to pass
 		//its data to Kubernetes. 
 		SecretData secretData=store.decryptSecret(existing);
-		rapidjson::Document contents(rapidjson::kObjectType,&body.GetAllocator());
+		RequestArena::Document contents(rapidjson::kObjectType,&body.GetAllocator());
 		contents.Parse(secretData.data.get(),secretData.dataSize);
+		for(const auto& member : contents.GetObject())
+			decodedValues.push_back(decodeBase64(member.value.GetString()));
 		body.AddMember("contents",contents,body.GetAllocator());
 	}
 	secret.valid=true;
@@ -302,8 +300,9 @@ crow::response createSecret(PersistentStore& store, const crow::request& req){
 		std::vector<std::string> arguments={"create","secret","generic",
 		                                    secret.name,"--namespace",group.namespaceName()};
 		std::vector<FileHandle> valueFiles;
+		auto decodedValue=decodedValues.begin();
 		for(const auto& member : body["contents"].GetObject()){
-			const std::string value=decodeBase64(member.value.GetString());
+			const std::string& value=*decodedValue++;
 			valueFiles.emplace_back(makeTemporaryFile("secret_"));
 			std::string outPath=valueFiles.back();
 			{
@@ -332,11 +331,11 @@ crow::response createSecret(PersistentStore& store, const crow::request& req){
 	         << " on behalf of " << user);
 	
 	//compose response
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	result.AddMember("apiVersion", "v1alpha3", alloc);
 	result.AddMember("kind", "Secret", alloc);
-	rapidjson::Value metadata(rapidjson::kObjectType);
+	RequestArena::Value metadata(rapidjson::kObjectType);
 	metadata.AddMember("id", secret.id, alloc);
 	metadata.AddMember("name", secret.name, alloc);
 	result.AddMember("metadata", metadata, alloc);
@@ -419,12 +418,13 @@ crow::response getSecret(PersistentStore& store, const crow::request& req,
 	
 	log_info("Sending " << secret << " to " << user);
 	
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena arena;
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha3", alloc);
 	result.AddMember("kind", "Secret", alloc);
-	rapidjson::Value metadata(rapidjson::kObjectType);
+	RequestArena::Value metadata(rapidjson::kObjectType);
 	metadata.AddMember("id", secret.id, alloc);
 	metadata.AddMember("name", secret.name, alloc);
 	metadata.AddMember("group", store.getGroup(secret.group).name, alloc);
@@ -432,7 +432,7 @@ crow::response getSecret(PersistentStore& store, const crow::request& req,
 	metadata.AddMember("created", secret.ctime, alloc);
 	result.AddMember("metadata", metadata, alloc);
 	
-	rapidjson::Document contents;
+	RequestArena::Document contents;
 	try{
 		auto secretData=store.decryptSecret(secret);
 		contents.Parse(secretData.data.get(), secretData.dataSize);
@@ -1,13 +1,175 @@
 #include "ServerUtilities.h"
 
-#include <boost/date_time/posix_time/posix_time.hpp>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <new>
+#include <type_traits>
 
 #include "Logging.h"
 #include "Process.h"
 
+namespace{
+	///The initial size of each thread's reusable arena buffer
+	const std::size_t initialArenaSize=64UL<<10;
+	///The largest size to which an arena buffer may grow. A request which needs
+	///more than the buffer holds spills into chunks allocated from the heap, 
+	///which are cleared and freed when the request completes; the buffer then
+	///grows, up to this size, for later requests. 
+	const std::size_t maxArenaSize=16UL<<20;
+	
+	///The space to leave in the arena buffer for the memory pool's bookkeeping
+	///header, which precedes the first chunk's data
+	const std::size_t chunkHeaderAllowance=64;
+	
+	///The backing state of a thread's RequestArena
+	struct ArenaState{
+		using Allocator=RequestArena::Allocator;
+		
+		std::unique_ptr<char[]> buffer;
+		std::size_t bufferSize=0;
+		///Serves the pool's first chunk from the buffer, and tracks any others
+		std::unique_ptr<ArenaChunkAllocator> chunks;
+		///Storage for the allocator, which is rebuilt in place for each request
+		typename std::aligned_storage<sizeof(Allocator),alignof(Allocator)>::type allocatorStorage;
+		Allocator* allocator=nullptr;
+		///The number of RequestArena objects currently alive on this thread
+		unsigned int depth=0;
+		
+		~ArenaState(){ destroyAllocator(); }
+		
+		void resizeBuffer(std::size_t size){
+			chunks.reset();
+			buffer.reset(new char[size]);
+			bufferSize=size;
+			chunks.reset(new ArenaChunkAllocator(buffer.get(),bufferSize));
+		}
+		
+		void createAllocator(){
+			allocator=new (&allocatorStorage) Allocator(bufferSize-chunkHeaderAllowance,chunks.get());
+		}
+		
+		///Return all chunks to the chunk allocator, which clears those which 
+		///spilled beyond the reusable buffer and frees them
+		void destroyAllocator(){
+			if(allocator)
+				allocator->~Allocator();
+			allocator=nullptr;
+		}
+	};
+	thread_local ArenaState arenaState;
+}
+
+ArenaChunkAllocator::~ArenaChunkAllocator(){
+	for(const auto& chunk : spilled){
+		insecure_memzero(chunk.first,chunk.second);
+		std::free(chunk.first);
+	}
+}
+
+void* ArenaChunkAllocator::Malloc(std::size_t size){
+	if(!size)
+		return nullptr;
+	if(buffer && !bufferInUse && size<=bufferSize){
+		bufferInUse=true;
+		return buffer;
+	}
+	spilled.reserve(spilled.size()+1);
+	void* chunk=std::malloc(size);
+	if(chunk)
+		spilled.emplace_back(chunk,size);
+	return chunk;
+}
+
+void* ArenaChunkAllocator::Realloc(void* originalPtr, std::size_t originalSize, std::size_t newSize){
+	if(!newSize){
+		Free(originalPtr);
+		return nullptr;
+	}
+	void* result=Malloc(newSize);
+	if(result && originalPtr){
+		std::memcpy(result,originalPtr,std::min(originalSize,newSize));
+		Free(originalPtr);
+	}
+	return result;
+}
+
+void ArenaChunkAllocator::Free(void* ptr){
+	if(!ptr)
+		return;
+	if(ptr==buffer){
+		//the owner of the buffer is responsible for clearing it, since only it
+		//knows how much was used
+		bufferInUse=false;
+		return;
+	}
+	for(auto it=spilled.begin(), end=spilled.end(); it!=end; ++it){
+		if(it->first==ptr){
+			insecure_memzero(it->first,it->second);
+			std::free(it->first);
+			spilled.erase(it);
+			return;
+		}
+	}
+}
+
+RequestArena::RequestArena(){
+	if(arenaState.depth++==0 && !arenaState.allocator){
+		arenaState.resizeBuffer(initialArenaSize);
+		arenaState.createAllocator();
+	}
+}
+
+RequestArena::~RequestArena(){
+	if(--arenaState.depth)
+		return;
+	const std::size_t used=arenaState.allocator->Size();
+	//Request bodies may contain sensitive data, like secrets, so do not leave
+	//them lying around in the buffer, or in the heap. The chunk allocator 
+	//clears any chunks which spilled into the heap as the pool frees them; of
+	//the buffer only the used part needs to be cleared, plus the pool's 
+	//bookkeeping header which precedes it. 
+	arenaState.destroyAllocator();
+	insecure_memzero(arenaState.buffer.get(),std::min(used+chunkHeaderAllowance,arenaState.bufferSize));
+	if(used>arenaState.bufferSize && arenaState.bufferSize<maxArenaSize){
+		//this request did not fit; make room for similar requests in the 
+		//future, as far as the limit allows
+		arenaState.resizeBuffer(std::min(std::max(used,2*arenaState.bufferSize),maxArenaSize));
+	}
+	arenaState.createAllocator();
+}
+
+RequestArena::Allocator& RequestArena::allocator(){
+	return *arenaState.allocator;
+}
+
+char* RequestArena::copyString(const std::string& str){
+	char* copy=static_cast<char*>(allocator().Malloc(str.size()+1));
+	std::copy(str.begin(),str.end(),copy);
+	copy[str.size()]='\0';
+	return copy;
+}
+
 std::string timestamp(){
-	auto now = boost::posix_time::second_clock::universal_time();
-	return to_simple_string(now)+" UTC";
+	return timestamp(std::time(nullptr));
+}
+
+std::string timestamp(std::time_t time){
+	//Formatting is comparatively expensive, and many messages are logged 
+	//within the same second, so remember the most recent result
+	thread_local std::time_t lastTime=-1;
+	thread_local std::string lastResult;
+	if(time!=lastTime){
+		std::tm parts;
+		gmtime_r(&time,&parts);
+		char buffer[32];
+		std::size_t length=std::strftime(buffer,sizeof(buffer),"%Y-%b-%d %H:%M:%S UTC",&parts);
+		lastResult.assign(buffer,length);
+		lastTime=time;
+	}
+	return lastResult;
 }
 
 std::string generateError(const std::string& message){
@@ -22,23 +184,91 @@ std::string generateError(const std::string& message){
 	return errBuffer.GetString();
 }
 
+std::string makeETag(const std::string& content){
+	//64-bit FNV-1a, which unlike std::hash is specified, and so is guaranteed 
+	//to give the same result in every process
+	std::uint64_t hash=0xcbf29ce484222325ULL;
+	for(unsigned char c : content){
+		hash^=c;
+		hash*=0x100000001b3ULL;
+	}
+	std::ostringstream ss;
+	ss << '"' << std::hex << std::setw(16) << std::setfill('0') << hash 
+	   << '-' << content.size() << '"';
+	return ss.str();
+}
+
+bool requestMatchesETag(const crow::request& req, const std::string& etag){
+	const std::string& header=req.get_header_value("If-None-Match");
+	if(header.empty())
+		return false;
+	//the header may contain a list of tags, any of which may be weak
+	for(std::string candidate : string_split_columns(header,',',false)){
+		candidate=trim(candidate);
+		if(candidate=="*")
+			return true;
+		if(candidate.compare(0,2,"W/")==0)
+			candidate.erase(0,2);
+		if(candidate==etag)
+			return true;
+	}
+	return false;
+}
+
+crow::response notModified(const std::string& etag){
+	crow::response response(304);
+	response.set_header("ETag",etag);
+	return response;
+}
+
+crow::response conditionalResponse(const crow::request& req, crow::response response){
+	if(response.code!=200)
+		return response;
+	const std::string etag=makeETag(response.body);
+	if(requestMatchesETag(req,etag))
+		return notModified(etag);
+	response.set_header("ETag",etag);
+	return response;
+}
+
 std::string unescape(const std::string& message){
-	std::string result = message;
-	std::vector<std::pair<std::string,std::string>> escaped;
-	escaped.push_back(std::make_pair("\\n", "\n"));
-	escaped.push_back(std::make_pair("\\t", "\t"));
-	escaped.push_back(std::make_pair("\\\\", "\\"));
-	escaped.push_back(std::make_pair("\\\"", "\""));
-
-	for (auto item : escaped){
-		auto replace = item.first;
-		auto found = result.find(replace);
-		while (found != std::string::npos){
-			result.replace(found, replace.length(), item.second);
-			found = result.find(replace);
+	//The escape sequences were historically replaced in successive passes over
+	//the whole string: \n, then \t, then \\ (repeatedly, so that any run of 
+	//backslashes collapses to one), then \". The effect of those passes on 
+	//each run of backslashes depends only on the run's length and on the 
+	//character after it, so a single scan reproduces them exactly. 
+	std::string result;
+	result.reserve(message.size());
+	const char* pos=message.data();
+	const char* const end=pos+message.size();
+	while(pos!=end){
+		const char* slash=(const char*)std::memchr(pos,'\\',end-pos);
+		if(!slash){
+			result.append(pos,end);
+			break;
+		}
+		result.append(pos,slash);
+		const char* runEnd=slash;
+		while(runEnd!=end && *runEnd=='\\')
+			runEnd++;
+		const std::size_t runLength=runEnd-slash;
+		pos=runEnd;
+		if(runEnd!=end && (*runEnd=='n' || *runEnd=='t')){
+			//the last backslash forms the escape sequence, and any others 
+			//collapse to one
+			if(runLength>1)
+				result+='\\';
+			result+=(*runEnd=='n' ? '\n' : '\t');
+			pos++;
 		}
+		else if(runEnd!=end && *runEnd=='"'){
+			//the run collapses to one backslash, which then escapes the quote
+			result+='"';
+			pos++;
+		}
+		else
+			result+='\\';
 	}
-	
 	return result;
 }
 
@@ -67,96 +297,31 @@ std::string shellEscapeSingleQuotes(const std::string& raw){
 }
 
 std::string reduceYAML(const std::string& input){
-	enum State{
-		def, //default, not in pure whitespace or a comment
-		whitespace, //a line which has so far only contained whitespace
-		comment,
-		newline //directly _after_ a newline character
-	} state=def;
-	std::size_t pos=0, last_handled=0, line=1;
+	//Lines which are empty, contain only whitespace, or contain only a comment
+	//are dropped, and comments are removed from the ends of other lines.
+	//The first line is treated as though it begins with text, so it is only
+	//dropped if it is empty or begins with a comment. 
 	std::string output;
-	for(char c : input){
-		switch(state){
-			case def:
-				if(c=='#'){
-					//std::cout << "Line " << line << ": start of comment" << std::endl;
-					state=comment;
-					if(pos>last_handled){
-						//std::cout << " Copying preceding data, pos=" << last_handled 
-						//          << " len=" << (pos-last_handled) << std::endl;
-						output+=input.substr(last_handled,pos-last_handled)+'\n';
-						last_handled=pos;
-					}
-				}
-				if(c=='\n'){
-					//std::cout << "Line " << line << ": end of line" << std::endl;
-					//std::cout << " Copying preceding data, pos=" << last_handled 
-					//          << " len=" << (pos-last_handled) << std::endl;
-					//copy this line, in case next turns out to be elidable
-					if(pos-last_handled) //if there was something there
-						output+=input.substr(last_handled,pos-last_handled)+'\n';
-					last_handled=pos;
-					state=newline;
-				}
-				break;
-			case whitespace:
-				if(c=='\n'){
-					//std::cout << "Line " << line << ": entire line was whitespace" << std::endl;
-					//whole line was whitespace, mark it handled so it will not be copied
-					last_handled=pos;
-					state=newline;
-				}
-				else if(c=='#'){
-					//std::cout << "Line " << line << ": transitioned from whitespace to comment" << std::endl;
-					state=comment;
-				}
-				else if(!std::isspace(c)){
-					//std::cout << "Line " << line << ": whitespace ended with " << (int)c << std::endl;
-					state=def;
-				}
-				break;
-			case comment:
-				//comments only end at newlines
-				if(c=='\n'){
-					//std::cout << "Line " << line << ": comment ended" << std::endl;
-					//mark everything in the last segment handled so it will not be copied
-					last_handled=pos;
-					state=newline;
-				}
-				break;
-			case newline:
-				line++;
-				last_handled=pos; //never explicitly copy newlines
-				if(c=='\n'){
-					state=newline;
-					//ignore empty line
-					last_handled=pos;
-					//std::cout << "Line " << line << ": is empty" << std::endl;
-				}
-				else if(std::isspace(c)){
-					state=whitespace;
-					//std::cout << "Line " << line << ": began with whitespace" << std::endl;
-				}
-				else if(c=='#'){
-					state=comment;
-					//std::cout << "Line " << line << ": began with comment" << std::endl;
-				}
-				else{
-					state=def;
-					//std::cout << "Line " << line << ": began with text" << std::endl;
-				}
-				break;
+	output.reserve(input.size());
+	const char* pos=input.data();
+	const char* const end=pos+input.size();
+	bool firstLine=true;
+	while(pos!=end){
+		const char* lineEnd=(const char*)std::memchr(pos,'\n',end-pos);
+		if(!lineEnd)
+			lineEnd=end;
+		const char* text=pos;
+		if(!firstLine){
+			while(text!=lineEnd && std::isspace((unsigned char)*text))
+				text++;
 		}
-		pos++;
-	}
-	if(state==def){
-		//std::cout << "Line " << line << ": implicit end of line (end of data)" << std::endl;
-		//std::cout << " Copying preceding data, pos=" << last_handled 
-		//          << " len=" << (pos-last_handled) << std::endl;
-		//copy this line, in case next turns out to be elidable
-		output+=input.substr(last_handled,pos-last_handled);
-		last_handled=pos;
-		state=newline;
+		if(text!=lineEnd && *text!='#'){
+			const char* comment=(const char*)std::memchr(text,'#',lineEnd-text);
+			output.append(pos,comment ? comment : lineEnd);
+			output+='\n';
+		}
+		firstLine=false;
+		pos=(lineEnd==end ? end : lineEnd+1);
 	}
 	//remove any trailing newline character
 	if(!output.empty() && output.back()=='\n')
@@ -164,6 +329,28 @@ std::string reduceYAML(const std::string& input){
 	return output;
 }
 
+std::string filterValuesFile(const std::string& data){
+	const static std::string startMarker="### SLATE-START ###";
+	const static std::string endMarker="### SLATE-END ###";
+	std::string output;
+	output.reserve(data.size());
+	std::size_t pos=0;
+	while(true){
+		std::size_t startPos=data.find(startMarker,pos);
+		if(startPos==std::string::npos)
+			break;
+		std::size_t endPos=data.find(endMarker,startPos);
+		if(endPos==std::string::npos){
+			log_error("Unbalanced SLATE-internal markers in values data");
+			break;
+		}
+		output.append(data,pos,startPos-pos);
+		pos=endPos+endMarker.size();
+	}
+	output.append(data,pos,std::string::npos);
+	return output;
+}
+
 std::string trim(const std::string &s){
     auto wsfront = std::find_if_not(s.begin(),s.end(),[](int c){return std::isspace(c);});
     auto wsback = std::find_if_not(s.rbegin(),s.rend(),[](int c){return std::isspace(c);}).base();
@@ -0,0 +1,166 @@
+#include "Tracing.h"
+
+#include <ctime>
+#include <deque>
+#include <mutex>
+
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+namespace tracing{
+
+namespace{
+
+thread_local RequestTrace* currentTrace=nullptr;
+
+struct SlowTraceRing{
+	static const std::size_t capacity=64;
+	std::mutex mutex;
+	std::deque<RequestTrace> traces;
+	Clock::duration threshold=std::chrono::seconds(1);
+};
+SlowTraceRing slowTraces;
+
+double milliseconds(Clock::duration d){
+	return std::chrono::duration_cast<std::chrono::duration<double,std::milli>>(d).count();
+}
+
+void writeTrace(rapidjson::Writer<rapidjson::StringBuffer>& writer, const RequestTrace& trace){
+	writer.StartObject();
+	writer.Key("route");
+	writer.String(trace.route.c_str(),trace.route.size());
+	writer.Key("target");
+	writer.String(trace.target.c_str(),trace.target.size());
+	writer.Key("status");
+	writer.Int(trace.status);
+	{
+		std::time_t start=std::chrono::system_clock::to_time_t(trace.wallStart);
+		std::tm parts;
+		gmtime_r(&start,&parts);
+		char buffer[32];
+		std::size_t length=std::strftime(buffer,sizeof(buffer),"%Y-%m-%dT%H:%M:%SZ",&parts);
+		writer.Key("start");
+		writer.String(buffer,length);
+	}
+	writer.Key("durationMilliseconds");
+	writer.Double(milliseconds(trace.duration));
+	writer.Key("spans");
+	writer.StartArray();
+	for(const auto& span : trace.spans){
+		writer.StartObject();
+		writer.Key("category");
+		writer.String(span.category);
+		writer.Key("operation");
+		writer.String(span.operation);
+		if(!span.detail.empty()){
+			writer.Key("detail");
+			writer.String(span.detail.c_str(),span.detail.size());
+		}
+		writer.Key("depth");
+		writer.Uint(span.depth);
+		writer.Key("offsetMilliseconds");
+		writer.Double(milliseconds(span.offset));
+		writer.Key("durationMilliseconds");
+		writer.Double(milliseconds(span.duration));
+		writer.EndObject();
+	}
+	writer.EndArray();
+	if(trace.droppedSpans){
+		writer.Key("droppedSpans");
+		writer.Uint64(trace.droppedSpans);
+	}
+	writer.Key("events");
+	writer.StartObject();
+	for(const auto& event : trace.events){
+		writer.Key(event.first.c_str(),event.first.size());
+		writer.Uint64(event.second);
+	}
+	writer.EndObject();
+	writer.EndObject();
+}
+
+} //anonymous namespace
+
+RequestTrace::RequestTrace(std::string route, std::string target):
+route(std::move(route)),target(std::move(target)),status(0),
+wallStart(std::chrono::system_clock::now()),start(Clock::now()),
+duration(Clock::duration::zero()),droppedSpans(0),depth(0){}
+
+void RequestTrace::finish(int status){
+	this->status=status;
+	duration=Clock::now()-start;
+}
+
+ActiveTrace::ActiveTrace(RequestTrace& trace):previous(currentTrace){
+	currentTrace=&trace;
+}
+
+ActiveTrace::~ActiveTrace(){
+	currentTrace=previous;
+}
+
+TraceSpan::TraceSpan(const char* category, const char* operation, const char* detail):
+trace(currentTrace){
+	if(!trace)
+		return;
+	start=Clock::now();
+	if(trace->spans.size()>=RequestTrace::maxSpans){
+		trace->droppedSpans++;
+		trace=nullptr;
+		return;
+	}
+	index=trace->spans.size();
+	trace->spans.push_back(Span{category,operation,detail,trace->depth,start-trace->start,Clock::duration::zero()});
+	trace->depth++;
+}
+
+TraceSpan::TraceSpan(const char* category, const char* operation, const std::string& detail):
+TraceSpan(category,operation,currentTrace ? detail.c_str() : ""){}
+
+TraceSpan::~TraceSpan(){
+	if(!trace)
+		return;
+	trace->spans[index].duration=Clock::now()-start;
+	trace->depth--;
+}
+
+void countTraceEvent(const char* name){
+	if(currentTrace)
+		currentTrace->events[name]++;
+}
+
+void setSlowThreshold(Clock::duration threshold){
+	std::lock_guard<std::mutex> lock(slowTraces.mutex);
+	slowTraces.threshold=threshold;
+}
+
+void offerSlowTrace(RequestTrace&& trace){
+	std::lock_guard<std::mutex> lock(slowTraces.mutex);
+	if(trace.duration<slowTraces.threshold)
+		return;
+	if(slowTraces.traces.size()==SlowTraceRing::capacity)
+		slowTraces.traces.pop_back();
+	slowTraces.traces.push_front(std::move(trace));
+}
+
+std::string slowTracesJSON(){
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	writer.StartObject();
+	writer.Key("apiVersion");
+	writer.String("v1alpha3");
+	writer.Key("kind");
+	writer.String("RequestTraceList");
+	std::lock_guard<std::mutex> lock(slowTraces.mutex);
+	writer.Key("thresholdMilliseconds");
+	writer.Double(milliseconds(slowTraces.threshold));
+	writer.Key("items");
+	writer.StartArray();
+	for(const auto& trace : slowTraces.traces)
+		writeTrace(writer,trace);
+	writer.EndArray();
+	writer.EndObject();
+	return buffer.GetString();
+}
+
+} //namespace tracing
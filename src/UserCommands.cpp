@@ -1,5 +1,6 @@
 #include "UserCommands.h"
 
+#include "EntitySerialization.h"
 #include "Logging.h"
 #include "ServerUtilities.h"
 
@@ -16,28 +17,15 @@ crow::response listUsers(PersistentStore& store, const crow::request& req){
 	else
 		users = store.listUsers();
 
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
-	
-	result.AddMember("apiVersion", "v1alpha3", alloc);
-	rapidjson::Value resultItems(rapidjson::kArrayType);
-	resultItems.Reserve(users.size(), alloc);
-	for(const User& user : users){
-		rapidjson::Value userResult(rapidjson::kObjectType);
-		userResult.AddMember("apiVersion", "v1alpha3", alloc);
-		userResult.AddMember("kind", "User", alloc);
-		rapidjson::Value userData(rapidjson::kObjectType);
-		userData.AddMember("id", rapidjson::StringRef(user.id.c_str()), alloc);
-		userData.AddMember("name", rapidjson::StringRef(user.name.c_str()), alloc);
-		userData.AddMember("email", rapidjson::StringRef(user.email.c_str()), alloc);
-		userData.AddMember("phone", rapidjson::StringRef(user.phone.c_str()), alloc);
-		userData.AddMember("institution", rapidjson::StringRef(user.institution.c_str()), alloc);
-		userResult.AddMember("metadata", userData, alloc);
-		resultItems.PushBack(userResult, alloc);
-	}
-	result.AddMember("items", resultItems, alloc);
-	
-	return crow::response(to_string(result));
+	crow::response response;
+	StringOutputStream stream(response.body);
+	JSONWriter writer(stream);
+	beginListResult(writer);
+	for(const User& user : users)
+		writeListFragment(writer, store.getUserListFragment(user));
+	endListResult(writer);
+	
+	return response;
 }
 
 crow::response createUser(PersistentStore& store, const crow::request& req){
@@ -55,7 +43,8 @@ crow::response createUser(PersistentStore& store, const crow::request& req){
 	}
 	
 	//unpack the target user info
-	rapidjson::Document body;
+	RequestArena arena;
+	RequestArena::Document body(&arena.allocator());
 	try{
 		body.Parse(req.body.c_str());
 	}catch(std::runtime_error& err){
@@ -149,11 +138,11 @@ crow::response createUser(PersistentStore& store, const crow::request& req){
 		return crow::response(500,generateError("User account creation failed"));
 	}
 
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha3", alloc);
-	rapidjson::Value metadata(rapidjson::kObjectType);
+	RequestArena::Value metadata(rapidjson::kObjectType);
 	metadata.AddMember("id", rapidjson::StringRef(targetUser.id.c_str()), alloc);
 	metadata.AddMember("name", rapidjson::StringRef(targetUser.name.c_str()), alloc);
 	metadata.AddMember("email", rapidjson::StringRef(targetUser.email.c_str()), alloc);
@@ -161,7 +150,7 @@ crow::response createUser(PersistentStore& store, const crow::request& req){
 	metadata.AddMember("institution", rapidjson::StringRef(targetUser.institution.c_str()), alloc);
 	metadata.AddMember("access_token", rapidjson::StringRef(targetUser.token.c_str()), alloc);
 	metadata.AddMember("admin", targetUser.admin, alloc);
-	rapidjson::Value vos(rapidjson::kArrayType);
+	RequestArena::Value vos(rapidjson::kArrayType);
 	metadata.AddMember("groups", vos, alloc);
 	result.AddMember("metadata", metadata, alloc);
 	
@@ -182,12 +171,13 @@ crow::response getUserInfo(PersistentStore& store, const crow::request& req, con
 	if(!targetUser)
 		return crow::response(404,generateError("Not found"));
 
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena arena;
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha3", alloc);
 	result.AddMember("kind", "User", alloc);
-	rapidjson::Value metadata(rapidjson::kObjectType);
+	RequestArena::Value metadata(rapidjson::kObjectType);
 	metadata.AddMember("id", rapidjson::StringRef(targetUser.id.c_str()), alloc);
 	metadata.AddMember("name", rapidjson::StringRef(targetUser.name.c_str()), alloc);
 	metadata.AddMember("email", rapidjson::StringRef(targetUser.email.c_str()), alloc);
@@ -195,10 +185,10 @@ crow::response getUserInfo(PersistentStore& store, const crow::request& req, con
 	metadata.AddMember("institution", rapidjson::StringRef(targetUser.institution.c_str()), alloc);
 	metadata.AddMember("access_token", rapidjson::StringRef(targetUser.token.c_str()), alloc);
 	metadata.AddMember("admin", targetUser.admin, alloc);
-	rapidjson::Value groupMemberships(rapidjson::kArrayType);
+	RequestArena::Value groupMemberships(rapidjson::kArrayType);
 	std::vector<std::string> groupMembershipList = store.getUserGroupMemberships(uID,true);
 	for (auto group : groupMembershipList) {
-		rapidjson::Value entry(rapidjson::kStringType);
+		RequestArena::Value entry(rapidjson::kStringType);
 		entry.SetString(group, alloc);
 		groupMemberships.PushBack(entry, alloc);
 	}
@@ -224,7 +214,8 @@ crow::response updateUser(PersistentStore& store, const crow::request& req, cons
 		return crow::response(404,generateError("User not found"));
 	
 	//unpack the target user info
-	rapidjson::Document body;
+	RequestArena arena;
+	RequestArena::Document body(&arena.allocator());
 	try{
 		body.Parse(req.body.c_str());
 	}catch(std::runtime_error& err){
@@ -321,17 +312,18 @@ crow::response listUsergroups(PersistentStore& store, const crow::request& req,
 	}
 	//TODO: can anyone list anyone else's Group memberships?
 
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena arena;
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha3", alloc);
-	rapidjson::Value groupMemberships(rapidjson::kArrayType);
+	RequestArena::Value groupMemberships(rapidjson::kArrayType);
 	std::vector<std::string> groupMembershipList = store.getUserGroupMemberships(uID,true);
 	for (auto groupName : groupMembershipList) {
-		rapidjson::Value entry(rapidjson::kObjectType);
+		RequestArena::Value entry(rapidjson::kObjectType);
 		entry.AddMember("apiVersion", "v1alpha3", alloc);
 		entry.AddMember("kind", "Group", alloc);
-		rapidjson::Value metadata(rapidjson::kObjectType);
+		RequestArena::Value metadata(rapidjson::kObjectType);
 		metadata.AddMember("name", groupName, alloc);
 		metadata.AddMember("id", store.findGroupByName(groupName).id, alloc);
 		entry.AddMember("metadata", metadata, alloc);
@@ -408,12 +400,13 @@ crow::response findUser(PersistentStore& store, const crow::request& req){
 	if(!targetUser)
 		return crow::response(404,generateError("User not found"));
 
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena arena;
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha3", alloc);
 	result.AddMember("kind", "User", alloc);
-	rapidjson::Value metadata(rapidjson::kObjectType);
+	RequestArena::Value metadata(rapidjson::kObjectType);
 	metadata.AddMember("id", rapidjson::StringRef(targetUser.id.c_str()), alloc);
 	metadata.AddMember("access_token", rapidjson::StringRef(targetUser.token.c_str()), alloc);
 	result.AddMember("metadata", metadata, alloc);
@@ -444,12 +437,13 @@ crow::response replaceUserToken(PersistentStore& store, const crow::request& req
 	if(!updated)
 		return crow::response(500,generateError("User account update failed"));
 	
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena arena;
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha3", alloc);
 	result.AddMember("kind", "User", alloc);
-	rapidjson::Value metadata(rapidjson::kObjectType);
+	RequestArena::Value metadata(rapidjson::kObjectType);
 	metadata.AddMember("id", updatedUser.id, alloc);
 	metadata.AddMember("access_token", updatedUser.token, alloc);
 	result.AddMember("metadata", metadata, alloc);
@@ -0,0 +1,167 @@
+#include "WorkerProcesses.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <thread>
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+	#include <sys/prctl.h>
+#endif
+
+#include "Logging.h"
+
+namespace{
+
+///The data which worker processes share with one another
+struct SharedWorkerState{
+	std::atomic<unsigned long long> storeGenerations[sharedStoreGenerationCount];
+	std::atomic<DatabaseInitialization> databaseInitialization;
+};
+static_assert(ATOMIC_LLONG_LOCK_FREE==2 && ATOMIC_INT_LOCK_FREE==2,
+              "Atomics shared between processes must be lock-free");
+
+SharedWorkerState* sharedState=nullptr;
+unsigned int thisWorkerIndex=0;
+
+struct WorkerRecord{
+	unsigned int index;
+	std::chrono::steady_clock::time_point started;
+};
+
+///Start a worker process
+///\param originalMask the signal mask to restore in the worker
+///\param supervisor the ID of the supervisor process
+///\param index the worker's position among the workers
+///\return the ID of the worker in the supervisor, and 0 in the worker
+pid_t startWorker(const sigset_t& originalMask, pid_t supervisor, unsigned int index){
+	pid_t child=fork();
+	if(child<0){
+		int err=errno;
+		log_fatal("Unable to start worker process: error " << err);
+	}
+	if(child==0){
+		thisWorkerIndex=index;
+		sigprocmask(SIG_SETMASK,&originalMask,nullptr);
+#ifdef __linux__
+		//do not outlive the supervisor
+		prctl(PR_SET_PDEATHSIG,SIGTERM);
+#endif
+		if(getppid()!=supervisor)
+			log_fatal("Supervisor process exited while starting worker");
+	}
+	return child;
+}
+
+std::string describeExit(int status){
+	if(WIFEXITED(status))
+		return "status "+std::to_string(WEXITSTATUS(status));
+	if(WIFSIGNALED(status))
+		return "signal "+std::to_string(WTERMSIG(status));
+	return "unknown cause";
+}
+
+} //anonymous namespace
+
+void runWorkerProcesses(unsigned int count){
+	void* memory=mmap(nullptr,sizeof(SharedWorkerState),PROT_READ|PROT_WRITE,
+	                  MAP_SHARED|MAP_ANONYMOUS,-1,0);
+	if(memory==MAP_FAILED){
+		int err=errno;
+		log_fatal("Unable to allocate memory shared by worker processes: error " << err);
+	}
+	sharedState=new(memory) SharedWorkerState;
+	for(auto& generation : sharedState->storeGenerations)
+		generation.store(0);
+	sharedState->databaseInitialization.store(DatabaseInitialization::Pending);
+	
+	//The supervisor handles signals synchronously. Blocking them before 
+	//starting workers also ensures that a signal arriving during startup is 
+	//not lost.
+	sigset_t handled, originalMask;
+	sigemptyset(&handled);
+	sigaddset(&handled,SIGINT);
+	sigaddset(&handled,SIGTERM);
+	sigaddset(&handled,SIGCHLD);
+	sigaddset(&handled,SIGUSR1);
+	sigaddset(&handled,SIGUSR2);
+	sigprocmask(SIG_BLOCK,&handled,&originalMask);
+	
+	typedef std::chrono::steady_clock Clock;
+	const pid_t supervisor=getpid();
+	std::map<pid_t,WorkerRecord> workers;
+	for(unsigned int i=0; i<count; i++){
+		pid_t worker=startWorker(originalMask,supervisor,i);
+		if(!worker)
+			return;
+		workers.emplace(worker,WorkerRecord{i,Clock::now()});
+	}
+	log_info("Started " << count << " worker processes");
+	
+	bool stopping=false;
+	while(!workers.empty()){
+		int signal=0;
+		if(sigwait(&handled,&signal)!=0)
+			continue;
+		if(signal==SIGINT || signal==SIGTERM){
+			if(!stopping)
+				log_info("Waiting for worker processes to finish");
+			stopping=true;
+			for(const auto& worker : workers)
+				kill(worker.first,SIGTERM);
+			continue;
+		}
+		if(signal==SIGUSR1 || signal==SIGUSR2){
+			//log level changes apply to all workers
+			for(const auto& worker : workers)
+				kill(worker.first,signal);
+			continue;
+		}
+		//collect all workers which have exited, since signals may coalesce
+		int status;
+		pid_t child;
+		while((child=waitpid(-1,&status,WNOHANG))>0){
+			auto it=workers.find(child);
+			if(it==workers.end())
+				continue;
+			const WorkerRecord record=it->second;
+			workers.erase(it);
+			if(stopping)
+				continue;
+			log_error("Worker process " << child << " exited unexpectedly with " 
+			          << describeExit(status) << "; restarting it");
+			//avoid restarting in a tight loop if workers fail immediately
+			if(Clock::now()-record.started<std::chrono::seconds(1))
+				std::this_thread::sleep_for(std::chrono::seconds(1));
+			pid_t worker=startWorker(originalMask,supervisor,record.index);
+			if(!worker)
+				return;
+			workers.emplace(worker,WorkerRecord{record.index,Clock::now()});
+		}
+	}
+	log_info("All worker processes have exited");
+	exit(0);
+}
+
+bool isWorkerProcess(){
+	return sharedState!=nullptr;
+}
+
+std::atomic<unsigned long long>* sharedStoreGeneration(std::size_t index){
+	if(!sharedState || index>=sharedStoreGenerationCount)
+		return nullptr;
+	return &sharedState->storeGenerations[index];
+}
+
+unsigned int workerIndex(){
+	return thisWorkerIndex;
+}
+
+std::atomic<DatabaseInitialization>* sharedDatabaseInitialization(){
+	return sharedState ? &sharedState->databaseInitialization : nullptr;
+}
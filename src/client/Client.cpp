@@ -6,6 +6,8 @@
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <set>
 #include <sstream>
 #include <stdexcept>
 #include <thread>
@@ -17,27 +19,209 @@
 
 #include "client_version.h"
 #include "Archive.h"
+#include "FileSystem.h"
 #include "Utilities.h"
 #include "Process.h"
 #include "OSDetection.h"
 
 namespace{
 	
-std::string makeTemporaryFile(const std::string& nameBase){
+std::string makeTemporaryDirectory(const std::string& nameBase){
 	std::string base=nameBase+"XXXXXXXX";
-	//make a modifiable copy for mkstemp to scribble over
-	std::unique_ptr<char[]> filePath(new char[base.size()+1]);
-	strcpy(filePath.get(),base.c_str());
-	struct fdHolder{
-		int fd;
-		~fdHolder(){ close(fd); }
-	} fd{mkstemp(filePath.get())};
-	if(fd.fd==-1){
+	//make a modifiable copy for mkdtemp to scribble over
+	std::unique_ptr<char[]> dirPath(new char[base.size()+1]);
+	strcpy(dirPath.get(),base.c_str());
+	if(!mkdtemp(dirPath.get())){
 		int err=errno;
-		throw std::runtime_error("Creating temporary file failed with error " + std::to_string(err));
+		throw std::runtime_error("Creating temporary directory failed with error " + std::to_string(err));
 	}
-	return filePath.get();
+	return dirPath.get();
 }
+
+///Extracts the value of the top-level "logs" member of a JSON document as the
+///document arrives, and writes it to a stream, so that long logs are printed 
+///progressively. Other members are skipped. 
+class LogPrinter{
+public:
+	explicit LogPrinter(std::ostream& out):
+	out(out),state(Structure),depth(0),expectingKey(false),
+	awaitingLogs(false),escaped(false),hexDigits(0),codeUnit(0),highSurrogate(0),
+	found(false),lastChar('\n'){}
+	
+	///Process the next portion of the document
+	void consume(const char* data, std::size_t length){
+		std::string decoded;
+		for(std::size_t i=0; i<length; i++){
+			const char c=data[i];
+			if(state==Structure)
+				structureChar(c);
+			else if(escaped || hexDigits)
+				escapeChar(c,decoded);
+			else if(c=='\\')
+				escaped=true;
+			else if(c=='"')
+				endString();
+			else if(state==Logs)
+				decoded+=c;
+			else if(state==Key)
+				key+=c;
+		}
+		if(!decoded.empty()){
+			out << decoded;
+			out.flush();
+			lastChar=decoded.back();
+		}
+	}
+	
+	///\return whether the complete logs member has been printed
+	bool complete() const{ return found; }
+	///\return whether the logs printed so far end with a newline
+	bool endsWithNewline() const{ return lastChar=='\n'; }
+	
+private:
+	enum State{Structure,Key,OtherString,Logs};
+	
+	std::ostream& out;
+	State state;
+	unsigned int depth;
+	///Whether the next string at the top level is a member name
+	bool expectingKey;
+	///Whether the next string at the top level is the logs
+	bool awaitingLogs;
+	std::string key;
+	bool escaped;
+	///The number of hexadecimal digits remaining in a \\u escape
+	unsigned int hexDigits;
+	uint32_t codeUnit;
+	///The first half of a UTF-16 surrogate pair, if one is pending
+	uint32_t highSurrogate;
+	bool found;
+	char lastChar;
+	
+	void structureChar(char c){
+		switch(c){
+			case '{':
+			case '[':
+				if(++depth==1)
+					expectingKey=(c=='{');
+				break;
+			case '}':
+			case ']':
+				depth--;
+				break;
+			case ':':
+				if(depth==1)
+					awaitingLogs=(key=="logs");
+				break;
+			case ',':
+				if(depth==1){
+					expectingKey=true;
+					awaitingLogs=false;
+				}
+				break;
+			case '"':
+				if(depth==1 && expectingKey){
+					state=Key;
+					key.clear();
+				}
+				else if(depth==1 && awaitingLogs)
+					state=Logs;
+				else
+					state=OtherString;
+				break;
+		}
+	}
+	
+	void endString(){
+		if(state==Key)
+			expectingKey=false;
+		else if(state==Logs)
+			found=true;
+		state=Structure;
+		awaitingLogs=false;
+	}
+	
+	void escapeChar(char c, std::string& decoded){
+		if(hexDigits){
+			codeUnit=(codeUnit<<4) | hexValue(c);
+			if(--hexDigits==0 && state==Logs)
+				appendCodeUnit(codeUnit,decoded);
+			return;
+		}
+		escaped=false;
+		if(state!=Logs){
+			if(c=='u')
+				startUnicodeEscape();
+			else if(state==Key)
+				key+=c;
+			return;
+		}
+		switch(c){
+			case 'b': decoded+='\b'; break;
+			case 'f': decoded+='\f'; break;
+			case 'n': decoded+='\n'; break;
+			case 'r': decoded+='\r'; break;
+			case 't': decoded+='\t'; break;
+			case 'u': startUnicodeEscape(); break;
+			default: decoded+=c; //quote, backslash, or slash
+		}
+	}
+	
+	void startUnicodeEscape(){
+		hexDigits=4;
+		codeUnit=0;
+	}
+	
+	static uint32_t hexValue(char c){
+		if(c>='0' && c<='9')
+			return c-'0';
+		if(c>='a' && c<='f')
+			return c-'a'+10;
+		if(c>='A' && c<='F')
+			return c-'A'+10;
+		throw std::runtime_error("Invalid unicode escape in server response");
+	}
+	
+	///Decode a UTF-16 code unit from an escape sequence to UTF-8
+	void appendCodeUnit(uint32_t unit, std::string& decoded){
+		if(unit>=0xD800 && unit<0xDC00){
+			if(highSurrogate)
+				appendCodePoint(0xFFFD,decoded);
+			highSurrogate=unit;
+			return;
+		}
+		if(unit>=0xDC00 && unit<0xE000 && highSurrogate){
+			appendCodePoint(0x10000+((highSurrogate-0xD800)<<10)+(unit-0xDC00),decoded);
+			highSurrogate=0;
+			return;
+		}
+		if(highSurrogate){
+			appendCodePoint(0xFFFD,decoded);
+			highSurrogate=0;
+		}
+		appendCodePoint(unit,decoded);
+	}
+	
+	static void appendCodePoint(uint32_t cp, std::string& decoded){
+		if(cp<0x80)
+			decoded+=(char)cp;
+		else if(cp<0x800){
+			decoded+=(char)(0xC0|(cp>>6));
+			decoded+=(char)(0x80|(cp&0x3F));
+		}
+		else if(cp<0x10000){
+			decoded+=(char)(0xE0|(cp>>12));
+			decoded+=(char)(0x80|((cp>>6)&0x3F));
+			decoded+=(char)(0x80|(cp&0x3F));
+		}
+		else{
+			decoded+=(char)(0xF0|(cp>>18));
+			decoded+=(char)(0x80|((cp>>12)&0x3F));
+			decoded+=(char)(0x80|((cp>>6)&0x3F));
+			decoded+=(char)(0x80|(cp&0x3F));
+		}
+	}
+};
 	
 ///Insert newlines and copies of indent to make orig fit in the given maximum 
 ///width. Does not indent the first line. Will do the wrong thing with 
@@ -71,6 +255,104 @@ std::string wrapWithIndent(const std::string orig, const std::string& indent, co
 	}
 	return result;
 }
+
+///A single operation read from the input to a batch command
+struct BatchOperation{
+	///The number of the input line from which the operation was read
+	std::size_t line;
+	///The text of the operation, for reporting its result
+	std::string description;
+	///The HTTP method used to carry out the operation
+	std::string method;
+	///The API path of the operation, relative to the API version
+	std::string path;
+	///Any query parameters other than the token, each preceded by '&'
+	std::string query;
+};
+
+///Translate the words of one line of batch input into the API request it 
+///represents. The supported operations mirror the corresponding client 
+///commands, which must not require a request body. 
+///\param words the words of the line, with the leading 'slate' omitted
+///\param line the number of the input line
+///\return the operation
+///\throws std::runtime_error if the words do not form a supported operation
+BatchOperation parseBatchOperation(std::vector<std::string> words, std::size_t line){
+	BatchOperation op;
+	op.line=line;
+	for(const auto& word : words)
+		op.description+=(op.description.empty()?"":" ")+word;
+	//remove any force flags, recording whether one was present
+	bool force=false;
+	auto flagEnd=std::remove_if(words.begin(),words.end(),
+	  [](const std::string& word){ return word=="-f" || word=="--force"; });
+	if(flagEnd!=words.end()){
+		force=true;
+		words.erase(flagEnd,words.end());
+	}
+	
+	auto expect=[&](std::size_t arguments){
+		if(words.size()!=arguments+2)
+			throw std::runtime_error("'"+op.description+"' requires "
+			  +std::to_string(arguments)+" argument"+(arguments==1?"":"s"));
+	};
+	auto forbidForce=[&](){
+		if(force)
+			throw std::runtime_error("'"+op.description+"' does not accept --force");
+	};
+	if(words.size()<2)
+		throw std::runtime_error("Unrecognized batch operation: '"+op.description+"'");
+	const std::string& noun=words[0], verb=words[1];
+	if(noun=="group" && verb=="delete"){
+		expect(1); forbidForce();
+		op.method="DELETE";
+		op.path="groups/"+words[2];
+	}
+	else if(noun=="cluster" && verb=="delete"){
+		expect(1);
+		op.method="DELETE";
+		op.path="clusters/"+words[2];
+		if(force)
+			op.query="&force";
+	}
+	else if(noun=="cluster" && (verb=="allow-group" || verb=="deny-group")){
+		expect(2); forbidForce();
+		op.method=(verb=="allow-group"?"PUT":"DELETE");
+		op.path="clusters/"+words[2]+"/allowed_groups/"+words[3];
+	}
+	else if(noun=="cluster" && (verb=="allow-group-app" || verb=="deny-group-app")){
+		expect(3); forbidForce();
+		op.method=(verb=="allow-group-app"?"PUT":"DELETE");
+		op.path="clusters/"+words[2]+"/allowed_groups/"+words[3]+"/applications/"+words[4];
+	}
+	else if(noun=="cluster" && verb=="ping"){
+		expect(1); forbidForce();
+		op.method="GET";
+		op.path="clusters/"+words[2]+"/ping";
+	}
+	else if(noun=="instance" && verb=="delete"){
+		expect(1);
+		op.method="DELETE";
+		op.path="instances/"+words[2];
+		if(force)
+			op.query="&force";
+	}
+	else if(noun=="instance" && verb=="restart"){
+		expect(1); forbidForce();
+		op.method="PUT";
+		op.path="instances/"+words[2]+"/restart";
+	}
+	else if(noun=="secret" && verb=="delete"){
+		expect(1);
+		op.method="DELETE";
+		op.path="secrets/"+words[2];
+		if(force)
+			op.query="&force";
+	}
+	else
+		throw std::runtime_error("Unrecognized batch operation: '"+op.description+"'");
+	return op;
+}
 	
 } //anonymous namespace
 
@@ -674,10 +956,11 @@ std::string Client::formatOutput(const rapidjson::Value& jdata, const rapidjson:
 }
 
 Client::Client(bool useANSICodes, std::size_t outputWidth):
+pman_(),
 apiVersion("v1alpha3"),
 useANSICodes(useANSICodes),
 outputWidth(outputWidth),
-pman_()
+responseCacheUnavailable(false)
 {
 	if(isatty(STDOUT_FILENO)){
 		if(!this->outputWidth){ //determine width to use automatically
@@ -832,32 +1115,31 @@ void Client::upgrade(const upgradeOptions& options){
 	else
 		std::cout << "assuming yes" << std::endl;
 	
-	//download the new version
+	//download the new version, decompressing and extracting it as it arrives. 
+	//It is placed next to the current executable, so that it can be moved 
+	//into place without crossing filesystems. 
+	const std::string executablePath=program_location();
+	const std::string extractDir=makeTemporaryDirectory(executablePath+"-upgrade-");
+	struct DirCleaner{
+		const std::string& path;
+		~DirCleaner(){ recursivelyDestroyDirectory(path); }
+	} cleaner{extractDir};
+	GzippedTarballExtractor extractor(extractDir);
 	progress.start("Downloading latest version...");
-	auto response=httpRequests::httpGet(downloadURL,defaultOptions());
+	auto response=httpRequests::httpGetStreaming(downloadURL,[&extractor](const char* data, std::size_t length){
+		extractor.consume(data,length);
+	},defaultOptions());
 	progress.end();
 	if(response.status!=200)
 		throw std::runtime_error("Failed to download new version archive: error "+std::to_string(response.status));
-	//decompress and extract from gzipped tarball
-	std::istringstream compressed(response.body);
-	std::stringstream decompressed;
-	gzipDecompress(compressed, decompressed);
-	//extractFromUStar(decompressed,"slate",tmpLoc);
-	TarReader tr(decompressed);
-	auto tmpLoc=makeTemporaryFile("");
-	std::ofstream outfile(tmpLoc);
-	auto datastream=tr.streamForFile("slate");
-	std::copy(std::istreambuf_iterator<char>(datastream->rdbuf()),
-	          std::istreambuf_iterator<char>(),
-	          std::ostreambuf_iterator<char>(outfile));
-	outfile.close();
-	int res=chmod(tmpLoc.c_str(),tr.modeForFile("slate"));
-	if(res!=0){
-		res=errno;
-		throw std::runtime_error("Failed to set mode of new executable: error "+std::to_string(res));
-	}
+	extractor.finish();
+	//the extractor preserves the executable's mode from the archive
+	const std::string newExecutable=extractDir+"/slate";
+	struct stat info;
+	if(lstat(newExecutable.c_str(),&info)!=0 || !S_ISREG(info.st_mode))
+		throw std::runtime_error("New version archive does not contain an executable");
 	//this step overwrites the current executable if successful!
-	res=rename(tmpLoc.c_str(),program_location().c_str());
+	int res=rename(newExecutable.c_str(),executablePath.c_str());
 	if(res!=0){
 		res=errno;
 		throw std::runtime_error("Failed to replace current executable with new version: error "+std::to_string(res));
@@ -969,7 +1251,7 @@ void Client::deleteGroup(const GroupDeleteOptions& opt){
 void Client::getGroupInfo(const GroupInfoOptions& opt){
 	ProgressToken progress(pman_,"Fetching group info...");
 	auto url = makeURL("groups/"+opt.groupName);
-	auto response=httpRequests::httpGet(url,defaultOptions());
+	auto response=httpRequests::httpGet(url,cachedOptions());
 	if(response.status==200){
 		rapidjson::Document json;
 		json.Parse(response.body.c_str());
@@ -994,7 +1276,7 @@ void Client::listGroups(const GroupListOptions& opt){
 	auto url = makeURL("groups");
 	if (opt.user)
 		url += "&user=true";
-	auto response=httpRequests::httpGet(url,defaultOptions());
+	auto response=httpRequests::httpGet(url,cachedOptions());
 	//TODO: handle errors, make output nice
 	if(response.status==200){
 		rapidjson::Document json;
@@ -1147,7 +1429,7 @@ void Client::listClusters(const ClusterListOptions& opt){
 	if(!opt.group.empty())
 		url+="&group="+opt.group;
 	ProgressToken progress(pman_,"Fetching cluster list...");
-	auto response=httpRequests::httpGet(url,defaultOptions());
+	auto response=httpRequests::httpGet(url,cachedOptions());
 	//TODO: handle errors, make output nice
 	if(response.status==200){
 		rapidjson::Document json;
@@ -1166,7 +1448,7 @@ void Client::listClusters(const ClusterListOptions& opt){
 void Client::getClusterInfo(const ClusterInfoOptions& opt){
 	auto url = makeURL("clusters/"+opt.clusterName);
 	ProgressToken progress(pman_,"Fetching cluster info...");
-	auto response=httpRequests::httpGet(url,defaultOptions());
+	auto response=httpRequests::httpGet(url,cachedOptions());
 	if(response.status==200){
 		rapidjson::Document json;
 		json.Parse(response.body.c_str());
@@ -1310,22 +1592,39 @@ void Client::denyGroupUseOfApplication(const GroupClusterAppUseOptions& opt){
 
 void Client::pingCluster(const ClusterPingOptions& opt){
 	ProgressToken progress(pman_,"Testing cluster connectivity...");
-	auto response=httpRequests::httpGet(makeURL("clusters/"+opt.clusterName+"/ping"),defaultOptions());
-	if(this->clientShouldPrintOnlyJson())
-		std::cout << response.body << std::endl;
-	else{
-		if(response.status==200){
-			rapidjson::Document json;
-			json.Parse(response.body.c_str());
-			if(!json.HasMember("reachable") || !json["reachable"].IsBool())
-				std::cout << "Got invalid response: " << response.body << std::endl;
-				std::cout << "Cluster " << opt.clusterName 
-				  << (json["reachable"].GetBool()?" is":" is not") 
-				  << " reachable" << std::endl;
+	//each check may take several seconds, so make them concurrently
+	std::vector<httpRequests::Request> requests;
+	for(const auto& clusterName : opt.clusterNames)
+		requests.push_back({httpRequests::Request::Method::Get,
+		                    makeURL("clusters/"+clusterName+"/ping"),"",defaultOptions()});
+	auto results=httpRequests::httpBatch(requests);
+	for(std::size_t i=0; i<results.size(); i++){
+		const std::string& clusterName=opt.clusterNames[i];
+		httpRequests::Response response;
+		try{
+			response=results[i].get();
+		}catch(std::runtime_error& err){
+			std::cerr << "Failed to check connectivity of cluster " << clusterName
+			  << ": " << err.what() << std::endl;
+			continue;
 		}
+		if(this->clientShouldPrintOnlyJson())
+			std::cout << response.body << std::endl;
 		else{
-			std::cerr << "Failed check cluster connectivity";
-			showError(response.body);
+			if(response.status==200){
+				rapidjson::Document json;
+				json.Parse(response.body.c_str());
+				if(!json.IsObject() || !json.HasMember("reachable") || !json["reachable"].IsBool())
+					std::cout << "Got invalid response: " << response.body << std::endl;
+				else
+					std::cout << "Cluster " << clusterName 
+					  << (json["reachable"].GetBool()?" is":" is not") 
+					  << " reachable" << std::endl;
+			}
+			else{
+				std::cerr << "Failed to check connectivity of cluster " << clusterName;
+				showError(response.body);
+			}
 		}
 	}
 }
@@ -1337,7 +1636,7 @@ void Client::listApplications(const ApplicationOptions& opt){
 		url+="&dev";
 	if(opt.testRepo)
 		url+="&test";
-	auto response=httpRequests::httpGet(url,defaultOptions());
+	auto response=httpRequests::httpGet(url,cachedOptions());
 	//TODO: handle errors, make output nice
 	if(response.status==200){
 		rapidjson::Document json;
@@ -1362,7 +1661,7 @@ void Client::getApplicationConf(const ApplicationConfOptions& opt){
 	if(opt.testRepo)
 		url+="&test";
 
-	auto response=httpRequests::httpGet(url,defaultOptions());
+	auto response=httpRequests::httpGet(url,cachedOptions());
 	//TODO: other output formats
 	if(response.status==200){
 		rapidjson::Document resultJSON;
@@ -1392,7 +1691,7 @@ void Client::getApplicationDocs(const ApplicationConfOptions& opt){
 	if(opt.testRepo)
 		url+="&test";
 
-	auto response=httpRequests::httpGet(url,defaultOptions());
+	auto response=httpRequests::httpGet(url,cachedOptions());
 	//TODO: other output formats
 	if(response.status==200){
 		rapidjson::Document resultJSON;
@@ -1452,16 +1751,6 @@ void Client::installApplication(const ApplicationInstallOptions& opt){
 			//TODO: verify that the file is a directory, has the structure 
 			//of a helm chart, etc.
 		}
-		std::stringstream tarBuffer,gzipBuffer;
-		TarWriter tw(tarBuffer);
-		std::string dirPath=opt.appName;
-		while(dirPath.size()>1 && dirPath.back()=='/') //strip trailing slashes
-			dirPath=dirPath.substr(0,dirPath.size()-1);
-		recursivelyArchive(dirPath,tw,true);
-		tw.endStream();
-		gzipCompress(tarBuffer,gzipBuffer);
-		std::string encodedChart=encodeBase64(gzipBuffer.str());
-		request.AddMember("chart",encodedChart,alloc);
 	}
 	
 	std::string url;
@@ -1478,7 +1767,33 @@ void Client::installApplication(const ApplicationInstallOptions& opt){
 	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
 	request.Accept(writer);
 
-	auto response=httpRequests::httpPost(url,buffer.GetString(),defaultOptions());
+	httpRequests::Response response;
+	if(opt.fromLocalChart){
+		std::string dirPath=opt.appName;
+		while(dirPath.size()>1 && dirPath.back()=='/') //strip trailing slashes
+			dirPath=dirPath.substr(0,dirPath.size()-1);
+		//The chart is archived, compressed, and encoded as it is sent, so 
+		//that no complete copy of it is held in memory. It is spliced into 
+		//the JSON document as the final member, which is safe because base64 
+		//data needs no escaping.
+		std::string prefix(buffer.GetString(),buffer.GetSize());
+		prefix.pop_back(); //remove the closing brace
+		prefix+=",\"chart\":\"";
+		response=httpRequests::httpPostStreaming(url,[&](std::ostream& body){
+			body << prefix;
+			Base64OutputStream encoder(body);
+			//compression is the slowest stage, so spread it over all cores
+			GzipOutputStream compressor(encoder,0);
+			TarWriter tw(compressor);
+			recursivelyArchive(dirPath,tw,true);
+			tw.endStream();
+			compressor.finish();
+			encoder.finish();
+			body << "\"}";
+		},defaultOptions());
+	}
+	else
+		response=httpRequests::httpPost(url,buffer.GetString(),defaultOptions());
 	
 	//TODO: other output formats
 	if(response.status==200){
@@ -1780,25 +2095,40 @@ void Client::fetchInstanceLogs(const InstanceLogOptions& opt){
 		url+="&container="+opt.container;
 	if(opt.previousLogs)
 		url+="&previous";
-	auto response=httpRequests::httpGet(url,defaultOptions());
-	if(response.status==200){
-		rapidjson::Document body;
-		body.Parse(response.body.c_str());
-		auto ptr=rapidjson::Pointer("/logs").Get(body);
-		if(ptr==NULL)
-			throw std::runtime_error("Failed to extract log data from server response");
-		if (clientShouldPrintOnlyJson()){
+	httpRequests::Response response;
+	if (clientShouldPrintOnlyJson()){
+		response=httpRequests::httpGet(url,defaultOptions());
+		if(response.status==200){
+			rapidjson::Document body;
+			body.Parse(response.body.c_str());
+			auto ptr=rapidjson::Pointer("/logs").Get(body);
+			if(ptr==NULL)
+				throw std::runtime_error("Failed to extract log data from server response");
 			std::cout << formatOutput(body, body, {{"Logs","/logs"}});
-		}else{
-			std::string logData=ptr->GetString();
-			std::cout << logData;
-			if(!logData.empty() && logData.back()!='\n') std::cout << '\n';
+			return;
 		}
 	}
 	else{
-		std::cerr << "Failed to get application instance logs";
-		showError(response.body);
+		//print the logs as they arrive, rather than waiting for all of them
+		LogPrinter printer(std::cout);
+		bool receiving=false;
+		response=httpRequests::httpGetStreaming(url,[&](const char* data, std::size_t length){
+			if(!receiving){ //stop the progress display before printing
+				progress.end();
+				receiving=true;
+			}
+			printer.consume(data,length);
+		},defaultOptions());
+		if(response.status==200){
+			if(!printer.complete())
+				throw std::runtime_error("Failed to extract log data from server response");
+			if(!printer.endsWithNewline())
+				std::cout << '\n';
+			return;
+		}
 	}
+	std::cerr << "Failed to get application instance logs";
+	showError(response.body);
 }
 
 void Client::listSecrets(const SecretListOptions& opt){
@@ -2016,6 +2346,154 @@ void Client::deleteSecret(const SecretDeleteOptions& opt){
 	}
 }
 
+void Client::runBatch(const BatchOptions& opt){
+	//the number of times to resend a bundle which the server asks to be retried
+	const unsigned int maxBatchRetries=10;
+	if(opt.bundleSize==0)
+		throw std::runtime_error("The batch bundle size must be at least 1");
+	
+	std::ifstream inputFile;
+	if(opt.inputPath!="-"){
+		inputFile.open(opt.inputPath);
+		if(!inputFile)
+			throw std::runtime_error("Unable to read "+opt.inputPath);
+	}
+	std::istream& input=(opt.inputPath=="-"?std::cin:inputFile);
+	
+	//read and check every operation before sending any of them, so that a 
+	//mistake late in the input does not leave the work half done
+	std::vector<BatchOperation> operations;
+	std::string line;
+	std::size_t lineNumber=0;
+	while(std::getline(input,line)){
+		lineNumber++;
+		std::istringstream ss(line.substr(0,line.find('#')));
+		std::vector<std::string> words{std::istream_iterator<std::string>(ss),
+		                               std::istream_iterator<std::string>()};
+		if(words.empty())
+			continue;
+		if(words.front()=="slate")
+			words.erase(words.begin());
+		try{
+			operations.push_back(parseBatchOperation(std::move(words),lineNumber));
+		}catch(std::runtime_error& err){
+			throw std::runtime_error("Line "+std::to_string(lineNumber)+": "+err.what());
+		}
+	}
+	
+	ProgressToken progress(pman_,"Running batch operations...");
+	const std::string token=getToken();
+	auto requestKey=[&](const BatchOperation& op){
+		return "/"+apiVersion+"/"+op.path+"?token="+token+op.query;
+	};
+	
+	rapidjson::Document results(rapidjson::kArrayType);
+	auto& alloc=results.GetAllocator();
+	std::size_t failures=0;
+	auto report=[&](const BatchOperation& op, unsigned int status, const std::string& body){
+		if(status!=200)
+			failures++;
+		if(clientShouldPrintOnlyJson()){
+			rapidjson::Value result(rapidjson::kObjectType);
+			result.AddMember("line",rapidjson::Value(uint64_t(op.line)),alloc);
+			result.AddMember("operation",rapidjson::Value(op.description,alloc),alloc);
+			result.AddMember("status",status,alloc);
+			result.AddMember("body",rapidjson::Value(body,alloc),alloc);
+			results.PushBack(result,alloc);
+		}
+		else if(status==200)
+			std::cout << "Succeeded: " << op.description << std::endl;
+		else{
+			std::cerr << "Failed: " << op.description;
+			showError(body);
+		}
+	};
+	
+	std::size_t next=0;
+	while(next<operations.size()){
+		//The server keys both requests and results by URL, so a bundle cannot 
+		//contain the same request twice; a repeated operation starts the next one.
+		//Operations within a bundle are executed concurrently, so repeating one
+		//is also the only way to ask for operations to be ordered. 
+		std::size_t end=next;
+		std::set<std::string> keys;
+		while(end<operations.size() && end-next<opt.bundleSize 
+		      && keys.insert(requestKey(operations[end])).second)
+			end++;
+		pman_.SetProgress((float)next/operations.size());
+		
+		//The server may turn away the whole bundle, or individual operations 
+		//within it, because it is busy or the token's budget is exhausted, in 
+		//which case it says when to try again, and those operations are resent
+		std::vector<std::size_t> pending;
+		for(std::size_t i=next; i<end; i++)
+			pending.push_back(i);
+		for(unsigned int attempt=0; !pending.empty(); attempt++){
+			const bool mayRetry=attempt<maxBatchRetries;
+			rapidjson::Document bundle(rapidjson::kObjectType);
+			for(std::size_t i : pending){
+				rapidjson::Value request(rapidjson::kObjectType);
+				request.AddMember("method",rapidjson::Value(operations[i].method,bundle.GetAllocator()),bundle.GetAllocator());
+				bundle.AddMember(rapidjson::Value(requestKey(operations[i]),bundle.GetAllocator()),
+				                 request,bundle.GetAllocator());
+			}
+			rapidjson::StringBuffer buffer;
+			rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+			bundle.Accept(writer);
+			auto response=httpRequests::httpPost(makeURL("multiplex"),buffer.GetString(),defaultOptions());
+			
+			std::vector<std::size_t> deferred;
+			unsigned long retryAfter=1;
+			if(mayRetry && (response.status==429 || response.status==503)){
+				deferred=pending;
+				retryAfter=std::max(response.retryAfter,retryAfter);
+			}
+			else{
+				rapidjson::Document resultJSON;
+				if(response.status==200)
+					resultJSON.Parse(response.body.c_str());
+				for(std::size_t i : pending){
+					const BatchOperation& op=operations[i];
+					if(response.status!=200){
+						report(op,response.status,response.body);
+						continue;
+					}
+					std::string key=requestKey(op);
+					if(!resultJSON.IsObject() || !resultJSON.HasMember(key) || !resultJSON[key].IsObject()
+					   || !resultJSON[key].HasMember("status") || !resultJSON[key]["status"].IsUint()
+					   || !resultJSON[key].HasMember("body") || !resultJSON[key]["body"].IsString()){
+						report(op,0,"No valid result returned by the server");
+						continue;
+					}
+					const rapidjson::Value& result=resultJSON[key];
+					const unsigned int status=result["status"].GetUint();
+					if(mayRetry && (status==429 || status==503)){
+						deferred.push_back(i);
+						if(result.HasMember("retryAfter") && result["retryAfter"].IsUint64())
+							retryAfter=std::max<unsigned long>(result["retryAfter"].GetUint64(),retryAfter);
+						continue;
+					}
+					report(op,status,std::string(result["body"].GetString(),result["body"].GetStringLength()));
+				}
+			}
+			if(!deferred.empty())
+				std::this_thread::sleep_for(std::chrono::seconds(retryAfter));
+			pending=std::move(deferred);
+		}
+		next=end;
+	}
+	
+	if(clientShouldPrintOnlyJson()){
+		rapidjson::StringBuffer buffer;
+		rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+		results.Accept(writer);
+		std::cout << buffer.GetString() << std::endl;
+	}
+	if(failures)
+		throw std::runtime_error(std::to_string(failures)+" of "+std::to_string(operations.size())
+		                         +" batch operations failed");
+}
+
 std::string Client::getDefaultEndpointFilePath(){
 	std::string path=getHomeDirectory();
 	path+=".slate/endpoint";
@@ -2127,8 +2605,35 @@ std::string Client::getEndpoint(){
 	return apiEndpoint;
 }
 
+httpRequests::ResponseCache* Client::getResponseCache(){
+	if(!responseCache && !responseCacheUnavailable){
+		//keep the cache alongside the credentials whose responses it holds
+		std::string path=(credentialPath.empty() ? getDefaultCredFilePath() : credentialPath);
+		const std::size_t sep=path.rfind('/');
+		path=(sep==std::string::npos ? std::string(".") : path.substr(0,sep))+"/cache";
+		try{
+			responseCache.reset(new httpRequests::ResponseCache(path));
+		}catch(std::runtime_error&){
+			//the cache is only an optimization
+			responseCacheUnavailable=true;
+		}
+	}
+	return responseCache.get();
+}
+
+httpRequests::Options Client::cachedOptions(){
+	//long enough to cover a script's burst of commands, short enough that 
+	//changes made by others are seen promptly
+	const static std::chrono::seconds cacheLifetime(30);
+	httpRequests::Options opts=defaultOptions();
+	opts.maxAge=cacheLifetime;
+	return opts;
+}
+
 httpRequests::Options Client::defaultOptions(){
 	httpRequests::Options opts;
+	opts.session=&httpSession;
+	opts.cache=getResponseCache();
 #ifdef USE_CURLOPT_CAINFO
 	detectCABundlePath();
 	opts.caBundlePath=caBundlePath;
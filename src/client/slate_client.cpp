@@ -190,8 +190,8 @@ void registerDenyGroupUseOfApplication(CLI::App& parent, Client& client){
 
 void registerClusterPing(CLI::App& parent, Client& client){
 	auto opt = std::make_shared<ClusterPingOptions>();
-	auto ping = parent.add_subcommand("ping", "Check whether the platform can connect to a cluster");
-	ping->add_option("cluster-name", opt->clusterName, "Name of the cluster")->required();
+	auto ping = parent.add_subcommand("ping", "Check whether the platform can connect to one or more clusters");
+	ping->add_option("cluster-name", opt->clusterNames, "Names of the clusters")->required();
 	ping->callback([&client,opt](){ client.pingCluster(*opt); });
 }
 
@@ -398,6 +398,18 @@ void registerSecretCommands(CLI::App& parent, Client& client){
 	registerSecretDelete(*secr, client);
 }
 
+void registerBatchCommand(CLI::App& parent, Client& client){
+	auto opt = std::make_shared<BatchOptions>();
+	auto batch = parent.add_subcommand("batch", "Run many operations, listed one per line, "
+	                                   "in a few requests. Supported operations are group "
+	                                   "delete, cluster delete, allow-group, deny-group, "
+	                                   "allow-group-app, deny-group-app, and ping, instance "
+	                                   "delete and restart, and secret delete.");
+	batch->add_option("file", opt->inputPath, "File listing the operations, or - to read stdin", true);
+	batch->add_option("--bundle-size", opt->bundleSize, "Maximum number of operations to send in one request", true);
+	batch->callback([&client,opt](){ client.runBatch(*opt); });
+}
+
 void registerCommonOptions(CLI::App& parent, Client& client){
 	parent.add_option("--orderBy", client.orderBy, "the name of a column in the JSON output"
 			"by which to order the table printed to stdout.");
@@ -464,6 +476,7 @@ int main(int argc, char* argv[]){
 		registerApplicationCommands(slate,client);
 		registerInstanceCommands(slate,client);
 		registerSecretCommands(slate,client);
+		registerBatchCommand(slate,client);
 		registerCommonOptions(slate,client);
 		
 		startReaper();
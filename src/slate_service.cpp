@@ -1,6 +1,7 @@
 #include <cerrno>
 #include <iostream>
 #include <cctype>
+#include <thread>
 
 #include <sys/stat.h>
 
@@ -11,7 +12,11 @@
 #include "Logging.h"
 #include "PersistentStore.h"
 #include "Process.h"
+#include "Readiness.h"
+#include "RouteMetrics.h"
 #include "ServerUtilities.h"
+#include "SSLContext.h"
+#include "WorkerProcesses.h"
 
 #include "ApplicationCommands.h"
 #include "ApplicationInstanceCommands.h"
@@ -21,6 +26,8 @@
 #include "GroupCommands.h"
 #include "VersionCommands.h"
 
+///Ensure that helm is available and that the catalog's repositories are 
+///configured. Refreshing the repositories is left to refreshCatalog. 
 void initializeHelm(){
 	const static std::string helmRepoBase="https://jenkins.slateci.io/catalog";
 	
@@ -89,13 +96,60 @@ void initializeHelm(){
 				log_fatal("Unable to install slate development repository");
 		}
 	}
-	{ //Ensure that repositories are up-to-date
-		err=runCommand("helm",{"repo","update"}).status;
-		if(err)
-			log_fatal("helm repo update failed");
+}
+
+///Bring the database tables up to date and load the caches.
+///In pre-fork mode only the first worker initializes the tables, since 
+///creating or updating them from several processes at once would conflict. 
+///The first worker always publishes whether it succeeded, so that the others 
+///fail along with it rather than waiting indefinitely. 
+void initializeDatabase(PersistentStore& store){
+	setStageStatus(StartupStage::Database,StageStatus::InProgress);
+	try{
+		std::atomic<DatabaseInitialization>* initialization=sharedDatabaseInitialization();
+		if(workerIndex()==0){
+			if(initialization)
+				initialization->store(DatabaseInitialization::Pending);
+			try{
+				store.InitializeTables();
+			}catch(...){
+				if(initialization)
+					initialization->store(DatabaseInitialization::Failed);
+				throw;
+			}
+			if(initialization)
+				initialization->store(DatabaseInitialization::Complete);
+		}
+		else{
+			log_info("Waiting for the first worker process to initialize the database");
+			DatabaseInitialization state;
+			while((state=initialization->load())==DatabaseInitialization::Pending)
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			if(state==DatabaseInitialization::Failed)
+				throw std::runtime_error("The first worker process failed to initialize the database");
+		}
+		store.preloadCaches();
+		setStageStatus(StartupStage::Database,StageStatus::Complete);
+	}catch(std::exception& err){
+		log_error("Database initialization failed: " << err.what());
+		setStageStatus(StartupStage::Database,StageStatus::Failed,err.what());
 	}
 }
 
+///Fetch the latest catalog indices. In pre-fork mode only the first worker 
+///does this, since the indices are shared by all workers. 
+void refreshHelmRepositories(){
+	if(workerIndex()!=0){
+		setStageStatus(StartupStage::HelmRepositories,StageStatus::Complete,"Performed by the first worker process");
+		return;
+	}
+	setStageStatus(StartupStage::HelmRepositories,StageStatus::InProgress);
+	if(refreshCatalog())
+		setStageStatus(StartupStage::HelmRepositories,StageStatus::Complete);
+	else
+		setStageStatus(StartupStage::HelmRepositories,StageStatus::Failed,"helm repo update failed");
+}
+
 struct Configuration{
 	struct ParamRef{
 		enum Type{String,Bool} type;
@@ -138,11 +192,30 @@ struct Configuration{
 	std::string portString;
 	std::string sslCertificate;
 	std::string sslKey;
+	std::string sslCiphers;
+	std::string sslCipherSuites;
+	std::string sslCurves;
+	std::string sslSessionCacheSizeString;
+	std::string sslSessionTimeoutString;
+	std::string sslTicketKeyLifetimeString;
 	std::string bootstrapUserFile;
 	std::string encryptionKeyFile;
 	std::string appLoggingServerName;
 	std::string appLoggingServerPortString;
 	bool allowAdHocApps;
+	std::string logLevel;
+	std::string logFormat;
+	std::string slowRequestThresholdString;
+	std::string cheapRequestRateString;
+	std::string cheapRequestBurstString;
+	std::string expensiveRequestRateString;
+	std::string expensiveRequestBurstString;
+	std::string maxConcurrentRequestsString;
+	std::string maxConcurrentExpensiveRequestsString;
+	std::string maxMultiplexRequestsString;
+	std::string workersString;
+	bool reusePort;
+	std::string drainTimeoutString;
 	
 	std::map<std::string,ParamRef> options;
 	
@@ -153,10 +226,26 @@ struct Configuration{
 	awsURLScheme("http"),
 	awsEndpoint("localhost:8000"),
 	portString("18080"),
+	sslSessionCacheSizeString("20480"),
+	sslSessionTimeoutString("3600"),
+	sslTicketKeyLifetimeString("3600"),
 	bootstrapUserFile("slate_portal_user"),
 	encryptionKeyFile("encryptionKey"),
 	appLoggingServerPortString("9200"),
 	allowAdHocApps(false),
+	logLevel("info"),
+	logFormat("text"),
+	slowRequestThresholdString("1000"),
+	cheapRequestRateString("20"),
+	cheapRequestBurstString("100"),
+	expensiveRequestRateString("0.5"),
+	expensiveRequestBurstString("10"),
+	maxConcurrentRequestsString("256"),
+	maxConcurrentExpensiveRequestsString("32"),
+	maxMultiplexRequestsString("100"),
+	workersString("1"),
+	reusePort(false),
+	drainTimeoutString("30"),
 	options{
 		{"awsAccessKey",awsAccessKey},
 		{"awsSecretKey",awsSecretKey},
@@ -166,11 +255,30 @@ struct Configuration{
 		{"port",portString},
 		{"sslCertificate",sslCertificate},
 		{"sslKey",sslKey},
+		{"sslCiphers",sslCiphers},
+		{"sslCipherSuites",sslCipherSuites},
+		{"sslCurves",sslCurves},
+		{"sslSessionCacheSize",sslSessionCacheSizeString},
+		{"sslSessionTimeout",sslSessionTimeoutString},
+		{"sslTicketKeyLifetime",sslTicketKeyLifetimeString},
 		{"bootstrapUserFile",bootstrapUserFile},
 		{"encryptionKeyFile",encryptionKeyFile},
 		{"appLoggingServerName",appLoggingServerName},
 		{"appLoggingServerPort",appLoggingServerPortString},
 		{"allowAdHocApps",allowAdHocApps},
+		{"logLevel",logLevel},
+		{"logFormat",logFormat},
+		{"slowRequestThreshold",slowRequestThresholdString},
+		{"cheapRequestRate",cheapRequestRateString},
+		{"cheapRequestBurst",cheapRequestBurstString},
+		{"expensiveRequestRate",expensiveRequestRateString},
+		{"expensiveRequestBurst",expensiveRequestBurstString},
+		{"maxConcurrentRequests",maxConcurrentRequestsString},
+		{"maxConcurrentExpensiveRequests",maxConcurrentExpensiveRequestsString},
+		{"maxMultiplexRequests",maxMultiplexRequestsString},
+		{"workers",workersString},
+		{"reusePort",reusePort},
+		{"drainTimeout",drainTimeoutString},
 	}
 	{
 		//check for environment variables
@@ -251,16 +359,36 @@ struct Configuration{
 	
 };
 
+///Interpret the value of a configuration option which sets a limit
+///\param name the name of the option
+///\param value the value of the option
+///\return the parsed value, which is guaranteed not to be negative
+template<typename T>
+T parseLimit(const std::string& name, const std::string& value){
+	std::istringstream is(value);
+	double result=0;
+	is >> result;
+	if(is.fail() || !is.eof() || result<0)
+		log_fatal("Unable to parse \"" << value << "\" as a valid value for " << name);
+	return static_cast<T>(result);
+}
+
 ///Accept a dictionary describing several individual requests, execute them all 
 ///concurrently, and return the results in another dictionary. Currently very
 ///simplistic; a new thread will be spawned for every individual request. 
-crow::response multiplex(crow::SimpleApp& server, PersistentStore& store, const crow::request& req){
+///Each individual request is admitted, and charged to the user whose token it
+///carries, just as if it had been made on its own, so the results may include
+///rejections with status 429 or 503, accompanied by a 'retryAfter' time. 
+///\param maxRequests the maximum number of individual requests a bundle may
+///                   contain, or zero for no limit
+crow::response multiplex(crow::SimpleApp& server, PersistentStore& store, const crow::request& req, std::size_t maxRequests){
 	const User user=authenticateUser(store, req.url_params.get("token"));
 	log_info(user << " requested execute a command bundle");
 	if(!user)
 		return crow::response(403,generateError("Not authorized"));
 	
-	rapidjson::Document body;
+	RequestArena arena;
+	RequestArena::Document body(&arena.allocator());
 	try{
 		body.Parse(req.body.c_str());
 	}catch(std::runtime_error& err){
@@ -269,6 +397,8 @@ crow::response multiplex(crow::SimpleApp& server, PersistentStore& store, const
 	
 	if(!body.IsObject())
 		return crow::response(400,generateError("Multiplexed requests must have a JSON object/dictionary as the request body"));
+	if(maxRequests && body.GetObject().MemberCount()>maxRequests)
+		return crow::response(400,generateError("Multiplexed requests may contain at most "+std::to_string(maxRequests)+" individual requests"));
 	
 	auto parseHTTPMethod=[](std::string method){
 		std::transform(method.begin(),method.end(),method.begin(),[](char c)->char{return std::toupper(c);});
@@ -317,16 +447,19 @@ crow::response multiplex(crow::SimpleApp& server, PersistentStore& store, const
 			return response;
 		}));
 	
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	RequestArena::Document result(rapidjson::kObjectType,&arena.allocator());
+	RequestArena::Allocator& alloc = result.GetAllocator();
 	
 	for(std::size_t i=0; i<requests.size(); i++){
 		const auto& request=requests[i];
-		rapidjson::Value singleResult(rapidjson::kObjectType);
+		RequestArena::Value singleResult(rapidjson::kObjectType);
 		try{
 			crow::response response=responses[i].get();
 			singleResult.AddMember("status",response.code,alloc);
 			singleResult.AddMember("body",response.body,alloc);
+			const std::string& retryAfter=response.get_header_value("Retry-After");
+			if(!retryAfter.empty())
+				singleResult.AddMember("retryAfter",(uint64_t)std::stoul(retryAfter),alloc);
 		}
 		catch(std::exception& ex){
 			singleResult.AddMember("status",400,alloc);
@@ -336,7 +469,7 @@ crow::response multiplex(crow::SimpleApp& server, PersistentStore& store, const
 			singleResult.AddMember("status",400,alloc);
 			singleResult.AddMember("body",generateError("Exception"),alloc);
 		}
-		rapidjson::Value key(rapidjson::kStringType);
+		RequestArena::Value key(rapidjson::kStringType);
 		key.SetString(requests[i].raw_url, alloc);
 		result.AddMember(key, singleResult, alloc);
 	}
@@ -352,6 +485,17 @@ int main(int argc, char* argv[]){
 		          " must be specified together");
 	}
 	
+	try{
+		logging::setLevel(logging::parseLevel(config.logLevel));
+	}catch(std::runtime_error& err){
+		log_fatal(err.what());
+	}
+	logging::handleLevelSignals();
+	if(config.logFormat=="json")
+		logging::setFormat(logging::JSONLines);
+	else if(config.logFormat!="text")
+		log_fatal("Unrecognized log format: '" << config.logFormat << "'; valid values are 'text' and 'json'");
+	
 	log_info("Database URL is " << config.awsURLScheme << "://" << config.awsEndpoint);
 	unsigned int port=0;
 	{
@@ -362,6 +506,28 @@ int main(int argc, char* argv[]){
 	}
 	log_info("Service port is " << port);
 	
+	{
+		std::istringstream is(config.slowRequestThresholdString);
+		unsigned int threshold=0;
+		is >> threshold;
+		if(is.fail())
+			log_fatal("Unable to parse \"" << config.slowRequestThresholdString << "\" as a number of milliseconds");
+		tracing::setSlowThreshold(std::chrono::milliseconds(threshold));
+	}
+	
+	{
+		AdmissionLimits limits;
+		limits.cheapRate=parseLimit<double>("cheapRequestRate",config.cheapRequestRateString);
+		limits.cheapBurst=parseLimit<double>("cheapRequestBurst",config.cheapRequestBurstString);
+		limits.expensiveRate=parseLimit<double>("expensiveRequestRate",config.expensiveRequestRateString);
+		limits.expensiveBurst=parseLimit<double>("expensiveRequestBurst",config.expensiveRequestBurstString);
+		limits.maxConcurrent=parseLimit<unsigned int>("maxConcurrentRequests",config.maxConcurrentRequestsString);
+		limits.maxConcurrentExpensive=parseLimit<unsigned int>("maxConcurrentExpensiveRequests",config.maxConcurrentExpensiveRequestsString);
+		if((limits.cheapRate>0 && limits.cheapBurst<1) || (limits.expensiveRate>0 && limits.expensiveBurst<1))
+			log_fatal("Request burst sizes must be at least 1 when rate limiting is enabled");
+		setAdmissionLimits(limits);
+	}
+	
 	unsigned int appLoggingServerPort=0;
 	{
 		std::istringstream is(config.appLoggingServerPortString);
@@ -370,8 +536,20 @@ int main(int argc, char* argv[]){
 			log_fatal("Unable to parse \"" << config.appLoggingServerPortString << "\" as a valid port number");
 	}
 	
+	const std::size_t maxMultiplexRequests=parseLimit<std::size_t>("maxMultiplexRequests",config.maxMultiplexRequestsString);
+	const unsigned int workers=parseLimit<unsigned int>("workers",config.workersString);
+	const std::chrono::seconds drainTimeout(parseLimit<unsigned long>("drainTimeout",config.drainTimeoutString));
+	
 	startReaper();
 	initializeHelm();
+	if(workers>1){
+		//helm only needs to be set up once for all workers, and no other 
+		//threads may be running when the workers are started
+		stopReaper();
+		runWorkerProcesses(workers);
+		startReaper();
+	}
+	logging::startWriter();
 	// DB client initialization
 	Aws::SDKOptions awsOptions;
 	Aws::InitAPI(awsOptions);
@@ -393,143 +571,181 @@ int main(int argc, char* argv[]){
 	PersistentStore store(credentials,clientConfig,
 	                      config.bootstrapUserFile,config.encryptionKeyFile,
 	                      config.appLoggingServerName,appLoggingServerPort);
+	setTokenOwnerLookup([&store](const std::string& token){ return store.findUserByToken(token).id; });
 	
 	// REST server initialization
 	crow::SimpleApp server;
 	
 	CROW_ROUTE(server, "/v1alpha3/multiplex").methods("POST"_method)(
-	  [&](const crow::request& req){ return multiplex(server,store,req); });
+	  instrumented("POST /v1alpha3/multiplex", [&](const crow::request& req){ return multiplex(server,store,req,maxMultiplexRequests); }));
 	
 	// == User commands ==
 	CROW_ROUTE(server, "/v1alpha3/users").methods("GET"_method)(
-	  [&](const crow::request& req){ return listUsers(store,req); });
+	  instrumented("GET /v1alpha3/users", [&](const crow::request& req){ return listUsers(store,req); }));
 	CROW_ROUTE(server, "/v1alpha3/users").methods("POST"_method)(
-	  [&](const crow::request& req){ return createUser(store,req); });
+	  instrumented("POST /v1alpha3/users", [&](const crow::request& req){ return createUser(store,req); }));
 	CROW_ROUTE(server, "/v1alpha3/users/<string>").methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& uID){ return getUserInfo(store,req,uID); });
+	  instrumented("GET /v1alpha3/users/<string>", [&](const crow::request& req, const std::string& uID){ return getUserInfo(store,req,uID); }));
 	CROW_ROUTE(server, "/v1alpha3/users/<string>").methods("PUT"_method)(
-	  [&](const crow::request& req, const std::string& uID){ return updateUser(store,req,uID); });
+	  instrumented("PUT /v1alpha3/users/<string>", [&](const crow::request& req, const std::string& uID){ return updateUser(store,req,uID); }));
 	CROW_ROUTE(server, "/v1alpha3/users/<string>").methods("DELETE"_method)(
-	  [&](const crow::request& req, const std::string& uID){ return deleteUser(store,req,uID); });
+	  instrumented("DELETE /v1alpha3/users/<string>", [&](const crow::request& req, const std::string& uID){ return deleteUser(store,req,uID); }));
 	CROW_ROUTE(server, "/v1alpha3/users/<string>/groups").methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& uID){ return listUsergroups(store,req,uID); });
+	  instrumented("GET /v1alpha3/users/<string>/groups", [&](const crow::request& req, const std::string& uID){ return listUsergroups(store,req,uID); }));
 	CROW_ROUTE(server, "/v1alpha3/users/<string>/groups/<string>").methods("PUT"_method)(
-	  [&](const crow::request& req, const std::string& uID, const std::string groupID){ return addUserToGroup(store,req,uID,groupID); });
+	  instrumented("PUT /v1alpha3/users/<string>/groups/<string>", [&](const crow::request& req, const std::string& uID, const std::string groupID){ return addUserToGroup(store,req,uID,groupID); }));
 	CROW_ROUTE(server, "/v1alpha3/users/<string>/groups/<string>").methods("DELETE"_method)(
-	  [&](const crow::request& req, const std::string& uID, const std::string groupID){ return removeUserFromGroup(store,req,uID,groupID); });
+	  instrumented("DELETE /v1alpha3/users/<string>/groups/<string>", [&](const crow::request& req, const std::string& uID, const std::string groupID){ return removeUserFromGroup(store,req,uID,groupID); }));
 	CROW_ROUTE(server, "/v1alpha3/users/<string>/replace_token").methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& uID){ return replaceUserToken(store,req,uID); });
+	  instrumented("GET /v1alpha3/users/<string>/replace_token", [&](const crow::request& req, const std::string& uID){ return replaceUserToken(store,req,uID); }));
 	CROW_ROUTE(server, "/v1alpha3/find_user").methods("GET"_method)(
-	  [&](const crow::request& req){ return findUser(store,req); });
+	  instrumented("GET /v1alpha3/find_user", [&](const crow::request& req){ return findUser(store,req); }));
 	
 	// == Cluster commands ==
 	CROW_ROUTE(server, "/v1alpha3/clusters").methods("GET"_method)(
-	  [&](const crow::request& req){ return listClusters(store,req); });
+	  instrumented("GET /v1alpha3/clusters", [&](const crow::request& req){ return listClusters(store,req); }));
 	CROW_ROUTE(server, "/v1alpha3/clusters").methods("POST"_method)(
-	  [&](const crow::request& req){ return createCluster(store,req); });
+	  instrumented("POST /v1alpha3/clusters", [&](const crow::request& req){ return createCluster(store,req); }, RequestCost::Expensive));
 	CROW_ROUTE(server, "/v1alpha3/clusters/<string>").methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& cID){ return getClusterInfo(store,req,cID); });
+	  instrumented("GET /v1alpha3/clusters/<string>", [&](const crow::request& req, const std::string& cID){ return getClusterInfo(store,req,cID); }));
 	CROW_ROUTE(server, "/v1alpha3/clusters/<string>").methods("DELETE"_method)(
-	  [&](const crow::request& req, const std::string& cID){ return deleteCluster(store,req,cID); });
+	  instrumented("DELETE /v1alpha3/clusters/<string>", [&](const crow::request& req, const std::string& cID){ return deleteCluster(store,req,cID); }, RequestCost::Expensive));
 	CROW_ROUTE(server, "/v1alpha3/clusters/<string>").methods("PUT"_method)(
-	  [&](const crow::request& req, const std::string& cID){ return updateCluster(store,req,cID); });
+	  instrumented("PUT /v1alpha3/clusters/<string>", [&](const crow::request& req, const std::string& cID){ return updateCluster(store,req,cID); }));
 	CROW_ROUTE(server, "/v1alpha3/clusters/<string>/ping").methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& cID){ return pingCluster(store,req,cID); });
+	  instrumented("GET /v1alpha3/clusters/<string>/ping", [&](const crow::request& req, const std::string& cID){ return pingCluster(store,req,cID); }, RequestCost::Expensive));
 	CROW_ROUTE(server, "/v1alpha3/clusters/<string>/verify").methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& cID){ return verifyCluster(store,req,cID); });
+	  instrumented("GET /v1alpha3/clusters/<string>/verify", [&](const crow::request& req, const std::string& cID){ return verifyCluster(store,req,cID); }, RequestCost::Expensive));
 	CROW_ROUTE(server, "/v1alpha3/clusters/<string>/allowed_groups").methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& cID){ return listClusterAllowedgroups(store,req,cID); });
+	  instrumented("GET /v1alpha3/clusters/<string>/allowed_groups", [&](const crow::request& req, const std::string& cID){ return listClusterAllowedgroups(store,req,cID); }));
 	CROW_ROUTE(server, "/v1alpha3/clusters/<string>/allowed_groups/<string>").methods("PUT"_method)(
-	  [&](const crow::request& req, const std::string& cID, const std::string& groupID){ 
-		  return grantGroupClusterAccess(store,req,cID,groupID); });
+	  instrumented("PUT /v1alpha3/clusters/<string>/allowed_groups/<string>", [&](const crow::request& req, const std::string& cID, const std::string& groupID){ 
+		  return grantGroupClusterAccess(store,req,cID,groupID); }));
 	CROW_ROUTE(server, "/v1alpha3/clusters/<string>/allowed_groups/<string>").methods("DELETE"_method)(
-	  [&](const crow::request& req, const std::string& cID, const std::string& groupID){ 
-		  return revokeGroupClusterAccess(store,req,cID,groupID); });
+	  instrumented("DELETE /v1alpha3/clusters/<string>/allowed_groups/<string>", [&](const crow::request& req, const std::string& cID, const std::string& groupID){ 
+		  return revokeGroupClusterAccess(store,req,cID,groupID); }));
 	CROW_ROUTE(server, "/v1alpha3/clusters/<string>/allowed_groups/<string>/applications")
 	  .methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& cID, const std::string& groupID){ 
-		  return listClusterGroupAllowedApplications(store,req,cID,groupID); });
+	  instrumented("GET /v1alpha3/clusters/<string>/allowed_groups/<string>/applications", [&](const crow::request& req, const std::string& cID, const std::string& groupID){ 
+		  return listClusterGroupAllowedApplications(store,req,cID,groupID); }));
 	CROW_ROUTE(server, "/v1alpha3/clusters/<string>/allowed_groups/<string>/applications/<string>")
 	  .methods("PUT"_method)(
-	  [&](const crow::request& req, const std::string& cID, const std::string& groupID, const std::string& app){ 
-		  return allowGroupUseOfApplication(store,req,cID,groupID,app); });
+	  instrumented("PUT /v1alpha3/clusters/<string>/allowed_groups/<string>/applications/<string>", [&](const crow::request& req, const std::string& cID, const std::string& groupID, const std::string& app){ 
+		  return allowGroupUseOfApplication(store,req,cID,groupID,app); }));
 	CROW_ROUTE(server, "/v1alpha3/clusters/<string>/allowed_groups/<string>/applications/<string>")
 	  .methods("DELETE"_method)(
-	  [&](const crow::request& req, const std::string& cID, const std::string& groupID, const std::string& app){ 
-		  return denyGroupUseOfApplication(store,req,cID,groupID,app); });
+	  instrumented("DELETE /v1alpha3/clusters/<string>/allowed_groups/<string>/applications/<string>", [&](const crow::request& req, const std::string& cID, const std::string& groupID, const std::string& app){ 
+		  return denyGroupUseOfApplication(store,req,cID,groupID,app); }));
 	
 	// == Group commands ==
 	CROW_ROUTE(server, "/v1alpha3/groups").methods("GET"_method)(
-	  [&](const crow::request& req){ return listGroups(store,req); });
+	  instrumented("GET /v1alpha3/groups", [&](const crow::request& req){ return listGroups(store,req); }));
 	CROW_ROUTE(server, "/v1alpha3/groups").methods("POST"_method)(
-	  [&](const crow::request& req){ return createGroup(store,req); });
+	  instrumented("POST /v1alpha3/groups", [&](const crow::request& req){ return createGroup(store,req); }));
 	CROW_ROUTE(server, "/v1alpha3/groups/<string>").methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& groupID){ return getGroupInfo(store,req,groupID); });
+	  instrumented("GET /v1alpha3/groups/<string>", [&](const crow::request& req, const std::string& groupID){ return getGroupInfo(store,req,groupID); }));
 	CROW_ROUTE(server, "/v1alpha3/groups/<string>").methods("PUT"_method)(
-	  [&](const crow::request& req, const std::string& groupID){ return updateGroup(store,req,groupID); });
+	  instrumented("PUT /v1alpha3/groups/<string>", [&](const crow::request& req, const std::string& groupID){ return updateGroup(store,req,groupID); }));
 	CROW_ROUTE(server, "/v1alpha3/groups/<string>").methods("DELETE"_method)(
-	  [&](const crow::request& req, const std::string& groupID){ return deleteGroup(store,req,groupID); });
+	  instrumented("DELETE /v1alpha3/groups/<string>", [&](const crow::request& req, const std::string& groupID){ return deleteGroup(store,req,groupID); }, RequestCost::Expensive));
 	CROW_ROUTE(server, "/v1alpha3/groups/<string>/members").methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& groupID){ return listGroupMembers(store,req,groupID); });
+	  instrumented("GET /v1alpha3/groups/<string>/members", [&](const crow::request& req, const std::string& groupID){ return listGroupMembers(store,req,groupID); }));
 	CROW_ROUTE(server, "/v1alpha3/groups/<string>/clusters").methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& groupID){ return listGroupClusters(store,req,groupID); });
+	  instrumented("GET /v1alpha3/groups/<string>/clusters", [&](const crow::request& req, const std::string& groupID){ return listGroupClusters(store,req,groupID); }));
 	
 	// == Application commands ==
 	CROW_ROUTE(server, "/v1alpha3/apps").methods("GET"_method)(
-	  [&](const crow::request& req){ return listApplications(store,req); });
+	  instrumented("GET /v1alpha3/apps", [&](const crow::request& req){ return listApplications(store,req); }));
 	CROW_ROUTE(server, "/v1alpha3/apps/<string>").methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& aID){ return fetchApplicationConfig(store,req,aID); });
+	  instrumented("GET /v1alpha3/apps/<string>", [&](const crow::request& req, const std::string& aID){ return fetchApplicationConfig(store,req,aID); }));
 	CROW_ROUTE(server, "/v1alpha3/apps/<string>/info").methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& aID){ return fetchApplicationDocumentation(store,req,aID); });
+	  instrumented("GET /v1alpha3/apps/<string>/info", [&](const crow::request& req, const std::string& aID){ return fetchApplicationDocumentation(store,req,aID); }));
 	if(config.allowAdHocApps){
 		CROW_ROUTE(server, "/v1alpha3/apps/ad-hoc").methods("POST"_method)(
-		  [&](const crow::request& req){ return installAdHocApplication(store,req); });
+		  instrumented("POST /v1alpha3/apps/ad-hoc", [&](const crow::request& req){ return installAdHocApplication(store,req); }, RequestCost::Expensive));
 	}
 	else{
 		CROW_ROUTE(server, "/v1alpha3/apps/ad-hoc").methods("POST"_method)(
-		  [&](const crow::request& req){ return crow::response(400,generateError("Ad-hoc application installation is not permitted")); });
+		  instrumented("POST /v1alpha3/apps/ad-hoc", [&](const crow::request& req){ return crow::response(400,generateError("Ad-hoc application installation is not permitted")); }));
 	}
 	CROW_ROUTE(server, "/v1alpha3/apps/<string>").methods("POST"_method)(
-	  [&](const crow::request& req, const std::string& aID){ return installApplication(store,req,aID); });
+	  instrumented("POST /v1alpha3/apps/<string>", [&](const crow::request& req, const std::string& aID){ return installApplication(store,req,aID); }, RequestCost::Expensive));
 	CROW_ROUTE(server, "/v1alpha3/update_apps").methods("POST"_method)(
-	  [&](const crow::request& req){ return updateCatalog(store,req); });
+	  instrumented("POST /v1alpha3/update_apps", [&](const crow::request& req){ return updateCatalog(store,req); }, RequestCost::Expensive));
 	
 	// == Application Instance commands ==
 	CROW_ROUTE(server, "/v1alpha3/instances").methods("GET"_method)(
-	  [&](const crow::request& req){ return listApplicationInstances(store,req); });
+	  instrumented("GET /v1alpha3/instances", [&](const crow::request& req){ return listApplicationInstances(store,req); }));
 	CROW_ROUTE(server, "/v1alpha3/instances/<string>").methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& iID){ return fetchApplicationInstanceInfo(store,req,iID); });
+	  instrumented("GET /v1alpha3/instances/<string>", [&](const crow::request& req, const std::string& iID){ return fetchApplicationInstanceInfo(store,req,iID); },
+	  [](const crow::request& req){ return req.url_params.get("detailed") ? RequestCost::Expensive : RequestCost::Cheap; }));
 	CROW_ROUTE(server, "/v1alpha3/instances/<string>").methods("DELETE"_method)(
-	  [&](const crow::request& req, const std::string& iID){ return deleteApplicationInstance(store,req,iID); });
+	  instrumented("DELETE /v1alpha3/instances/<string>", [&](const crow::request& req, const std::string& iID){ return deleteApplicationInstance(store,req,iID); }, RequestCost::Expensive));
 	CROW_ROUTE(server, "/v1alpha3/instances/<string>/restart").methods("PUT"_method)(
-	  [&](const crow::request& req, const std::string& iID){ return restartApplicationInstance(store,req,iID); });
+	  instrumented("PUT /v1alpha3/instances/<string>/restart", [&](const crow::request& req, const std::string& iID){ return restartApplicationInstance(store,req,iID); }, RequestCost::Expensive));
 	CROW_ROUTE(server, "/v1alpha3/instances/<string>/logs").methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& iID){ return getApplicationInstanceLogs(store,req,iID); });
+	  instrumented("GET /v1alpha3/instances/<string>/logs", [&](const crow::request& req, const std::string& iID){ return getApplicationInstanceLogs(store,req,iID); }, RequestCost::Expensive));
 	
 	// == Secret commands ==
 	CROW_ROUTE(server, "/v1alpha3/secrets").methods("GET"_method)(
-	  [&](const crow::request& req){ return listSecrets(store,req); });
+	  instrumented("GET /v1alpha3/secrets", [&](const crow::request& req){ return listSecrets(store,req); }));
 	CROW_ROUTE(server, "/v1alpha3/secrets").methods("POST"_method)(
-	  [&](const crow::request& req){ return createSecret(store,req); });
+	  instrumented("POST /v1alpha3/secrets", [&](const crow::request& req){ return createSecret(store,req); }, RequestCost::Expensive));
 	CROW_ROUTE(server, "/v1alpha3/secrets/<string>").methods("GET"_method)(
-	  [&](const crow::request& req, const std::string& id){ return getSecret(store,req,id); });
+	  instrumented("GET /v1alpha3/secrets/<string>", [&](const crow::request& req, const std::string& id){ return getSecret(store,req,id); }));
 	CROW_ROUTE(server, "/v1alpha3/secrets/<string>").methods("DELETE"_method)(
-	  [&](const crow::request& req, const std::string& id){ return deleteSecret(store,req,id); });
+	  instrumented("DELETE /v1alpha3/secrets/<string>", [&](const crow::request& req, const std::string& id){ return deleteSecret(store,req,id); }, RequestCost::Expensive));
 	
 	CROW_ROUTE(server, "/v1alpha3/stats").methods("GET"_method)(
-	  [&](){ return(store.getStatistics()); });
-	
-	CROW_ROUTE(server, "/version").methods("GET"_method)(&serverVersionInfo);
+	  instrumented("GET /v1alpha3/stats", [&](const crow::request& req){ return crow::response(store.getStatistics()); }));
+	CROW_ROUTE(server, "/v1alpha3/stats/routes").methods("GET"_method)(
+	  instrumented("GET /v1alpha3/stats/routes", [&](const crow::request& req){ return getRouteStatistics(store,req); }));
+	CROW_ROUTE(server, "/v1alpha3/stats/traces").methods("GET"_method)(
+	  instrumented("GET /v1alpha3/stats/traces", [&](const crow::request& req){ return getSlowRequestTraces(store,req); }));
+	
+	//Probes are not subject to admission control, since they must be answered
+	//while the server is starting and they are made without tokens
+	CROW_ROUTE(server, "/healthz").methods("GET"_method)(
+	  [](){ return checkLiveness(); });
+	CROW_ROUTE(server, "/readyz").methods("GET"_method)(
+	  [](){ return checkReadiness(); });
+	
+	CROW_ROUTE(server, "/version").methods("GET"_method)(
+	  instrumented("GET /version", [](const crow::request& req){ return serverVersionInfo(); }));
 	
 	//include a fallback to catch unexpected/unsupported things
 	CROW_ROUTE(server, "/<string>/<path>").methods("GET"_method)(
-	  [](std::string apiVersion, std::string path){
-	  	return crow::response(400,generateError("Unsupported API version")); });
+	  instrumented("GET /<string>/<path>", [](const crow::request& req, std::string apiVersion, std::string path){
+	  	return crow::response(400,generateError("Unsupported API version")); }));
 	
 	server.loglevel(crow::LogLevel::Warning);
-	if(!config.sslCertificate.empty())
-		server.port(port).ssl_file(config.sslCertificate,config.sslKey).multithreaded().run();
-		//server.port(port).ssl_file(config.sslCertificate,config.sslKey).concurrency(128).run();
-	else
-		server.port(port).multithreaded().run();
+	server.reuse_port(workers>1 || config.reusePort);
+	server.graceful_shutdown(drainTimeout,[]{ return requestsInProgress()==0; });
+	if(!config.sslCertificate.empty()){
+		SSLSettings sslSettings;
+		sslSettings.certificate=config.sslCertificate;
+		sslSettings.key=config.sslKey;
+		sslSettings.ciphers=config.sslCiphers;
+		sslSettings.cipherSuites=config.sslCipherSuites;
+		sslSettings.curves=config.sslCurves;
+		sslSettings.sessionCacheSize=parseLimit<unsigned long>("sslSessionCacheSize",config.sslSessionCacheSizeString);
+		sslSettings.sessionTimeout=std::chrono::seconds(parseLimit<unsigned long>("sslSessionTimeout",config.sslSessionTimeoutString));
+		sslSettings.ticketKeyLifetime=std::chrono::seconds(parseLimit<unsigned long>("sslTicketKeyLifetime",config.sslTicketKeyLifetimeString));
+		boost::asio::ssl::context sslContext(boost::asio::ssl::context::sslv23);
+		try{
+			sslContext=createSSLContext(sslSettings);
+		}catch(std::runtime_error& err){
+			log_fatal("SSL configuration failed: " << err.what());
+		}
+		server.ssl(std::move(sslContext));
+	}
+	
+	//the remaining initialization is done in the background, so that the 
+	//server can answer health and readiness probes in the meantime
+	std::thread databaseInitializer(initializeDatabase,std::ref(store));
+	std::thread helmRefresher(refreshHelmRepositories);
+	server.port(port).multithreaded().run();
+	databaseInitializer.join();
+	helmRefresher.join();
+	logging::stopWriter();
 }
@@ -0,0 +1,243 @@
+#include "test.h"
+
+#include <fstream>
+
+#include <sys/stat.h>
+
+#include <Archive.h>
+#include <FileHandle.h>
+#include <FileSystem.h>
+
+namespace{
+
+std::string makeTarball(const std::map<std::string,std::string>& files){
+	std::stringstream tarBuffer;
+	TarWriter tw(tarBuffer);
+	tw.appendDirectory("chart");
+	for(const auto& file : files)
+		tw.appendFile(file.first,file.second);
+	tw.endStream();
+	const std::string tarData=tarBuffer.str();
+	return gzipCompress(tarData.data(),tarData.size());
+}
+
+std::string readFile(const std::string& path){
+	std::ifstream file(path);
+	std::stringstream data;
+	data << file.rdbuf();
+	return data.str();
+}
+
+}
+
+TEST(GzippedTarballExtraction){
+	std::map<std::string,std::string> files={
+		{"chart/empty",""},
+		{"chart/small","name: test-app\n"},
+		//larger than the decompression buffer, with a size which is not a
+		//multiple of the tar block size
+		{"chart/large",std::string(300000,'x')+std::string(1001,'y')}
+	};
+	const std::string compressed=makeTarball(files);
+	
+	{ //the in-memory compressor should agree with the stream decompressor
+		std::stringstream compressedStream(compressed), tarStream;
+		gzipDecompress(compressedStream,tarStream);
+		TarReader tr(tarStream);
+		ENSURE_EQUAL(tr.stringForFile("chart/large"),files["chart/large"]);
+	}
+	
+	FileHandle dir=makeTemporaryDir("/tmp/slate_archive_test_");
+	struct DirCleaner{
+		const FileHandle& dir;
+		~DirCleaner(){ recursivelyDestroyDirectory(dir); }
+	} cleaner{dir};
+	extractGzippedTarball(compressed.data(),compressed.size(),dir+"/");
+	for(const auto& file : files)
+		ENSURE_EQUAL(readFile(dir+"/"+file.first),file.second,"Extracted file contents should match the original");
+}
+
+TEST(GzippedTarballDamaged){
+	const std::string compressed=makeTarball({{"chart/file",std::string(100000,'z')}});
+	FileHandle dir=makeTemporaryDir("/tmp/slate_archive_test_");
+	struct DirCleaner{
+		const FileHandle& dir;
+		~DirCleaner(){ recursivelyDestroyDirectory(dir); }
+	} cleaner{dir};
+	
+	try{
+		extractGzippedTarball(compressed.data(),compressed.size()/2,dir+"/");
+		FAIL("Extracting a truncated tarball should fail");
+	}catch(std::runtime_error& err){}
+	
+	std::string corrupted=compressed;
+	corrupted[corrupted.size()-6]^=1; //damage the checksum
+	try{
+		extractGzippedTarball(corrupted.data(),corrupted.size(),dir+"/");
+		FAIL("Extracting a tarball with a bad checksum should fail");
+	}catch(std::runtime_error& err){}
+}
+
+TEST(GzippedTarballEscape){
+	const std::string compressed=makeTarball({{"chart/../../escaped","data"}});
+	FileHandle dir=makeTemporaryDir("/tmp/slate_archive_test_");
+	struct DirCleaner{
+		const FileHandle& dir;
+		~DirCleaner(){ recursivelyDestroyDirectory(dir); }
+	} cleaner{dir};
+	try{
+		extractGzippedTarball(compressed.data(),compressed.size(),dir+"/");
+		FAIL("Files outside the extraction directory should be rejected");
+	}catch(std::runtime_error& err){}
+}
+
+TEST(IndexedTarReader){
+	std::stringstream tarBuffer;
+	{
+		TarWriter tw(tarBuffer);
+		tw.appendDirectory("chart");
+		tw.appendFile("chart/Chart.yaml","name: test-app\n");
+		tw.appendFile("chart/values.yaml",std::string(1500,'v'));
+	}
+	const std::string compressed=gzipCompress(tarBuffer.str().data(),tarBuffer.str().size());
+	const std::string tarData=gzipDecompress(compressed.data(),compressed.size());
+	ENSURE_EQUAL(tarData,tarBuffer.str(),"In-memory decompression should invert compression");
+	
+	TarReader tr(tarData.data(),tarData.size());
+	//files may be requested out of order
+	auto values=tr.viewForFile("chart/values.yaml");
+	ENSURE_EQUAL(std::string(values.first,values.second),std::string(1500,'v'));
+	ENSURE_EQUAL(tr.stringForFile("chart/Chart.yaml"),"name: test-app\n");
+	ENSURE_EQUAL(tr.typeForFile("chart"),TarReader::FileRecord::DIRECTORY);
+	std::string line;
+	std::getline(*tr.streamForFile("chart/Chart.yaml"),line);
+	ENSURE_EQUAL(line,"name: test-app");
+	try{
+		tr.viewForFile("chart/missing");
+		FAIL("Requesting a file which is not in the tarball should fail");
+	}catch(TarReader::missing_file_exception& ex){}
+	
+	//iteration still follows the order of the tarball
+	ENSURE_EQUAL(tr.nextFile(),"chart");
+	ENSURE_EQUAL(tr.nextFileOfType(TarReader::FileRecord::REGULAR_FILE),"chart/Chart.yaml");
+	ENSURE_EQUAL(tr.nextFile(),"chart/values.yaml");
+	ENSURE(tr.eof());
+	ENSURE_EQUAL(tr.nextFile(),"");
+	
+	FileHandle dir=makeTemporaryDir("/tmp/slate_archive_test_");
+	struct DirCleaner{
+		const FileHandle& dir;
+		~DirCleaner(){ recursivelyDestroyDirectory(dir); }
+	} cleaner{dir};
+	TarReader extractor(tarData.data(),tarData.size());
+	extractor.extractToFileSystem(dir+"/");
+	ENSURE_EQUAL(readFile(dir+"/chart/values.yaml"),std::string(1500,'v'));
+	struct stat info;
+	ENSURE_EQUAL(stat((dir+"/chart/values.yaml").c_str(),&info),0);
+	ENSURE_EQUAL(info.st_mode&07777,tr.modeForFile("chart/values.yaml"),
+	             "Extracted files should have the permissions recorded in the tarball");
+}
+
+TEST(StreamingArchiveEncoding){
+	const std::string large=std::string(200000,'a')+std::string(70001,'b');
+	std::stringstream encoded;
+	{
+		Base64OutputStream encoder(encoded);
+		GzipOutputStream compressor(encoder);
+		TarWriter tw(compressor);
+		tw.appendDirectory("chart");
+		std::istringstream largeStream(large);
+		tw.appendFile("chart/large",largeStream,large.size());
+		tw.appendFile("chart/small","name: test-app\n");
+		tw.endStream();
+		compressor.finish();
+		encoder.finish();
+	}
+	const std::string compressed=decodeBase64(encoded.str());
+	FileHandle dir=makeTemporaryDir("/tmp/slate_archive_test_");
+	struct DirCleaner{
+		const FileHandle& dir;
+		~DirCleaner(){ recursivelyDestroyDirectory(dir); }
+	} cleaner{dir};
+	extractGzippedTarball(compressed.data(),compressed.size(),dir+"/");
+	ENSURE_EQUAL(readFile(dir+"/chart/large"),large,"Streamed file contents should match the original");
+	ENSURE_EQUAL(readFile(dir+"/chart/small"),"name: test-app\n");
+	
+	//a stream which ends early must be reported rather than padded
+	std::stringstream tarBuffer;
+	TarWriter tw(tarBuffer);
+	std::istringstream shortStream("abc");
+	try{
+		tw.appendFile("chart/short",shortStream,10);
+		FAIL("Appending a stream shorter than its stated size should fail");
+	}catch(std::runtime_error&){}
+}
+
+TEST(ParallelGzipCompression){
+	//compressible, but not trivially so, and long enough to be split into
+	//several blocks, with a length which is not a multiple of the block size
+	std::string data;
+	unsigned int state=1;
+	while(data.size()<1000000){
+		state=state*1103515245+12345;
+		data+="line "+std::to_string((state>>16)%1000)+" of the input\n";
+	}
+	
+	const std::string serial=gzipCompress(data.data(),data.size());
+	const std::string parallel=gzipCompress(data.data(),data.size(),4);
+	ENSURE(parallel!=serial,"Large inputs should be compressed in blocks");
+	ENSURE_EQUAL(gzipDecompress(parallel.data(),parallel.size()),data,
+	             "Data compressed in parallel should decompress correctly");
+	{
+		std::stringstream compressedStream(parallel), decompressed;
+		gzipDecompress(compressedStream,decompressed);
+		ENSURE_EQUAL(decompressed.str(),data,
+		             "Data compressed in parallel should be readable as a single gzip stream");
+	}
+	
+	std::stringstream streamed;
+	{
+		GzipOutputStream compressor(streamed,4);
+		//write in pieces which do not line up with the blocks
+		for(std::size_t offset=0; offset<data.size(); offset+=10000)
+			compressor.write(data.data()+offset,std::min<std::size_t>(10000,data.size()-offset));
+		compressor.finish();
+	}
+	ENSURE_EQUAL(streamed.str(),parallel,"Stream and in-memory parallel compression should agree");
+}
+
+TEST(IncrementalTarballExtraction){
+	std::map<std::string,std::string> files={
+		{"chart/small","name: test-app\n"},
+		{"chart/large",std::string(300000,'x')+std::string(1001,'y')}
+	};
+	const std::string compressed=makeTarball(files);
+	
+	for(std::size_t pieceSize : {std::size_t(1),std::size_t(1000),compressed.size()}){
+		FileHandle dir=makeTemporaryDir("/tmp/slate_archive_test_");
+		struct DirCleaner{
+			const FileHandle& dir;
+			~DirCleaner(){ recursivelyDestroyDirectory(dir); }
+		} cleaner{dir};
+		GzippedTarballExtractor extractor(dir+"/");
+		for(std::size_t offset=0; offset<compressed.size(); offset+=pieceSize)
+			extractor.consume(compressed.data()+offset,std::min(pieceSize,compressed.size()-offset));
+		extractor.finish();
+		for(const auto& file : files)
+			ENSURE_EQUAL(readFile(dir+"/"+file.first),file.second,"Extracted file contents should match the original");
+	}
+	
+	{ //incomplete data should be detected
+		FileHandle dir=makeTemporaryDir("/tmp/slate_archive_test_");
+		struct DirCleaner{
+			const FileHandle& dir;
+			~DirCleaner(){ recursivelyDestroyDirectory(dir); }
+		} cleaner{dir};
+		GzippedTarballExtractor extractor(dir+"/");
+		extractor.consume(compressed.data(),compressed.size()-4);
+		try{
+			extractor.finish();
+			FAIL("Extracting a truncated tarball should fail");
+		}catch(std::runtime_error&){}
+	}
+}
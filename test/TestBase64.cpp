@@ -0,0 +1,158 @@
+#include "test.h"
+
+#include <climits>
+#include <random>
+
+#include <Archive.h>
+
+namespace{
+
+//The original bit-at-a-time implementations, against which the current codec
+//is checked
+
+const char referenceAlphabet[65]=
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+	"abcdefghijklmnopqrstuvwxyz"
+	"0123456789"
+	"+/";
+
+std::string referenceDecode(const std::string& coded){
+	static const signed char lookupTable[] = {
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+		-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,62,-1,-1,-1,63,
+		52,53,54,55,56,57,58,59,60,61,-1,-1,-1, 0,-1,-1,
+		-1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,
+		15,16,17,18,19,20,21,22,23,24,25,-1,-1,-1,-1,-1,
+		-1,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,
+		41,42,43,44,45,46,47,48,49,50,51,-1,-1,-1,-1,-1
+	};
+	std::size_t codedSize=coded.size();
+	while(codedSize && coded[codedSize-1]=='=')
+		codedSize--;
+	std::string decoded((codedSize*3)/4,'\0');
+	char* outData=&decoded.front();
+	unsigned char curBits=0;
+	for(const unsigned char next : coded){
+		if(next=='=')
+			break;
+		if(next>=128 || lookupTable[next]==-1)
+			throw std::runtime_error("Illegal base64 character");
+		unsigned char newBits=lookupTable[next];
+		unsigned char putBits=std::min(CHAR_BIT-curBits,6);
+		unsigned int mask=(((1u<<putBits)-1)<<(6-putBits));
+		*outData|=((newBits&mask)>>(6-putBits))<<(CHAR_BIT-curBits-putBits);
+		curBits+=putBits;
+		if(curBits==CHAR_BIT){
+			curBits=0;
+			outData++;
+			if(putBits<6){
+				putBits=6-putBits;
+				mask=(1u<<putBits)-1;
+				*outData|=(newBits&mask)<<(CHAR_BIT-putBits);
+				curBits=putBits;
+			}
+		}
+	}
+	return decoded;
+}
+
+std::string referenceEncode(const std::string& raw){
+	std::size_t pad=(3-raw.size()%3)%3;
+	std::size_t outLen=4*((raw.size()+2)/3);
+	std::string encoded(outLen,'=');
+	unsigned char availBits=CHAR_BIT;
+	std::size_t inputIdx=0;
+	for(std::size_t i=0; i<outLen-pad; i++){
+		unsigned char getBits=std::min((unsigned char)6,availBits);
+		unsigned int mask=((1u<<getBits)-1)<<(availBits-getBits);
+		unsigned char lutIdx=((raw[inputIdx]&mask)>>(availBits-getBits))<<(6-getBits);
+		availBits-=getBits;
+		if(availBits==0){
+			inputIdx++;
+			availBits=CHAR_BIT;
+			if(getBits<6){
+				getBits=6-getBits;
+				mask=((1u<<getBits)-1)<<(availBits-getBits);
+				lutIdx|=((raw[inputIdx]&mask)>>(availBits-getBits));
+				availBits-=getBits;
+			}
+		}
+		encoded[i]=referenceAlphabet[lutIdx];
+	}
+	return encoded;
+}
+
+const Base64Kernel allKernels[]={Base64Kernel::Scalar,Base64Kernel::SSSE3,Base64Kernel::AVX2};
+
+///Restores the default implementation when a test ends
+struct KernelSelection{
+	~KernelSelection(){ selectBase64Kernel(bestBase64Kernel()); }
+};
+
+}
+
+TEST(Base64KnownValues){
+	KernelSelection restore;
+	for(Base64Kernel kernel : allKernels){
+		if(!selectBase64Kernel(kernel))
+			continue;
+		ENSURE_EQUAL(encodeBase64(""),"");
+		ENSURE_EQUAL(encodeBase64("f"),"Zg==");
+		ENSURE_EQUAL(encodeBase64("fo"),"Zm8=");
+		ENSURE_EQUAL(encodeBase64("foo"),"Zm9v");
+		ENSURE_EQUAL(encodeBase64("foobar"),"Zm9vYmFy");
+		ENSURE_EQUAL(decodeBase64(""),"");
+		ENSURE_EQUAL(decodeBase64("Zg=="),"f");
+		ENSURE_EQUAL(decodeBase64("Zm8"),"fo");
+		ENSURE_EQUAL(decodeBase64("Zm9vYmFy"),"foobar");
+		//anything after the start of the padding is ignored
+		ENSURE_EQUAL(decodeBase64("Zm9v=mFy"),"foo");
+		ENSURE_EQUAL(decodeBase64("Zg==Zm9v"),"f");
+		for(const std::string bad : {"Zm9v YmFy","Zm9v$=="}){
+			try{
+				decodeBase64(bad);
+				FAIL("Decoding invalid data should throw");
+			}catch(std::runtime_error& err){}
+		}
+	}
+}
+
+TEST(Base64Fuzz){
+	KernelSelection restore;
+	std::mt19937 rng(61);
+	for(Base64Kernel kernel : allKernels){
+		if(!selectBase64Kernel(kernel))
+			continue;
+		for(unsigned int i=0; i<20000; i++){
+			//lengths span several vector blocks, so that both the blocks and
+			//the remainders are exercised
+			std::string raw(rng()%160,'\0');
+			for(char& c : raw)
+				c=rng();
+			const std::string encoded=encodeBase64(raw);
+			ENSURE_EQUAL(encoded,referenceEncode(raw),"Encoding should match the reference implementation");
+			ENSURE_EQUAL(decodeBase64(encoded),raw,"Decoding should invert encoding");
+			
+			//unpadded data of any length
+			const std::string truncated=encoded.substr(0,rng()%(encoded.find('=')==std::string::npos ? encoded.size()+1 : encoded.find('=')+1));
+			ENSURE_EQUAL(decodeBase64(truncated),referenceDecode(truncated),"Decoding should match the reference implementation");
+			
+			//damaged data must be rejected exactly when the part before any 
+			//padding fails the sanity check
+			if(truncated.empty())
+				continue;
+			std::string damaged=truncated;
+			damaged[rng()%damaged.size()]=rng();
+			const std::string data=damaged.substr(0,damaged.find('='));
+			std::string decoded(base64DecodedLength(damaged.size()),'\0');
+			std::size_t decodedLength;
+			bool valid=decodeBase64(damaged.data(),damaged.size(),&decoded[0],decodedLength);
+			ENSURE_EQUAL(valid,sanityCheckBase64(data),"Decoding should validate the data");
+			if(valid){
+				decoded.resize(decodedLength);
+				ENSURE_EQUAL(decoded,referenceDecode(data),"Decoding should match the reference implementation");
+			}
+		}
+	}
+}
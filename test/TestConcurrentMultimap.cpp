@@ -0,0 +1,68 @@
+#include "test.h"
+
+#include <atomic>
+#include <thread>
+
+#include <concurrent_multimap.h>
+
+TEST(MultimapSnapshotIsolation){
+	concurrent_multimap<std::string,int> map;
+	map.insert("a",1);
+	map.insert("a",2);
+	map.insert("a",3);
+	auto snapshot=map.find("a");
+	ENSURE_EQUAL(snapshot.first->size(),3,"All inserted values should be found");
+
+	map.insert("a",4);
+	map.erase("a",1);
+	ENSURE_EQUAL(snapshot.first->size(),3,"Later insertions and deletions should not alter a snapshot");
+	ENSURE(snapshot.first->count(1),"A deleted value should remain in an earlier snapshot");
+	ENSURE(!snapshot.first->count(4),"A newly inserted value should not appear in an earlier snapshot");
+
+	auto current=map.find("a");
+	ENSURE_EQUAL(current.first->size(),3,"Later snapshots should reflect modifications");
+	ENSURE(!current.first->count(1),"A deleted value should not be found");
+	ENSURE(current.first->count(4),"A newly inserted value should be found");
+
+	map.erase("a");
+	ENSURE_EQUAL(current.first->size(),3,"Erasing the key should not alter a snapshot");
+	ENSURE(!map.contains("a"),"An erased key should not be found");
+
+	auto missing=map.find("b");
+	ENSURE(missing.first,"Looking up a missing key should produce a valid snapshot");
+	ENSURE(missing.first->empty(),"Looking up a missing key should produce an empty snapshot");
+	ENSURE(missing.second<=std::chrono::steady_clock::now(),"Looking up a missing key should not produce an unexpired category");
+}
+
+TEST(MultimapConcurrentSnapshots){
+	concurrent_multimap<std::string,int> map;
+	const int nValues=2000;
+	std::atomic<bool> done(false);
+	std::atomic<unsigned int> inconsistent(0);
+
+	//Values are inserted in ascending order, so every consistent snapshot
+	//contains exactly the values less than its size.
+	std::vector<std::thread> readers;
+	for(unsigned int i=0; i<4; i++){
+		readers.emplace_back([&](){
+			while(!done.load()){
+				auto snapshot=map.find("key");
+				const auto& values=*snapshot.first;
+				for(int j=0; j<(int)values.size(); j++){
+					if(!values.count(j)){
+						inconsistent++;
+						break;
+					}
+				}
+			}
+		});
+	}
+	for(int i=0; i<nValues; i++)
+		map.insert_or_assign("key",i);
+	done=true;
+	for(auto& reader : readers)
+		reader.join();
+
+	ENSURE_EQUAL(inconsistent.load(),0,"Every snapshot should be consistent");
+	ENSURE_EQUAL(map.count("key"),nValues,"All inserted values should be present");
+}
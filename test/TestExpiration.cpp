@@ -0,0 +1,153 @@
+#include "test.h"
+
+#include <map>
+#include <thread>
+
+#include <Expiration.h>
+#include <PersistentStore.h>
+
+namespace{
+
+///Records the keys passed to it, and the ticks at which they arrived
+struct RecordingTarget : public ExpiryTarget{
+	std::map<std::string,unsigned int> reclaimed;
+	unsigned int currentTick=0;
+	unsigned int calls=0;
+	void reclaim(const std::vector<std::string>& keys) override{
+		calls++;
+		for(const auto& key : keys)
+			reclaimed[key]=currentTick;
+	}
+};
+
+///Wait for the expiration wheel's background thread to bring about a 
+///condition, giving up after a generous limit so that a loaded machine does
+///not cause spurious failures
+template<typename Condition>
+bool waitFor(Condition condition){
+	const auto limit=std::chrono::steady_clock::now()+std::chrono::seconds(5);
+	while(!condition()){
+		if(std::chrono::steady_clock::now()>limit)
+			return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	return true;
+}
+
+}
+
+TEST(TimingWheelDeadlines){
+	using namespace std::chrono;
+	const steady_clock::time_point start;
+	const milliseconds resolution(10);
+	TimingWheel wheel(resolution,start);
+	auto target=std::make_shared<RecordingTarget>();
+
+	//deadlines spanning every level of the wheel, and beyond
+	const std::vector<unsigned int> deadlines={1,2,63,64,65,100,4095,4096,4097,
+	                                           262143,262144,300000,20000000};
+	for(unsigned int deadline : deadlines)
+		wheel.schedule(start+deadline*resolution,target,std::to_string(deadline));
+	//a deadline which is not a whole number of ticks is rounded up
+	wheel.schedule(start+milliseconds(15),target,"rounded");
+	ENSURE_EQUAL(wheel.size(),deadlines.size()+1);
+
+	//advance in irregular steps, as a delayed background thread might
+	unsigned int tick=0;
+	while(tick<20000000){
+		tick+=(tick<300000 ? 7 : 4093);
+		target->currentTick=tick;
+		wheel.advance(start+tick*resolution);
+	}
+	ENSURE_EQUAL(wheel.size(),0,"All entries should have been reclaimed");
+	ENSURE_EQUAL(target->reclaimed.size(),deadlines.size()+1);
+	for(unsigned int deadline : deadlines){
+		ENSURE(target->reclaimed.count(std::to_string(deadline)),"Entry with deadline "+std::to_string(deadline)+" should be reclaimed");
+		unsigned int reclaimedAt=target->reclaimed[std::to_string(deadline)];
+		ENSURE(reclaimedAt>=deadline,"Entry with deadline "+std::to_string(deadline)+" should not be reclaimed early");
+		ENSURE(reclaimedAt<deadline+(deadline<300000 ? 7 : 4093),"Entry with deadline "+std::to_string(deadline)+" should be reclaimed by the first advance after its deadline");
+	}
+	ENSURE_EQUAL(target->reclaimed["rounded"],7);
+}
+
+TEST(TimingWheelBatchesAndTargetLifetime){
+	using namespace std::chrono;
+	const steady_clock::time_point start;
+	const milliseconds resolution(10);
+	TimingWheel wheel(resolution,start);
+	auto target=std::make_shared<RecordingTarget>();
+	auto destroyed=std::make_shared<RecordingTarget>();
+	for(unsigned int i=0; i<100; i++){
+		wheel.schedule(start+seconds(1),target,"key"+std::to_string(i));
+		wheel.schedule(start+seconds(1),destroyed,"key"+std::to_string(i));
+	}
+	destroyed.reset();
+	wheel.advance(start+milliseconds(990));
+	ENSURE_EQUAL(target->calls,0,"Nothing should be reclaimed before its deadline");
+	wheel.advance(start+seconds(1));
+	ENSURE_EQUAL(target->calls,1,"Entries due at the same time should be reclaimed in one batch");
+	ENSURE_EQUAL(target->reclaimed.size(),100);
+	ENSURE_EQUAL(wheel.size(),0,"Entries for destroyed targets should be dropped");
+
+	//deadlines which have already passed are handled by the next advance
+	wheel.schedule(start,target,"late");
+	wheel.advance(start+seconds(1)+resolution);
+	ENSURE(target->reclaimed.count("late"),"An entry whose deadline has passed should be reclaimed");
+}
+
+TEST(CoarseClockAdvances){
+	using namespace std::chrono;
+	auto first=coarse_clock::now();
+	ENSURE(first<=steady_clock::now());
+	std::this_thread::sleep_for(milliseconds(100));
+	auto second=coarse_clock::now();
+	ENSURE(second-first>=milliseconds(50),"The coarse clock should advance");
+	ENSURE(steady_clock::now()-second<=milliseconds(100),"The coarse clock should not lag far behind");
+}
+
+TEST(ExpiringCacheReclaimsOnlyExpiredRecords){
+	using namespace std::chrono;
+	ExpiringCache<std::string> cache;
+	const std::size_t scheduled=expirationWheel().size();
+	cache.insert_or_assign("short",CacheRecord<std::string>("a",milliseconds(20)));
+	cache.insert_or_assign("refreshed",CacheRecord<std::string>("b",milliseconds(20)));
+	for(unsigned int i=0; i<5; i++)
+		cache.insert_or_assign("refreshed",CacheRecord<std::string>("b",milliseconds(300)));
+	ENSURE_EQUAL(expirationWheel().size()-scheduled,2,"Replacing a record should not schedule it again");
+	
+	ENSURE(waitFor([&]{ return !cache.contains("short"); }),"An expired record should be reclaimed");
+	ENSURE(cache.contains("refreshed"),"A record which was refreshed should be kept until it expires");
+	CacheRecord<std::string> record;
+	ENSURE(cache.find("refreshed",record) && record);
+	ENSURE(waitFor([&]{ return !cache.contains("refreshed"); }),"A refreshed record should be reclaimed once its new expiration passes");
+	ENSURE(waitFor([&]{ return expirationWheel().size()==scheduled; }),"No expirations should remain scheduled");
+}
+
+TEST(ExpiringCacheRetainsUntil){
+	using namespace std::chrono;
+	slate_atomic<steady_clock::time_point> until(coarse_clock::now()+milliseconds(300));
+	ExpiringCache<std::string> cache;
+	cache.retainUntil(until);
+	cache.insert_or_assign("record",CacheRecord<std::string>("a",milliseconds(20)));
+	std::this_thread::sleep_for(milliseconds(150));
+	ENSURE(cache.contains("record"),"An expired record should be kept while the cache-wide time is valid");
+	CacheRecord<std::string> record;
+	ENSURE(cache.find("record",record) && !record,"The retained record should still be expired");
+	ENSURE(waitFor([&]{ return !cache.contains("record"); }),"The record should be reclaimed once the cache-wide time passes");
+}
+
+TEST(ExpiringMultimapKeepsValidCategories){
+	using namespace std::chrono;
+	ExpiringMultimap<std::string> map;
+	const std::size_t scheduled=expirationWheel().size();
+	map.insert_or_assign("category",CacheRecord<std::string>("a",milliseconds(20)));
+	map.insert_or_assign("category",CacheRecord<std::string>("b",milliseconds(20)));
+	map.insert_or_assign("category",CacheRecord<std::string>("c",milliseconds(400)));
+	ENSURE_EQUAL(expirationWheel().size()-scheduled,1,"Only the creation of the category should be scheduled");
+	map.update_expiration("category",coarse_clock::now()+milliseconds(200));
+	
+	std::this_thread::sleep_for(milliseconds(100));
+	ENSURE_EQUAL(map.count("category"),3,"Expired records should be kept while their category is valid");
+	ENSURE(waitFor([&]{ return map.count("category")==1; }),"Expired records should be reclaimed once their category expires");
+	ENSURE(waitFor([&]{ return !map.contains("category"); }),"The category should be reclaimed once its last record expires");
+}
@@ -0,0 +1,84 @@
+#include "test.h"
+
+#include <chrono>
+#include <iostream>
+#include <set>
+#include <thread>
+
+#include <Entities.h>
+
+namespace{
+
+bool urlSafe(const std::string& text){
+	return text.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_")==std::string::npos;
+}
+
+}
+
+TEST(ChaCha20BlockVector){
+	//RFC 8439 section 2.3.2
+	const uint32_t key[8]={0x03020100,0x07060504,0x0b0a0908,0x0f0e0d0c,
+	                       0x13121110,0x17161514,0x1b1a1918,0x1f1e1d1c};
+	const uint32_t nonce[3]={0x09000000,0x4a000000,0x00000000};
+	const unsigned char expected[64]={
+		0x10,0xf1,0xe7,0xe4,0xd1,0x3b,0x59,0x15,0x50,0x0f,0xdd,0x1f,0xa3,0x20,0x71,0xc4,
+		0xc7,0xd1,0xf4,0xc7,0x33,0xc0,0x68,0x03,0x04,0x22,0xaa,0x9a,0xc3,0xd4,0x6c,0x4e,
+		0xd2,0x82,0x64,0x46,0x07,0x9f,0xaa,0x09,0x14,0xc2,0xd7,0x05,0xd9,0x8b,0x02,0xa2,
+		0xb5,0x12,0x9c,0xd1,0xde,0x16,0x4e,0xb9,0xcb,0xd0,0x83,0xe8,0xa2,0x50,0x3c,0x4e};
+	unsigned char output[64];
+	detail::chacha20Block(key,nonce,1,output);
+	for(unsigned int i=0; i<64; i++)
+		ENSURE_EQUAL((unsigned int)output[i],(unsigned int)expected[i],"Byte "+std::to_string(i)+" of the block should match");
+}
+
+TEST(IDFormat){
+	const std::vector<std::pair<std::string,std::string>> ids={
+		{IDGenerator::userIDPrefix,idGenerator.generateUserID()},
+		{IDGenerator::clusterIDPrefix,idGenerator.generateClusterID()},
+		{IDGenerator::groupIDPrefix,idGenerator.generateGroupID()},
+		{IDGenerator::instanceIDPrefix,idGenerator.generateInstanceID()},
+		{IDGenerator::secretIDPrefix,idGenerator.generateSecretID()},
+	};
+	for(const auto& id : ids){
+		ENSURE_EQUAL(id.second.substr(0,id.first.size()),id.first,"IDs should start with their prefix");
+		ENSURE_EQUAL(id.second.size(),id.first.size()+11,"The random part of an ID should be 11 characters");
+		ENSURE(urlSafe(id.second.substr(id.first.size())),"IDs should be URL-safe base64: "+id.second);
+	}
+	for(unsigned int i=0; i<100; i++){
+		std::string token=idGenerator.generateUserToken();
+		ENSURE_EQUAL(token.size(),22,"Tokens should be 22 characters");
+		ENSURE(urlSafe(token),"Tokens should be URL-safe base64: "+token);
+		//each half encodes 64 bits, so the last character of each carries only
+		//four bits, and the two low bits of its value are zero
+		const std::string alphabet="ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+		ENSURE_EQUAL(alphabet.find(token[10])%4,0);
+		ENSURE_EQUAL(alphabet.find(token[21])%4,0);
+	}
+}
+
+TEST(ConcurrentIDGeneration){
+	//IDs generated by several threads at once should all be distinct; the rate
+	//is reported so that changes to the generator can be compared
+	const unsigned int nThreads=4, perThread=100000;
+	std::vector<std::vector<std::string>> results(nThreads);
+	auto start=std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for(unsigned int i=0; i<nThreads; i++){
+		threads.emplace_back([&results,i](){
+			results[i].reserve(perThread);
+			for(unsigned int j=0; j<perThread; j++)
+				results[i].push_back(idGenerator.generateInstanceID());
+		});
+	}
+	for(auto& thread : threads)
+		thread.join();
+	std::chrono::duration<double> elapsed=std::chrono::steady_clock::now()-start;
+	std::cout << nThreads << " threads generated " << nThreads*perThread << " IDs in "
+	  << elapsed.count() << " seconds (" << (nThreads*perThread/elapsed.count()/1e6)
+	  << "M IDs/s)" << std::endl;
+
+	std::set<std::string> distinct;
+	for(const auto& result : results)
+		distinct.insert(result.begin(),result.end());
+	ENSURE_EQUAL(distinct.size(),nThreads*perThread,"All IDs should be distinct");
+}
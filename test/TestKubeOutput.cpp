@@ -0,0 +1,174 @@
+#include "test.h"
+
+#include <KubeOutput.h>
+
+using namespace kubernetes;
+
+TEST(ParseHelmSearch){
+	const std::string output=R"([{"Name":"slate/nginx","Version":"1.1.0","AppVersion":"1.15.2","Description":"A web server, \"fast\""},)"
+	  R"({"Name":"slate/osg-frontier-squid","Version":"0.2.0","AppVersion":"squid-3","Description":"Squid","Extra":{"Name":"ignored"}}])";
+	auto charts=parseHelmSearch(output);
+	ENSURE_EQUAL(charts.size(),2);
+	ENSURE_EQUAL(charts[0].name,"slate/nginx");
+	ENSURE_EQUAL(charts[0].chartVersion,"1.1.0");
+	ENSURE_EQUAL(charts[0].appVersion,"1.15.2");
+	ENSURE_EQUAL(charts[0].description,"A web server, \"fast\"");
+	ENSURE_EQUAL(charts[1].name,"slate/osg-frontier-squid","Fields of nested objects should be ignored");
+
+	ENSURE(parseHelmSearch("No results found\n").empty());
+	ENSURE(parseHelmSearch("[]\n").empty());
+	ENSURE(parseHelmSearch("").empty());
+
+	bool threw=false;
+	try{
+		parseHelmSearch("NAME\tCHART VERSION\tAPP VERSION\tDESCRIPTION\n");
+	}catch(std::runtime_error&){
+		threw=true;
+	}
+	ENSURE(threw,"Tabular output should be rejected");
+	
+	const std::string helm3=R"([{"name":"slate/nginx","version":"1.1.0","app_version":"1.15.2","description":"A web server"}])";
+	charts=parseHelmSearch(helm3);
+	ENSURE_EQUAL(charts.size(),1);
+	ENSURE_EQUAL(charts[0].name,"slate/nginx");
+	ENSURE_EQUAL(charts[0].chartVersion,"1.1.0");
+	ENSURE_EQUAL(charts[0].appVersion,"1.15.2");
+	ENSURE_EQUAL(charts[0].description,"A web server");
+	
+	threw=false;
+	try{
+		parseHelmSearch(R"([{"chart":"slate/nginx","chartVersion":"1.1.0"}])");
+	}catch(std::runtime_error&){
+		threw=true;
+	}
+	ENSURE(threw,"Output with an unrecognized schema should be rejected");
+}
+
+TEST(ParseHelmList){
+	const std::string output=R"({"Next":"release-c","Releases":[)"
+	  R"({"Name":"release-a","Revision":3,"Updated":"Mon Jan  7 10:00:00 2019","Status":"DEPLOYED","Chart":"nginx-1.1.0","AppVersion":"1.15.2","Namespace":"slate-group-a"},)"
+	  R"({"Name":"release-b","Revision":1,"Updated":"Tue Jan  8 11:00:00 2019","Status":"FAILED","Chart":"squid-0.2.0","AppVersion":"","Namespace":"slate-group-b"}]})";
+	auto list=parseHelmList(output);
+	ENSURE_EQUAL(list.next,"release-c");
+	ENSURE_EQUAL(list.releases.size(),2);
+	ENSURE_EQUAL(list.releases[0].name,"release-a");
+	ENSURE_EQUAL(list.releases[0].revision,3);
+	ENSURE_EQUAL(list.releases[0].updated,"Mon Jan  7 10:00:00 2019");
+	ENSURE_EQUAL(list.releases[0].status,"DEPLOYED");
+	ENSURE_EQUAL(list.releases[0].chart,"nginx-1.1.0");
+	ENSURE_EQUAL(list.releases[0].appVersion,"1.15.2");
+	ENSURE_EQUAL(list.releases[0].namespaceName,"slate-group-a");
+	ENSURE_EQUAL(list.releases[1].name,"release-b");
+	ENSURE_EQUAL(list.releases[1].status,"FAILED");
+
+	auto empty=parseHelmList("\n");
+	ENSURE(empty.releases.empty(),"Helm prints nothing when there are no releases");
+	ENSURE(empty.next.empty());
+	
+	const std::string helm3=R"([{"name":"release-a","namespace":"slate-group-a","revision":"3","updated":"2019-01-07 10:00:00.000000000 +0000 UTC",)"
+	  R"("status":"deployed","chart":"nginx-1.1.0","app_version":"1.15.2"}])";
+	list=parseHelmList(helm3);
+	ENSURE(list.next.empty());
+	ENSURE_EQUAL(list.releases.size(),1);
+	ENSURE_EQUAL(list.releases[0].name,"release-a");
+	ENSURE_EQUAL(list.releases[0].revision,3);
+	ENSURE_EQUAL(list.releases[0].status,"deployed");
+	ENSURE_EQUAL(list.releases[0].chart,"nginx-1.1.0");
+	ENSURE_EQUAL(list.releases[0].appVersion,"1.15.2");
+	ENSURE_EQUAL(list.releases[0].namespaceName,"slate-group-a");
+	ENSURE(parseHelmList("[]").releases.empty());
+	
+	for(const std::string bad : {R"({"next":"","releases":[{"name":"release-a"}]})",
+	                             R"([{"Release":"release-a"}])"}){
+		bool threw=false;
+		try{
+			parseHelmList(bad);
+		}catch(std::runtime_error&){
+			threw=true;
+		}
+		ENSURE(threw,"Output with an unrecognized schema should be rejected");
+	}
+}
+
+TEST(ParseLargeHelmList){
+	const unsigned int nReleases=20000;
+	std::string output=R"({"Next":"","Releases":[)";
+	for(unsigned int i=0; i<nReleases; i++){
+		if(i)
+			output+=',';
+		output+=R"({"Name":"release-)"+std::to_string(i)+R"(","Revision":)"+std::to_string(i%7+1)
+		  +R"(,"Updated":"Mon Jan  7 10:00:00 2019","Status":"DEPLOYED","Chart":"app-1.0.0","AppVersion":"1.0","Namespace":"slate-group-)"
+		  +std::to_string(i%50)+R"("})";
+	}
+	output+="]}";
+	auto list=parseHelmList(output);
+	ENSURE_EQUAL(list.releases.size(),nReleases);
+	for(unsigned int i=0; i<nReleases; i++){
+		ENSURE_EQUAL(list.releases[i].name,"release-"+std::to_string(i));
+		ENSURE_EQUAL(list.releases[i].revision,i%7+1);
+		ENSURE_EQUAL(list.releases[i].namespaceName,"slate-group-"+std::to_string(i%50));
+	}
+}
+
+TEST(ParseHelmStatusPods){
+	const std::string output=R"({"name":"nginx-test","info":{"status":{"code":1,"resources":)"
+	  R"("==> v1/Service\nNAME        TYPE      CLUSTER-IP     PORT(S)  AGE\nnginx-test  NodePort  10.96.110.46  80/TCP   5m\n\n)"
+	  R"(==> v1/Pod(related)\nNAME                         READY  STATUS   RESTARTS  AGE\nnginx-test-5d8f7c8b5c-8xm2q  1/1    Running  0         5m\n)"
+	  R"(nginx-test-5d8f7c8b5c-q7zrc  1/1    Running  0         5m\n\n)"
+	  R"(==> v1/Deployment\nNAME        READY  UP-TO-DATE  AVAILABLE  AGE\nnginx-test  2/2    2           2          5m\n",)"
+	  R"("notes":"==> v1/Pod\nnot-a-pod"}},"namespace":"slate-group-test"})";
+	auto pods=parseHelmStatusPods(output);
+	ENSURE_EQUAL(pods.size(),2);
+	ENSURE_EQUAL(pods[0],"nginx-test-5d8f7c8b5c-8xm2q");
+	ENSURE_EQUAL(pods[1],"nginx-test-5d8f7c8b5c-q7zrc");
+	
+	const std::string helm3=R"({"name":"nginx-test","info":{"status":"deployed","resources":{)"
+	  R"("v1/Service":[{"kind":"Service","metadata":{"name":"nginx-test"}}],)"
+	  R"json("v1/Pod(related)":[{"kind":"Pod","metadata":{"name":"nginx-test-5d8f7c8b5c-8xm2q","labels":{"name":"ignored"}}},)json"
+	  R"({"kind":"Pod","metadata":{"name":"nginx-test-5d8f7c8b5c-q7zrc"}}]}},"namespace":"slate-group-test"})";
+	pods=parseHelmStatusPods(helm3);
+	ENSURE_EQUAL(pods.size(),2);
+	ENSURE_EQUAL(pods[0],"nginx-test-5d8f7c8b5c-8xm2q");
+	ENSURE_EQUAL(pods[1],"nginx-test-5d8f7c8b5c-q7zrc");
+	
+	for(const std::string bad : {std::string(R"({"name":"nginx-test","info":{"status":"deployed"},"namespace":"slate-group-test"})"),
+	                             std::string("")}){
+		bool threw=false;
+		try{
+			parseHelmStatusPods(bad);
+		}catch(std::runtime_error&){
+			threw=true;
+		}
+		ENSURE(threw,"Output which does not list the release's resources should be rejected");
+	}
+}
+
+TEST(ParseKubectlNames){
+	const std::string list=R"({"apiVersion":"v1","items":[)"
+	  R"({"kind":"Secret","metadata":{"name":"default-token-abcde","labels":{"name":"ignored"}},"data":{"token":"c2VjcmV0"}},)"
+	  R"({"kind":"Secret","metadata":{"name":"my-secret","namespace":"slate-group-a"},"data":{"name":"bm90IGEgbmFtZQ=="}}],)"
+	  R"("kind":"List","metadata":{"resourceVersion":""}})";
+	auto names=parseItemNames(list);
+	ENSURE_EQUAL(names.size(),2);
+	ENSURE_EQUAL(names[0],"default-token-abcde");
+	ENSURE_EQUAL(names[1],"my-secret");
+	ENSURE(parseItemNames(R"({"apiVersion":"v1","items":[],"kind":"List"})").empty());
+
+	const std::string pod=R"({"metadata":{"name":"pod-a"},"spec":{"containers":[)"
+	  R"({"name":"web","image":"nginx","ports":[{"name":"http","containerPort":80}]},{"name":"sidecar","image":"busybox"}]},)"
+	  R"("status":{"containerStatuses":[{"name":"web","ready":true}]}})";
+	auto containers=parsePodContainerNames(pod);
+	ENSURE_EQUAL(containers.size(),2);
+	ENSURE_EQUAL(containers[0],"web");
+	ENSURE_EQUAL(containers[1],"sidecar");
+}
+
+TEST(ParseNameColumn){
+	auto names=parseNameColumn("default-token-abcde\nmy-secret\r\n\n  other-secret  \n");
+	ENSURE_EQUAL(names.size(),3);
+	ENSURE_EQUAL(names[0],"default-token-abcde");
+	ENSURE_EQUAL(names[1],"my-secret");
+	ENSURE_EQUAL(names[2],"other-secret");
+	ENSURE(parseNameColumn("").empty());
+	ENSURE(parseNameColumn("\n").empty(),"kubectl may print nothing but a newline when there are no objects");
+}
@@ -0,0 +1,127 @@
+#include "test.h"
+
+#include <ServerUtilities.h>
+
+TEST(CheapRequestRateLimit){
+	using namespace httpRequests;
+	TestContext tc({"--cheapRequestRate=0.001","--cheapRequestBurst=3"});
+
+	std::string adminKey=getPortalToken();
+	std::string userURL=tc.getAPIServerURL()+"/"+currentAPIVersion+"/users?token="+adminKey;
+	for(unsigned int i=0; i<3; i++){
+		auto listResp=httpGet(userURL);
+		ENSURE_EQUAL(listResp.status,200,"Requests within the burst size should be accepted");
+	}
+	auto listResp=httpGet(userURL);
+	ENSURE_EQUAL(listResp.status,429,"Requests beyond the burst size should be rejected");
+}
+
+TEST(SeparateCostBudgets){
+	using namespace httpRequests;
+	TestContext tc({"--expensiveRequestRate=0.001","--expensiveRequestBurst=1"});
+
+	std::string adminKey=getPortalToken();
+	std::string instanceURL=tc.getAPIServerURL()+"/"+currentAPIVersion+"/instances/Instance_does-not-exist?token="+adminKey;
+	auto deleteResp=httpDelete(instanceURL);
+	ENSURE_EQUAL(deleteResp.status,404,"The first expensive request should be handled");
+	deleteResp=httpDelete(instanceURL);
+	ENSURE_EQUAL(deleteResp.status,429,"The second expensive request should be rejected");
+
+	auto listResp=httpGet(tc.getAPIServerURL()+"/"+currentAPIVersion+"/users?token="+adminKey);
+	ENSURE_EQUAL(listResp.status,200,"Cheap requests should not be limited by the expensive budget");
+}
+
+TEST(SeparateTokenBudgets){
+	using namespace httpRequests;
+	TestContext tc({"--cheapRequestRate=0.001","--cheapRequestBurst=2"});
+
+	std::string adminKey=getPortalToken();
+
+	std::string tok;
+	{ //create a user
+		rapidjson::Document request(rapidjson::kObjectType);
+		auto& alloc = request.GetAllocator();
+		request.AddMember("apiVersion", currentAPIVersion, alloc);
+		rapidjson::Value metadata(rapidjson::kObjectType);
+		metadata.AddMember("name", "Bob", alloc);
+		metadata.AddMember("email", "bob@place.com", alloc);
+		metadata.AddMember("phone", "555-5555", alloc);
+		metadata.AddMember("institution", "Center of the Earth University", alloc);
+		metadata.AddMember("admin", false, alloc);
+		metadata.AddMember("globusID", "Bob's Globus ID", alloc);
+		request.AddMember("metadata", metadata, alloc);
+		auto createResp=httpPost(tc.getAPIServerURL()+"/"+currentAPIVersion+"/users?token="+adminKey,to_string(request));
+		ENSURE_EQUAL(createResp.status,200,"User creation request should succeed");
+		rapidjson::Document createData;
+		createData.Parse(createResp.body);
+		tok=createData["metadata"]["access_token"].GetString();
+	}
+
+	//use up the rest of the admin's budget
+	auto listResp=httpGet(tc.getAPIServerURL()+"/"+currentAPIVersion+"/users?token="+adminKey);
+	ENSURE_EQUAL(listResp.status,200,"Requests within the burst size should be accepted");
+	listResp=httpGet(tc.getAPIServerURL()+"/"+currentAPIVersion+"/users?token="+adminKey);
+	ENSURE_EQUAL(listResp.status,429,"Requests beyond the burst size should be rejected");
+
+	listResp=httpGet(tc.getAPIServerURL()+"/"+currentAPIVersion+"/users?token="+tok);
+	ENSURE_EQUAL(listResp.status,200,"Other tokens should have independent budgets");
+}
+
+TEST(UnknownTokensShareBudget){
+	using namespace httpRequests;
+	TestContext tc({"--cheapRequestRate=0.001","--cheapRequestBurst=2"});
+
+	std::string baseURL=tc.getAPIServerURL()+"/"+currentAPIVersion+"/users?token=";
+	auto listResp=httpGet(baseURL+"made-up-token-1");
+	ENSURE_EQUAL(listResp.status,403,"Requests with unknown tokens should be handled");
+	listResp=httpGet(baseURL+"made-up-token-2");
+	ENSURE_EQUAL(listResp.status,403,"Requests with unknown tokens should be handled");
+	listResp=httpGet(baseURL+"made-up-token-3");
+	ENSURE_EQUAL(listResp.status,429,"A new unknown token should not get a fresh budget");
+	listResp=httpGet(baseURL.substr(0,baseURL.find('?')));
+	ENSURE_EQUAL(listResp.status,429,"Requests without tokens should share the same budget");
+
+	std::string adminKey=getPortalToken();
+	listResp=httpGet(baseURL+adminKey);
+	ENSURE_EQUAL(listResp.status,200,"Users should have budgets separate from the anonymous budget");
+}
+
+TEST(MultiplexRequestsChargedIndividually){
+	using namespace httpRequests;
+	TestContext tc({"--expensiveRequestRate=0.001","--expensiveRequestBurst=2","--maxMultiplexRequests=4"});
+
+	std::string adminKey=getPortalToken();
+	auto makeBundle=[&](unsigned int size){
+		rapidjson::Document bundle(rapidjson::kObjectType);
+		auto& alloc = bundle.GetAllocator();
+		for(unsigned int i=0; i<size; i++){
+			rapidjson::Value request(rapidjson::kObjectType);
+			request.AddMember("method", "DELETE", alloc);
+			rapidjson::Value key("/"+currentAPIVersion+"/instances/Instance_does-not-exist-"+std::to_string(i)+"?token="+adminKey, alloc);
+			bundle.AddMember(key, request, alloc);
+		}
+		return to_string(bundle);
+	};
+	std::string multiplexURL=tc.getAPIServerURL()+"/"+currentAPIVersion+"/multiplex?token="+adminKey;
+	
+	auto multiResp=httpPost(multiplexURL,makeBundle(5));
+	ENSURE_EQUAL(multiResp.status,400,"Bundles with too many requests should be rejected");
+	
+	multiResp=httpPost(multiplexURL,makeBundle(3));
+	ENSURE_EQUAL(multiResp.status,200,"The bundle should be admitted");
+	rapidjson::Document results;
+	results.Parse(multiResp.body);
+	ENSURE(results.IsObject());
+	ENSURE_EQUAL(results.MemberCount(),3);
+	unsigned int handled=0, limited=0;
+	for(const auto& result : results.GetObject()){
+		if(result.value["status"].GetInt()==404)
+			handled++;
+		else if(result.value["status"].GetInt()==429){
+			limited++;
+			ENSURE(result.value.HasMember("retryAfter"),"Rejected requests should say when to try again");
+		}
+	}
+	ENSURE_EQUAL(handled,2,"Requests within the budget should be handled");
+	ENSURE_EQUAL(limited,1,"Each request within a bundle should be charged");
+}
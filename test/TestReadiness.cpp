@@ -0,0 +1,32 @@
+#include "test.h"
+
+#include <ServerUtilities.h>
+
+TEST(HealthAndReadiness){
+	using namespace httpRequests;
+	TestContext tc;
+
+	auto healthResp=httpGet(tc.getAPIServerURL()+"/healthz");
+	ENSURE_EQUAL(healthResp.status,200,"Liveness probe should succeed");
+
+	auto readyResp=httpGet(tc.getAPIServerURL()+"/readyz");
+	ENSURE_EQUAL(readyResp.status,200,"Readiness probe should succeed once the server is ready");
+	rapidjson::Document data;
+	data.Parse(readyResp.body);
+	ENSURE(data.HasMember("ready"));
+	ENSURE(data["ready"].GetBool());
+	ENSURE(data.HasMember("stages"));
+	ENSURE(data["stages"].IsArray());
+	bool foundDatabase=false;
+	for(rapidjson::SizeType i=0; i<data["stages"].Size(); i++){
+		const auto& stage=data["stages"][i];
+		ENSURE(stage.HasMember("name"));
+		ENSURE(stage.HasMember("status"));
+		if(stage["name"].GetString()==std::string("database")){
+			foundDatabase=true;
+			ENSURE_EQUAL(stage["status"].GetString(),std::string("Complete"),
+			             "The database stage must be complete when the server is ready");
+		}
+	}
+	ENSURE(foundDatabase,"Readiness should report the database stage");
+}
@@ -0,0 +1,173 @@
+#include "test.h"
+
+#include <random>
+
+#include <ServerUtilities.h>
+
+namespace{
+
+//The original implementations, which rescanned or copied the data repeatedly,
+//against which the current ones are checked
+
+std::string referenceUnescape(const std::string& message){
+	std::string result = message;
+	std::vector<std::pair<std::string,std::string>> escaped;
+	escaped.push_back(std::make_pair("\\n", "\n"));
+	escaped.push_back(std::make_pair("\\t", "\t"));
+	escaped.push_back(std::make_pair("\\\\", "\\"));
+	escaped.push_back(std::make_pair("\\\"", "\""));
+
+	for (auto item : escaped){
+		auto replace = item.first;
+		auto found = result.find(replace);
+		while (found != std::string::npos){
+			result.replace(found, replace.length(), item.second);
+			found = result.find(replace);
+		}
+	}
+	
+	return result;
+}
+
+std::string referenceReduceYAML(const std::string& input){
+	enum State{
+		def, //default, not in pure whitespace or a comment
+		whitespace, //a line which has so far only contained whitespace
+		comment,
+		newline //directly _after_ a newline character
+	} state=def;
+	std::size_t pos=0, last_handled=0, line=1;
+	std::string output;
+	for(char c : input){
+		switch(state){
+			case def:
+				if(c=='#'){
+					state=comment;
+					if(pos>last_handled){
+						output+=input.substr(last_handled,pos-last_handled)+'\n';
+						last_handled=pos;
+					}
+				}
+				if(c=='\n'){
+					//copy this line, in case next turns out to be elidable
+					if(pos-last_handled) //if there was something there
+						output+=input.substr(last_handled,pos-last_handled)+'\n';
+					last_handled=pos;
+					state=newline;
+				}
+				break;
+			case whitespace:
+				if(c=='\n'){
+					//whole line was whitespace, mark it handled so it will not be copied
+					last_handled=pos;
+					state=newline;
+				}
+				else if(c=='#'){
+					state=comment;
+				}
+				else if(!std::isspace(c)){
+					state=def;
+				}
+				break;
+			case comment:
+				//comments only end at newlines
+				if(c=='\n'){
+					//mark everything in the last segment handled so it will not be copied
+					last_handled=pos;
+					state=newline;
+				}
+				break;
+			case newline:
+				line++;
+				last_handled=pos; //never explicitly copy newlines
+				if(c=='\n'){
+					state=newline;
+					//ignore empty line
+					last_handled=pos;
+				}
+				else if(std::isspace(c)){
+					state=whitespace;
+				}
+				else if(c=='#'){
+					state=comment;
+				}
+				else{
+					state=def;
+				}
+				break;
+		}
+		pos++;
+	}
+	if(state==def){
+		//copy this line, in case next turns out to be elidable
+		output+=input.substr(last_handled,pos-last_handled);
+		last_handled=pos;
+		state=newline;
+	}
+	//remove any trailing newline character
+	if(!output.empty() && output.back()=='\n')
+		output.resize(output.size()-1);
+	return output;
+}
+
+std::string referenceFilterValuesFile(std::string data){
+	const static std::string startMarker="### SLATE-START ###";
+	const static std::string endMarker="### SLATE-END ###";
+	std::size_t pos=0;
+	while(true){
+		std::size_t startPos=data.find(startMarker,pos);
+		if(startPos==std::string::npos)
+			break;
+		std::size_t endPos=data.find(endMarker,startPos);
+		if(endPos==std::string::npos){
+			break;
+		}
+		data.erase(startPos,endPos-startPos + endMarker.size());
+		pos=startPos;
+	}
+	return data;
+}
+
+///Generate text built from the characters and markers to which the filters 
+///are sensitive, so that random inputs exercise their special cases densely
+std::string randomText(std::mt19937& rng){
+	static const std::vector<std::string> pieces={
+		"a","b","n","t","key: value",":"," "," ","\t","\r","\n","\n","#",
+		"\\","\\","\"","'","\xC3\xA9",
+		"### SLATE-START ###","### SLATE-END ###","### SLATE-"," ###",
+	};
+	std::string text;
+	std::size_t length=rng()%48;
+	for(std::size_t i=0; i<length; i++)
+		text+=pieces[rng()%pieces.size()];
+	return text;
+}
+
+}
+
+TEST(TextFilterKnownValues){
+	ENSURE_EQUAL(unescape(R"(a\nb\tc\"d\\e)"),"a\nb\tc\"d\\e");
+	ENSURE_EQUAL(unescape(R"(\\n)"),"\\\n","Backslash runs have always been collapsed after newlines were unescaped");
+	ENSURE_EQUAL(unescape(R"(\\\\)"),"\\");
+	ENSURE_EQUAL(unescape(R"(\\")"),"\"");
+	ENSURE_EQUAL(unescape("trailing\\"),"trailing\\");
+	
+	ENSURE_EQUAL(reduceYAML("  \nfoo: bar # comment\n  \n# comment\n  baz: quux\n"),"  \nfoo: bar \n  baz: quux");
+	ENSURE_EQUAL(reduceYAML(""),"");
+	
+	ENSURE_EQUAL(filterValuesFile("a\n### SLATE-START ###\nsecret\n### SLATE-END ###\nb\n"),"a\n\nb\n");
+	ENSURE_EQUAL(filterValuesFile("a ### SLATE-START ### b"),"a ### SLATE-START ### b","Unbalanced markers should leave the data unaltered");
+	ENSURE_EQUAL(filterValuesFile("### SLATE-START ### SLATE-END ###x"),"x","The end marker may overlap the start marker");
+}
+
+TEST(TextFilterFuzz){
+	std::mt19937 rng(75);
+	for(unsigned int i=0; i<100000; i++){
+		const std::string text=randomText(rng);
+		ENSURE_EQUAL(unescape(text),referenceUnescape(text),"Unescaping should match the reference implementation");
+		ENSURE_EQUAL(reduceYAML(text),referenceReduceYAML(text),"YAML reduction should match the reference implementation");
+		//mostly balanced markers, since unbalanced ones are logged as errors
+		const std::string values=(rng()%8 ? text+"### SLATE-END ###" : text);
+		ENSURE_EQUAL(filterValuesFile(values),referenceFilterValuesFile(values),"Values filtering should match the reference implementation");
+	}
+}
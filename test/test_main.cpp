@@ -90,11 +90,13 @@ void TestContext::waitServerReady(){
 			std::cerr.flush();
 		throw std::runtime_error("Child process output ended");
 	}
-	//wait just until the server begins responding to requests
+	//wait until the server reports that it can handle requests
 	while(true){
 		try{
-			auto resp=httpRequests::httpGet(getAPIServerURL()+"/"+currentAPIVersion+"/stats");
-			break; //if we got any reponse, assume that we're done
+			auto resp=httpRequests::httpGet(getAPIServerURL()+"/readyz");
+			if(resp.status==200)
+				break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
 		}catch(std::exception& ex){
 			//std::cout << "Exception: " << ex.what() << std::endl;
 			std::this_thread::sleep_for(std::chrono::milliseconds(100));
@@ -156,6 +158,9 @@ TestContext::TestContext(std::vector<std::string> options){
 	ENSURE_EQUAL(portResp.status,200);
 	serverPort=portResp.body;
 	
+	//most tests make requests in quick succession, so per-token rate limiting
+	//is off unless the test's own options turn it back on
+	options.insert(options.begin(),{"--cheapRequestRate=0","--expensiveRequestRate=0"});
 	options.insert(options.end(),{"--awsEndpoint","localhost:"+dbPort,"--port",serverPort});
 	server=startProcessAsync("./slate-service",options);
 	waitServerReady();